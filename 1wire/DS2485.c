@@ -52,6 +52,182 @@
 #include "DS2485.h"
 
 #include "one_wire.h" // one_wire_speeds...
+#include "one_wire_instrument.h"
+#include "one_wire_os.h" // microsecond clock
+#include "one_wire_stats.h"
+#ifdef DS2485_TRACE
+  #include "DS2485_trace.h"
+#endif
+
+/* **** Locals **** */
+// Shadow of the 1-Wire port configuration registers. The registers only change
+// when written here, by Master Reset, or by a script changing speed, so reads
+// are answered from the shadow and rewriting an unchanged value is skipped.
+static uint8_t portConfigShadow[RESERVED][2];
+static uint32_t portConfigShadowValid; // bit per register
+_Static_assert(RESERVED <= 32, "portConfigShadowValid needs a bit per register");
+
+void DS2485_InvalidatePortConfigShadow(void)
+{
+	portConfigShadowValid = 0;
+}
+
+// 1-Wire Script command and reply buffers. Every 1-Wire operation of the stack is a script of up to
+// DS2485_SCRIPT_MAX bytes each way, so they are kept here rather than on the caller's stack.
+// The DS2485 runs one command at a time; callers already serialize access to it.
+#define DS2485_SCRIPT_MAX 126
+static uint8_t scriptCommand[2 + DS2485_SCRIPT_MAX]; // command, length, script
+static uint8_t scriptReply[2 + DS2485_SCRIPT_MAX];   // length, result, script response
+
+/* **** Learned execution delays **** */
+// The delay before reading a response is an analytic estimate with generous padding.
+// In learning mode the response is read early and then polled (the DS2485 does not
+// acknowledge the read while it is still executing), which measures the true completion
+// time. Each command class keeps a least-squares fit of completion time against the
+// analytic estimate, so the fit follows data length, 1-Wire speed and timings. Once a
+// class has DS2485_LEARN_MIN_SAMPLES measurements, its fitted time plus the worst
+// residual seen is used instead of the estimate; a read that is still refused falls
+// back to polling and widens the margin.
+#define LEARN_START_PERCENT 25 // learning mode first reads the response this far into the estimate
+
+typedef struct {
+	double n, sx, sy, sxx, sxy; // least-squares sums
+	double slope, offset, maxResidual;
+	DS2485_delay_stats_T stats;
+} delayModel_T;
+
+static delayModel_T delayModels[DS2485_CLASS_COUNT];
+static bool delayLearning;
+
+void DS2485_SetDelayLearning(bool learn)
+{
+	delayLearning = learn;
+}
+
+void DS2485_ResetDelayLearning(void)
+{
+	memset(delayModels, 0, sizeof(delayModels));
+}
+
+void DS2485_GetDelayStats(DS2485_command_class_T commandClass, DS2485_delay_stats_T *stats)
+{
+	const delayModel_T *model = &delayModels[commandClass];
+	*stats = model->stats;
+	stats->slope = model->slope;
+	stats->offset_uSec = model->offset;
+	stats->margin_uSec = model->maxResidual + DS2485_LEARN_MARGIN_USEC;
+}
+
+// I2C time of a transfer (address byte and data, 9 clocks each), spent outside the execution delay
+static int transferTime_uSec(int bytes)
+{
+	return (int)((bytes + 1) * 9ULL * 1000000U / DS2485_I2C_CLOCKRATE);
+}
+
+static double predictDelay(const delayModel_T *model, int estimate_uSec)
+{
+	return model->slope * estimate_uSec + model->offset;
+}
+
+static void addDelaySample(delayModel_T *model, int estimate_uSec, double measured_uSec)
+{
+	double x = estimate_uSec, y = measured_uSec;
+	model->n += 1;
+	model->sx += x;
+	model->sy += y;
+	model->sxx += x*x;
+	model->sxy += x*y;
+	double denominator = model->n * model->sxx - model->sx * model->sx;
+	if (denominator > 1e-6 * model->n * model->sxx)
+	{
+		model->slope = (model->n * model->sxy - model->sx * model->sy) / denominator;
+	}
+	else
+	{
+		model->slope = 0; // every estimate alike so far: fit a constant
+	}
+	model->offset = (model->sy - model->slope * model->sx) / model->n;
+	double residual = y - predictDelay(model, estimate_uSec);
+	if (residual > model->maxResidual) model->maxResidual = residual;
+	model->stats.samples++;
+}
+
+/* **** Port calls **** */
+// Built with DS2485_TRACE, every exchange with the port is also passed to the recorder
+static int portExecuteCommand(const uint8_t *packet, int packetSize, int delay_uSec, uint8_t *response, int responseSize)
+{
+	ONEWIRE_INSTR_BEGIN(instrStart);
+#ifdef DS2485_TRACE
+	uint32_t start = DS2485_Trace_Now_uSec();
+	int error = DS2485_ExecuteCommand(packet, packetSize, delay_uSec, response, responseSize);
+	DS2485_Trace_Record(DS2485_TRACE_EXECUTE, start, packet, packetSize, delay_uSec, response, responseSize, error);
+#else
+	int error = DS2485_ExecuteCommand(packet, packetSize, delay_uSec, response, responseSize);
+#endif
+	ONEWIRE_INSTR_END(ONEWIRE_INSTR_DS2485_COMMAND, instrStart);
+	return error;
+}
+
+static int portReadResponse(int delay_uSec, uint8_t *response, int responseSize)
+{
+	ONEWIRE_INSTR_BEGIN(instrStart);
+#ifdef DS2485_TRACE
+	uint32_t start = DS2485_Trace_Now_uSec();
+	int error = DS2485_ReadResponse(delay_uSec, response, responseSize);
+	DS2485_Trace_Record(DS2485_TRACE_READ, start, NULL, 0, delay_uSec, response, responseSize, error);
+#else
+	int error = DS2485_ReadResponse(delay_uSec, response, responseSize);
+#endif
+	ONEWIRE_INSTR_END(ONEWIRE_INSTR_DS2485_POLL, instrStart);
+	return error;
+}
+
+static int executeCommand(DS2485_command_class_T commandClass, const uint8_t *packet, int packetSize, int estimate_uSec, uint8_t *response, int responseSize)
+{
+	delayModel_T *model = &delayModels[commandClass];
+	bool learned = !delayLearning && model->stats.samples >= DS2485_LEARN_MIN_SAMPLES;
+	int delay_uSec = estimate_uSec;
+	if (delayLearning)
+	{
+		delay_uSec = estimate_uSec * LEARN_START_PERCENT / 100;
+	}
+	else if (learned)
+	{
+		delay_uSec = (int)(predictDelay(model, estimate_uSec) + model->maxResidual + DS2485_LEARN_MARGIN_USEC);
+		if (delay_uSec < 0) delay_uSec = 0;
+	}
+
+	model->stats.commands++;
+	model->stats.estimated_uSec += estimate_uSec;
+	uint32_t start_uSec = ONEWIRE_OS_NOW_USEC();
+	int error = portExecuteCommand(packet, packetSize, delay_uSec, response, responseSize);
+	bool refused = (error == RB_NOT_READY); // the delay was too short, rather than the port sleeping longer
+	if (refused && !delayLearning) model->stats.earlyReads++;
+	// Poll, giving up well after the analytic estimate (the command or the DS2485 has failed)
+	while (error == RB_NOT_READY && (int)(ONEWIRE_OS_NOW_USEC() - start_uSec) < 2*estimate_uSec + 10*DS2485_POLL_USEC)
+	{
+		error = portReadResponse(DS2485_POLL_USEC, response, responseSize);
+	}
+	// Completion time: from the end of the command write to the start of the read that was answered
+	int waited_uSec = (int)(ONEWIRE_OS_NOW_USEC() - start_uSec) - transferTime_uSec(packetSize) - transferTime_uSec(responseSize);
+	if (waited_uSec < 0) waited_uSec = 0;
+	model->stats.waited_uSec += waited_uSec;
+	if (error) return error;
+	if (commandClass >= DS2485_CLASS_SCRIPT)
+	{
+		ONEWIRE_STATS_ADD(busy_uSec, (uint32_t)estimate_uSec); // 1-Wire commands hold the bus for about the estimate
+	}
+
+	if (delayLearning)
+	{
+		addDelaySample(model, estimate_uSec, waited_uSec);
+	}
+	else if (learned && refused && waited_uSec > delay_uSec)
+	{
+		model->maxResidual += waited_uSec - delay_uSec; // widen the margin by the time polling took
+	}
+	return 0;
+}
 
 /* **** Device Function Commands **** */
 int DS2485_WriteMemory(DS2485_memory_page_T pgNumber, const uint8_t *pgData)
@@ -73,7 +249,7 @@ int DS2485_WriteMemory(DS2485_memory_page_T pgNumber, const uint8_t *pgData)
     memcpy(&packet[3], &pgData[0], 32);          // Data
 
     //Execute Command
-	if ((error = DS2485_ExecuteCommand(packet, sizeof(packet), delay_msec*1000, response, sizeof(response))) != 0)
+	if ((error = executeCommand(DS2485_CLASS_MEMORY, packet, sizeof(packet), delay_msec*1000, response, sizeof(response))) != 0)
 	{
 		return error;
 	}
@@ -117,7 +293,7 @@ int DS2485_ReadMemory(DS2485_memory_page_T pgNumber, uint8_t *pgData)
 	packet[2] = pgNumber; 						 // Parameter
 
     //Execute Command
-	if ((error = DS2485_ExecuteCommand(packet, sizeof(packet), delay_msec*1000, response, sizeof(response))) != 0)
+	if ((error = executeCommand(DS2485_CLASS_MEMORY, packet, sizeof(packet), delay_msec*1000, response, sizeof(response))) != 0)
 	{
 		return error;
 	}
@@ -169,7 +345,7 @@ int DS2485_ReadStatus(DS2485_status_outputs_T output, uint8_t *status)
 	packet[2] = output; 						 // Parameter
 
     //Execute Command
-	if ((error = DS2485_ExecuteCommand(packet, sizeof(packet), delay_msec*1000, response, sizeof(response))) != 0)
+	if ((error = executeCommand(DS2485_CLASS_MEMORY, packet, sizeof(packet), delay_msec*1000, response, sizeof(response))) != 0)
 	{
 		return error;
 	}
@@ -212,7 +388,7 @@ int DS2485_SetI2cAddress(uint8_t newAddress)
 	packet[2] = newAddress << 1; 				 // Parameter
 
     //Execute Command
-	if ((error = DS2485_ExecuteCommand(packet, sizeof(packet), delay_msec*1000, response, sizeof(response))) != 0)
+	if ((error = executeCommand(DS2485_CLASS_MEMORY, packet, sizeof(packet), delay_msec*1000, response, sizeof(response))) != 0)
 	{
 		return error;
 	}
@@ -253,7 +429,7 @@ int DS2485_SetPageProtection(DS2485_memory_page_T pgNumber, DS2485_page_protecti
 	packet[3] = protection; 				 	 // Parameter
 
     //Execute Command
-	if ((error = DS2485_ExecuteCommand(packet, sizeof(packet), delay_msec*1000, response, sizeof(response))) != 0)
+	if ((error = executeCommand(DS2485_CLASS_MEMORY, packet, sizeof(packet), delay_msec*1000, response, sizeof(response))) != 0)
 	{
 		return error;
 	}
@@ -300,13 +476,19 @@ int DS2485_ReadOneWirePortConfig(DS2485_configuration_register_address_T reg, ui
 	uint8_t packet[txLength];
 	uint8_t response[rxLength];
 
+	if (reg < RESERVED && (portConfigShadowValid & (1UL << reg)))
+	{
+		memcpy(regData, portConfigShadow[reg], 2);
+		return RB_SUCCESS;
+	}
+
 	//Build command packet
 	packet[0] = DFC_READ_ONE_WIRE_PORT_CONFIG; 	 // Command
 	packet[1] = sizeof(packet) - 2;  			 // Command length byte
 	packet[2] = reg; 						     // Parameter
 
     //Execute Command
-	if ((error = DS2485_ExecuteCommand(packet, sizeof(packet), delay_usec, response, sizeof(response))) != 0)
+	if ((error = executeCommand(DS2485_CLASS_CONFIG, packet, sizeof(packet), delay_usec, response, sizeof(response))) != 0)
 	{
 		return error;
 	}
@@ -317,6 +499,16 @@ int DS2485_ReadOneWirePortConfig(DS2485_configuration_register_address_T reg, ui
 	switch (response[1]) {
 	case 0xAA:
 		error = RB_SUCCESS;
+		if (reg < RESERVED)
+		{
+			memcpy(portConfigShadow[reg], regData, 2);
+			portConfigShadowValid |= 1UL << reg;
+		}
+		else if (reg > 0x13)
+		{
+			memcpy(portConfigShadow, regData, sizeof(portConfigShadow)); // all registers, in order
+			portConfigShadowValid = (1UL << RESERVED) - 1;
+		}
 		break;
 
 	default:
@@ -339,6 +531,11 @@ int DS2485_WriteOneWirePortConfig(DS2485_configuration_register_address_T reg, c
 	uint8_t packet[txLength];
 	uint8_t response[rxLength];
 
+	if (reg < RESERVED && (portConfigShadowValid & (1UL << reg)) && memcmp(portConfigShadow[reg], regData, 2) == 0)
+	{
+		return RB_SUCCESS; // already set
+	}
+
 	//Build command packet
 	packet[0] = DFC_WRITE_ONE_WIRE_PORT_CONFIG; 	// Command
 	packet[1] = sizeof(packet) - 2;  			 	// Command length byte
@@ -347,8 +544,13 @@ int DS2485_WriteOneWirePortConfig(DS2485_configuration_register_address_T reg, c
 	packet[4] = regData[1]; 				 		// Data
 
 
+	if (reg < RESERVED)
+	{
+		portConfigShadowValid &= ~(1UL << reg); // unknown until the write succeeds
+	}
+
     //Execute Command
-	if ((error = DS2485_ExecuteCommand(packet, sizeof(packet), delay_usec, response, sizeof(response))) != 0)
+	if ((error = executeCommand(DS2485_CLASS_CONFIG, packet, sizeof(packet), delay_usec, response, sizeof(response))) != 0)
 	{
 		return error;
 	}
@@ -356,6 +558,11 @@ int DS2485_WriteOneWirePortConfig(DS2485_configuration_register_address_T reg, c
 	switch (response[1]) {
 	case 0xAA:
 		error = RB_SUCCESS;
+		if (reg < RESERVED)
+		{
+			memcpy(portConfigShadow[reg], regData, 2);
+			portConfigShadowValid |= 1UL << reg;
+		}
 		break;
 
 	case 0x77:
@@ -385,8 +592,10 @@ int DS2485_MasterReset(void)
 	//Build command packet
 	packet[0] = DFC_MASTER_RESET; 			 // Command
 
+	DS2485_InvalidatePortConfigShadow(); // registers return to defaults
+
     //Execute Command
-	if ((error = DS2485_ExecuteCommand(packet, sizeof(packet), delay_usec, response, sizeof(response))) != 0)
+	if ((error = executeCommand(DS2485_CLASS_CONFIG, packet, sizeof(packet), delay_usec, response, sizeof(response))) != 0)
 	{
 		return error;
 	}
@@ -417,24 +626,26 @@ int DS2485_OneWireScript(const uint8_t *script, uint8_t script_length, double ac
 	const int delay_usec = tOP_USEC + (tSEQ_USEC*(commandsCount)) + accumulativeOneWireTime + 1000;
 	const int rxLength = scriptResponse_length + 2;
 
-	uint8_t packet[txLength];
-	uint8_t response[rxLength];
+	if (script_length > DS2485_SCRIPT_MAX || scriptResponse_length > DS2485_SCRIPT_MAX)
+	{
+		return RB_INVALID_LENGTH;
+	}
 
 	//Build command packet
-	packet[0] = DFC_ONE_WIRE_SCRIPT; 			 					// Command
-	packet[1] = sizeof(packet) - 2;  			 					// Command length byte
-	memcpy(&packet[2], &script[0], script_length);        			// Primitive commands + data + parameters = script
+	scriptCommand[0] = DFC_ONE_WIRE_SCRIPT; 			 			// Command
+	scriptCommand[1] = txLength - 2;  			 					// Command length byte
+	memcpy(&scriptCommand[2], &script[0], script_length);        	// Primitive commands + data + parameters = script
 
     //Execute Command
-	if ((error = DS2485_ExecuteCommand(packet, sizeof(packet), delay_usec, response, sizeof(response))) != 0)
+	if ((error = executeCommand(DS2485_CLASS_SCRIPT, scriptCommand, txLength, delay_usec, scriptReply, rxLength)) != 0)
 	{
 		return error;
 	}
 
 	//Fetch page CRC16 from response
-	memcpy(&scriptResponse[0], &response[2], sizeof(response) - 2);
+	memcpy(&scriptResponse[0], &scriptReply[2], rxLength - 2);
 
-	switch (response[1]) {
+	switch (scriptReply[1]) {
 	case 0xAA:
 		error = RB_SUCCESS;
 		break;
@@ -540,7 +751,7 @@ int DS2485_OneWireBlock(const uint8_t *blockData, int blockData_Length, uint8_t
 	memcpy(&packet[3], &blockData[0], blockData_Length);        			// Data
 
     //Execute Command
-	if ((error = DS2485_ExecuteCommand(packet, sizeof(packet), delay_usec, response, sizeof(response))) != 0)
+	if ((error = executeCommand(DS2485_CLASS_BLOCK, packet, sizeof(packet), delay_usec, response, sizeof(response))) != 0)
 	{
 		return error;
 	}
@@ -658,7 +869,7 @@ int DS2485_OneWireWriteBlock(const uint8_t *writeData, int writeData_Length, boo
 	memcpy(&packet[3], &writeData[0], writeData_Length);     	// Data
 
     //Execute Command
-	if ((error = DS2485_ExecuteCommand(packet, sizeof(packet), delay_usec, response, sizeof(response))) != 0)
+	if ((error = executeCommand(DS2485_CLASS_BLOCK, packet, sizeof(packet), delay_usec, response, sizeof(response))) != 0)
 	{
 		return error;
 	}
@@ -771,7 +982,7 @@ int DS2485_OneWireReadBlock(uint8_t *readData, uint8_t bytes)
 	packet[2] = bytes;  			 				        // Parameter Byte
 
     //Execute Command
-	if ((error = DS2485_ExecuteCommand(packet, sizeof(packet), delay_usec, response, sizeof(response))) != 0)
+	if ((error = executeCommand(DS2485_CLASS_BLOCK, packet, sizeof(packet), delay_usec, response, sizeof(response))) != 0)
 	{
 		return error;
 	}
@@ -864,7 +1075,7 @@ int DS2485_OneWireSearch(uint8_t *romId, uint8_t code, bool ow_reset, bool ignor
 	//'1-Wire time'
 	t_slot = t_w0l + t_rec;					//Time it takes to complete a 1-Wire Write/Read bit time slot
 	ow_rst_time = t_rstl + t_rsth;			//Time it takes to complete a 1-Wire Reset slot
-	one_wire_time = ((t_slot * 8) * (64));
+	one_wire_time = t_slot * (8 + 3 * 64);	// search command byte, then a triplet (2 read slots, 1 write slot) per ROM ID bit
 	if(ow_reset)
 	{
 		one_wire_time += ow_rst_time;
@@ -897,7 +1108,7 @@ int DS2485_OneWireSearch(uint8_t *romId, uint8_t code, bool ow_reset, bool ignor
 	packet[3] = code;													// Search command code
 
     //Execute Command
-	if ((error = DS2485_ExecuteCommand(packet, sizeof(packet), delay_usec, response, sizeof(response))) != 0)
+	if ((error = executeCommand(DS2485_CLASS_SEARCH, packet, sizeof(packet), delay_usec, response, sizeof(response))) != 0)
 	{
 		return error;
 	}
@@ -1013,7 +1224,7 @@ int DS2485_FullCommandSequence(const uint8_t *owData, int owData_Length, uint8_t
 	memcpy(&packet[11], &owData[0], owData_Length);						// 1-Wire Data
 
     //Execute Command
-	if ((error = DS2485_ExecuteCommand(packet, sizeof(packet), delay_usec, response, sizeof(response))) != 0)
+	if ((error = executeCommand(DS2485_CLASS_FULL_SEQUENCE, packet, sizeof(packet), delay_usec, response, sizeof(response))) != 0)
 	{
 		return error;
 	}
@@ -1056,7 +1267,7 @@ int DS2485_ComputeCrc16(const uint8_t *crcData, int crcData_Length, uint8_t *crc
 	memcpy(&packet[2], &crcData[0], crcData_Length);        // Data
 
     //Execute Command
-	if ((error = DS2485_ExecuteCommand(packet, sizeof(packet), delay_usec, response, sizeof(response))) != 0)
+	if ((error = executeCommand(DS2485_CLASS_CONFIG, packet, sizeof(packet), delay_usec, response, sizeof(response))) != 0)
 	{
 		return error;
 	}
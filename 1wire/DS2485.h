@@ -60,21 +60,21 @@ extern "C" {
 #define DS2485_I2C_CLOCKRATE  1000000U ///< 1MHz
 
 /* Device Function Commands */
-#define DFC_WRITE_MEMORY                0x96;
-#define DFC_READ_MEMORY                 0x44;
-#define DFC_READ_STATUS                 0xAA;
-#define DFC_SET_I2C_ADDRESS             0x75;
-#define DFC_SET_PAGE_PROTECTION         0xC3;
-#define DFC_READ_ONE_WIRE_PORT_CONFIG   0x52;
-#define DFC_WRITE_ONE_WIRE_PORT_CONFIG  0x99;
-#define DFC_MASTER_RESET                0x62;
-#define DFC_ONE_WIRE_SCRIPT             0x88;
-#define DFC_ONE_WIRE_BLOCK              0xAB;
-#define DFC_ONE_WIRE_READ_BLOCK         0x50;
-#define DFC_ONE_WIRE_WRITE_BLOCK        0x68;
-#define DFC_ONE_WIRE_SEARCH             0x11;
-#define DFC_FULL_COMMAND_SEQUENCE       0x57;
-#define DFC_COMPUTE_CRC16               0xCC;
+#define DFC_WRITE_MEMORY                0x96
+#define DFC_READ_MEMORY                 0x44
+#define DFC_READ_STATUS                 0xAA
+#define DFC_SET_I2C_ADDRESS             0x75
+#define DFC_SET_PAGE_PROTECTION         0xC3
+#define DFC_READ_ONE_WIRE_PORT_CONFIG   0x52
+#define DFC_WRITE_ONE_WIRE_PORT_CONFIG  0x99
+#define DFC_MASTER_RESET                0x62
+#define DFC_ONE_WIRE_SCRIPT             0x88
+#define DFC_ONE_WIRE_BLOCK              0xAB
+#define DFC_ONE_WIRE_READ_BLOCK         0x50
+#define DFC_ONE_WIRE_WRITE_BLOCK        0x68
+#define DFC_ONE_WIRE_SEARCH             0x11
+#define DFC_FULL_COMMAND_SEQUENCE       0x57
+#define DFC_COMPUTE_CRC16               0xCC
 
 /* Result Bytes */
 #define RB_SUCCESS                      0      // No Failure
@@ -91,6 +91,8 @@ extern "C" {
 #define RB_LENGTH_MISMATCH              -110   // Length byte does not match actual length of data (Rx Length Byte will be 0)
 #define RB_WRITE_PROTECTED              -111   // The command failed because destination page is protected (WP)
 #define RB_UNKNOWN                      -112   // Unknown error
+#define RB_NOT_READY                    -113   // DS2485 did not acknowledge the response read: still executing the command
+#define RB_TABLE_FULL                   -114   // More devices than a ROM ID table holds (ONEWIRE_ROM_TABLE_MAX, or ONEWIRE_ROM_TABLE_SAVE_MAX to save)
 
 /* Operation Times */
 #define tOP_USEC    40
@@ -122,6 +124,61 @@ typedef enum {
     NONE_PROTECTION = 0x20,
 } DS2485_page_protection_T;
 
+/* Command classes, each with its own learned execution delay */
+typedef enum {
+    DS2485_CLASS_MEMORY,        // memory, status, I2C address, page protection
+    DS2485_CLASS_CONFIG,        // port configuration, master reset, CRC
+    DS2485_CLASS_SCRIPT,
+    DS2485_CLASS_BLOCK,         // 1-Wire block, read block, write block
+    DS2485_CLASS_SEARCH,
+    DS2485_CLASS_FULL_SEQUENCE,
+    DS2485_CLASS_COUNT,
+} DS2485_command_class_T;
+
+/* Execution delay statistics for one command class (DS2485_GetDelayStats) */
+typedef struct {
+    uint32_t commands;          // executed
+    uint32_t samples;           // completion times measured in learning mode
+    double slope;               // fitted completion time = slope * estimate + offset_uSec
+    double offset_uSec;
+    double margin_uSec;         // added to the fitted time: worst residual seen, plus DS2485_LEARN_MARGIN_USEC
+    uint32_t earlyReads;        // outside learning mode, response reads refused because the DS2485 was still busy
+    uint64_t estimated_uSec;    // sum of analytic delay estimates
+    uint64_t waited_uSec;       // sum of delays actually waited, including polling
+} DS2485_delay_stats_T;
+
+#ifndef DS2485_LEARN_MIN_SAMPLES
+  #define DS2485_LEARN_MIN_SAMPLES  8    // measurements of a class before its fitted delay is used
+#endif
+#ifndef DS2485_LEARN_MARGIN_USEC
+  #define DS2485_LEARN_MARGIN_USEC  50
+#endif
+#ifndef DS2485_POLL_USEC
+  #define DS2485_POLL_USEC          100  // interval between response reads while the DS2485 is busy
+#endif
+
+/* I2C error recovery in the port layer (DS2485_GetPortStats) */
+typedef struct {
+    uint32_t commands;          // DS2485_ExecuteCommand calls
+    uint32_t timeouts;          // I2C transfers not completed by their deadline
+    uint32_t busErrors;         // I2C transfers ended by a bus error (arbitration lost, driver busy, ...)
+    uint32_t recoveries;        // bus recoveries and I2C re-initializations
+    uint32_t retries;           // commands sent again after a recovery
+    uint32_t failures;          // commands which failed after all retries
+    uint32_t maxStall_uSec;     // longest DS2485_ExecuteCommand call
+    uint32_t maxRecovery_uSec;  // longest bus recovery
+} DS2485_port_stats_T;
+
+#ifndef DS2485_I2C_TIMEOUT_MARGIN_USEC
+  #define DS2485_I2C_TIMEOUT_MARGIN_USEC  2000 // added to an I2C transfer's time on the bus to get its deadline
+#endif
+#ifndef DS2485_I2C_RETRIES
+  #define DS2485_I2C_RETRIES        1    // times a command is sent again after its write timed out or failed (never after the DS2485 took it)
+#endif
+#ifndef DS2485_LINUX_MAX_BUSES
+  #define DS2485_LINUX_MAX_BUSES    8    // DS2485s one process can address through DS2485_port_linux.c
+#endif
+
 /* Write 1-Wire Port Configuration Registers */
 typedef enum {
     MASTER_CONFIGURATION,
@@ -424,8 +481,55 @@ int DS2485_OneWireSearch(uint8_t *romId, uint8_t code, bool ow_reset, bool ignor
 int DS2485_FullCommandSequence(const uint8_t *owData, int owData_Length, uint8_t *rom_id, DS2485_full_command_sequence_delays_msecs_T ow_delay_msecs, uint8_t *ow_rslt_data, uint8_t ow_rslt_len);
 int DS2485_ComputeCrc16(const uint8_t *crcData, int crcData_Length, uint8_t *crc16);
 
+/// Forget cached port configuration registers; call after anything other than
+/// DS2485_WriteOneWirePortConfig changes them (e.g. a script containing PC_SPEED or PC_OV_SKIP).
+void DS2485_InvalidatePortConfigShadow(void);
+
+/* Learned execution delays */
+void DS2485_SetDelayLearning(bool learn); // measure completion times; otherwise use what was learned
+void DS2485_ResetDelayLearning(void);
+void DS2485_GetDelayStats(DS2485_command_class_T commandClass, DS2485_delay_stats_T *stats);
+
 /// Platform-specific I2C command interface implemented in DS2485_port_xxxx.c Returns 'error' (0 if completed OK) */
+/// Returns RB_NOT_READY if the command was sent but the DS2485 did not acknowledge the response read.
 int DS2485_ExecuteCommand(const uint8_t *packet, int packetSize, int delay_uSec, uint8_t *response, int responseSize);
+/// Platform-specific: wait delay_uSec, then read the response to the command in progress.
+/// Returns RB_NOT_READY if the DS2485 is still executing it.
+int DS2485_ReadResponse(int delay_uSec, uint8_t *response, int responseSize);
+/// Platform-specific: time-out and bus recovery counts. Commands that could not be completed return RB_COMMS_FAIL.
+void DS2485_GetPortStats(DS2485_port_stats_T *stats);
+void DS2485_ResetPortStats(void);
+
+/* Linux i2c-dev port only (DS2485_port_linux.c) */
+/// Register the DS2485 at 7-bit 'address' on adapter 'device' (e.g. "/dev/i2c-1"). Returns its bus number, or -errno.
+int DS2485_Linux_AddBus(const char *device, uint8_t address);
+/// Direct following commands to a bus returned by DS2485_Linux_AddBus.
+int DS2485_Linux_SelectBus(int bus);
+void DS2485_Linux_CloseAll(void);
+
+/* Simulator port only (DS2485_port_sim.c) */
+#ifndef DS2485_SIM_MAX_PROBES
+  #define DS2485_SIM_MAX_PROBES     128  // DS28E18s with an ENS210 the simulated bus can carry
+#endif
+typedef struct {
+    int probes;                 // DS28E18 + ENS210 probes on the bus
+    double temperature_C;       // first probe; each further probe reads 0.5 C warmer
+    double humidity_pct;
+} DS2485_sim_config_T;
+/// Power up a simulated DS2485 and its probes. Probes keep their state until the next call.
+void DS2485_Sim_Start(const DS2485_sim_config_T *config);
+/// Power-on reset of one probe: its sequencer memory and unique ROM ID are lost until its next command.
+void DS2485_Sim_PowerCycleProbe(int probe);
+/// Unplug a probe from the bus, or plug it back in (powering it up, as DS2485_Sim_PowerCycleProbe).
+void DS2485_Sim_ConnectProbe(int probe, bool connected);
+/// Content of the SPI flash on a probe's SPI port.
+uint8_t DS2485_Sim_SpiFlashByte(int probe, uint32_t address);
+/// 1-Wire signalling time (resets, time slots) since DS2485_Sim_Start.
+uint64_t DS2485_Sim_BusTime_uSec(void);
+/// Corrupt the CRC16 of a probe's next count responses to a DS28E18 device function command, as noise would.
+void DS2485_Sim_CorruptResponses(int probe, uint8_t command, int count);
+/// Make every port delay last uSec longer than asked, as a coarse OS timer would.
+void DS2485_Sim_SetOversleep(int uSec);
 
 #ifdef __cplusplus
 }
@@ -18,8 +18,13 @@
  * - Send a DS2485 command or script requested by the caller.
  * - Wait for the DS2485 to execute the command or script and collect the reply.
  * - Read the response back from the DS2485.
+ * - Give up on any transfer not complete by its deadline and recover the bus. Retry the command only if
+ *   its write failed: once the DS2485 has it, a failed response read is returned, not sent again.
  *
- * @todo Add time-outs in DS2485_port_NXP_LPI2C in case the DS2485 does not reply.
+ * @par Bus recovery
+ * Each transfer's deadline is its time on the bus plus DS2485_I2C_TIMEOUT_MARGIN_USEC, and the command's
+ * execution delay is a fixed wait, so a command which gets no reply returns after at most
+ * (DS2485_I2C_RETRIES+1) * (write deadline + delay + read deadline + recovery); see DS2485_GetPortStats.
  */
 
 
@@ -27,7 +32,15 @@
 
 #define NXP_LPI2C_USE_DMA  // Non-DMA implementation below loops waiting for I2C FIFO to be empty
 
-// ToDo 1-Wire: Time-outs in DS2485_port_NXP_LPI2C in case DS2485 does not reply
+// Bus recovery drives the LPI2C pins as GPIO: SensorBox uses LPI2C3 on GPIO_SD_B0_00 (SCL) and GPIO_SD_B0_01 (SDA)
+#define LPI2C_SCL_I2C_MUX   IOMUXC_GPIO_SD_B0_00_LPI2C3_SCL
+#define LPI2C_SDA_I2C_MUX   IOMUXC_GPIO_SD_B0_01_LPI2C3_SDA
+#define LPI2C_SCL_GPIO_MUX  IOMUXC_GPIO_SD_B0_00_GPIO3_IO13
+#define LPI2C_SDA_GPIO_MUX  IOMUXC_GPIO_SD_B0_01_GPIO3_IO14
+#define LPI2C_RECOVERY_GPIO GPIO3
+#define LPI2C_SCL_GPIO_PIN  13U
+#define LPI2C_SDA_GPIO_PIN  14U
+#define LPI2C_PIN_LOW_TIMEOUT_NS 1000000U // LPI2C reports a pin held low this long (nothing legitimately stretches the DS2485 bus)
 
 
 #include <stdint.h>
@@ -39,15 +52,16 @@
 
 #include "FreeRTOS.h"
 #include "task.h"
-#include "semphr.h"
 
 #include "fsl_iomuxc.h" // I2C IO pin setup
+#include "fsl_gpio.h"   // bus recovery
 #include "fsl_lpi2c.h"
 #include "fsl_lpi2c_edma.h"
 #include "fsl_edma.h"
 #include "fsl_dmamux.h"
 
 #include "DS2485.h" // DS2485 I2C 1-Wire master
+#include "one_wire_instrument.h"
 
 #ifdef NXP_LPI2C_USE_DMA
     #define LPI2C_DMA_MUX (DMAMUX)
@@ -71,9 +85,24 @@
             lpi2c_master_edma_handle_t *handle,
             status_t completionStatus,
             void *userData);
-    static volatile bool xferFailed, txPending, rxPending; // waiting for DMA to complete?
-    static SemaphoreHandle_t xResponseDataReadySemaphore = NULL;
-    static StaticSemaphore_t xResponseDataReadySemaphoreBuffer;
+
+    // Completed transfers are passed from the DMA callback (the only producer) to the waiting task
+    // (the only consumer) through a ring of completion records, so no state is shared between them
+    // other than the ring indices. Each side writes only its own index.
+    typedef struct {
+        status_t status;     // kStatus_Success, or the LPI2C error which ended the transfer
+        uint16_t bytes;      // bytes transferred (0 on error)
+        TickType_t timestamp;// tick count at completion
+    } completion_T;
+    #define COMPLETION_RING_SIZE 4 // power of 2; one transfer is in flight at a time now, room for a pipeline later
+    static completion_T completionRing[COMPLETION_RING_SIZE];
+    static volatile uint32_t completionHead; // written only by the DMA callback
+    static volatile uint32_t completionTail; // written only by the task
+    static int completionOverruns = 0;       // For diagnostics only. Ring full: completion dropped (should never happen)
+    static TaskHandle_t waitingTask;         // notified on each completion; set before a transfer is started
+    #ifdef ONEWIRE_INSTRUMENT
+        static uint32_t transferStartCycles; // set before a transfer is started, read by the DMA callback
+    #endif
 #endif
 
 // Based on lpi2c_master_config_t default (only clock-rate changed)
@@ -85,7 +114,7 @@ static const lpi2c_master_config_t masterConfig = {
     .pinConfig = kLPI2C_2PinOpenDrain,
     .baudRate_Hz = DS2485_I2C_CLOCKRATE, // 1MHz, not default 100kHz
     .busIdleTimeout_ns = 0,        // Bus idle timeout in nanoseconds. Set to 0 to disable.
-    .pinLowTimeout_ns = 0,         // Pin low timeout in nanoseconds. Set to 0 to disable.
+    .pinLowTimeout_ns = LPI2C_PIN_LOW_TIMEOUT_NS, // Pin low timeout in nanoseconds. Set to 0 to disable.
     .sdaGlitchFilterWidth_ns = 0,  // Width in nanoseconds of glitch filter on SDA pin. Set to 0 to disable.
     .sclGlitchFilterWidth_ns = 0,  // Width in nanoseconds of glitch filter on SCL pin. Set to 0 to disable.
     .hostRequest = {
@@ -96,6 +125,7 @@ static const lpi2c_master_config_t masterConfig = {
 };
 
 static bool NXP_I2C_initialized;
+static int readResponse(uint8_t *response, int responseSize);
 static void NXP_I2C_init(void) {
     #if 0 // Pin setup and LP2I2C clocks should be initialized at application startup, not here...
         // SensorBox uses LPI2C3: Pin 47 is GPIO_SD_BD_01 SDA, Pin 48 is GPIO_SD_BD_00 SCL
@@ -157,13 +187,91 @@ static void NXP_I2C_init(void) {
         NVIC_SetPriority((DMA0_DMA16_IRQn + (LPI2C3_RECEIVE_DMA_CHANNEL %16)), LPI2C3_DMA_IRQ_PRIORITY);
         // The I2C interrupt fires on I2C errors, after which FSL stops DMA and calls the same handler
         NVIC_SetPriority(LPI2C3_IRQn, LPI2C3_error_IRQ_PRIORITY);
-        // created in the 'empty' state; semaphore must first be given before it can subsequently be taken
-        xResponseDataReadySemaphore = xSemaphoreCreateBinaryStatic(&xResponseDataReadySemaphoreBuffer );
     #endif // NXP_LPI2C_USE_DMA
 
     NXP_I2C_initialized = true;
 };
 
+/* **** Bus recovery **** */
+
+static DS2485_port_stats_T portStats;
+
+static uint32_t ticksToUsec(TickType_t ticks) { return (uint32_t)ticks * portTICK_PERIOD_MS * 1000U; }
+
+// Ticks to sleep for at least uSec, whatever part of the current tick is already gone
+static TickType_t ticksCovering(int uSec) { return (TickType_t)(((uint32_t)uSec + ticksToUsec(1) - 1) / ticksToUsec(1)) + 1; }
+
+// Wait at least delay_uSec. Sleeping goes by system ticks, so a shorter wait (the DS2485 poll
+// interval, most commands) spins instead of being rounded down to no wait at all.
+static void waitUsec(int delay_uSec)
+{
+    if(delay_uSec <= 0) return;
+    if((uint32_t)delay_uSec < ticksToUsec(1)) SDK_DelayAtLeastUs((uint32_t)delay_uSec, SystemCoreClock);
+    else vTaskDelay(ticksCovering(delay_uSec));
+}
+
+// Longest a transfer of 'bytes' can take on the bus (address byte plus data, 9 clocks each), plus margin
+static uint32_t transferTimeout_uSec(int bytes)
+{
+    return (uint32_t)(bytes + 1) * 9U * 1000000U / DS2485_I2C_CLOCKRATE + DS2485_I2C_TIMEOUT_MARGIN_USEC;
+}
+
+// Count a failed transfer; the caller recovers the bus
+static int busError(status_t status)
+{
+    if(status == kStatus_LPI2C_PinLowTimeout) portStats.timeouts++;
+    else portStats.busErrors++;
+    return RB_COMMS_FAIL;
+}
+
+// A transfer cut short (reset, ESD, aborted time-out) can leave the DS2485 holding SDA low mid-byte.
+// Clock SCL as GPIO until it lets go, then send a STOP.
+static void clockOutSCL(void)
+{
+    const gpio_pin_config_t released = { kGPIO_DigitalOutput, 1, kGPIO_NoIntmode }; // open-drain pads: 1 releases the line
+    GPIO_PinInit(LPI2C_RECOVERY_GPIO, LPI2C_SCL_GPIO_PIN, &released);
+    GPIO_PinInit(LPI2C_RECOVERY_GPIO, LPI2C_SDA_GPIO_PIN, &released);
+    IOMUXC_SetPinMux(LPI2C_SCL_GPIO_MUX, 1U); // input path forced on, so the pad level can be read back
+    IOMUXC_SetPinMux(LPI2C_SDA_GPIO_MUX, 1U);
+    for(int clock = 0; clock < 9 && !GPIO_PinRead(LPI2C_RECOVERY_GPIO, LPI2C_SDA_GPIO_PIN); clock++) {
+        GPIO_PinWrite(LPI2C_RECOVERY_GPIO, LPI2C_SCL_GPIO_PIN, 0);
+        SDK_DelayAtLeastUs(5, SystemCoreClock);
+        GPIO_PinWrite(LPI2C_RECOVERY_GPIO, LPI2C_SCL_GPIO_PIN, 1);
+        SDK_DelayAtLeastUs(5, SystemCoreClock);
+    }
+    // STOP: SDA low to high while SCL is high
+    GPIO_PinWrite(LPI2C_RECOVERY_GPIO, LPI2C_SCL_GPIO_PIN, 0);
+    GPIO_PinWrite(LPI2C_RECOVERY_GPIO, LPI2C_SDA_GPIO_PIN, 0);
+    SDK_DelayAtLeastUs(5, SystemCoreClock);
+    GPIO_PinWrite(LPI2C_RECOVERY_GPIO, LPI2C_SCL_GPIO_PIN, 1);
+    SDK_DelayAtLeastUs(5, SystemCoreClock);
+    GPIO_PinWrite(LPI2C_RECOVERY_GPIO, LPI2C_SDA_GPIO_PIN, 1);
+    SDK_DelayAtLeastUs(5, SystemCoreClock);
+    IOMUXC_SetPinMux(LPI2C_SCL_I2C_MUX, 1U);
+    IOMUXC_SetPinMux(LPI2C_SDA_I2C_MUX, 1U);
+}
+
+// Recover from a time-out or bus error: free the bus, re-initialize LPI2C (and EDMA),
+// and forget DS2485 state cached on this side, as a command cut short may have changed it.
+static void recoverBus(void)
+{
+    TickType_t start = xTaskGetTickCount();
+    #ifdef NXP_LPI2C_USE_DMA
+        LPI2C_MasterTransferAbortEDMA(LPI2C3, &g_m_edma_handle);
+    #endif
+    LPI2C_MasterDeinit(LPI2C3);
+    clockOutSCL();
+    NXP_I2C_init();
+    #ifdef NXP_LPI2C_USE_DMA
+        completionTail = completionHead; // discard anything posted by the aborted transfer
+        ulTaskNotifyTake(pdTRUE, 0);
+    #endif
+    DS2485_InvalidatePortConfigShadow();
+    portStats.recoveries++;
+    uint32_t elapsed = ticksToUsec(xTaskGetTickCount() - start);
+    if(elapsed > portStats.maxRecovery_uSec) portStats.maxRecovery_uSec = elapsed;
+}
+
 #ifdef NXP_LPI2C_USE_DMA // This is a non-blocking implementation using DMA for I2C TX and RX
 
 // DMA transfer has completed or failed (same ISR callback used for TX and RX completion, and LPI2C errors)
@@ -173,93 +281,120 @@ static void dmaCompleteCallback(LPI2C_Type *base,
         void *userData)
 {
     (void)base;
-    (void)handle;
     (void)userData;
-    if(completionStatus != kStatus_Success) {
-        // LPI2C3 IRQ reports bus/protocol errors here (NACK, arbitration lost, timeout, FIFO, etc.).
-        // On an error, FSL terminates the DMA operation reports the error here.
-        // Possible errors: kStatus_LPI2C_PinLowTimeout, kStatus_LPI2C_ArbitrationLost, kStatus_LPI2C_Nak, kStatus_LPI2C_FifoError
-        // Dave saw:
-        //   rxPending and kStatus_LPI2C_Nak=902 /*!< The slave device sent a NAK in response to a byte. */
-        //   rxPending and kStatus_LPI2C_FifoError=903/*!< FIFO under run or overrun. */
-        // Remember this error is on I2C from MCU->DS2485, not the 1-wire or remote I2C
-        xferFailed = true;
-    }
-    if(txPending) {
-        // On completing TX to DS2485, nothing to do; we must finish waiting for DS2485 (to finish executing 1-Wire script)...
-        txPending = false;
-        return;
+    // LPI2C3 IRQ reports bus/protocol errors here (NACK, arbitration lost, timeout, FIFO, etc.).
+    // On an error, FSL terminates the DMA operation reports the error here.
+    // Possible errors: kStatus_LPI2C_PinLowTimeout, kStatus_LPI2C_ArbitrationLost, kStatus_LPI2C_Nak, kStatus_LPI2C_FifoError
+    // Dave saw:
+    //   RX and kStatus_LPI2C_Nak=902 /*!< The slave device sent a NAK in response to a byte. */
+    //   RX and kStatus_LPI2C_FifoError=903/*!< FIFO under run or overrun. */
+    // Remember this error is on I2C from MCU->DS2485, not the 1-wire or remote I2C
+    uint32_t head = completionHead;
+    if(head - completionTail < COMPLETION_RING_SIZE) {
+        completion_T *c = &completionRing[head % COMPLETION_RING_SIZE];
+        c->status = completionStatus;
+        c->bytes = (completionStatus == kStatus_Success) ? (uint16_t)handle->transfer.dataSize : 0;
+        c->timestamp = xTaskGetTickCountFromISR();
+        __DMB(); // record must be visible before it is published
+        completionHead = head + 1;
     } else {
-        assert(rxPending);
-        rxPending = false;
+        completionOverruns++;
     }
-    // unblock DS2485_ExecuteCommand, which is waiting for this response data (or error)
-    xSemaphoreGiveFromISR( xResponseDataReadySemaphore, NULL );
+    #ifdef ONEWIRE_INSTRUMENT
+        OneWire_Instr_Record(handle->transfer.direction == kLPI2C_Read ? ONEWIRE_INSTR_I2C_READ : ONEWIRE_INSTR_I2C_WRITE,
+                             OneWire_Instr_Cycles() - transferStartCycles);
+    #endif
+    // unblock the task waiting for this transfer (or error)
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+    if(waitingTask) vTaskNotifyGiveFromISR(waitingTask, &higherPriorityTaskWoken);
+    portYIELD_FROM_ISR(higherPriorityTaskWoken);
 }
 
-int DS2485_ExecuteCommand(const uint8_t *packet, int packetSize, int delay_uSec, uint8_t *response, int responseSize)
+// Wait until 'deadline' for the DMA callback to post the next completion record
+static bool waitCompletion(completion_T *completion, TickType_t deadline)
 {
-    // Setup the I2C master if not yet initialized
-    if(!NXP_I2C_initialized) NXP_I2C_init();
-    // ToDo 1-Wire: Every-command re-initialization? Maxim code does I2C shutdown and (re-) initialization EVERY COMMAND.
-    // Might be advisable in case I2C bus gets into weird lock-up state, which never happens, right?
-
-    // Copy transmit data into local buffer (DMA needs guaranteed non-cacheable-memory buffer)
-    assert(packetSize<=(int)sizeof(i2c_DMA_buf));
-    if(packetSize>(int)sizeof(i2c_DMA_buf)) return 1; // error
-    memcpy(i2c_DMA_buf, packet, packetSize);
-    if(maxUsedBufferSize<packetSize) maxUsedBufferSize=packetSize;
-    
-    // Set initial state flag values...
-    xferFailed = false; // will be set in ISR callback above if a transfer fails because of an I2C error
-    rxPending = false;
+    uint32_t tail = completionTail;
+    while(completionHead == tail) {
+        TickType_t remaining = deadline - xTaskGetTickCount();
+        if(remaining == 0 || remaining > portMAX_DELAY/2) return false; // deadline passed
+        ulTaskNotifyTake(pdTRUE, remaining); // the ring, not the notification count, says what completed
+    }
+    __DMB(); // read the record only after seeing it published
+    *completion = completionRing[tail % COMPLETION_RING_SIZE];
+    __DMB(); // finish copying before the slot is released
+    completionTail = tail + 1;
+    return true;
+}
 
-    // ====  I2C write to slave DS2485  ====
-    txPending = true; // cleared asynchronously in DMA completion callback above
-    lpi2c_master_transfer_t mt_TX = {
+// Run one DMA transfer to or from i2c_DMA_buf, waiting no longer than it can take on the bus.
+// Returns RB_NOT_READY if the DS2485 did not acknowledge, RB_COMMS_FAIL if the bus needs recovery.
+static int transfer(lpi2c_direction_t direction, int size, completion_T *completion)
+{
+    lpi2c_master_transfer_t mt = {
         .flags=kLPI2C_TransferDefaultFlag, /*!< Bit mask of options for the transfer. Set to 0 or kLPI2C_TransferDefaultFlag for normal transfers. */
         .slaveAddress=DS2485_I2C_7BIT_ADDRESS, /*!< The 7-bit slave address. */
-        .direction=kLPI2C_Write, /*!< Either kLPI2C_Read or kLPI2C_Write. */
+        .direction=direction,  /*!< Either kLPI2C_Read or kLPI2C_Write. */
         .subaddress=0,         /*!< Sub address. Transferred MSB first. */
         .subaddressSize=0,     /*!< Length of sub address to send in bytes. Maximum size is 4 bytes. */
         .data=i2c_DMA_buf,     /*!< Pointer to data to transfer. */
-        .dataSize=packetSize,  /*!< Number of bytes to transfer. */
+        .dataSize=size,        /*!< Number of bytes to transfer. */
     };
+    waitingTask = xTaskGetCurrentTaskHandle();
+    TickType_t deadline = xTaskGetTickCount() + pdUS_TO_TICKS(transferTimeout_uSec(size)) + 1; // +1: the current tick is partly gone
+    #ifdef ONEWIRE_INSTRUMENT
+        transferStartCycles = OneWire_Instr_Cycles();
+    #endif
     volatile status_t reVal; // volatile to discourage optimizing out (for debugging ease)
-    reVal = LPI2C_MasterTransferEDMA(LPI2C3, &g_m_edma_handle, &mt_TX);
-    assert(reVal == kStatus_Success); // 900 is kStatus_LPI2C_Busy; driver fails to resolve hang w/out powercycle?
+    reVal = LPI2C_MasterTransferEDMA(LPI2C3, &g_m_edma_handle, &mt);
     if(reVal != kStatus_Success) {
-        return 1; // error...
-    };
-    // Wait the specified time for command to complete, could be a while...
-    while(txPending && !xferFailed) {
-        TickType_t ticksDelay = pdUS_TO_TICKS(delay_uSec);
-        vTaskDelay(ticksDelay);
-        assert(txPending == false);
-    };
-    if(xferFailed) {
-        return 1; // error, something bad happened during transmission (I2C error etc)
+        return busError(reVal); // 900 is kStatus_LPI2C_Busy: driver or bus stuck, used to need a power cycle
+    }
+    if(!waitCompletion(completion, deadline)) {
+        portStats.timeouts++;
+        return RB_COMMS_FAIL;
+    }
+    if(completion->status == kStatus_LPI2C_Nak || completion->status == kStatus_LPI2C_FifoError) {
+        return RB_NOT_READY; // both seen when the DS2485 refuses a read while busy
     }
+    if(completion->status != kStatus_Success) {
+        return busError(completion->status);
+    }
+    return 0;
+}
+
+// *written is set once the DS2485 has taken the packet, after which the command must not be sent again
+static int executeOnce(const uint8_t *packet, int packetSize, int delay_uSec, uint8_t *response, int responseSize, bool *written)
+{
+    // Copy transmit data into local buffer (DMA needs guaranteed non-cacheable-memory buffer)
+    assert(packetSize<=(int)sizeof(i2c_DMA_buf));
+    if(packetSize>(int)sizeof(i2c_DMA_buf)) return 1; // error
+    memcpy(i2c_DMA_buf, packet, packetSize);
+    if(maxUsedBufferSize<packetSize) maxUsedBufferSize=packetSize;
+
+    // ====  I2C write to slave DS2485  ====
+    completion_T tx;
+    int error = transfer(kLPI2C_Write, packetSize, &tx);
+    if(error == RB_NOT_READY) error = RB_COMMS_FAIL; // write NAK'd: command not accepted
+    if(error) return error;
+    *written = true;
+    // Wait the specified time for command to complete, could be a while; timed from the end of the write
+    if(delay_uSec > 0 && (uint32_t)delay_uSec < ticksToUsec(1)) SDK_DelayAtLeastUs((uint32_t)delay_uSec, SystemCoreClock);
+    else if(delay_uSec > 0) vTaskDelayUntil(&tx.timestamp, ticksCovering(delay_uSec));
+
+    return readResponse(response, responseSize);
+}
+
+// Read the DS2485 response; it does not acknowledge the read while still executing the command
+static int readResponse(uint8_t *response, int responseSize)
+{
+    assert(responseSize<=(int)sizeof(i2c_DMA_buf));
+    if(responseSize>(int)sizeof(i2c_DMA_buf)) return 1; // error
 
     // ====  I2C read from slave DS2485  ====
-    rxPending = true; // cleared asynchronously in DMA completion callback
-    lpi2c_master_transfer_t mt_RX = {
-        .flags=kLPI2C_TransferDefaultFlag, /*!< Bit mask of options for the transfer. Set to 0 or kLPI2C_TransferDefaultFlag for normal transfers. */
-        .slaveAddress=DS2485_I2C_7BIT_ADDRESS, /*!< The 7-bit slave address. */
-        .direction=kLPI2C_Read,/*!< Either kLPI2C_Read or kLPI2C_Write. */
-        .subaddress=0,         /*!< Sub address. Transferred MSB first. */
-        .subaddressSize=0,     /*!< Length of sub address to send in bytes. Maximum size is 4 bytes. */
-        .data=i2c_DMA_buf,     /*!< Pointer to data to transfer. */
-        .dataSize=responseSize,/*!< Number of bytes to transfer. */
-    };
-    reVal = LPI2C_MasterTransferEDMA(LPI2C3, &g_m_edma_handle, &mt_RX);
-    assert(reVal == kStatus_Success); // 900 is kStatus_LPI2C_Busy; driver fails to resolve hang w/out powercycle?
-    if(reVal != kStatus_Success) {
-        return 1; // error, something bad happened during reception (I2C error etc)
-    }
-    
-    // wait for DMA read transfer to complete (DMA completion callback releases semaphore)
-    xSemaphoreTake( xResponseDataReadySemaphore, portMAX_DELAY );
+    completion_T rx;
+    int error = transfer(kLPI2C_Read, responseSize, &rx);
+    if(error) return error;
+    assert(rx.bytes == responseSize);
     // copy response from local DMA buffer to caller's response buffer
     memcpy(response, i2c_DMA_buf, responseSize);
 
@@ -269,13 +404,11 @@ int DS2485_ExecuteCommand(const uint8_t *packet, int packetSize, int delay_uSec,
 #else // This is a blocking implementation with polling.
 // LPI2C_MasterTransferBlocking sits in a loop polling I2C FIFO to push out data, as does LPI2C_MasterReceive
 // CPU pig! Other tasks could be getting work done!
-int DS2485_ExecuteCommand(const uint8_t *packet, int packetSize, int delay_uSec, uint8_t *response, int responseSize)
+// The FSL loops end on LPI2C errors, including the pin-low time-out; define I2C_RETRY_TIMES
+// project-wide so they also give up on a peripheral that never sets its flags.
+// *written is set once the DS2485 has taken the packet, after which the command must not be sent again
+static int executeOnce(const uint8_t *packet, int packetSize, int delay_uSec, uint8_t *response, int responseSize, bool *written)
 {
-    // Setup the I2C master
-    if(!NXP_I2C_initialized) NXP_I2C_init();
-    // ToDo 1-Wire: Every-command re-initialization? Maxim code does I2C shutdown and (re-) initialization EVERY COMMAND.
-    // Might be advisable in case I2C bus gets into weird lock-up state, which never happens, right?
-
     // ====  I2C write to slave DS2485  ====
   #pragma GCC diagnostic push
   #pragma GCC diagnostic ignored "-Wcast-qual" // yick, see comment below...
@@ -291,19 +424,79 @@ int DS2485_ExecuteCommand(const uint8_t *packet, int packetSize, int delay_uSec,
     };
   #pragma GCC diagnostic pop
     status_t reVal = LPI2C_MasterTransferBlocking(LPI2C3, &mt); // blocks waiting for send completion...
-    assert(reVal == kStatus_Success); // 900 is kStatus_LPI2C_Busy; driver fails to resolve hang w/out powercycle?
+    if(reVal != kStatus_Success) {
+        return busError(reVal); // 900 is kStatus_LPI2C_Busy: driver or bus stuck, used to need a power cycle
+    }
+    *written = true;
 
     // Wait specified time for command to complete, could be a long time...
-    TickType_t ticksDelay = pdUS_TO_TICKS(delay_uSec);
-    vTaskDelay(ticksDelay);
+    waitUsec(delay_uSec);
+
+    return readResponse(response, responseSize);
+}
 
+// Read the DS2485 response; it does not acknowledge the read while still executing the command
+static int readResponse(uint8_t *response, int responseSize)
+{
     // ====  I2C read from slave DS2485  ====
     // Read out Length Byte
-    reVal = LPI2C_MasterStart(LPI2C3, DS2485_I2C_7BIT_ADDRESS, kLPI2C_Read);
-    assert(reVal == kStatus_Success);
-    reVal = LPI2C_MasterReceive(LPI2C3, response, responseSize);
-    assert(reVal == kStatus_Success);
+    status_t reVal = LPI2C_MasterStart(LPI2C3, DS2485_I2C_7BIT_ADDRESS, kLPI2C_Read);
+    if(reVal == kStatus_Success) {
+        reVal = LPI2C_MasterReceive(LPI2C3, response, responseSize);
+    }
+    LPI2C_MasterStop(LPI2C3); // release the bus whether or not the read succeeded
+    if(reVal == kStatus_LPI2C_Nak || reVal == kStatus_LPI2C_FifoError) {
+        return RB_NOT_READY; // read NAK'd: DS2485 still busy
+    }
+    if(reVal != kStatus_Success) {
+        return busError(reVal);
+    }
 
     return 0;
 }
 #endif
+
+int DS2485_ExecuteCommand(const uint8_t *packet, int packetSize, int delay_uSec, uint8_t *response, int responseSize)
+{
+    // Setup the I2C master if not yet initialized; afterwards it is re-initialized only to recover from an error
+    if(!NXP_I2C_initialized) NXP_I2C_init();
+
+    TickType_t start = xTaskGetTickCount();
+    int error;
+    for(int attempt = 0; ; attempt++) {
+        bool written = false;
+        error = executeOnce(packet, packetSize, delay_uSec, response, responseSize, &written);
+        if(error != RB_COMMS_FAIL) break;
+        recoverBus();
+        if(written || attempt >= DS2485_I2C_RETRIES) { // written: the DS2485 ran the command; sending it again would run it twice
+            portStats.failures++;
+            break;
+        }
+        portStats.retries++;
+    }
+    portStats.commands++;
+    uint32_t stall = ticksToUsec(xTaskGetTickCount() - start);
+    if(stall > portStats.maxStall_uSec) portStats.maxStall_uSec = stall;
+    return error;
+}
+
+int DS2485_ReadResponse(int delay_uSec, uint8_t *response, int responseSize)
+{
+    waitUsec(delay_uSec);
+    int error = readResponse(response, responseSize);
+    if(error == RB_COMMS_FAIL) {
+        recoverBus(); // the command's response is lost; the caller sees the failure
+        portStats.failures++;
+    }
+    return error;
+}
+
+void DS2485_GetPortStats(DS2485_port_stats_T *stats)
+{
+    *stats = portStats;
+}
+
+void DS2485_ResetPortStats(void)
+{
+    memset(&portStats, 0, sizeof(portStats));
+}
@@ -0,0 +1,156 @@
+/**
+ * @file DS2485_port_linux.c
+ * @brief Platform-specific interface used to drive the DS2485 over I2C on embedded Linux (i2c-dev).
+ *
+ * @par Notes
+ * - Each I2C transfer is one ioctl(I2C_RDWR) on /dev/i2c-N, so a command costs a write syscall,
+ *   a clock_nanosleep for the execution delay, and a read syscall.
+ * - Several DS2485s (different adapters and/or addresses) may be used by one process:
+ *   register each with DS2485_Linux_AddBus, then DS2485_Linux_SelectBus before using it.
+ *   Bus numbers match OneWire_device_T.bus.
+ * - If no bus is added, DS2485_LINUX_DEFAULT_DEVICE at DS2485_I2C_7BIT_ADDRESS is opened on first use.
+ * - The caller serializes access, as with the other ports.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* **** Includes **** */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "DS2485.h"
+
+/* **** Definitions **** */
+#ifndef DS2485_LINUX_DEFAULT_DEVICE
+  #define DS2485_LINUX_DEFAULT_DEVICE "/dev/i2c-1"
+#endif
+
+typedef struct {
+    int fd;             // shared by buses on the same adapter
+    char device[32];
+    uint16_t address;   // 7-bit
+} bus_T;
+
+/* **** Globals **** */
+static bus_T buses[DS2485_LINUX_MAX_BUSES];
+static int busCount;
+static int currentBus;
+static DS2485_port_stats_T portStats; // maxRecovery_uSec unused: there is no recovery beyond the kernel driver's own
+
+/* **** Functions **** */
+static uint64_t now_uSec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000U + (uint64_t)ts.tv_nsec / 1000U;
+}
+
+int DS2485_Linux_AddBus(const char *device, uint8_t address)
+{
+    if (busCount >= DS2485_LINUX_MAX_BUSES || strlen(device) >= sizeof(buses[0].device)) return -EINVAL;
+    int fd = -1;
+    for (int i = 0; i < busCount; i++)
+    {
+        if (strcmp(buses[i].device, device) == 0) fd = buses[i].fd;
+    }
+    if (fd < 0 && (fd = open(device, O_RDWR | O_CLOEXEC)) < 0) return -errno;
+
+    bus_T *bus = &buses[busCount];
+    bus->fd = fd;
+    strcpy(bus->device, device);
+    bus->address = address;
+    return busCount++;
+}
+
+int DS2485_Linux_SelectBus(int bus)
+{
+    if (bus < 0 || bus >= busCount) return RB_INVALID_PARAMETER;
+    currentBus = bus;
+    return 0;
+}
+
+void DS2485_Linux_CloseAll(void)
+{
+    for (int i = 0; i < busCount; i++)
+    {
+        bool shared = false;
+        for (int j = i + 1; j < busCount; j++) shared |= (buses[j].fd == buses[i].fd);
+        if (!shared) close(buses[i].fd); // close each adapter once, at its last use
+    }
+    busCount = 0;
+    currentBus = 0;
+}
+
+// One I2C message to the current DS2485: returns 0, RB_NOT_READY if it was not acknowledged, else RB_COMMS_FAIL
+static int transfer(uint16_t flags, uint8_t *data, int length)
+{
+    if (busCount == 0 && DS2485_Linux_AddBus(DS2485_LINUX_DEFAULT_DEVICE, DS2485_I2C_7BIT_ADDRESS) < 0)
+    {
+        return RB_COMMS_FAIL;
+    }
+    struct i2c_msg msg = {
+        .addr = buses[currentBus].address,
+        .flags = flags,
+        .len = (uint16_t)length,
+        .buf = data,
+    };
+    struct i2c_rdwr_ioctl_data rdwr = { .msgs = &msg, .nmsgs = 1 };
+    if (ioctl(buses[currentBus].fd, I2C_RDWR, &rdwr) == 1) return 0;
+    if (errno == ENXIO || errno == EREMOTEIO) return RB_NOT_READY; // address or data NAK'd
+    portStats.busErrors++;
+    return RB_COMMS_FAIL;
+}
+
+// Sleep until 'start_uSec + delay_uSec' on the monotonic clock, resuming after signals
+static void sleepUntil(uint64_t start_uSec, int delay_uSec)
+{
+    uint64_t wake = start_uSec + (uint64_t)delay_uSec;
+    struct timespec ts = { .tv_sec = (time_t)(wake / 1000000U), .tv_nsec = (long)(wake % 1000000U) * 1000L };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    {
+    }
+}
+
+int DS2485_ExecuteCommand(const uint8_t *packet, int packetSize, int delay_uSec, uint8_t *response, int responseSize)
+{
+    uint64_t start = now_uSec();
+    portStats.commands++;
+
+    // i2c_msg.buf is not const, though the kernel only reads it for a write
+    int error = transfer(0, (uint8_t *)(uintptr_t)packet, packetSize);
+    if (error == RB_NOT_READY) error = RB_COMMS_FAIL; // write NAK'd: command not accepted
+    if (error == 0)
+    {
+        sleepUntil(now_uSec(), delay_uSec); // timed from the end of the write
+        error = transfer(I2C_M_RD, response, responseSize);
+    }
+    if (error == RB_COMMS_FAIL) portStats.failures++;
+
+    uint64_t stall = now_uSec() - start;
+    if (stall > portStats.maxStall_uSec) portStats.maxStall_uSec = (uint32_t)stall;
+    return error;
+}
+
+int DS2485_ReadResponse(int delay_uSec, uint8_t *response, int responseSize)
+{
+    sleepUntil(now_uSec(), delay_uSec);
+    return transfer(I2C_M_RD, response, responseSize);
+}
+
+void DS2485_GetPortStats(DS2485_port_stats_T *stats)
+{
+    *stats = portStats;
+}
+
+void DS2485_ResetPortStats(void)
+{
+    memset(&portStats, 0, sizeof(portStats));
+}
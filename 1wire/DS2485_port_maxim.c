@@ -45,6 +45,7 @@
 
 /* **** Includes **** */
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>  // memcpy...
 
 #if 1 // Maxim-specific
@@ -61,31 +62,156 @@
 #define I2C_MASTER	    MXC_I2C0
 #define I2C_MASTER_IDX	0
 #define I2C_SLAVE_ADDR	(DS2485_I2C_7BIT_ADDRESS << 1)
+#define I2C_SPEED	    I2C_FASTPLUS_MODE // DS2485_I2C_CLOCKRATE, 1MHz
+
+// Uncomment to use the interrupt-driven I2C_MasterAsync API, sleeping (WFI) while a transfer is in progress.
+// Requires the application's I2C0 interrupt handler to call I2C_Handler(MXC_I2C0).
+// #define DS2485_MAXIM_USE_ASYNC
 
 /* **** Globals **** */
+static bool i2cInitialized; // initialized once, and again only after an error
+static DS2485_port_stats_T portStats; // maxStall_uSec and maxRecovery_uSec are not measured here
 
 /* **** Functions **** */
-int DS2485_ExecuteCommand(const uint8_t *packet, int packetSize, int delay_uSec, uint8_t *response, int responseSize)
+static int i2cInit(void)
 {
-    int error = 0;
     const sys_cfg_i2c_t sys_i2c_cfg = NULL;
 
-    //Setup the I2C Master
     I2C_Shutdown(I2C_MASTER);
-    if((error = I2C_Init(I2C_MASTER, I2C_STD_MODE, &sys_i2c_cfg)) != E_NO_ERROR) {
+    int error = I2C_Init(I2C_MASTER, I2C_SPEED, &sys_i2c_cfg);
+    i2cInitialized = (error == E_NO_ERROR);
+    return error;
+}
+
+// Re-initialize after an I2C error; a command cut short may have changed DS2485 port configuration
+static void i2cRecover(void)
+{
+    portStats.recoveries++;
+    i2cInit();
+    DS2485_InvalidatePortConfigShadow();
+}
+
+#ifdef DS2485_MAXIM_USE_ASYNC
+static volatile int asyncResult; // set by the I2C interrupt when the transfer ends
+#define ASYNC_PENDING 1          // not a valid error code
+
+static void asyncComplete(i2c_req_t *req, int error)
+{
+    (void)req;
+    asyncResult = error;
+}
+
+static int i2cTransfer(const uint8_t *txData, int txLength, uint8_t *rxData, int rxLength)
+{
+    i2c_req_t req = {
+        .addr = I2C_SLAVE_ADDR,
+        .tx_data = txData,
+        .rx_data = rxData,
+        .tx_len = txLength,
+        .rx_len = rxLength,
+        .restart = 0,
+        .callback = asyncComplete,
+    };
+    int error;
+
+    asyncResult = ASYNC_PENDING;
+    if((error = I2C_MasterAsync(I2C_MASTER, &req)) != E_NO_ERROR) {
         return error;
     }
+    while(asyncResult == ASYNC_PENDING) {
+        __WFI();
+    }
+    return asyncResult;
+}
+
+// E_COMM_ERR is a NAK: the DS2485 refused the transfer. Any other error is a bus fault needing i2cRecover().
+static int i2cWrite(const uint8_t *data, int length) { return i2cTransfer(data, length, NULL, 0); }
+static int i2cRead(uint8_t *data, int length) { return i2cTransfer(NULL, 0, data, length); }
+#else
+// The driver returns the bytes transferred, fewer if the DS2485 NAK'd, or a negative error code.
+// E_COMM_ERR is a NAK: the DS2485 refused the transfer. Any other error is a bus fault needing i2cRecover().
+static int transferResult(int result, int length)
+{
+    if(result == length) return E_NO_ERROR;
+    return (result >= 0) ? E_COMM_ERR : result;
+}
 
-    if((error = I2C_MasterWrite(MXC_I2C0, I2C_SLAVE_ADDR, packet, packetSize, 0)) != packetSize) {
+static int i2cWrite(const uint8_t *data, int length)
+{
+    return transferResult(I2C_MasterWrite(I2C_MASTER, I2C_SLAVE_ADDR, data, length, 0), length);
+}
+
+static int i2cRead(uint8_t *data, int length)
+{
+    return transferResult(I2C_MasterRead(I2C_MASTER, I2C_SLAVE_ADDR, data, length, 0), length);
+}
+#endif
+
+// Map a failed response read: a NAK means the DS2485 is still executing the command.
+// After a bus fault the response is lost; recover and report it (the command is not sent again).
+static int readError(int error)
+{
+    if(error == E_COMM_ERR) return RB_NOT_READY;
+    portStats.busErrors++;
+    portStats.failures++;
+    i2cRecover();
+    return RB_COMMS_FAIL;
+}
+
+int DS2485_ExecuteCommand(const uint8_t *packet, int packetSize, int delay_uSec, uint8_t *response, int responseSize)
+{
+    int error = 0;
+
+    //Setup the I2C Master
+    if(!i2cInitialized && (error = i2cInit()) != E_NO_ERROR) {
         return error;
     }
+    portStats.commands++;
+
+    // Send again only a packet the DS2485 refused. After a bus fault it may have taken the whole packet,
+    // and sending it again would run the command twice.
+    for(int attempt = 0; (error = i2cWrite(packet, packetSize)) != E_NO_ERROR; attempt++) {
+        if(error != E_COMM_ERR) {
+            portStats.busErrors++;
+            portStats.failures++;
+            i2cRecover();
+            return RB_COMMS_FAIL;
+        }
+        if(attempt >= DS2485_I2C_RETRIES) {
+            portStats.failures++;
+            return RB_COMMS_FAIL;
+        }
+        portStats.retries++;
+    }
 
-    mxc_delay(MXC_DELAY_MSEC(delay_uSec));
+    mxc_delay(MXC_DELAY_USEC(delay_uSec));
 
     //Read out Length Byte
-    if((error = I2C_MasterRead(MXC_I2C0, I2C_SLAVE_ADDR, response, responseSize, 0)) != responseSize) {
-        return error;
+    if((error = i2cRead(response, responseSize)) != E_NO_ERROR) {
+        return readError(error); // DS2485 does not acknowledge reads while busy
     }
 
     return 0;
 }
+
+int DS2485_ReadResponse(int delay_uSec, uint8_t *response, int responseSize)
+{
+    mxc_delay(MXC_DELAY_USEC(delay_uSec));
+
+    int error = i2cRead(response, responseSize);
+    if(error != E_NO_ERROR) {
+        return readError(error);
+    }
+
+    return 0;
+}
+
+void DS2485_GetPortStats(DS2485_port_stats_T *stats)
+{
+    *stats = portStats;
+}
+
+void DS2485_ResetPortStats(void)
+{
+    memset(&portStats, 0, sizeof(portStats));
+}
@@ -0,0 +1,157 @@
+/**
+ * @file DS2485_port_replay.c
+ * @brief Platform-specific interface answering DS2485 commands from a recorded trace (see DS2485_trace.h).
+ *
+ * @par Notes
+ * - Host (Linux) only: replays a session recorded on any platform, deterministically.
+ * - Each call must match the next record: same kind, and for commands the same packet.
+ *   A call that does not match is answered RB_COMMS_FAIL and counted; the log is not advanced.
+ * - With timeScale 0 nothing sleeps, so the run time is the CPU cost of the stack above the port.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* **** Includes **** */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "DS2485.h"
+#include "DS2485_trace.h"
+
+/* **** Globals **** */
+static const uint8_t *replayLog;
+static size_t replayLength, replayPosition;
+static double replayScale;
+static DS2485_replay_status_T replayStatus;
+static DS2485_port_stats_T portStats;
+
+/* **** Functions **** */
+int DS2485_Replay_Start(const uint8_t *log, size_t length, double timeScale)
+{
+    replayLog = NULL;
+    memset(&replayStatus, 0, sizeof(replayStatus));
+    if (length < 5 || memcmp(log, "DSTR", 4) != 0 || log[4] != DS2485_TRACE_VERSION)
+    {
+        replayStatus.ended = true;
+        return RB_INVALID_PARAMETER;
+    }
+    replayLog = log;
+    replayLength = length;
+    replayPosition = 5;
+    replayScale = timeScale;
+    replayStatus.ended = (length == 5);
+    return 0;
+}
+
+void DS2485_Replay_GetStatus(DS2485_replay_status_T *status)
+{
+    *status = replayStatus;
+}
+
+static bool getVarint(size_t *position, uint32_t *value)
+{
+    *value = 0;
+    for (int shift = 0; shift < 35 && *position < replayLength; shift += 7)
+    {
+        uint8_t b = replayLog[(*position)++];
+        *value |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+typedef struct {
+    uint8_t kind;
+    uint32_t delay_uSec, latency_uSec, responseSize, packetSize;
+    int error;
+    const uint8_t *packet, *response;
+    size_t next; // position of the following record
+} record_T;
+
+static bool parseRecord(record_T *r)
+{
+    size_t p = replayPosition;
+    uint32_t sincePrevious, zigzag;
+    if (p >= replayLength) return false;
+    r->kind = replayLog[p++];
+    if (!getVarint(&p, &sincePrevious) || !getVarint(&p, &r->delay_uSec) || !getVarint(&p, &r->latency_uSec)
+        || !getVarint(&p, &zigzag) || !getVarint(&p, &r->responseSize)) return false;
+    r->error = (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+    r->packetSize = 0;
+    r->packet = NULL;
+    if (r->kind == DS2485_TRACE_EXECUTE)
+    {
+        if (!getVarint(&p, &r->packetSize) || replayLength - p < r->packetSize) return false;
+        r->packet = &replayLog[p];
+        p += r->packetSize;
+    }
+    r->response = NULL;
+    if (r->error == 0)
+    {
+        if (replayLength - p < r->responseSize) return false;
+        r->response = &replayLog[p];
+        p += r->responseSize;
+    }
+    r->next = p;
+    return true;
+}
+
+static void sleep_uSec(double uSec)
+{
+    if (uSec <= 0) return;
+    struct timespec ts = { .tv_sec = (time_t)(uSec / 1e6), .tv_nsec = (long)((uSec - (double)(time_t)(uSec / 1e6) * 1e6) * 1000) };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+    {
+    }
+}
+
+// Answer one port call from the next record
+static int replay(DS2485_trace_kind_T kind, const uint8_t *packet, int packetSize, uint8_t *response, int responseSize)
+{
+    record_T r;
+    if (!replayLog || replayStatus.ended || !parseRecord(&r))
+    {
+        replayStatus.ended = true;
+        return RB_COMMS_FAIL;
+    }
+    if (r.kind != kind || (int)r.responseSize != responseSize
+        || (kind == DS2485_TRACE_EXECUTE && ((int)r.packetSize != packetSize || memcmp(r.packet, packet, packetSize) != 0)))
+    {
+        replayStatus.mismatches++;
+        return RB_COMMS_FAIL;
+    }
+    sleep_uSec(r.latency_uSec * replayScale);
+    if (r.error == 0) memcpy(response, r.response, responseSize);
+    replayPosition = r.next;
+    replayStatus.records++;
+    replayStatus.ended = (replayPosition >= replayLength);
+    return r.error;
+}
+
+int DS2485_ExecuteCommand(const uint8_t *packet, int packetSize, int delay_uSec, uint8_t *response, int responseSize)
+{
+    (void)delay_uSec; // the recorded latency includes the delay the recording stack asked for
+    portStats.commands++;
+    int error = replay(DS2485_TRACE_EXECUTE, packet, packetSize, response, responseSize);
+    if (error == RB_COMMS_FAIL) portStats.failures++;
+    return error;
+}
+
+int DS2485_ReadResponse(int delay_uSec, uint8_t *response, int responseSize)
+{
+    (void)delay_uSec;
+    return replay(DS2485_TRACE_READ, NULL, 0, response, responseSize);
+}
+
+void DS2485_GetPortStats(DS2485_port_stats_T *stats)
+{
+    *stats = portStats;
+}
+
+void DS2485_ResetPortStats(void)
+{
+    memset(&portStats, 0, sizeof(portStats));
+}
@@ -0,0 +1,955 @@
+/**
+ * @file DS2485_port_sim.c
+ * @brief Platform-specific interface to a simulated DS2485, with DS28E18/ENS210 probes on its 1-Wire bus (host only).
+ *
+ * @par Notes
+ * - The DS2485 model executes memory, port configuration, Master Reset, 1-Wire Search and 1-Wire Script commands.
+ *   Other commands, and script primitives not modeled, are answered with result 77h (invalid parameter).
+ * - Each DS28E18 follows the 1-Wire protocol byte by byte: reset and presence at its speed, Skip, Match,
+ *   Search and Overdrive Skip/Match ROM, command packets with CRC16, release byte, and response.
+ *   Several devices answering at once are combined as on the wire (wired-AND).
+ * - Its sequencer runs I2C commands against an ENS210, which must first be powered with SENS_VDD on,
+ *   and SPI commands against an SPI flash answering Read Data (03h, 24-bit address) with DS2485_Sim_SpiFlashByte.
+ * - Time: an I2C byte takes 9 us, and a command tOP plus tSEQ per primitive plus its 1-Wire time at the
+ *   default (PRESET_6) timings. A response read before that is refused (RB_NOT_READY), as by a DS2485.
+ *   A DS28E18 sequencer run takes its Utility Delays plus its I2C/SPI clocks at the configured speed;
+ *   the Run Sequencer response reads as all ones (no device driving the bus) until it completes.
+ *   With OneWire_OS_UseSimulatedClock(true) no call sleeps, so workloads run in CPU time.
+ */
+
+/* **** Includes **** */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "DS2485.h"
+#include "one_wire.h"
+#include "DS28E18.h"
+#include "one_wire_os.h"
+
+/* **** Definitions **** */
+#define I2C_BYTE_USEC       9   // 8 bits and acknowledge at DS2485_I2C_CLOCKRATE
+#define RESULT_SUCCESS      0xAA
+#define RESULT_INVALID      0x77
+#define SEQUENCER_SIZE      512
+#define ENS210_ADDRESS      0x43
+#define SPI_FLASH_READ      0x03
+
+static const uint32_t resetTime_uSec[2] = { tRSTL_STANDARD_PRESET_6 + tRSTH_STANDARD_PRESET_6, tRSTL_OVERDRIVE_PRESET_6 + tRSTH_OVERDRIVE_PRESET_6 };
+static const uint32_t slotTime_uSec[2]  = { tW0L_STANDARD_PRESET_6 + tREC_STANDARD_PRESET_6, tW0L_OVERDRIVE_PRESET_6 + tREC_OVERDRIVE_PRESET_6 };
+
+typedef struct {
+    bool powered;
+    uint8_t reg[0x40];
+    uint8_t address;        // current address register
+    bool addressed, reading;
+    int phase;              // bytes written since START: device address, register address, data
+    uint32_t conversions;
+    double temperature_C, humidity_pct;
+    uint8_t probe;
+} ens210_T;
+
+typedef struct {
+    bool selected;          // slave select low
+    int index;              // bytes clocked since it went low
+    uint8_t command;
+    uint32_t address;
+} spi_flash_T;
+
+typedef enum {
+    DEV_INACTIVE,           // not addressed until the next reset
+    DEV_ROM_COMMAND,        // reset seen, waiting for a ROM command
+    DEV_MATCH,              // receiving the ROM ID of (Overdrive) Match ROM
+    DEV_SEARCH,             // taking part in Search ROM
+    DEV_SELECTED,           // waiting for the command start byte
+    DEV_PACKET,             // receiving a command packet
+    DEV_COMMAND_CRC,        // sending the command packet's CRC16
+    DEV_RELEASE,            // waiting for the release byte
+    DEV_RESPONSE,           // sending the response
+} device_state_T;
+
+typedef struct {
+    bool connected;         // on the bus (see DS2485_Sim_ConnectProbe)
+    uint8_t romID[8];
+    bool romLoaded;         // unique ROM ID loaded by the first command after power-up
+    bool overdrive;
+    bool por;               // power-on reset not yet reported by Device Status
+    device_state_T state;
+    int index;              // ROM ID bit or byte, packet byte, or output byte
+    uint8_t packet[2 + 256];
+    uint8_t out[4 + 256];
+    int outLength;
+    uint8_t sequencer[SEQUENCER_SIZE];
+    uint64_t busyUntil_uSec;// sequencer run in progress until then
+    uint8_t configuration;
+    uint8_t gpio[2][2];     // control, buffer
+    ens210_T sensor;
+    spi_flash_T flash;
+} ds28e18_T;
+
+/* **** Globals **** */
+static ds28e18_T probes[DS2485_SIM_MAX_PROBES];
+static int probeCount;
+static uint8_t memory[PAGE_5 + 1][32];
+static uint8_t portConfig[RESERVED][2];
+static uint8_t response[2 + 256];
+static int responseLength;
+static bool responsePending;
+static uint64_t readyAt_uSec;
+static uint64_t busTime_uSec;
+static uint32_t commandTime_uSec; // of the command being executed
+static uint8_t searchRomID[8];    // 1-Wire Search state: last ROM ID found,
+static int searchLastDiscrepancy; // bit number (1..64) where the next search takes the 1 branch,
+static bool searchLastDevice;     // and whether it was the last
+static DS2485_port_stats_T portStats;
+static struct { int probe; uint8_t command; int count; } corrupt; // see DS2485_Sim_CorruptResponses
+static int oversleep_uSec;        // see DS2485_Sim_SetOversleep
+
+/* **** ENS210 **** */
+static const uint8_t powerUpRomID[8] = { DS28E18_FAMILY_CODE, 0, 0, 0, 0, 0, 0, 0xB2 };
+
+// CRC-7 of a 17-bit ENS210 measurement: polynomial x^7+x^3+1, initial value 7Fh
+static uint32_t crc7(uint32_t value)
+{
+    uint32_t polynomial = 0x89UL << 16;
+    uint32_t bit = 1UL << 23;
+    value = (value << 7) | 0x7F;
+    while (bit >= 0x80)
+    {
+        if (value & bit) value ^= polynomial;
+        bit >>= 1;
+        polynomial >>= 1;
+    }
+    return value;
+}
+
+static void ens210SetValue(ens210_T *s, int reg, uint32_t raw)
+{
+    uint32_t payload = (1UL << 16) | (raw & 0xFFFF); // valid
+    s->reg[reg] = raw & 0xFF;
+    s->reg[reg + 1] = (raw >> 8) & 0xFF;
+    s->reg[reg + 2] = (uint8_t)((crc7(payload) << 1) | 1);
+}
+
+static void ens210Convert(ens210_T *s)
+{
+    double wobble = 0.01 * (s->conversions++ % 8); // successive readings differ slightly
+    ens210SetValue(s, 0x30, (uint32_t)((s->temperature_C + wobble + 273.15) * 64 + 0.5));
+    ens210SetValue(s, 0x33, (uint32_t)((s->humidity_pct + wobble) * 512 + 0.5));
+}
+
+static void ens210Reset(ens210_T *s)
+{
+    memset(s->reg, 0, sizeof(s->reg));
+    s->reg[0x00] = 0x10; // PART_ID 0210h
+    s->reg[0x01] = 0x02;
+    s->reg[0x02] = 0x03; // DIE_REV
+    for (int i = 0; i < 8; i++)
+    {
+        s->reg[0x04 + i] = (uint8_t)(0xE0 + s->probe + i); // UID
+    }
+    s->reg[0x10] = 0x01; // SYS_CTRL: low power
+}
+
+static void ens210Write(ens210_T *s, uint8_t value)
+{
+    uint8_t reg = s->address++ & 0x3F;
+    switch (reg)
+    {
+    case 0x10: // SYS_CTRL
+        if (value & 0x80)
+        {
+            ens210Reset(s);
+            return;
+        }
+        s->reg[reg] = value & 0x01;
+        break;
+    case 0x21: // SENS_RUN
+        s->reg[reg] = value & 0x03;
+        if (value & 0x03) ens210Convert(s);
+        break;
+    case 0x22: // SENS_START
+        if (value & 0x03) ens210Convert(s);
+        break;
+    default:
+        break; // read-only
+    }
+}
+
+static uint8_t ens210Read(ens210_T *s)
+{
+    uint8_t reg = s->address++ & 0x3F;
+    if (reg == 0x11) return (s->reg[0x10] & 0x01) ? 0 : 1; // SYS_STAT: active unless low power
+    if (reg == 0x30 && (s->reg[0x21] & 0x03)) ens210Convert(s); // continuous: a new conversion each read
+    return s->reg[reg];
+}
+
+static bool i2cWrite(ens210_T *s, uint8_t value)
+{
+    switch (s->phase++)
+    {
+    case 0:
+        s->addressed = s->powered && (value >> 1) == ENS210_ADDRESS;
+        s->reading = value & 0x01;
+        return s->addressed;
+    case 1:
+        if (s->addressed && !s->reading) s->address = value;
+        return s->addressed && !s->reading;
+    default:
+        if (s->addressed && !s->reading) ens210Write(s, value);
+        return s->addressed && !s->reading;
+    }
+}
+
+static uint8_t i2cRead(ens210_T *s)
+{
+    return (s->addressed && s->reading) ? ens210Read(s) : 0xFF;
+}
+
+/* **** SPI flash **** */
+// Clock one byte out to the flash, returning the byte clocked in
+static uint8_t spiTransfer(ds28e18_T *d, uint8_t mosi)
+{
+    spi_flash_T *f = &d->flash;
+    if (!f->selected) return 0xFF;
+    int index = f->index++;
+    if (index == 0)
+    {
+        f->command = mosi;
+        f->address = 0;
+        return 0xFF;
+    }
+    if (f->command != SPI_FLASH_READ) return 0xFF;
+    if (index <= 3)
+    {
+        f->address = (f->address << 8) | mosi;
+        return 0xFF;
+    }
+    return DS2485_Sim_SpiFlashByte(d->sensor.probe, f->address++);
+}
+
+/* **** DS28E18 **** */
+static void ds28e18PowerUp(ds28e18_T *d)
+{
+    d->romLoaded = false;
+    d->overdrive = false;
+    d->por = true;
+    d->state = DEV_INACTIVE;
+    memset(d->sequencer, 0, sizeof(d->sequencer));
+    d->configuration = KHZ_400;
+    memset(d->gpio, 0, sizeof(d->gpio));
+    d->sensor.powered = false;
+    d->flash.selected = false;
+    d->busyUntil_uSec = 0;
+}
+
+static const uint8_t *ds28e18RomID(const ds28e18_T *d)
+{
+    return d->romLoaded ? d->romID : powerUpRomID;
+}
+
+// Execute the sequencer commands at address..address+length; returns the result byte, and its run time
+static uint8_t ds28e18RunSequencer(ds28e18_T *d, int address, int length, int *nackAddress, uint32_t *runTime_uSec)
+{
+    static const uint32_t clockPeriod_nsec[] = { 10000, 2500, 1000, 435 }; // KHZ_100 .. KHZ_2300
+    ens210_T *s = &d->sensor;
+    bool ignoreNack = d->configuration & (IGNORE << 2);
+    int end = address + length;
+    int i = address;
+    uint32_t delay_uSec = 0, clocks = 0;
+    uint8_t result = SUCCESS;
+    while (i < end && result == SUCCESS)
+    {
+        uint8_t *cmd = &d->sequencer[i % SEQUENCER_SIZE];
+        int p1 = d->sequencer[(i + 1) % SEQUENCER_SIZE];
+        int p2 = d->sequencer[(i + 2) % SEQUENCER_SIZE];
+        switch (*cmd)
+        {
+        case I2C_START:
+            s->phase = 0;
+            s->addressed = false;
+            i += 1;
+            break;
+        case I2C_STOP:
+            s->addressed = false;
+            i += 1;
+            break;
+        case I2C_WRITE_DATA:
+            for (int k = 0; k < p1 && result == SUCCESS; k++)
+            {
+                int at = (i + 2 + k) % SEQUENCER_SIZE;
+                clocks += 9;
+                if (!i2cWrite(s, d->sequencer[at]) && !ignoreNack)
+                {
+                    *nackAddress = at;
+                    result = NACK_OCCURED;
+                }
+            }
+            i += 2 + p1;
+            break;
+        case I2C_READ_DATA:
+        case I2C_READ_DATA_W_NACK_END:
+            if (p1 == 0) p1 = 256;
+            for (int k = 0; k < p1; k++)
+            {
+                d->sequencer[(i + 2 + k) % SEQUENCER_SIZE] = i2cRead(s);
+            }
+            clocks += 9 * p1;
+            i += 2 + p1;
+            break;
+        case SPI_WRITE_READ_BYTE: // write array out, then 0xFF; the read array takes what comes back from the first byte
+            for (int k = 0; k < p1 || k < p2; k++)
+            {
+                uint8_t miso = spiTransfer(d, (k < p1) ? d->sequencer[(i + 3 + k) % SEQUENCER_SIZE] : 0xFF);
+                if (k < p2) d->sequencer[(i + 3 + p1 + k) % SEQUENCER_SIZE] = miso;
+            }
+            clocks += 8 * (p1 > p2 ? p1 : p2);
+            i += 3 + p1 + p2;
+            break;
+        case SPI_WRITE_READ_BIT:
+            clocks += (p1 > p2 ? p1 : p2);
+            i += 3 + (p1 + 7) / 8 + (p2 + 7) / 8;
+            break;
+        case UTILITY_DELAY:
+            delay_uSec += 1000U << (p1 & 0x0F);
+            i += 2;
+            break;
+        case UTILITY_GPIO_BUF_WRITE:
+        case UTILITY_GPIO_BUF_READ:
+            i += 2;
+            break;
+        case UTILITY_GPIO_CNTL_WRITE:
+        case UTILITY_GPIO_CNTL_READ:
+            i += 3;
+            break;
+        case UTILITY_SENS_VDD_ON:
+            if (!s->powered) ens210Reset(s);
+            s->powered = true;
+            i += 1;
+            break;
+        case UTILITY_SENS_VDD_OFF:
+            s->powered = false;
+            i += 1;
+            break;
+        case SPI_SS_HIGH:
+        case SPI_SS_LOW:
+            d->flash.selected = (*cmd == SPI_SS_LOW);
+            d->flash.index = 0;
+            i += 1;
+            break;
+        default:
+            result = EXECUTION_ERROR;
+            break;
+        }
+    }
+    *runTime_uSec = delay_uSec + (clocks * clockPeriod_nsec[d->configuration & 0x03]) / 1000;
+    return (result == SUCCESS && i != end) ? EXECUTION_ERROR : result;
+}
+
+// Execute the received command packet; leave the response to be read
+static void ds28e18Execute(ds28e18_T *d)
+{
+    const uint8_t *p = &d->packet[3]; // parameters
+    int parameters = d->packet[1] - 1;
+    uint8_t *result = &d->out[2];
+    int resultLength = 1;
+    int address, length;
+
+    d->romLoaded = true;
+    result[0] = SUCCESS;
+    switch (d->packet[2])
+    {
+    case WRITE_SEQUENCER:
+        address = p[0] | (p[1] & 0x01) << 8;
+        length = parameters - 2;
+        if (length < 0 || address + length > SEQUENCER_SIZE)
+        {
+            result[0] = INVALID_PARAMETER;
+            break;
+        }
+        memcpy(&d->sequencer[address], &p[2], length);
+        break;
+    case READ_SEQUENCER:
+        address = p[0] | (p[1] & 0x01) << 8;
+        length = (p[1] >> 1) ? (p[1] >> 1) : 128;
+        if (address + length > SEQUENCER_SIZE)
+        {
+            result[0] = INVALID_PARAMETER;
+            break;
+        }
+        memcpy(&result[1], &d->sequencer[address], length);
+        resultLength += length;
+        break;
+    case RUN_SEQUENCER:
+    {
+        int nackAddress = 0;
+        uint32_t runTime_uSec = 0;
+        address = p[0] | (p[1] & 0x01) << 8;
+        length = ((p[1] >> 1) | (p[2] & 0x03) << 7);
+        if (length == 0) length = SEQUENCER_SIZE;
+        if (d->por)
+        {
+            result[0] = POR_OCCURRED;
+            break;
+        }
+        result[0] = ds28e18RunSequencer(d, address, length, &nackAddress, &runTime_uSec);
+        d->busyUntil_uSec = OneWire_OS_Now_uSec() + commandTime_uSec + runTime_uSec;
+        if (result[0] == NACK_OCCURED)
+        {
+            result[1] = nackAddress & 0xFF;
+            result[2] = (nackAddress >> 8) & 0xFF;
+            resultLength += 2;
+        }
+        break;
+    }
+    case WRITE_CONFIGURATION:
+        d->configuration = p[0];
+        break;
+    case READ_CONFIGURATION:
+        result[1] = d->configuration;
+        resultLength += 1;
+        break;
+    case WRITE_GPIO_CONFIGURATION:
+        d->gpio[p[0] == BUFFER][0] = p[2];
+        d->gpio[p[0] == BUFFER][1] = p[3];
+        break;
+    case READ_GPIO_CONFIGURATION:
+        result[1] = d->gpio[p[0] == BUFFER][0];
+        result[2] = d->gpio[p[0] == BUFFER][1];
+        resultLength += 2;
+        break;
+    case DEVICE_STATUS:
+        result[1] = d->por ? 0x80 : 0x00;
+        result[2] = 0x01; // device version
+        result[3] = 0x00; // manufacturer ID
+        result[4] = 0x00;
+        resultLength += 4;
+        d->por = false;
+        break;
+    default:
+        result[0] = INVALID_PARAMETER;
+        break;
+    }
+
+    d->out[0] = 0xFF; // dummy byte
+    d->out[1] = (uint8_t)resultLength;
+    unsigned int crc = OneWire_CalculateCrc16Block(&d->out[1], 1 + resultLength, 0) ^ 0xFFFFU;
+    d->out[2 + resultLength] = crc & 0xFF;
+    d->out[3 + resultLength] = crc >> 8;
+    if (corrupt.count > 0 && d == &probes[corrupt.probe] && d->packet[2] == corrupt.command)
+    {
+        corrupt.count--;
+        d->out[2 + resultLength] ^= 0x01;
+    }
+    d->outLength = 4 + resultLength;
+    d->index = 0;
+    d->state = DEV_RESPONSE;
+}
+
+static void ds28e18WriteByte(ds28e18_T *d, uint8_t value)
+{
+    switch (d->state)
+    {
+    case DEV_ROM_COMMAND:
+        d->index = 0;
+        switch (value)
+        {
+        case SKIP_ROM:
+            d->state = DEV_SELECTED;
+            break;
+        case OVERDRIVE_SKIP:
+            d->overdrive = true;
+            d->state = DEV_SELECTED;
+            break;
+        case MATCH_ROM:
+            d->state = DEV_MATCH;
+            break;
+        case OVERDRIVE_MATCH:
+            d->overdrive = true; // the ROM ID follows at overdrive; a device not matching returns to standard
+            d->state = DEV_MATCH;
+            break;
+        case SEARCH_ROM:
+            d->state = DEV_SEARCH;
+            break;
+        default:
+            d->state = DEV_INACTIVE;
+            break;
+        }
+        break;
+    case DEV_MATCH:
+        if (value != ds28e18RomID(d)[d->index])
+        {
+            d->overdrive = false;
+            d->state = DEV_INACTIVE;
+        }
+        else if (++d->index == 8)
+        {
+            d->state = DEV_SELECTED;
+        }
+        break;
+    case DEV_SELECTED:
+        d->index = 0;
+        d->state = (value == COMMAND_START) ? DEV_PACKET : DEV_INACTIVE;
+        break;
+    case DEV_PACKET:
+        d->packet[0] = COMMAND_START;
+        d->packet[1 + d->index++] = value;
+        if (d->index > 1 && d->index == 1 + d->packet[1])
+        {
+            unsigned int crc = OneWire_CalculateCrc16Block(d->packet, 2 + d->packet[1], 0) ^ 0xFFFFU;
+            d->out[0] = crc & 0xFF;
+            d->out[1] = crc >> 8;
+            d->outLength = 2;
+            d->index = 0;
+            d->state = DEV_COMMAND_CRC;
+        }
+        break;
+    case DEV_RELEASE:
+        if (value == OneWire_Release_Byte_xAA)
+        {
+            ds28e18Execute(d);
+        }
+        else
+        {
+            d->state = DEV_INACTIVE;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static uint8_t ds28e18ReadByte(ds28e18_T *d)
+{
+    if ((d->state != DEV_COMMAND_CRC && d->state != DEV_RESPONSE) || d->index >= d->outLength) return 0xFF;
+    if (d->state == DEV_RESPONSE && OneWire_OS_Now_uSec() < d->busyUntil_uSec) return 0xFF; // still running
+    uint8_t value = d->out[d->index++];
+    if (d->state == DEV_COMMAND_CRC && d->index == d->outLength) d->state = DEV_RELEASE;
+    return value;
+}
+
+/* **** 1-Wire bus **** */
+static bool hears(const ds28e18_T *d, one_wire_speeds speed)
+{
+    return d->connected && d->overdrive == (speed == OVERDRIVE);
+}
+
+static void busTime(uint32_t uSec)
+{
+    busTime_uSec += uSec;
+    commandTime_uSec += uSec;
+}
+
+// Returns true on a presence pulse
+static bool busReset(one_wire_speeds speed)
+{
+    bool presence = false;
+    busTime(resetTime_uSec[speed]);
+    for (int i = 0; i < probeCount; i++)
+    {
+        ds28e18_T *d = &probes[i];
+        if (speed == STANDARD) d->overdrive = false; // a standard reset returns every device to standard speed
+        if (!hears(d, speed)) continue;            // an overdrive reset is too short for standard-speed devices
+        d->state = DEV_ROM_COMMAND;
+        presence = true;
+    }
+    return presence;
+}
+
+static void busWriteByte(one_wire_speeds speed, uint8_t value)
+{
+    busTime(8 * slotTime_uSec[speed]);
+    for (int i = 0; i < probeCount; i++)
+    {
+        if (hears(&probes[i], speed)) ds28e18WriteByte(&probes[i], value);
+    }
+}
+
+static uint8_t busReadByte(one_wire_speeds speed)
+{
+    uint8_t value = 0xFF;
+    busTime(8 * slotTime_uSec[speed]);
+    for (int i = 0; i < probeCount; i++)
+    {
+        if (hears(&probes[i], speed)) value &= ds28e18ReadByte(&probes[i]);
+    }
+    return value;
+}
+
+// Search ROM triplet: read a ROM ID bit and its complement from the devices taking part, then write the direction
+static uint8_t busTriplet(one_wire_speeds speed, bool direction)
+{
+    bool idBit = true, cmpBit = true;
+    busTime(3 * slotTime_uSec[speed]);
+    for (int i = 0; i < probeCount; i++)
+    {
+        ds28e18_T *d = &probes[i];
+        if (d->state != DEV_SEARCH || !hears(d, speed)) continue;
+        bool bit = (ds28e18RomID(d)[d->index / 8] >> (d->index % 8)) & 1;
+        idBit &= bit;
+        cmpBit &= !bit;
+    }
+    if (idBit != cmpBit) direction = idBit;
+    for (int i = 0; i < probeCount; i++)
+    {
+        ds28e18_T *d = &probes[i];
+        if (d->state != DEV_SEARCH || !hears(d, speed)) continue;
+        bool bit = (ds28e18RomID(d)[d->index / 8] >> (d->index % 8)) & 1;
+        if (bit != direction) d->state = DEV_INACTIVE;
+        else if (++d->index == 64) d->state = DEV_SELECTED;
+    }
+    return (idBit ? OW_TRIPLET_ID_BIT : 0) | (cmpBit ? OW_TRIPLET_CMP_ID_BIT : 0) | (direction ? OW_TRIPLET_DIRECTION : 0);
+}
+
+/* **** DS2485 **** */
+static one_wire_speeds masterSpeed(void)
+{
+    return (portConfig[MASTER_CONFIGURATION][1] & 0x80) ? OVERDRIVE : STANDARD;
+}
+
+static void setMasterSpeed(one_wire_speeds speed)
+{
+    portConfig[MASTER_CONFIGURATION][1] = (portConfig[MASTER_CONFIGURATION][1] & ~0x80) | (speed << 7);
+}
+
+static void masterReset(void)
+{
+    memset(portConfig, 0, sizeof(portConfig));
+    for (int reg = STANDARD_SPEED_tRSTL; reg <= OVERDRIVE_SPEED_tREC; reg++)
+    {
+        portConfig[reg][0] = PRESET_6;
+    }
+}
+
+// CRC16 of the 1-Wire bytes written and read since PC_CRC16_START, while crcActive
+static bool crcActive;
+static unsigned int crc;
+
+static void scriptWriteByte(one_wire_speeds speed, uint8_t value)
+{
+    busWriteByte(speed, value);
+    if (crcActive) crc = OneWire_CalculateCrc16Byte(value, crc);
+}
+
+static uint8_t scriptReadByte(one_wire_speeds speed)
+{
+    uint8_t value = busReadByte(speed);
+    if (crcActive) crc = OneWire_CalculateCrc16Byte(value, crc);
+    return value;
+}
+
+// Run a 1-Wire script; returns the result byte, and appends primitive responses to 'out'
+static uint8_t runScript(const uint8_t *script, int length, uint8_t *out, int *outLength)
+{
+    int i = 0;
+    crcActive = false;
+    while (i < length)
+    {
+        uint8_t primitive = script[i++];
+        uint8_t parameter = (i < length) ? script[i] : 0;
+        one_wire_speeds speed = masterSpeed();
+        commandTime_uSec += tSEQ_USEC;
+        switch (primitive)
+        {
+        case PC_OW_RESET:
+            setMasterSpeed((parameter >> 3) & 1);
+            out[(*outLength)++] = primitive;
+            out[(*outLength)++] = busReset(masterSpeed()) ? 0x02 : 0x00;
+            i++;
+            break;
+        case PC_OW_WRITE_BYTE:
+            scriptWriteByte(speed, parameter);
+            out[(*outLength)++] = primitive;
+            out[(*outLength)++] = parameter;
+            i++;
+            break;
+        case PC_OW_READ_BYTE:
+            out[(*outLength)++] = primitive;
+            out[(*outLength)++] = scriptReadByte(speed);
+            break;
+        case PC_OW_TRIPLET:
+            out[(*outLength)++] = primitive;
+            out[(*outLength)++] = busTriplet(speed, parameter & 1);
+            i++;
+            break;
+        case PC_OW_SKIP:
+            out[(*outLength)++] = primitive;
+            out[(*outLength)++] = busReset(speed) ? 0x02 : 0x00;
+            busWriteByte(speed, SKIP_ROM);
+            break;
+        case PC_OW_OV_SKIP:
+        {
+            bool presence = busReset(STANDARD);
+            busWriteByte(STANDARD, OVERDRIVE_SKIP);
+            setMasterSpeed(OVERDRIVE);
+            presence = busReset(OVERDRIVE) && presence;
+            out[(*outLength)++] = primitive;
+            out[(*outLength)++] = presence ? 0x02 : 0x00;
+            break;
+        }
+        case PC_OW_READ_BLOCK:
+            out[(*outLength)++] = primitive;
+            out[(*outLength)++] = parameter;
+            for (int k = 0; k < parameter; k++)
+            {
+                out[(*outLength)++] = scriptReadByte(speed);
+            }
+            i++;
+            break;
+        case PC_OW_WRITE_BLOCK:
+            if (i + 1 + parameter > length) return RESULT_INVALID;
+            for (int k = 0; k < parameter; k++)
+            {
+                scriptWriteByte(speed, script[i + 1 + k]);
+            }
+            out[(*outLength)++] = primitive;
+            out[(*outLength)++] = RESULT_SUCCESS;
+            i += 1 + parameter;
+            break;
+        case PC_DELAY:
+            commandTime_uSec += parameter * 1000U;
+            i++;
+            break;
+        case PC_PRIME_SPU:
+        case PC_SPU_OFF:
+            break;
+        case PC_SPEED:
+            setMasterSpeed((parameter >> 3) & 1);
+            busReset(masterSpeed());
+            i++;
+            break;
+        case PC_CRC16_START:
+            crcActive = true;
+            crc = 0;
+            break;
+        case PC_VERIFY_CRC16:
+            if (i + 2 > length) return RESULT_INVALID;
+            out[(*outLength)++] = primitive;
+            out[(*outLength)++] = (crcActive && crc == (unsigned int)(script[i] | script[i + 1] << 8)) ? RESULT_SUCCESS : 0x00;
+            crcActive = false;
+            i += 2;
+            break;
+        default:
+            return RESULT_INVALID;
+        }
+    }
+    return RESULT_SUCCESS;
+}
+
+// 1-Wire Search command: find the next device, as in the DS2485 (Maxim application note 187).
+// Returns the result byte; the ROM ID and last device flag follow it in 'out'.
+static uint8_t search(uint8_t parameter, uint8_t code, uint8_t *out)
+{
+    one_wire_speeds speed = masterSpeed();
+    int lastZero = 0;
+
+    memset(out, 0, 9);
+    if (parameter & 0x04)
+    {
+        searchLastDiscrepancy = 0;
+        searchLastDevice = false;
+    }
+    if (searchLastDevice)
+    {
+        searchLastDiscrepancy = 0;
+        searchLastDevice = false;
+        return 0x00; // no more devices
+    }
+    if ((parameter & 0x01) && !busReset(speed) && !(parameter & 0x02)) return 0x33;
+    commandTime_uSec += tSEQ_USEC;
+    busWriteByte(speed, code);
+    for (int bit = 0; bit < 64; bit++)
+    {
+        bool direction = (bit + 1 < searchLastDiscrepancy) ? (searchRomID[bit / 8] >> (bit % 8)) & 1 : (bit + 1 == searchLastDiscrepancy);
+        commandTime_uSec += tSEQ_USEC;
+        uint8_t triplet = busTriplet(speed, direction);
+        if ((triplet & OW_TRIPLET_ID_BIT) && (triplet & OW_TRIPLET_CMP_ID_BIT))
+        {
+            searchLastDiscrepancy = 0;
+            return 0x00; // no device taking part
+        }
+        direction = triplet & OW_TRIPLET_DIRECTION;
+        if (!(triplet & (OW_TRIPLET_ID_BIT | OW_TRIPLET_CMP_ID_BIT)) && !direction) lastZero = bit + 1;
+        if (direction) searchRomID[bit / 8] |= (1 << (bit % 8));
+        else searchRomID[bit / 8] &= ~(1 << (bit % 8));
+    }
+    searchLastDiscrepancy = lastZero;
+    searchLastDevice = (lastZero == 0);
+    memcpy(out, searchRomID, 8);
+    out[8] = searchLastDevice;
+    return RESULT_SUCCESS;
+}
+
+// Execute a DS2485 command packet, leaving its response and completion time
+static void execute(const uint8_t *packet, int packetSize)
+{
+    uint8_t result = RESULT_SUCCESS;
+    int length = 0; // data bytes after the result byte
+    commandTime_uSec = tOP_USEC;
+    switch (packet[0])
+    {
+    case DFC_WRITE_MEMORY:
+        if (packetSize != 35 || packet[2] > PAGE_5)
+        {
+            result = RESULT_INVALID;
+            break;
+        }
+        memcpy(memory[packet[2]], &packet[3], 32);
+        commandTime_uSec += tWM_MSEC * 1000;
+        break;
+    case DFC_READ_MEMORY:
+        if (packetSize != 3 || packet[2] > PAGE_5)
+        {
+            result = RESULT_INVALID;
+            break;
+        }
+        memcpy(&response[2], memory[packet[2]], 32);
+        length = 32;
+        commandTime_uSec += tRM_MSEC * 1000;
+        break;
+    case DFC_READ_ONE_WIRE_PORT_CONFIG:
+        if (packet[2] < RESERVED)
+        {
+            memcpy(&response[2], portConfig[packet[2]], 2);
+            length = 2;
+        }
+        else
+        {
+            memset(&response[2], 0, 40);
+            memcpy(&response[2], portConfig, sizeof(portConfig));
+            length = 40;
+        }
+        break;
+    case DFC_WRITE_ONE_WIRE_PORT_CONFIG:
+        if (packetSize != 5 || packet[2] >= RESERVED)
+        {
+            result = RESULT_INVALID;
+            break;
+        }
+        memcpy(portConfig[packet[2]], &packet[3], 2);
+        break;
+    case DFC_MASTER_RESET:
+        masterReset();
+        break;
+    case DFC_ONE_WIRE_SEARCH:
+        if (packetSize != 4)
+        {
+            result = RESULT_INVALID;
+            break;
+        }
+        result = search(packet[2], packet[3], &response[2]);
+        length = 9;
+        break;
+    case DFC_ONE_WIRE_SCRIPT:
+        result = runScript(&packet[2], packetSize - 2, &response[2], &length);
+        break;
+    default:
+        result = RESULT_INVALID;
+        break;
+    }
+    response[0] = (uint8_t)(1 + length);
+    response[1] = result;
+    responseLength = 2 + length;
+    responsePending = true;
+    readyAt_uSec = OneWire_OS_Now_uSec() + commandTime_uSec;
+}
+
+/* **** Functions **** */
+void DS2485_Sim_Start(const DS2485_sim_config_T *config)
+{
+    probeCount = (config->probes < 0) ? 0 : (config->probes > DS2485_SIM_MAX_PROBES) ? DS2485_SIM_MAX_PROBES : config->probes;
+    for (int i = 0; i < probeCount; i++)
+    {
+        ds28e18_T *d = &probes[i];
+        d->romID[0] = DS28E18_FAMILY_CODE;
+        for (int b = 1; b < 7; b++)
+        {
+            d->romID[b] = (uint8_t)((b == 1) ? i + 1 : 0x10 * b + i);
+        }
+        d->romID[7] = OneWire_CalculateCrc8(d->romID, 7);
+        d->sensor.probe = (uint8_t)i;
+        d->sensor.temperature_C = config->temperature_C + 0.5 * i;
+        d->sensor.humidity_pct = config->humidity_pct;
+        d->sensor.conversions = 0;
+        d->connected = true;
+        ds28e18PowerUp(d);
+    }
+    memset(memory, 0xFF, sizeof(memory)); // blank
+    masterReset();
+    searchLastDiscrepancy = 0;
+    searchLastDevice = false;
+    responsePending = false;
+    busTime_uSec = 0;
+    memset(&portStats, 0, sizeof(portStats));
+    corrupt.count = 0;
+    oversleep_uSec = 0;
+}
+
+void DS2485_Sim_PowerCycleProbe(int probe)
+{
+    if (probe >= 0 && probe < probeCount) ds28e18PowerUp(&probes[probe]);
+}
+
+void DS2485_Sim_ConnectProbe(int probe, bool connected)
+{
+    if (probe < 0 || probe >= probeCount) return;
+    if (connected && !probes[probe].connected) ds28e18PowerUp(&probes[probe]);
+    probes[probe].connected = connected;
+}
+
+uint8_t DS2485_Sim_SpiFlashByte(int probe, uint32_t address)
+{
+    return (uint8_t)(address * 31 + (address >> 8) + probe * 0x11);
+}
+
+uint64_t DS2485_Sim_BusTime_uSec(void)
+{
+    return busTime_uSec;
+}
+
+void DS2485_Sim_CorruptResponses(int probe, uint8_t command, int count)
+{
+    if (probe < 0 || probe >= probeCount) return;
+    corrupt.probe = probe;
+    corrupt.command = command;
+    corrupt.count = count;
+}
+
+void DS2485_Sim_SetOversleep(int uSec)
+{
+    oversleep_uSec = (uSec < 0) ? 0 : uSec;
+}
+
+int DS2485_ExecuteCommand(const uint8_t *packet, int packetSize, int delay_uSec, uint8_t *response, int responseSize)
+{
+    portStats.commands++;
+    if (packetSize < 1)
+    {
+        portStats.failures++;
+        return RB_COMMS_FAIL;
+    }
+    OneWire_OS_Delay_uSec((1 + packetSize) * I2C_BYTE_USEC); // address and packet
+    execute(packet, packetSize);
+    return DS2485_ReadResponse(delay_uSec, response, responseSize);
+}
+
+int DS2485_ReadResponse(int delay_uSec, uint8_t *responseBuffer, int responseSize)
+{
+    OneWire_OS_Delay_uSec(delay_uSec + oversleep_uSec + I2C_BYTE_USEC); // then the address byte
+    if (!responsePending) return RB_COMMS_FAIL;
+    if (OneWire_OS_Now_uSec() < readyAt_uSec) return RB_NOT_READY; // address not acknowledged
+    OneWire_OS_Delay_uSec(responseSize * I2C_BYTE_USEC);
+    memset(responseBuffer, 0xFF, responseSize);
+    memcpy(responseBuffer, response, (responseSize < responseLength) ? responseSize : responseLength);
+    return 0;
+}
+
+void DS2485_GetPortStats(DS2485_port_stats_T *stats)
+{
+    *stats = portStats;
+}
+
+void DS2485_ResetPortStats(void)
+{
+    memset(&portStats, 0, sizeof(portStats));
+}
@@ -0,0 +1,108 @@
+/**
+ * @file DS2485_trace.c
+ * @brief Recorder for DS2485 I2C exchanges, see DS2485_trace.h.
+ */
+
+#ifdef __linux__
+  #define _POSIX_C_SOURCE 200809L
+  #include <time.h>
+#endif
+#include <stdint.h>
+#include <string.h>
+#include "DS2485_trace.h"
+
+/* **** Locals **** */
+static uint8_t *logBuffer;
+static size_t logSize, logUsed;
+static bool logOverflow;
+static uint32_t lastStart_uSec;
+
+uint32_t DS2485_Trace_Now_uSec(void)
+{
+#if defined(DS2485_TRACE_NOW_USEC)
+    return DS2485_TRACE_NOW_USEC();
+#elif defined(__linux__)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000U + (uint64_t)ts.tv_nsec / 1000U);
+#else
+    #error "Define DS2485_TRACE_NOW_USEC() for this platform"
+#endif
+}
+
+void DS2485_Trace_StartRecording(uint8_t *buffer, size_t size)
+{
+    logBuffer = NULL;
+    logOverflow = (size < 5);
+    if (logOverflow) return;
+    memcpy(buffer, "DSTR", 4);
+    buffer[4] = DS2485_TRACE_VERSION;
+    logUsed = 5;
+    logSize = size;
+    lastStart_uSec = DS2485_Trace_Now_uSec();
+    logBuffer = buffer; // set last: recording starts here
+}
+
+size_t DS2485_Trace_StopRecording(bool *complete)
+{
+    logBuffer = NULL;
+    if (complete) *complete = !logOverflow;
+    return logUsed;
+}
+
+// Append to the record being built in 'record'; false if it would not fit in the log
+static bool put(uint8_t *record, size_t *length, const void *data, size_t size)
+{
+    if (logUsed + *length + size > logSize) return false;
+    memcpy(&record[*length], data, size);
+    *length += size;
+    return true;
+}
+
+static bool putVarint(uint8_t *record, size_t *length, uint32_t value)
+{
+    uint8_t bytes[5];
+    size_t n = 0;
+    do {
+        bytes[n] = value & 0x7F;
+        value >>= 7;
+        if (value) bytes[n] |= 0x80;
+        n++;
+    } while (value);
+    return put(record, length, bytes, n);
+}
+
+void DS2485_Trace_Record(DS2485_trace_kind_T kind, uint32_t start_uSec, const uint8_t *packet, int packetSize,
+                         int delay_uSec, const uint8_t *response, int responseSize, int error)
+{
+    if (!logBuffer) return;
+    uint32_t latency_uSec = DS2485_Trace_Now_uSec() - start_uSec;
+    uint32_t sincePrevious_uSec = start_uSec - lastStart_uSec;
+    lastStart_uSec = start_uSec;
+
+    // Build in place after the log, then commit the record only if all of it fit
+    uint8_t *record = &logBuffer[logUsed];
+    size_t length = 0;
+    uint8_t kindByte = (uint8_t)kind;
+    bool fits = put(record, &length, &kindByte, 1)
+             && putVarint(record, &length, sincePrevious_uSec)
+             && putVarint(record, &length, (uint32_t)delay_uSec)
+             && putVarint(record, &length, latency_uSec)
+             && putVarint(record, &length, ((uint32_t)error << 1) ^ (uint32_t)(error >> 31)) // zigzag: small negative codes stay short
+             && putVarint(record, &length, (uint32_t)responseSize);
+    if (fits && kind == DS2485_TRACE_EXECUTE)
+    {
+        fits = putVarint(record, &length, (uint32_t)packetSize) && put(record, &length, packet, packetSize);
+    }
+    if (fits && error == 0)
+    {
+        fits = put(record, &length, response, responseSize);
+    }
+    if (!fits)
+    {
+        logOverflow = true;
+        logBuffer = NULL;
+        return;
+    }
+    logUsed += length;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file DS2485_trace.h
+ * @brief Record and replay of the I2C exchanges between DS2485.c and the DS2485.
+ *
+ * Built with DS2485_TRACE defined, DS2485.c passes every DS2485_ExecuteCommand and
+ * DS2485_ReadResponse call (packet, requested delay, response, result and latency) to
+ * the recorder, which appends it to a caller-supplied buffer in a compact binary log.
+ * Recording works with any port; save the buffer however the platform allows.
+ *
+ * DS2485_port_replay.c is a port which answers from such a log instead of a DS2485,
+ * so a field session can be re-run on a host, in real time or with the delays compressed.
+ *
+ * @par Log format
+ * "DSTR", version byte, then one record per call:
+ * - kind: DS2485_TRACE_EXECUTE or DS2485_TRACE_READ
+ * - varints: microseconds since the previous record started, requested delay, latency,
+ *   result (zigzag encoded), response size
+ * - EXECUTE only: packet size (varint) and packet
+ * - response bytes, if the result was 0
+ */
+
+#ifndef DS2485_TRACE_H_INCLUDED
+#define DS2485_TRACE_H_INCLUDED
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#define DS2485_TRACE_VERSION  1
+
+typedef enum {
+    DS2485_TRACE_EXECUTE = 'E', // DS2485_ExecuteCommand
+    DS2485_TRACE_READ    = 'R', // DS2485_ReadResponse
+} DS2485_trace_kind_T;
+
+/// Microsecond timestamp for recording. Defaults to CLOCK_MONOTONIC on Linux;
+/// elsewhere define DS2485_TRACE_NOW_USEC() (e.g. from a cycle counter) when building with DS2485_TRACE.
+uint32_t DS2485_Trace_Now_uSec(void);
+
+/***** Recording *****/
+
+/// Start appending to 'buffer'. Recording stops quietly when it is full (see DS2485_Trace_StopRecording).
+void DS2485_Trace_StartRecording(uint8_t *buffer, size_t size);
+/// Stop recording. Returns the log length; *complete is false if the buffer filled up.
+size_t DS2485_Trace_StopRecording(bool *complete);
+/// Called by DS2485.c after each port call
+void DS2485_Trace_Record(DS2485_trace_kind_T kind, uint32_t start_uSec, const uint8_t *packet, int packetSize,
+                         int delay_uSec, const uint8_t *response, int responseSize, int error);
+
+/***** Replay (DS2485_port_replay.c) *****/
+
+typedef struct {
+    uint32_t records;       ///< calls answered from the log
+    uint32_t mismatches;    ///< calls that did not match the next record (answered RB_COMMS_FAIL)
+    bool ended;             ///< the log has been used up
+} DS2485_replay_status_T;
+
+/// Answer port calls from 'log'. Each call takes its recorded latency times 'timeScale':
+/// 1.0 preserves the recorded timing, 0 replays as fast as possible.
+/// Returns RB_INVALID_PARAMETER if 'log' is not a trace log.
+int DS2485_Replay_Start(const uint8_t *log, size_t length, double timeScale);
+void DS2485_Replay_GetStatus(DS2485_replay_status_T *status);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* DS2485_TRACE_H_INCLUDED */
@@ -62,17 +62,14 @@
 #include <assert.h>
 
 #include "DS28E18.h"
+#include "DS2485.h" // RB_ result codes
+#include "one_wire_registry.h"
+#include "one_wire_instrument.h"
+#include "one_wire_stats.h"
+#include "one_wire_os.h"
 
-#ifdef USE_MAXIM_DEFINITIONS // Maxim
-  #include "mxc_delay.h"
-  #include "mxc_sys.h"
-  #include "tmr.h"
-  #define DELAY_MSEC(msec_) mxc_delay(MXC_DELAY_MSEC(msec_))
-#else
-  #include "FreeRTOS.h"
-  #include "task.h"
-  #define DELAY_MSEC(msec_) vTaskDelay(pdMS_TO_TICKS(msec_))
-#endif
+#define DELAY_MSEC(msec_) ONEWIRE_OS_DELAY_MSEC(msec_)
+#define NOW_MSEC() ONEWIRE_OS_NOW_MSEC()
 
 #ifdef DS28E18_ENABLE_PRINTF_DEBUGGING
   #define PRINTF(...) printf("DS28E18: " __VA_ARGS__)
@@ -80,33 +77,200 @@
   #define PRINTF(...) {}
 #endif
 
-/* **** Globals **** */
-OneWire_ROM_ID_T current_DS28E18_ROM_ID;
+/* **** Locals **** */
+static DS28E18_sequence_T localPacket; // holds command sequence constructed below
+static OneWire_ROM_table_T deviceTable; // DS28E18 found by most recent DS28E18_Init or DS28E18_InitWarm
+static OneWire_handle_T deviceHandles[ONEWIRE_ROM_TABLE_MAX]; // registry handle for each deviceTable entry
+// Device left at overdrive by Overdrive Match ROM (a standard-speed reset returns it to standard),
+// or ONEWIRE_HANDLE_ALL_DEVICES while DS28E18_SetOnewireSpeed(OVERDRIVE) has the whole bus at overdrive.
+static OneWire_handle_T overdriveDevice = ONEWIRE_HANDLE_INVALID;
+static uint8_t protocolSpeed[ONEWIRE_REGISTRY_MAX]; // DS28E18_protocol_speed_T last configured, per handle (KHZ_100 if unknown)
+static DS28E18_run_timing_T lastRunTiming;
+// Run time model of the sequence each device holds from sequencer address 0, per handle (the last entry for
+// Skip ROM), kept when DS28E18_BuildPacket_WriteAndRun or DS28E18_SPI_StreamRead loads it: a rerun waits
+// for that sequence rather than whatever has been built since. length 0: not known.
+typedef struct {
+    unsigned short length;
+    unsigned short commandCount;
+    unsigned int totalSequencerDelayTime; // milliseconds
+    unsigned int busClocks;
+} loaded_sequence_T;
+static loaded_sequence_T loadedSequence[ONEWIRE_REGISTRY_MAX + 1];
+#if DS28E18_SEQUENCER_CACHE
+  #if DS28E18_SEQUENCER_CACHE_BLOCK < 16 || DS28E18_SEQUENCER_CACHE_BLOCK > 512 || (DS28E18_SEQUENCER_CACHE_BLOCK & (DS28E18_SEQUENCER_CACHE_BLOCK - 1))
+    #error "DS28E18_SEQUENCER_CACHE_BLOCK must be a power of 2 from 16 to 512"
+  #endif
+  #define SEQUENCER_CACHE_BLOCKS (512 / DS28E18_SEQUENCER_CACHE_BLOCK)
+// What each device's sequencer memory holds, per handle, as uploaded by DS28E18_BuildPacket_WriteAndRun:
+// a hash of each block from address 0, valid while the block's bit is set in 'known'.
+// Each hash is chained over the blocks before it, so a block matches only with every byte before it:
+// its commands then start at the same addresses, and any read slot a run has since filled is a read slot
+// again, refilled before it is read. (A block matching alone may have held read data where the new
+// sequence has command bytes.)
+typedef struct {
+    uint32_t blockHash[SEQUENCER_CACHE_BLOCKS];
+    uint32_t known;
+} sequencer_record_T;
+static sequencer_record_T sequencerRecord[ONEWIRE_REGISTRY_MAX];
+#endif
 /*
- * For example, prototype Temperature probe's DS28E18 ID is set by DS28E18_Init:
- *  current_DS28E18_ROM_ID.ID[0]    uint8_t 0x56 (Hex)
- *  current_DS28E18_ROM_ID.ID[1]    uint8_t 0xf6 (Hex)
- *  current_DS28E18_ROM_ID.ID[2]    uint8_t 0x60 (Hex)
- *  current_DS28E18_ROM_ID.ID[3]    uint8_t 0x12 (Hex)
- *  current_DS28E18_ROM_ID.ID[4]    uint8_t 0x0 (Hex)
- *  current_DS28E18_ROM_ID.ID[5]    uint8_t 0x0 (Hex)
- *  current_DS28E18_ROM_ID.ID[6]    uint8_t 0x0 (Hex)
- *  current_DS28E18_ROM_ID.ID[7]    uint8_t 0x5c (Hex)
+ * For example, prototype Temperature probe's DS28E18 ROM ID found by DS28E18_Init:
+ *  0x56 0xf6 0x60 0x12 0x00 0x00 0x00 0x5c
  */
+/// Add the bus clocks and delays of complete sequencer commands to localPacket's run time model.
+static void accountSequencerCommands(const uint8_t* sequencerCmds, int length)
+{
+    int i = 0;
+    while (i < length)
+    {
+        int p1 = (i + 1 < length) ? sequencerCmds[i+1] : 0; // first parameter, usually a length
+        int p2 = (i + 2 < length) ? sequencerCmds[i+2] : 0;
+        localPacket.commandCount++;
+        switch (sequencerCmds[i])
+        {
+            case I2C_START:
+            case I2C_STOP:
+                localPacket.busClocks += 1; // setup and hold, about a clock period
+                i += 1;
+                break;
+            case I2C_WRITE_DATA:
+                localPacket.busClocks += 9 * p1; // 8 data bits + ACK per byte
+                i += 2 + p1;
+                break;
+            case I2C_READ_DATA:
+            case I2C_READ_DATA_W_NACK_END:
+                if (p1 == 0) p1 = 256;
+                localPacket.busClocks += 9 * p1;
+                i += 2 + p1;
+                break;
+            case SPI_WRITE_READ_BYTE: // write length, read length (includes write length unless full duplex), arrays
+                localPacket.busClocks += 8 * (p1 > p2 ? p1 : p2);
+                i += 3 + p1 + p2;
+                break;
+            case SPI_WRITE_READ_BIT: // write bits, read bits, arrays
+                localPacket.busClocks += (p1 > p2 ? p1 : p2);
+                i += 3 + (p1 + 7) / 8 + (p2 + 7) / 8;
+                break;
+            case UTILITY_DELAY:
+                localPacket.totalSequencerDelayTime += 1U << p1;
+                i += 2;
+                break;
+            case UTILITY_GPIO_BUF_WRITE:
+            case UTILITY_GPIO_BUF_READ:
+                i += 2;
+                break;
+            case UTILITY_GPIO_CNTL_WRITE:
+            case UTILITY_GPIO_CNTL_READ:
+                i += 3;
+                break;
+            default: // SPI slave select, SENS_VDD on/off
+                i += 1;
+                break;
+        }
+    }
+}
+// Builders write commands in place at the end of the packet, then commit them (no copy through the stack)
+static inline uint8_t *sequencerPacketEnd(void) {
+    return &localPacket.sequenceData[localPacket.sequenceIdx];
+}
+static inline void commitToSequencerPacket(int length) {
+    accountSequencerCommands(sequencerPacketEnd(), length);
+    localPacket.sequenceIdx += length;
+}
+
+/// Stop trusting the upload cache's record of a device's sequencer memory (every device's for
+/// ONEWIRE_HANDLE_ALL_DEVICES), so the next upload writes it in full. Called after a failed command:
+/// the memory is most likely unchanged, but re-sending a block costs less than running a stale one.
+static void doubtSequencer(OneWire_handle_T device, int address, int length)
+{
+#if DS28E18_SEQUENCER_CACHE
+    if (device < 0 || device >= ONEWIRE_REGISTRY_MAX)
+    {
+        memset(sequencerRecord, 0, sizeof(sequencerRecord));
+        return;
+    }
+    for (int b = address / DS28E18_SEQUENCER_CACHE_BLOCK; b < SEQUENCER_CACHE_BLOCKS && b * DS28E18_SEQUENCER_CACHE_BLOCK < address + length; b++)
+    {
+        sequencerRecord[device].known &= ~(1UL << b);
+    }
+#else
+    (void)device;
+    (void)address;
+    (void)length;
+#endif
+}
+#define DOUBT_SEQUENCER(device_) doubtSequencer(device_, 0, 512)
+
+/// Forget what a device's sequencer memory holds (every device's for ONEWIRE_HANDLE_ALL_DEVICES).
+/// Called whenever it has changed other than by DS28E18_BuildPacket_WriteAndRun:
+/// (re)initialization or a reported POR, which clear it, and other writes.
+static void forgetSequencer(OneWire_handle_T device, int address, int length)
+{
+    if (device < 0 || device >= ONEWIRE_REGISTRY_MAX)
+    {
+        memset(loadedSequence, 0, sizeof(loadedSequence));
+    }
+    else if (address < loadedSequence[device].length)
+    {
+        loadedSequence[device].length = 0;
+        loadedSequence[ONEWIRE_REGISTRY_MAX].length = 0; // no longer what every device holds
+    }
+    doubtSequencer(device, address, length);
+}
+#define FORGET_SEQUENCER(device_) forgetSequencer(device_, 0, 512)
+
+/// Forget or doubt the sequencer memory after a command's result byte r (not SUCCESS)
+static void afterFailedResult(OneWire_handle_T device, uint8_t r)
+{
+    if (r == POR_OCCURRED) FORGET_SEQUENCER(device);
+    else DOUBT_SEQUENCER(device);
+}
+
+/// Note that the device (every device for Skip ROM) now holds the locally constructed packet from address 0
+static void rememberLoadedSequence(OneWire_handle_T device)
+{
+    loaded_sequence_T loaded = {
+        .length = (unsigned short)localPacket.sequenceIdx,
+        .commandCount = (unsigned short)localPacket.commandCount,
+        .totalSequencerDelayTime = localPacket.totalSequencerDelayTime,
+        .busClocks = localPacket.busClocks,
+    };
+    if (device < 0 || device >= ONEWIRE_REGISTRY_MAX)
+    {
+        for (int i = 0; i <= ONEWIRE_REGISTRY_MAX; i++) loadedSequence[i] = loaded;
+        return;
+    }
+    loadedSequence[device] = loaded;
+    loadedSequence[ONEWIRE_REGISTRY_MAX].length = 0;
+}
+
+/// Modeled run time of a sequence at the given I2C/SPI speed:
+/// Utility Delay commands, plus every bus clock at that speed, plus command decoding.
+static unsigned int estimateRunTime_uSec(const loaded_sequence_T *sequence, DS28E18_protocol_speed_T speed)
+{
+    static const unsigned int clockPeriod_nsec[] = { 10000, 2500, 1000, 435 }; // KHZ_100 .. KHZ_2300
+    return sequence->totalSequencerDelayTime * 1000 +
+           (sequence->busClocks * clockPeriod_nsec[speed & 3] + 999) / 1000 +
+           sequence->commandCount * DS28E18_SEQUENCER_COMMAND_USEC;
+}
 
-/* **** Locals **** */
-static DS28E18_one_wire_rom_commands_T current_ROM_command; // (normally MATCH_ROM, SKIP_ROM during device search)
-static DS28E18_sequence_T localPacket; // holds command sequence constructed below
 // Eliminates cut-and-paste of memcpy etc:
 static inline void appendToSequencerPacket(const uint8_t* sequencerCmds, int length) {
-    memcpy(&localPacket.sequenceData[localPacket.sequenceIdx], sequencerCmds, length);
-    localPacket.sequenceIdx += length;
+    memcpy(sequencerPacketEnd(), sequencerCmds, length);
+    commitToSequencerPacket(length);
 };
 // Append an array (macro eliminates repeated error-prone sizeof)
 #define APPEND_TO_PACKET(s_) { appendToSequencerPacket(s_, sizeof(s_)); }
 
 #define SPU_Delay_tOP_msec      1 // say what? what is this delay?
 
+#define COMMAND_PARAMETERS_MAX      4   // parameters before any data streamed from the caller's buffer (Write GPIO Configuration)
+#define WRITE_SEQUENCER_MAX         128 // Write Sequencer data per command (command length byte limits it to 252)
+#define READ_SEQUENCER_MAX          128
+#define STREAM_SLOT_SIZE            256 // SPI stream: two chunks, each at most half the sequencer
+#define CALIBRATION_PATTERN_LENGTH  128 // longest Read Sequencer, so each trial exercises a full-length transfer
+#define CALIBRATION_MARGIN_PRESETS  1   // presets added to the shortest passing duration
+
 
 /* **** Functions **** */
 
@@ -117,8 +281,49 @@ command. This initial command populates (for all DS28E18 on the bus) the unique
 Ignore the command CRC-16 result and the Result byte, as both might be invalid. Next issue a successful Write GPIO
 Configuration command to configure the GPIO pullup/down states so that the voltage on the GPIO ports is known.
 */
+/// Make a DS28E18 ready for use:
+/// set GPIO configuration so the voltage on GPIO ports is known, and clear POR status.
+static bool initializeDevice(OneWire_handle_T device)
+{
+    FORGET_SEQUENCER(device); // may have been power cycled
+    PRINTF("-- Write GPIO Configuration so the voltage on GPIO ports is known --\n");
+    if(!DS28E18_WriteGpioConfiguration(device, CONTROL, 0xA5, 0x0F))
+    {
+        return false;
+    }
+
+    PRINTF("-- Read Device Status information (clears POR status bit) --\n");
+    uint8_t status[4] = {0xFF, 0xFF, 0xFF, 0xFF};
+    if(!DS28E18_DeviceStatus(device, status))
+    {
+        return false;
+    }
+    else
+    {
+        PRINTF("-- Status: ");
+        #ifdef DS28E18_ENABLE_PRINTF_DEBUGGING
+            for(uint8_t i = 0; i < sizeof(status); i++)
+            {
+                printf("%02X.", status[i]);
+            }
+            printf("\n");
+        #endif
+    }
+
+    #if DS28E18_PROBE_OVERDRIVE
+        OneWire_device_T *entry = OneWire_Registry_Get(device);
+        if(entry && entry->speedCapability == ONEWIRE_SPEED_UNTESTED)
+        {
+            DS28E18_ProbeOverdrive(device); // standard speed remains usable whatever the outcome
+        }
+    #endif
+    return true;
+}
+
 /// Initialize all DS28E18 on the 1-Wire bus.
-/// @return number of DS28E18  found on the bus.
+/// If there are more than ONEWIRE_ROM_TABLE_MAX, the first ones found are initialized
+/// and DS28E18_GetDeviceTable()->truncated is set.
+/// @return number of DS28E18 found and initialized, 0 if none or on error.
 int DS28E18_Init()
 {
     int devicesFound = 0;
@@ -131,62 +336,104 @@ int DS28E18_Init()
     {
         return 0; // no devices found because of error...
     }
-    DS28E18_SetRomCommand(SKIP_ROM); // Skip trying to match a particular ROM ID
-    DS28E18_WriteGpioConfiguration(CONTROL, 0xA5, 0x0F); // populate all DS28E18 ROMID etc. Write is not addressed to a specific DS28E18 (now in SKIP_ROM mode)
-    DS28E18_SetRomCommand(MATCH_ROM); // for all subsequent operations...
+    // populate all DS28E18 ROMID etc. Write is not addressed to a specific DS28E18 (Skip ROM)
+    DS28E18_WriteGpioConfiguration(ONEWIRE_HANDLE_ALL_DEVICES, CONTROL, 0xA5, 0x0F);
 
-    PRINTF("-- Search and initialize every device found on the 1-Wire line --\n");
-    // Temporary ID tracks last DS28E18 found, may be clobbered if there's a DS2485 error...
-    OneWire_ROM_ID_T temp_rom_id = { .ID = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}};
-    bool last_device_found = false;
-    while ( !last_device_found )
+    PRINTF("-- Search and initialize every DS28E18 found on the 1-Wire line --\n");
+    // Only the DS28E18 family subtree is searched; other devices on the bus are not enumerated
+    error = OneWire_SearchTable(&deviceTable, ONEWIRE_SEARCH_NORMAL, DS28E18_FAMILY_CODE);
+    if(error == RB_TABLE_FULL)
+    {
+        PRINTF("Warning: more than %d DS28E18 on the bus, only the first are used\n", ONEWIRE_ROM_TABLE_MAX);
+    }
+    else if(error)
+    {
+        deviceTable.count = 0; // table may be partial after a DS2485 error...
+        return 0;
+    }
+    for(int d = 0; d < deviceTable.count; d++)
     {
-        // Look for the next DS28E18
-        bool startNewSearch = (devicesFound==0);
-        int searchError = OneWire_Search(&temp_rom_id, startNewSearch, &last_device_found);
-        if(searchError) break;
         devicesFound++;
 
         PRINTF("Found ROM ID: x");
         #ifdef DS28E18_ENABLE_PRINTF_DEBUGGING
-            for(uint8_t i = 0; i < sizeof(temp_rom_id.ID); i++)
+            for(uint8_t i = 0; i < sizeof(deviceTable.romID[d].ID); i++)
             {
-                printf("%02X", temp_rom_id.ID[i]);
+                printf("%02X", deviceTable.romID[d].ID[i]);
             }
             printf("\n");
         #endif
 
-        // ToDo 1-Wire: DS28E18_Init() assumes any 1-Wire device found on the bus is a DS28E18
-        current_DS28E18_ROM_ID = temp_rom_id; // Set active DS28E18 to device just found
-
-        PRINTF("-- Write GPIO Configuration so the voltage on GPIO ports is known --\n");
-        if(!DS28E18_WriteGpioConfiguration(CONTROL, 0xA5, 0x0F))
+        deviceHandles[d] = OneWire_Registry_Add(/*bus=*/0, &deviceTable.romID[d]);
+        if(deviceHandles[d] == ONEWIRE_HANDLE_INVALID)
         {
-            return false;
+            return 0; // registry full
         }
 
-        PRINTF("-- Read Device Status information (clears POR status bit) --\n");
-        uint8_t status[4] = {0xFF, 0xFF, 0xFF, 0xFF};
-        if(!DS28E18_DeviceStatus(status))
-        {
-            return false;
-        }
-        else
+        if(!initializeDevice(deviceHandles[d]))
         {
-            PRINTF("-- Status: ");
-            #ifdef DS28E18_ENABLE_PRINTF_DEBUGGING
-                for(uint8_t i = 0; i < sizeof(status); i++)
-                {
-                    printf("%02X.", status[i]);
-                }
-                printf("\n");
-            #endif
+            return 0;
         }
     };
 
     DS28E18_BuildPacket_ClearSequencerPacket(); // general initialization (sequencer is not used during Init() above).
 
-    return devicesFound>0;
+    return devicesFound;
+}
+
+/// Initialize DS28E18 on the 1-Wire bus using the ROM ID table saved in DS2485 memory by a previous boot.
+/// Each saved device is addressed with Match ROM and initialized as in DS28E18_Init(), which skips the search.
+/// If there is no valid saved table or any saved device does not respond, fall back to DS28E18_Init()
+/// and save the newly found table for next time.
+/// Note: devices added to the bus since the table was saved are not found; call DS28E18_Init() for that.
+/// @return number of DS28E18 found and initialized, 0 if none or on error.
+int DS28E18_InitWarm()
+{
+    OneWire_ROM_table_T storedTable;
+
+    if (DS28E18_SetOnewireSpeed(STANDARD)) // Set DS2485 master 1-Wire speed
+    {
+        return 0; // no devices found because of error...
+    }
+    bool verified = (OneWire_LoadRomTable(&storedTable) == 0) && storedTable.count > 0;
+    if(verified)
+    {
+        PRINTF("-- Verify %d DS28E18 from saved ROM ID table (generation %lu) --\n", storedTable.count, (unsigned long)storedTable.generation);
+        // A device that has been power-cycled must be given its unique ROM ID before Match ROM works (see DS28E18_Init)
+        DS28E18_WriteGpioConfiguration(ONEWIRE_HANDLE_ALL_DEVICES, CONTROL, 0xA5, 0x0F);
+        for(int i = 0; i < storedTable.count && verified; i++)
+        {
+            deviceHandles[i] = OneWire_Registry_Add(/*bus=*/0, &storedTable.romID[i]);
+            verified = (deviceHandles[i] != ONEWIRE_HANDLE_INVALID) && initializeDevice(deviceHandles[i]);
+        }
+    }
+    if(verified)
+    {
+        deviceTable = storedTable;
+        DS28E18_BuildPacket_ClearSequencerPacket();
+        return deviceTable.count;
+    }
+
+    PRINTF("-- Saved ROM ID table missing or stale, searching --\n");
+    int devicesFound = DS28E18_Init();
+    if(devicesFound)
+    {
+        OneWire_SaveRomTable(&deviceTable); // failure (including a list too long to save) only costs a search at next boot
+    }
+    return devicesFound;
+}
+
+/// Table of DS28E18 found by the most recent DS28E18_Init() or DS28E18_InitWarm()
+const OneWire_ROM_table_T *DS28E18_GetDeviceTable()
+{
+    return &deviceTable;
+}
+
+/// Registry handle of DS28E18_GetDeviceTable()->romID[index]
+OneWire_handle_T DS28E18_GetDeviceHandle(int index)
+{
+    if(index < 0 || index >= deviceTable.count) return ONEWIRE_HANDLE_INVALID;
+    return deviceHandles[index];
 }
 
 //-----------------------------------------------------------------------------
@@ -205,6 +452,7 @@ int DS28E18_SetOnewireSpeed(one_wire_speeds spd)
             error = OneWire_Set_OneWireMasterSpeed(STANDARD);
             if (error) break;
             // do a 1-Wire reset in Standard and catch presence result
+            overdriveDevice = ONEWIRE_HANDLE_INVALID;
             error = OneWire_ResetPulse();
             break;
         case OVERDRIVE:
@@ -218,6 +466,7 @@ int DS28E18_SetOnewireSpeed(one_wire_speeds spd)
             //Set host speed to Overdrive
             error = OneWire_Set_OneWireMasterSpeed(OVERDRIVE);
             if (error) break;
+            overdriveDevice = ONEWIRE_HANDLE_ALL_DEVICES;
             // do a 1-Wire reset in Overdrive and catch presence result
             error = OneWire_ResetPulse();
             break;
@@ -227,127 +476,251 @@ int DS28E18_SetOnewireSpeed(one_wire_speeds spd)
     return error;
 }
 
-/// Set 1-Wire 'current_ROM_command' (normally MATCH_ROM, SKIP_ROM during device search).
-/// Does not send anything to lower-level code; just sets the operating mode for this DS28E18 layer.
-void DS28E18_SetRomCommand(DS28E18_one_wire_rom_commands_T rom_cmd)
+/// Reset the bus and address the device (entry NULL for all devices), at overdrive if requested.
+/// Only one device at a time can be at overdrive after Overdrive Match ROM, because the
+/// standard-speed reset needed to address any other device returns it to standard speed.
+/// Consecutive transactions to the same overdrive device skip that reset and stay at overdrive.
+static int select_device(OneWire_handle_T device, OneWire_device_T *entry, bool overdrive)
 {
-    assert(rom_cmd==MATCH_ROM || rom_cmd==SKIP_ROM);
-    current_ROM_command = rom_cmd;
+    int error = 0;
+
+    if (overdriveDevice == ONEWIRE_HANDLE_ALL_DEVICES || (overdrive && overdriveDevice == device))
+    {
+        // Device is already at overdrive; an overdrive reset is not seen by standard-speed devices
+        if ((error = OneWire_Set_OneWireMasterSpeed(OVERDRIVE)) != 0) return error;
+        if ((error = OneWire_ResetPulse()) != 0) return error;
+        if (!entry) return OneWire_WriteByte(SKIP_ROM);
+        if ((error = OneWire_WriteByte(MATCH_ROM)) != 0) return error;
+        return OneWire_WriteBlock(entry->romID.ID, 8);
+    }
+
+    if ((error = OneWire_Set_OneWireMasterSpeed(STANDARD)) != 0) return error;
+    overdriveDevice = ONEWIRE_HANDLE_INVALID; // standard reset returns every device to standard speed
+    if ((error = OneWire_ResetPulse()) != 0) return error;
+    if (!entry) return OneWire_WriteByte(SKIP_ROM);
+    if (!overdrive)
+    {
+        if ((error = OneWire_WriteByte(MATCH_ROM)) != 0) return error;
+        return OneWire_WriteBlock(entry->romID.ID, 8);
+    }
+    // Overdrive Match ROM is sent at standard speed, the ROM ID and everything after it at overdrive
+    if ((error = OneWire_WriteByte(OVERDRIVE_MATCH)) != 0) return error;
+    if ((error = OneWire_Set_OneWireMasterSpeed(OVERDRIVE)) != 0) return error;
+    if ((error = OneWire_WriteBlock(entry->romID.ID, 8)) != 0) return error;
+    overdriveDevice = device;
+    return 0;
 }
-/// Return the value of 'current_ROM_command'
-DS28E18_one_wire_rom_commands_T DS28E18_GetRomCommand()
+
+/// Bulk data of a command, streamed over 1-Wire directly from and to the caller's buffers
+typedef struct {
+    const uint8_t *tx;  // sent after the parameters
+    int txSize;
+    uint8_t *rx;        // receives the response after the bytes that fit in 'response'
+    int rxSize;
+} command_data_T;
+
+/// Host check of a packet's CRC16 (inverted, LSB first) over 'first' then 'second', continuing from 'crc'
+static bool packetCrcValid(unsigned int crc, const uint8_t *first, int first_length, const uint8_t *second, int second_length, const uint8_t crc16[2])
 {
-    return current_ROM_command;
+    unsigned int expectedCrc = OneWire_CalculateCrc16Block(first, first_length, crc);
+    if (second_length) expectedCrc = OneWire_CalculateCrc16Block(second, second_length, expectedCrc);
+    expectedCrc ^= 0xFFFFU;
+    return expectedCrc == (unsigned int)((crc16[1] << 8) | crc16[0]);
 }
 
-static unsigned int calculateCrc16Byte(uint8_t data, unsigned int crc)
+/// Count and report a CRC16 check; with DS28E18_CRC_DIAGNOSTICS also compare the DS2485's check with the host's.
+static bool crcCheckPassed(bool ds2485OK, bool hostOK)
 {
-  const uint8_t oddparity[] = {0, 1, 1, 0, 1, 0, 0, 1,
-                                     1, 0, 0, 1, 0, 1, 1, 0};
+#if DS28E18_CRC_DIAGNOSTICS
+    if (ds2485OK != hostOK)
+    {
+        PRINTF("CRC16 check disagrees: DS2485 %s, host %s\n", ds2485OK ? "pass" : "fail", hostOK ? "pass" : "fail");
+    }
+    ds2485OK = ds2485OK && hostOK;
+#else
+    (void)hostOK;
+#endif
+    if (!ds2485OK)
+    {
+        ONEWIRE_STATS_ADD(crcFailures, 1);
+        PRINTF("Error: Invalid CRC16\n");
+    }
+    return ds2485OK;
+}
 
-  unsigned int data16 = (data ^ crc) & 0xff;
-  crc = (crc >> 8) & 0xff;
+/// Write the command packet (header and parameters, then any data), and check the CRC16 the device returns.
+/// With DS28E18_SCRIPT_CRC a packet that fits takes one script, in which the DS2485 checks the CRC16.
+static bool send_command_packet(const uint8_t *tx_header, int tx_header_size, const uint8_t *tx_data, int tx_data_size)
+{
+    uint8_t tx_packet_CRC16[2];
+    int error = 0; // error return from OneWire functions (0 return is no error)
 
-  if (oddparity[data16 & 0xf] ^ oddparity[data16 >> 4]) {
-    crc ^= 0xc001;
-  }
+#if DS28E18_SCRIPT_CRC
+    if (tx_header_size + tx_data_size <= ONEWIRE_WRITE_CRC16_MAX)
+    {
+        bool crcOK;
+        error = OneWire_WriteBlockVerifyCrc16(tx_header, tx_header_size, tx_data, tx_data_size, &crcOK,
+                                              DS28E18_CRC_DIAGNOSTICS ? tx_packet_CRC16 : NULL);
+        if(error) return false;
+        return crcCheckPassed(crcOK, !DS28E18_CRC_DIAGNOSTICS ||
+                              packetCrcValid(0, tx_header, tx_header_size, tx_data, tx_data_size, tx_packet_CRC16));
+    }
+#endif
+    error = OneWire_WriteBlockGather(tx_header, tx_header_size, tx_data, tx_data_size);
+    if(error) return false;
 
-  data16 <<= 6;
-  crc ^= data16;
-  data16 <<= 1;
-  crc ^= data16;
+    //Read CRC16 of the tx_packet
+    error = OneWire_ReadBlock(tx_packet_CRC16, sizeof(tx_packet_CRC16));
+    if(error) return false;
 
-  return crc;
+    //Verify CRC16
+    bool crcOK = packetCrcValid(0, tx_header, tx_header_size, tx_data, tx_data_size, tx_packet_CRC16);
+    return crcCheckPassed(crcOK, crcOK);
 }
-static unsigned int calculateCrc16Block(uint8_t *data, int dataSize, unsigned int crc)
+
+#if DS28E18_SCRIPT_CRC
+/// Copy result bytes [offset, offset+length) to 'response', and those past response_size to data->rx
+static void scatter_result(const uint8_t *src, int offset, int length, uint8_t *response, int response_size, const command_data_T *data)
 {
-  for (int i = 0; i < dataSize; i++)
-  {
-    crc = calculateCrc16Byte(data[i], crc);
-  }
-  return crc;
+    for (int i = 0; i < length; i++)
+    {
+        int at = offset + i;
+        if (at < response_size) response[at] = src[i];
+        else data->rx[at - response_size] = src[i];
+    }
 }
+#endif
 
-/// Run a DS28E18 command (can be run sequencer), wait for it to complete, and return bool SUCCESS.
-static bool run_command(DS28E18_device_function_commands_T command, uint8_t *parameters, int parameters_size, int delay_msec, uint8_t *result_data)
+/// Read the response packet: dummy byte, length, result byte and data (into 'response', the rest into data->rx), CRC16.
+/// With DS28E18_SCRIPT_CRC a response of the expected length takes one script, in which the DS2485 checks the CRC16.
+static bool receive_response_packet(DS28E18_device_function_commands_T command, const command_data_T *data, uint8_t *response, int response_size)
 {
-    OneWire_ROM_ID_T ROMID;
-    uint8_t tx_packet[3 + parameters_size];
-    uint8_t tx_packet_CRC16[2];
-    unsigned int expectedCrc = 0;
+    int rx_size = data ? data->rxSize : 0;
     uint8_t headerResponse[2];
     int result_data_length;
+    int in_response; // result bytes read into 'response', the rest go to data->rx
     uint8_t rx_packet_CRC16[2];
     int error = 0; // error return from OneWire functions (0 return is no error)
 
-    tx_packet[0] = COMMAND_START;
-    tx_packet[1] = 1 + parameters_size;
-    tx_packet[2] = command;
-    if (parameters_size)
+#if DS28E18_SCRIPT_CRC
+    // Length of a successful response (Run Sequencer adds the NACK offset only after a NACK)
+    int expected_length = (command == RUN_SEQUENCER) ? 1 : response_size + rx_size;
+    if (1 + 1 + expected_length + 2 <= ONEWIRE_READ_CRC16_MAX)
     {
-        memcpy(&tx_packet[3], parameters, parameters_size);
-    }
+        const uint8_t *packet; // length, result byte and data, CRC16; valid until the next script
+        bool crcOK;
+        error = OneWire_ReadBlockVerifyCrc16(1, 1 + expected_length + 2, &packet, &crcOK); // after the dummy byte
+        if(error) return false;
+        result_data_length = packet[0];
+        if (result_data_length == 0xFF)
+        {
+            PRINTF("Error: 1-Wire Communication Error\n");
+            return false;
+        }
+        if (result_data_length > response_size + rx_size)
+        {
+            PRINTF("Error: Response longer than expected\n");
+            return false;
+        }
+        if (result_data_length == expected_length)
+        {
+            scatter_result(&packet[1], 0, result_data_length, response, response_size, data);
+            return crcCheckPassed(crcOK, !DS28E18_CRC_DIAGNOSTICS ||
+                                  packetCrcValid(0, packet, 1 + result_data_length, NULL, 0, &packet[1 + result_data_length]));
+        }
 
-    //Reset pulse + presence
-    error = OneWire_ResetPulse();
+        // Another length (an error result): the DS2485 checked the wrong bytes, so check on the host,
+        // first reading the rest of a longer packet
+        int in_script = expected_length + 2; // packet bytes read after the length byte
+        int rest = result_data_length + 2 - in_script;
+        uint8_t tail[4];
+        if (rest > (int)sizeof(tail))
+        {
+            PRINTF("Error: Response longer than expected\n");
+            return false;
+        }
+        unsigned int residual = OneWire_CalculateCrc16Block(packet, 1 + (rest > 0 ? in_script : result_data_length + 2), 0);
+        scatter_result(&packet[1], 0, (result_data_length < in_script) ? result_data_length : in_script, response, response_size, data);
+        if (rest > 0)
+        {
+            error = OneWire_ReadBlock(tail, rest);
+            if(error) return false;
+            residual = OneWire_CalculateCrc16Block(tail, rest, residual);
+            if (result_data_length > in_script) scatter_result(tail, in_script, result_data_length - in_script, response, response_size, data);
+        }
+        return crcCheckPassed(residual == ONEWIRE_CRC16_RESIDUAL, residual == ONEWIRE_CRC16_RESIDUAL);
+    }
+#else
+    (void)command;
+#endif
+    error = OneWire_ReadBlock(headerResponse, sizeof(headerResponse)); //Dummy Byte + Length Byte;
     if(error) return false;
+    result_data_length = headerResponse[1];
 
-    //Execute ROM Command currently set
-    switch(current_ROM_command)
+    if (result_data_length == 0xFF)
     {
-        case READ_ROM:
-            PRINTF("Error: Not appropriate use of Read ROM \n");
-            return false;
-        case MATCH_ROM:
-            ROMID  = current_DS28E18_ROM_ID;
-            error = OneWire_WriteByte(MATCH_ROM);
-            if(error) return false;
-            error = OneWire_WriteBlock(ROMID.ID, 8);
-            if(error) return false;
-            break;
-        case SEARCH_ROM:
-            PRINTF("Error: Not appropriate use of Search ROM \n");
-            return false;
-        case SKIP_ROM:
-            error = OneWire_WriteByte(SKIP_ROM);
-            if(error) return false;
-            break;
-        case RESUME:
-            error = OneWire_WriteByte(RESUME);
-            if(error) return false;
-            break;
-        case OVERDRIVE_SKIP:
-            error = OneWire_WriteByte(OVERDRIVE_SKIP);
-            if(error) return false;
-            break;
-        case OVERDRIVE_MATCH:
-            ROMID  = current_DS28E18_ROM_ID;;
-            error = OneWire_WriteByte(OVERDRIVE_MATCH);
-            if(error) return false;
-            error = OneWire_WriteBlock(ROMID.ID, 8);
-            if(error) return false;
-            break;
-        default:
-            PRINTF("Error: 1-Wire Communication Error\n");
-            return false;
+        PRINTF("Error: 1-Wire Communication Error\n");
+        return false;
     }
 
-    //Write command-specific 1-Wire packet, tx_packet
-    error = OneWire_WriteBlock(tx_packet, sizeof(tx_packet));
+    if (result_data_length > response_size + rx_size)
+    {
+        PRINTF("Error: Response longer than expected\n");
+        return false;
+    }
+
+    //Read rest of response
+    in_response = (result_data_length < response_size) ? result_data_length : response_size;
+    error = OneWire_ReadBlockScatter(response, in_response, data ? data->rx : NULL, result_data_length - in_response); //Result Byte + Result Data
     if(error) return false;
 
-    //Read CRC16 of the tx_packet
-    error = OneWire_ReadBlock(tx_packet_CRC16, sizeof(tx_packet_CRC16));
+    //Read CRC16 of the rx_packet
+    error = OneWire_ReadBlock(rx_packet_CRC16, sizeof(rx_packet_CRC16));
     if(error) return false;
 
-    //Verify CRC16
-    expectedCrc = calculateCrc16Block(tx_packet, sizeof(tx_packet), expectedCrc);
-    expectedCrc ^= 0xFFFFU;
-    if (expectedCrc != (unsigned int)((tx_packet_CRC16[1] << 8) | tx_packet_CRC16[0]))
+    //Verify CRC16: length byte, then result byte and data
+    bool crcOK = packetCrcValid(OneWire_CalculateCrc16Block(&headerResponse[1], sizeof(headerResponse) - 1, 0),
+                                response, in_response, data ? data->rx : NULL, result_data_length - in_response, rx_packet_CRC16);
+    return crcCheckPassed(crcOK, crcOK);
+}
+
+/// Run a DS28E18 command once at the requested speed, see run_command().
+static bool run_command_at_speed(OneWire_handle_T device, bool overdrive, DS28E18_device_function_commands_T command, const uint8_t *parameters, int parameters_size,
+                                 const command_data_T *data, int delay_msec, uint8_t *response, int response_size)
+{
+    OneWire_device_T *entry = NULL; // registry entry of addressed device (none for Skip ROM)
+    uint8_t tx_header[3 + COMMAND_PARAMETERS_MAX];
+    int tx_header_size = 3 + parameters_size;
+    int tx_data_size = data ? data->txSize : 0;
+    int error = 0; // error return from OneWire functions (0 return is no error)
+
+    if (parameters_size > COMMAND_PARAMETERS_MAX)
     {
-        PRINTF("Error: Invalid CRC16\n");
         return false;
     }
+    tx_header[0] = COMMAND_START;
+    tx_header[1] = 1 + parameters_size + tx_data_size;
+    tx_header[2] = command;
+    if (parameters_size)
+    {
+        memcpy(&tx_header[3], parameters, parameters_size);
+    }
+
+    //Reset pulse + presence, then address the device: Skip ROM for all devices, else (Overdrive) Match ROM
+    if (device != ONEWIRE_HANDLE_ALL_DEVICES)
+    {
+        entry = OneWire_Registry_Get(device);
+        if (!entry)
+        {
+            PRINTF("Error: Invalid device handle %d\n", device);
+            return false;
+        }
+    }
+    error = select_device(device, entry, overdrive);
+    if(error) return false;
+
+    //Write command-specific 1-Wire packet: header and parameters, then any data; check its CRC16
+    if (!send_command_packet(tx_header, tx_header_size, tx_data_size ? data->tx : NULL, tx_data_size)) return false;
 
     //Send Release Byte (0xAA) then enable SPU
     error = OneWire_WriteBytePower(OneWire_Release_Byte_xAA); // Enables SPU (hence 'Power')
@@ -355,51 +728,254 @@ static bool run_command(DS28E18_device_function_commands_T command, uint8_t *par
 
     //Command-specific delay
     DELAY_MSEC(delay_msec);
+    ONEWIRE_STATS_ADD(busy_uSec, (uint32_t)delay_msec * 1000); // strong pull-up holds the bus
 
     // NO! BUG! Some applications require SPU stays on to power peripheral, specifically DS28E18: Disable SPU
     //   OneWire_Enable_SPU(false); // Bug: DS28E18 run_command disabled SPU
 
     // Read command-specific 1-Wire packet
-    error = OneWire_ReadBlock(headerResponse, sizeof(headerResponse)); //Dummy Byte + Length Byte;
-    if(error) return false;
-    result_data_length = headerResponse[1];
+    if (!receive_response_packet(command, data, response, response_size)) return false;
 
-    if (result_data_length == 0xFF)
+    if (entry) entry->lastSeenMS = NOW_MSEC();
+    return true;
+}
+
+/// Run a DS28E18 command (can be run sequencer), wait for it to complete, and return bool SUCCESS.
+/// Devices whose overdrive probe passed are run at overdrive; if that fails the command is
+/// retried at standard speed (so a failed Run Sequencer may run twice), and a device which
+/// keeps failing at overdrive is kept at standard speed from then on.
+/// Bulk data, if any, is streamed from and to the caller's buffers rather than copied on the stack.
+static bool run_command(OneWire_handle_T device, DS28E18_device_function_commands_T command, const uint8_t *parameters, int parameters_size,
+                        const command_data_T *data, int delay_msec, uint8_t *response, int response_size)
+{
+    ONEWIRE_INSTR_BEGIN(instrStart);
+    OneWire_device_T *entry = OneWire_Registry_Get(device);
+    bool overdrive = entry && entry->speedCapability == ONEWIRE_SPEED_OVERDRIVE_OK;
+
+    bool ok = run_command_at_speed(device, overdrive, command, parameters, parameters_size, data, delay_msec, response, response_size);
+    if (ok)
     {
-        PRINTF("Error: 1-Wire Communication Error\n");
-        return false;
+        if (overdrive) entry->overdriveFailures = 0;
+    }
+    else if (overdrive)
+    {
+        if (++entry->overdriveFailures >= DS28E18_OVERDRIVE_FAILURES_TO_FALL_BACK)
+        {
+            PRINTF("Device %d unreliable at overdrive, using standard speed\n", device);
+            entry->speedCapability = ONEWIRE_SPEED_STANDARD_ONLY;
+        }
+        ONEWIRE_STATS_ADD(retries, 1);
+        ok = run_command_at_speed(device, false, command, parameters, parameters_size, data, delay_msec, response, response_size);
     }
+    if (!ok) DOUBT_SEQUENCER(device);
+    ONEWIRE_INSTR_END(command == RUN_SEQUENCER ? ONEWIRE_INSTR_DS28E18_RUN_SEQUENCER : ONEWIRE_INSTR_DS28E18_COMMAND, instrStart);
+    return ok;
+}
 
-    //Read rest of response
-    error = OneWire_ReadBlock(result_data, result_data_length); //Result Byte + Result Data
-    if(error) return false;
+/// Test whether a device communicates reliably at overdrive speed, and record the result
+/// in its registry entry (speedCapability), which run_command() uses to choose the speed.
+/// The device is left at standard speed if the test fails.
+/// @return true if the device will be used at overdrive.
+bool DS28E18_ProbeOverdrive(OneWire_handle_T device)
+{
+    OneWire_device_T *entry = OneWire_Registry_Get(device);
+    uint8_t response[5];
+    if (!entry) return false;
 
-    //Read CRC16 of the rx_packet
-    error = OneWire_ReadBlock(rx_packet_CRC16, sizeof(rx_packet_CRC16));
-    if(error) return false;
+    entry->overdriveFailures = 0;
+    for (int i = 0; i < DS28E18_OVERDRIVE_PROBE_COUNT; i++)
+    {
+        if (!run_command_at_speed(device, true, DEVICE_STATUS, NULL, 0, NULL, SPU_Delay_tOP_msec, response, sizeof(response)))
+        {
+            PRINTF("Device %d failed overdrive probe\n", device);
+            entry->speedCapability = ONEWIRE_SPEED_STANDARD_ONLY;
+            return false;
+        }
+    }
+    entry->speedCapability = ONEWIRE_SPEED_OVERDRIVE_OK;
+    return true;
+}
 
-    //Verify CRC16
-    expectedCrc = 0;
-    expectedCrc = calculateCrc16Block(&headerResponse[1], sizeof(headerResponse) - 1, expectedCrc);
-    expectedCrc = calculateCrc16Block(result_data, result_data_length, expectedCrc);
-    expectedCrc ^= 0xFFFFU;
-    if (expectedCrc != (unsigned int)((rx_packet_CRC16[1] << 8) | rx_packet_CRC16[0]))
+/// Failed calibration trials out of 'trials', stopping once more than maxFailures.
+/// A trial is a reset (presence), Match ROM, and Read Sequencer of the calibration pattern, so
+/// missing presence, CRC errors, and corrupted data all count.
+static int calibrationFailures(OneWire_handle_T device, bool overdrive, int trials, int maxFailures)
+{
+    uint8_t parameters[2] = { 0x00, 0x00 }; // address 0, length 128 (encoded as 0)
+    uint8_t response[1 + CALIBRATION_PATTERN_LENGTH];
+    int failures = 0;
+
+    for (int i = 0; i < trials && failures <= maxFailures; i++)
     {
-        PRINTF("Error: Invalid CRC16\n");
-        return false;
+        bool ok = run_command_at_speed(device, overdrive, READ_SEQUENCER, parameters, sizeof(parameters), NULL, SPU_Delay_tOP_msec, response, sizeof(response)) &&
+                  response[0] == SUCCESS;
+        for (int b = 0; ok && b < CALIBRATION_PATTERN_LENGTH; b++)
+        {
+            ok = response[1 + b] == (uint8_t)(0x55 ^ (b * 0x3B));
+        }
+        if (!ok) failures++;
     }
+    return failures;
+}
 
-    return true;
+/// Sweep one timing through every preset, keeping all other settings, and set it to the best passing preset:
+/// the shortest plus CALIBRATION_MARGIN_PRESETS for durations, the middle of the passing range for sample points.
+/// The timing is left unchanged if no preset passes. Returns DS2485 error, if any.
+static int calibrateTiming(OneWire_handle_T device, bool overdrive, one_wire_timings timing, bool samplePoint,
+                           int trials, int maxFailures, OneWire_timing_profile_T *profile)
+{
+    uint8_t *preset = overdrive ? &profile->overdrive[timing] : &profile->standard[timing];
+    uint8_t original = *preset;
+    int firstPass = -1, lastPass = -1;
+    int error = 0;
+
+    for (int p = PRESET_0; p <= PRESET_F; p++)
+    {
+        *preset = p;
+        if ((error = OneWire_Apply_TimingProfile(profile)) != 0) break;
+        if (calibrationFailures(device, overdrive, trials, maxFailures) <= maxFailures)
+        {
+            if (firstPass < 0) firstPass = p;
+            lastPass = p;
+            if (!samplePoint) break; // longer durations only cost time
+        }
+        else if (firstPass >= 0)
+        {
+            break; // end of the passing range
+        }
+    }
+
+    if (firstPass < 0)
+    {
+        *preset = original;
+    }
+    else if (samplePoint)
+    {
+        *preset = (firstPass + lastPass) / 2;
+    }
+    else
+    {
+        *preset = (firstPass + CALIBRATION_MARGIN_PRESETS <= PRESET_F) ? firstPass + CALIBRATION_MARGIN_PRESETS : PRESET_F;
+    }
+    PRINTF("Calibrated %s timing %d: preset %d\n", overdrive ? "overdrive" : "standard", timing, *preset);
+    int applyError = OneWire_Apply_TimingProfile(profile);
+    return error ? error : applyError;
+}
+
+/// Choose the candidate value of one RPUP/BUF setting ('setting', a member of 'profile') with the fewest
+/// failed trials at the current timings; the first candidate is kept over any equally good. Returns the
+/// error of applying the profile.
+static int calibratePullupSetting(OneWire_handle_T device, int trials, uint8_t *setting, const uint8_t *candidates, int count,
+                                  OneWire_timing_profile_T *profile)
+{
+    int bestFailures = trials + 1;
+    uint8_t best = *setting;
+    for (int i = 0; i < count && bestFailures > 0; i++)
+    {
+        *setting = candidates[i];
+        int error = OneWire_Apply_TimingProfile(profile);
+        if (error) return error;
+        int failures = calibrationFailures(device, false, trials, trials);
+        if (failures < bestFailures)
+        {
+            bestFailures = failures;
+            best = candidates[i];
+        }
+    }
+    *setting = best;
+    return 0;
+}
+
+/// Find the fastest 1-Wire timings which reach the target error rate with this device, on its cable.
+/// Starting from 'profile' (e.g. OneWire_DefaultTimingProfile), the RPUP/BUF settings are chosen first:
+/// the pull-up resistance (RWPU), then the threshold (VTH) and the active pull-over level (VIAPO), each
+/// kept at its starting value unless another fails fewer trials. Then tRSTL, tMSP, tW0L, tMSR and tREC
+/// are swept in turn at standard speed, and at overdrive if the device passed its overdrive probe.
+/// Each setting is tested with 'trials' Read Sequencer transfers of known data, and passes with at most
+/// maxFailures failed trials.
+/// The chosen profile is applied and returned in 'profile'; save it with OneWire_SaveTimingProfile()
+/// and restore it at boot with OneWire_LoadTimingProfile() and OneWire_Apply_TimingProfile().
+/// Note: overwrites the start of the device's sequencer memory.
+/// @return true if the device communicates reliably with the resulting profile.
+bool DS28E18_CalibrateTiming(OneWire_handle_T device, int trials, int maxFailures, OneWire_timing_profile_T *profile)
+{
+    static const struct { uint8_t timing; bool samplePoint; } sweep[] = {
+        { ONEWIRE_tRSTL, false }, { ONEWIRE_tMSP, true }, { ONEWIRE_tW0L, false }, { ONEWIRE_tMSR, true }, { ONEWIRE_tREC, false },
+    };
+    static const uint8_t pullups[] = { RWPU_1000, RWPU_500, RWPU_333 }; // weakest first: preferred when equally good
+    uint8_t pattern[CALIBRATION_PATTERN_LENGTH];
+    uint8_t thresholds[VTH_OFF + 1], pullovers[VIAPO_OFF + 1]; // starting value first
+    int count;
+    OneWire_device_T *entry = OneWire_Registry_Get(device);
+
+    if (!entry || OneWire_Apply_TimingProfile(profile)) return false;
+    for (int b = 0; b < CALIBRATION_PATTERN_LENGTH; b++)
+    {
+        pattern[b] = 0x55 ^ (b * 0x3B); // mixed bit patterns, including runs of zeros and ones
+    }
+    if (!DS28E18_WriteSequencer(device, 0, pattern, sizeof(pattern))) return false;
+
+    // Pull-up, threshold and active pull-over: fewest failures at the starting timings
+    if (calibratePullupSetting(device, trials, &profile->rwpu, pullups, sizeof(pullups), profile)) return false;
+    count = 0;
+    thresholds[count++] = profile->vth;
+    for (uint8_t v = VTH_LOW; v < VTH_OFF; v++)
+    {
+        if (v != thresholds[0]) thresholds[count++] = v;
+    }
+    if (calibratePullupSetting(device, trials, &profile->vth, thresholds, count, profile)) return false;
+    count = 0;
+    pullovers[count++] = profile->viapo;
+    for (uint8_t v = VIAPO_LOW; v <= VIAPO_OFF; v++)
+    {
+        if (v != pullovers[0]) pullovers[count++] = v;
+    }
+    if (calibratePullupSetting(device, trials, &profile->viapo, pullovers, count, profile)) return false;
+
+    bool overdrive = false;
+    do
+    {
+        for (unsigned int i = 0; i < sizeof(sweep) / sizeof(sweep[0]); i++)
+        {
+            if (calibrateTiming(device, overdrive, sweep[i].timing, sweep[i].samplePoint, trials, maxFailures, profile)) return false;
+        }
+        overdrive = !overdrive;
+    } while (overdrive && entry->speedCapability == ONEWIRE_SPEED_OVERDRIVE_OK);
+
+    return calibrationFailures(device, false, trials, maxFailures) <= maxFailures &&
+           (entry->speedCapability != ONEWIRE_SPEED_OVERDRIVE_OK || calibrationFailures(device, true, trials, maxFailures) <= maxFailures);
+}
+
+/// Order devices for a pass over the bus so it needs the fewest speed changes:
+/// standard-speed devices first, then overdrive devices, each group keeping its original order.
+/// Issue all of one device's commands before moving to the next, as those stay at overdrive.
+void DS28E18_OrderBySpeed(OneWire_handle_T *devices, int count)
+{
+    int standardCount = 0;
+    for (int i = 0; i < count; i++)
+    {
+        OneWire_device_T *entry = OneWire_Registry_Get(devices[i]);
+        if (entry && entry->speedCapability == ONEWIRE_SPEED_OVERDRIVE_OK) continue;
+        // Stable partition: rotate this standard device down to the end of the standard group
+        OneWire_handle_T handle = devices[i];
+        memmove(&devices[standardCount + 1], &devices[standardCount], (i - standardCount) * sizeof(devices[0]));
+        devices[standardCount++] = handle;
+    }
 }
 
 //---------------------------------------------------------------------------
 //-------- Device Function Commands -----------------------------------------
 //---------------------------------------------------------------------------
 
-static bool returnDeviceResponseResult(DS28E18_result_byte_T r) {
+static bool returnDeviceResponseResult(OneWire_handle_T device, DS28E18_result_byte_T r) {
+    if (r != SUCCESS) afterFailedResult(device, r);
     switch (r) {
     case SUCCESS:
         break;
+    case POR_OCCURRED:
+        ONEWIRE_STATS_ADD(porEvents, 1);
+        PRINTF("Error: POR occurred\n");
+        return false;
     case INVALID_PARAMETER:
         PRINTF("Error: Invalid input or parameter\n");
         return false;
@@ -412,6 +988,7 @@ static bool returnDeviceResponseResult(DS28E18_result_byte_T r) {
 
 /// Device Function Command: Write Sequencer (11h) - Write command sequence into DS28E28 sequencer memory over 1Wire
 ///
+/// @param device DS28E18 to address (handle from DS28E18_GetDeviceHandle)
 /// @param nineBitStartingAddress Target write address
 /// @param txData Array of data to be written into the sequencer memory starting from the target write address
 /// @param txDataSize Number of elements found in txData array
@@ -420,37 +997,47 @@ static bool returnDeviceResponseResult(DS28E18_result_byte_T r) {
 /// false - command failed
 ///
 /// @note Use Sequencer Commands functions to help build txData array.
-bool DS28E18_WriteSequencer(unsigned short nineBitStartingAddress, const uint8_t *txData, int txDataSize)
+bool DS28E18_WriteSequencer(OneWire_handle_T device, unsigned short nineBitStartingAddress, const uint8_t *txData, int txDataSize)
 {
-    uint8_t parameters[2 + txDataSize];
-    uint8_t response[1];
-    uint8_t addressLow = nineBitStartingAddress & 0xFF;
-    uint8_t addressHigh = (nineBitStartingAddress >> 8) & 0x01;
-    parameters[0] = addressLow;
-    parameters[1] = addressHigh;
-    memcpy(&parameters[2], &txData[0], txDataSize);
-
-    if (!run_command(WRITE_SEQUENCER, parameters, sizeof(parameters), SPU_Delay_tOP_msec, response))
+    forgetSequencer(device, nineBitStartingAddress, txDataSize); // DS28E18_BuildPacket_WriteAndRun records its own uploads
+    // Long writes (up to the full 512 bytes) are split, as one command holds at most 252 bytes
+    for (int done = 0; done < txDataSize; done += WRITE_SEQUENCER_MAX)
     {
-        return false;
+        int length = (txDataSize - done < WRITE_SEQUENCER_MAX) ? txDataSize - done : WRITE_SEQUENCER_MAX;
+        unsigned short address = nineBitStartingAddress + done;
+        uint8_t parameters[2];
+        const command_data_T data = { .tx = &txData[done], .txSize = length };
+        uint8_t response[1];
+        parameters[0] = address & 0xFF;
+        parameters[1] = (address >> 8) & 0x01;
+
+        if (!run_command(device, WRITE_SEQUENCER, parameters, sizeof(parameters), &data, SPU_Delay_tOP_msec, response, sizeof(response)))
+        {
+            return false;
+        }
+        if (!returnDeviceResponseResult(device, response[0]))
+        {
+            return false;
+        }
     }
-    return returnDeviceResponseResult(response[0]);
+    return true;
 }
 
 //---------------------------------------------------------------------------
 /// Device Function Command: Read Sequencer (22h)
 ///
+/// @param device DS28E18 to address (handle from DS28E18_GetDeviceHandle)
 /// @param nineBitStartingAddress Target read address
 /// @param readLength Number of data bytes to be read from the sequencer memory starting from the target read address
 /// @param[out] rxData Array of data returned from specified memory address
 /// @return
 /// true - command successful @n
 /// false - command failed
-bool DS28E18_ReadSequencer(unsigned short nineBitStartingAddress, uint8_t *rxData, unsigned short readLength)
+bool DS28E18_ReadSequencer(OneWire_handle_T device, unsigned short nineBitStartingAddress, uint8_t *rxData, unsigned short readLength)
 {
     uint8_t parameters[2];
-    int response_length = 1 + readLength;
-    uint8_t response[response_length];
+    const command_data_T data = { .rx = rxData, .rxSize = readLength }; // data follows the result byte
+    uint8_t response[1];
     uint8_t addressLow;
     uint8_t addressHigh;
 
@@ -465,14 +1052,13 @@ bool DS28E18_ReadSequencer(unsigned short nineBitStartingAddress, uint8_t *rxDat
     parameters[0] = addressLow;
     parameters[1] = (readLength << 1) | addressHigh;
 
-    if (!run_command(READ_SEQUENCER, parameters, sizeof(parameters), SPU_Delay_tOP_msec, response))
+    if (!run_command(device, READ_SEQUENCER, parameters, sizeof(parameters), &data, SPU_Delay_tOP_msec, response, sizeof(response)))
     {
         return false;
     }
 
-    memcpy(rxData, &response[1], response_length - 1);
-
     // Parse result byte.
+    if (response[0] != SUCCESS) afterFailedResult(device, response[0]);
     switch (response[0]) {
     case SUCCESS:
         // Success response.
@@ -493,25 +1079,40 @@ bool DS28E18_ReadSequencer(unsigned short nineBitStartingAddress, uint8_t *rxDat
 //---------------------------------------------------------------------------
 /// Device Function Command: Run Sequencer (33h) - Command DS28E18 over 1wire to run a command sequence already placed in DS28E18 sequence memory
 ///
+/// @param device DS28E18 to address (handle from DS28E18_GetDeviceHandle)
 /// @param nineBitStartingAddress Target run address
 /// @param runLength Number of data bytes to run from the sequencer memory starting from the target run address
 /// @return
 /// true - command successful @n
 /// false - command failed
-bool DS28E18_RunSequencer(unsigned short nineBitStartingAddress, unsigned short runLength)
+bool DS28E18_RunSequencer(OneWire_handle_T device, unsigned short nineBitStartingAddress, unsigned short runLength)
 {
     uint8_t parameters[3];
-    int response_length = 3;
-    uint8_t response[response_length];
+    uint8_t response[3];
     uint8_t addressLow;
     uint8_t addressHigh;
     uint8_t sequencerLengthLow;
     uint8_t sequencerLengthHigh;
-    int totalSequencerCommunicationTime = 0;
     int snackLo;
     int snackHi;
     unsigned short nackOffset;
 
+    // Wait for the modeled run time of the sequence the device was loaded with, else for the
+    // delays of the last sequence built plus an estimate from the run length
+    const loaded_sequence_T *loaded = &loadedSequence[(device >= 0 && device < ONEWIRE_REGISTRY_MAX) ? device : ONEWIRE_REGISTRY_MAX];
+    lastRunTiming.modeled = (nineBitStartingAddress == 0 && loaded->length != 0 && runLength == loaded->length);
+    if (lastRunTiming.modeled)
+    {
+        OneWire_device_T *entry = OneWire_Registry_Get(device);
+        lastRunTiming.estimated_uSec = estimateRunTime_uSec(loaded, entry ? protocolSpeed[device] : KHZ_100);
+    }
+    else
+    {
+        lastRunTiming.estimated_uSec = localPacket.totalSequencerDelayTime * 1000 + runLength * 100; // 1ms for every 10 sequencer bytes
+    }
+    // Add ~5% for assurance, and round up
+    lastRunTiming.delay_msec = SPU_Delay_tOP_msec + (lastRunTiming.estimated_uSec + lastRunTiming.estimated_uSec / 20 + 999) / 1000;
+
     if (runLength == 512)
     {
         runLength = 0;
@@ -526,28 +1127,17 @@ bool DS28E18_RunSequencer(unsigned short nineBitStartingAddress, unsigned short
     parameters[1] = sequencerLengthLow | addressHigh;
     parameters[2] = sequencerLengthHigh;
 
-    #if 0 // Replace stunningly INSANE looping and floating-point coding
-        for (float i = 0; i < (runLength / 10); i++)  //add 1ms to Run Sequencer delay for every 10 sequencer commands
-        {
-            totalSequencerCommunicationTime += 1;
-        }
-        localPacket.totalSequencerDelayTime += localPacket.totalSequencerDelayTime * 0.05; // Add ~5% to delay option time for assurance
-    #else
-        totalSequencerCommunicationTime += (runLength / 10); // add 1ms to Run Sequencer delay for every 10 sequencer commands
-        localPacket.totalSequencerDelayTime += localPacket.totalSequencerDelayTime / 20; // Add ~5% to delay option time for assurance
-    #endif
-
-    int run_sequencer_delay_msec = SPU_Delay_tOP_msec + localPacket.totalSequencerDelayTime + totalSequencerCommunicationTime;
-
-    if (!run_command(RUN_SEQUENCER, parameters, sizeof(parameters), run_sequencer_delay_msec, response))
+    if (!run_command(device, RUN_SEQUENCER, parameters, sizeof(parameters), NULL, lastRunTiming.delay_msec, response, sizeof(response)))
     {
         return false;
     }
 
     // Parse result byte.
+    if (response[0] != SUCCESS) afterFailedResult(device, response[0]);
     switch (response[0]) {
 
     case POR_OCCURRED:
+        ONEWIRE_STATS_ADD(porEvents, 1);
         PRINTF("Error: POR occurred resulting in the command sequencer memory being set to zero\n");
         return false;
 
@@ -563,6 +1153,10 @@ bool DS28E18_RunSequencer(unsigned short nineBitStartingAddress, unsigned short
         {
             nackOffset = 512;
         }
+        OneWire_Stats_Lock();
+        oneWireBusStats[oneWireStatsBus].sequencerNacks++;
+        oneWireBusStats[oneWireStatsBus].lastNackOffset = nackOffset;
+        OneWire_Stats_Unlock();
         PRINTF("Error: RunSequencer NACK occurred at sequencer byte index: %d\n", nackOffset);
         return false;
 
@@ -570,12 +1164,13 @@ bool DS28E18_RunSequencer(unsigned short nineBitStartingAddress, unsigned short
         break;
     }
 
-    return returnDeviceResponseResult(response[0]);
+    return returnDeviceResponseResult(device, response[0]);
 }
 
 //---------------------------------------------------------------------------
 /// Device Function Command: Write Configuration (55h)
 ///
+/// @param device DS28E18 to address (handle from DS28E18_GetDeviceHandle)
 /// @param SPD Desired protocol speed from macros
 /// @param INACK Desired INACK configuration from macros
 /// @param PROT Desired protocol from macros
@@ -583,47 +1178,57 @@ bool DS28E18_RunSequencer(unsigned short nineBitStartingAddress, unsigned short
 /// @return
 /// true - command successful @n
 /// false - command failed
-bool DS28E18_WriteConfiguration(DS28E18_protocol_speed_T SPD, DS28E18_ignore_nack_T INACK, DS28E18_protocol_T PROT, DS28E18_spi_mode_T SPI_MODE)
+bool DS28E18_WriteConfiguration(OneWire_handle_T device, DS28E18_protocol_speed_T SPD, DS28E18_ignore_nack_T INACK, DS28E18_protocol_T PROT, DS28E18_spi_mode_T SPI_MODE)
 {
     uint8_t parameters[1];
     uint8_t response[1];
 
     parameters[0] = (SPI_MODE << 4) | (PROT << 3) | (INACK << 2) | SPD;
 
-    if (!run_command(WRITE_CONFIGURATION, parameters, sizeof(parameters), SPU_Delay_tOP_msec, response))
+    if (!run_command(device, WRITE_CONFIGURATION, parameters, sizeof(parameters), NULL, SPU_Delay_tOP_msec, response, sizeof(response)))
     {
         return false;
     }
+    if (device == ONEWIRE_HANDLE_ALL_DEVICES)
+    {
+        memset(protocolSpeed, SPD, sizeof(protocolSpeed));
+    }
+    else
+    {
+        protocolSpeed[device] = SPD; // run_command() succeeded, so the handle is valid
+    }
 
-    return returnDeviceResponseResult(response[0]);
+    return returnDeviceResponseResult(device, response[0]);
 }
 
 //---------------------------------------------------------------------------
 /// Device Function Command: Read Configuration (6Ah)
 ///
+/// @param device DS28E18 to address (handle from DS28E18_GetDeviceHandle)
 /// @param[out] rxData Array of 2 bytes to be updated with devices' configuration information
 /// @return
 /// true - command successful @n
 /// false - command failed
-bool DS28E18_ReadConfiguration(uint8_t *rxData)
+bool DS28E18_ReadConfiguration(OneWire_handle_T device, uint8_t *rxData)
 {
     uint8_t parameters[0]; //no parameters
-    int response_length = 2;
-    uint8_t response[response_length];
+    uint8_t response[2];
+    const int response_length = sizeof(response);
 
-    if (!run_command(READ_CONFIGURATION, parameters, 0, SPU_Delay_tOP_msec, response))
+    if (!run_command(device, READ_CONFIGURATION, parameters, 0, NULL, SPU_Delay_tOP_msec, response, response_length))
     {
         return false;
     }
 
     memcpy(rxData, &response[1], response_length - 1);
 
-    return returnDeviceResponseResult(response[0]);
+    return returnDeviceResponseResult(device, response[0]);
 }
 
 //---------------------------------------------------------------------------
 /// Device Function Command: Write GPIO Configuration (83h)
 ///
+/// @param device DS28E18 to address (handle from DS28E18_GetDeviceHandle)
 /// @param CFG_REG_TARGET Desired GPIO Configuration Register to write to
 /// @param GPIO_HI Control/Buffer register high byte
 /// @param GPIO_LO Control/Buffer register low byte
@@ -632,7 +1237,7 @@ bool DS28E18_ReadConfiguration(uint8_t *rxData)
 /// false - command failed
 ///
 /// @note Use GPIO Configuration functions to help build GPIO_HI/GPIO_LO parameter.
-bool DS28E18_WriteGpioConfiguration(DS28E18_target_configuration_register_T CFG_REG_TARGET, uint8_t GPIO_HI, uint8_t GPIO_LO)
+bool DS28E18_WriteGpioConfiguration(OneWire_handle_T device, DS28E18_target_configuration_register_T CFG_REG_TARGET, uint8_t GPIO_HI, uint8_t GPIO_LO)
 {
     uint8_t parameters[4];
     uint8_t response[1];
@@ -642,59 +1247,61 @@ bool DS28E18_WriteGpioConfiguration(DS28E18_target_configuration_register_T CFG_
     parameters[2] = GPIO_HI;
     parameters[3] = GPIO_LO;
 
-    if (!run_command(WRITE_GPIO_CONFIGURATION, parameters, sizeof(parameters), SPU_Delay_tOP_msec, response))
+    if (!run_command(device, WRITE_GPIO_CONFIGURATION, parameters, sizeof(parameters), NULL, SPU_Delay_tOP_msec, response, sizeof(response)))
     {
         return false;
     }
-    return returnDeviceResponseResult(response[0]);
+    return returnDeviceResponseResult(device, response[0]);
 }
 
 //---------------------------------------------------------------------------
 /// Device Function Command: Read GPIO Configuration (7Ch)
 ///
+/// @param device DS28E18 to address (handle from DS28E18_GetDeviceHandle)
 /// @param CFG_REG_TARGET Desired GPIO Configuration Register from macros to read from
 /// @param[out] rxData Array of 2 bytes to be updated with device current GPIO configuration for GPIO_HI and GPIO_LO
 /// @return
 /// true - command successful @n
 /// false - command failed
-bool DS28E18_ReadGpioConfiguration(uint8_t CFG_REG_TARGET, uint8_t *rxData)
+bool DS28E18_ReadGpioConfiguration(OneWire_handle_T device, uint8_t CFG_REG_TARGET, uint8_t *rxData)
 {
     uint8_t parameters[2];
-    const int response_length = 3;
-    uint8_t response[response_length];
+    uint8_t response[3];
+    const int response_length = sizeof(response);
 
     parameters[0] = CFG_REG_TARGET;
     parameters[1] = 0x03;
 
-    if (!run_command(READ_GPIO_CONFIGURATION, parameters, sizeof(parameters), SPU_Delay_tOP_msec, response))
+    if (!run_command(device, READ_GPIO_CONFIGURATION, parameters, sizeof(parameters), NULL, SPU_Delay_tOP_msec, response, response_length))
     {
         return false;
     }
 
     memcpy(rxData, &response[1], response_length - 1);
-    return returnDeviceResponseResult(response[0]);
+    return returnDeviceResponseResult(device, response[0]);
 }
 
 //---------------------------------------------------------------------------
 /// Device Function Command: Device Status (7Ah)
 ///
+/// @param device DS28E18 to address (handle from DS28E18_GetDeviceHandle)
 /// @param[out] rxData Array of 4 bytes to receive DS28E18's status information
 /// @return
 /// true - command successful @n
 /// false - command failed
-bool DS28E18_DeviceStatus(uint8_t *rxData)
+bool DS28E18_DeviceStatus(OneWire_handle_T device, uint8_t *rxData)
 {
     uint8_t parameters[0]; //no parameters
-    const int response_length = 5;
-    uint8_t response[response_length];
+    uint8_t response[5];
+    const int response_length = sizeof(response);
 
-    if (!run_command(DEVICE_STATUS, parameters, 0, SPU_Delay_tOP_msec, response))
+    if (!run_command(device, DEVICE_STATUS, parameters, 0, NULL, SPU_Delay_tOP_msec, response, response_length))
     {
         return false;
     }
 
     memcpy(rxData, &response[1], response_length - 1);
-    return returnDeviceResponseResult(response[0]);
+    return returnDeviceResponseResult(device, response[0]);
 }
 
 
@@ -708,6 +1315,8 @@ void DS28E18_BuildPacket_ClearSequencerPacket()
     memset(localPacket.sequenceData, 0x00, sizeof(localPacket.sequenceData));
     localPacket.sequenceIdx = 0;
     localPacket.totalSequencerDelayTime = 0;
+    localPacket.busClocks = 0;
+    localPacket.commandCount = 0;
 }
 /// Get address of locally constructed command sequencer packet's data
 uint8_t *DS28E18_BuildPacket_GetSequencerPacket()
@@ -724,15 +1333,104 @@ void DS28E18_BuildPacket_Append(const uint8_t* sequencerCmds, size_t length)
 {
     appendToSequencerPacket(sequencerCmds,length);
 }
+/// Modeled run time of the locally constructed packet at the given I2C/SPI speed:
+/// Utility Delay commands, plus every bus clock at that speed, plus command decoding.
+unsigned int DS28E18_BuildPacket_GetEstimatedRunTime_uSec(DS28E18_protocol_speed_T speed)
+{
+    loaded_sequence_T sequence = {
+        .length = (unsigned short)localPacket.sequenceIdx,
+        .commandCount = (unsigned short)localPacket.commandCount,
+        .totalSequencerDelayTime = localPacket.totalSequencerDelayTime,
+        .busClocks = localPacket.busClocks,
+    };
+    return estimateRunTime_uSec(&sequence, speed);
+}
+/// Estimated run time and delay used by the most recent DS28E18_RunSequencer, for diagnostics
+const DS28E18_run_timing_T *DS28E18_GetLastRunTiming()
+{
+    return &lastRunTiming;
+}
+#if DS28E18_SEQUENCER_CACHE
+/// FNV-1a hash of a block of sequencer memory and its length, continuing the hash of the blocks before it
+/// (any one changed byte always changes it)
+static uint32_t hashSequencerBlock(uint32_t hash, const uint8_t *data, int length)
+{
+    for (int i = 0; i < length; i++)
+    {
+        hash = (hash ^ data[i]) * 16777619U;
+    }
+    return (hash ^ (uint32_t)length) * 16777619U;
+}
+#endif
+
+/// Write the locally constructed packet into sequencer memory from address 0.
+/// With DS28E18_SEQUENCER_CACHE, blocks the device is known to hold already are not sent;
+/// each run of changed blocks is sent with one (addressed) Write Sequencer.
+static bool uploadSequencerPacket(OneWire_handle_T device)
+{
+#if DS28E18_SEQUENCER_CACHE
+    if (device < 0 || device >= ONEWIRE_REGISTRY_MAX) // Skip ROM: devices may hold different sequences
+    {
+        return DS28E18_WriteSequencer(device, 0x000, localPacket.sequenceData, localPacket.sequenceIdx);
+    }
+    sequencer_record_T *record = &sequencerRecord[device];
+    uint32_t hash[SEQUENCER_CACHE_BLOCKS];
+    int blocks = (localPacket.sequenceIdx + DS28E18_SEQUENCER_CACHE_BLOCK - 1) / DS28E18_SEQUENCER_CACHE_BLOCK;
+    int firstChanged = -1; // first block of the run of changed blocks not yet sent
+    int skipped = 0;
+    for (int b = 0; b <= blocks; b++)
+    {
+        bool changed = false;
+        if (b < blocks)
+        {
+            int start = b * DS28E18_SEQUENCER_CACHE_BLOCK;
+            int length = (localPacket.sequenceIdx - start < DS28E18_SEQUENCER_CACHE_BLOCK) ? localPacket.sequenceIdx - start : DS28E18_SEQUENCER_CACHE_BLOCK;
+            hash[b] = hashSequencerBlock(b ? hash[b - 1] : 2166136261U, &localPacket.sequenceData[start], length);
+            changed = !(record->known & (1UL << b)) || record->blockHash[b] != hash[b];
+            if (!changed) skipped += length;
+        }
+        if (changed && firstChanged < 0)
+        {
+            firstChanged = b;
+        }
+        else if (!changed && firstChanged >= 0)
+        {
+            int start = firstChanged * DS28E18_SEQUENCER_CACHE_BLOCK;
+            int end = (b * DS28E18_SEQUENCER_CACHE_BLOCK < localPacket.sequenceIdx) ? b * DS28E18_SEQUENCER_CACHE_BLOCK : localPacket.sequenceIdx;
+            if (!DS28E18_WriteSequencer(device, start, &localPacket.sequenceData[start], end - start)) return false;
+            firstChanged = -1;
+        }
+    }
+    for (int b = 0; b < blocks; b++) // blocks past the packet still hold what they did
+    {
+        record->blockHash[b] = hash[b];
+        record->known |= 1UL << b;
+    }
+    if (skipped)
+    {
+        OneWire_Stats_Lock();
+        oneWireBusStats[oneWireStatsBus].sequencerBytesSkipped += skipped;
+        if (skipped == localPacket.sequenceIdx) oneWireBusStats[oneWireStatsBus].sequencerUploadsSkipped++;
+        OneWire_Stats_Unlock();
+    }
+    return true;
+#else
+    return DS28E18_WriteSequencer(device, 0x000, localPacket.sequenceData, localPacket.sequenceIdx);
+#endif
+}
+
 /// Write locally constructed command sequencer packet into DS28E18's
 /// sequence memory over 1wire, run it, and wait long enough for completion.
 /// Does NOT fetch any response; use DS28E18_ReadSequencer for that.
-bool DS28E18_BuildPacket_WriteAndRun()
+/// Only what the device does not already hold is written (DS28E18_SEQUENCER_CACHE), so the bytes
+/// a sequence reads into may then hold the previous run's data rather than 0xFF until it runs.
+bool DS28E18_BuildPacket_WriteAndRun(OneWire_handle_T device)
 {
     //printf("\n\n-- Load packet sequence into DS28E18's sequence memory --");
-    bool success = DS28E18_WriteSequencer(0x000, localPacket.sequenceData, localPacket.sequenceIdx);
+    bool success = uploadSequencerPacket(device);
+    if(success) rememberLoadedSequence(device);
     //printf("\n\n-- Run packet sequence --");
-    if(success) success = DS28E18_RunSequencer(0x000, localPacket.sequenceIdx);
+    if(success) success = DS28E18_RunSequencer(device, 0x000, localPacket.sequenceIdx);
     return success;
 }
 
@@ -741,11 +1439,12 @@ unsigned short DS28E18_GetLastSequenceLength()
   { return localPacket.sequenceIdx; }; // DRN addition
 /// Run last locally constructed and loaded command sequencer packet in DS28E18's
 /// sequence memory and wait long enough for completion. Presumes start at 0x000. DRN addition.
+/// The wait is modeled on the sequence this device was loaded with, whatever has been built since.
 /// Does NOT fetch any response; use DS28E18_ReadSequencer for that.
-bool DS28E18_RerunLastSequence(unsigned int length) {
-    // As above, but skip: bool success = DS28E18_WriteSequencer(0x000, localPacket.sequenceData, localPacket.sequenceIdx);
+bool DS28E18_RerunLastSequence(OneWire_handle_T device, unsigned int length) {
+    // As above, but skip: bool success = DS28E18_WriteSequencer(device, 0x000, localPacket.sequenceData, localPacket.sequenceIdx);
     //printf("\n\n-- Run packet sequence --");
-    bool success = DS28E18_RunSequencer(0x000, length);
+    bool success = DS28E18_RunSequencer(device, 0x000, length);
     return success;
 }
 
@@ -777,11 +1476,23 @@ void DS28E18_BuildPacket_I2C_Stop()
 /// @param i2cDataSize Number of elements found in i2cData array
 void DS28E18_BuildPacket_I2C_WriteData(const uint8_t *i2cData, uint8_t i2cDataSize)
 {
-    uint8_t i2c_write_data[2 + i2cDataSize];
+    uint8_t *i2c_write_data = sequencerPacketEnd();
     i2c_write_data[0] = I2C_WRITE_DATA;
     i2c_write_data[1] = i2cDataSize;
     memcpy(&i2c_write_data[2], i2cData, i2cDataSize);
-    APPEND_TO_PACKET(i2c_write_data);
+    commitToSequencerPacket(2 + i2cDataSize);
+}
+
+/// Append an I2C Read Data or Read Data w/NACK end command; returns the address of the data read
+static unsigned short appendI2cRead(DS28E18_sequencer_commands_T command, int readBytes)
+{
+    unsigned short readArrayFFhStartingAddress = localPacket.sequenceIdx + 2;
+    uint8_t *i2c_read_data = sequencerPacketEnd();
+    i2c_read_data[0] = command;
+    i2c_read_data[1] = (readBytes == 256) ? 0 : readBytes;
+    memset(&i2c_read_data[2], 0xFF, readBytes); // Note: This set read bytes to 0xFF in sequencer memory prior to actual read
+    commitToSequencerPacket(2 + readBytes);
+    return readArrayFFhStartingAddress;
 }
 
 //---------------------------------------------------------------------------
@@ -794,21 +1505,7 @@ void DS28E18_BuildPacket_I2C_WriteData(const uint8_t *i2cData, uint8_t i2cDataSi
 /// readArrayFFhStartingAddress - Address where I2C slave response will reside
 unsigned short DS28E18_BuildPacket_I2C_ReadData(int readBytes)
 {
-    unsigned short readArrayFFhStartingAddress = localPacket.sequenceIdx + 2;
-    uint8_t i2c_read_data[2 + readBytes];
-
-    i2c_read_data[0] = I2C_READ_DATA;
-    if (readBytes == 256)
-    {
-        i2c_read_data[1] = 0;
-    }
-    else
-    {
-        i2c_read_data[1] = readBytes;
-    }
-    memset(&i2c_read_data[2], 0xFF, readBytes); // Note: This set read bytes to 0xFF in sequencer memory prior to actual read
-    APPEND_TO_PACKET(i2c_read_data);
-    return readArrayFFhStartingAddress;
+    return appendI2cRead(I2C_READ_DATA, readBytes);
 }
 
 //---------------------------------------------------------------------------
@@ -821,20 +1518,7 @@ unsigned short DS28E18_BuildPacket_I2C_ReadData(int readBytes)
 /// readArrayFFhStartingAddress - Address where I2C slave response will reside
 unsigned short DS28E18_BuildPacket_I2C_ReadDataWithNackEnd(int readBytes)
 {
-    unsigned short readArrayFFhStartingAddress = localPacket.sequenceIdx + 2;
-    uint8_t i2c_read_data_with_nack_end[2 + readBytes];
-    i2c_read_data_with_nack_end[0] = I2C_READ_DATA_W_NACK_END;
-    if (readBytes == 256)
-    {
-        i2c_read_data_with_nack_end[1] = 0;
-    }
-    else
-    {
-        i2c_read_data_with_nack_end[1] = readBytes;
-    }
-    memset(&i2c_read_data_with_nack_end[2], 0xFF, readBytes); // Note: This set read bytes to 0xFF in sequencer memory prior to actual read
-    APPEND_TO_PACKET(i2c_read_data_with_nack_end);
-    return readArrayFFhStartingAddress;
+    return appendI2cRead(I2C_READ_DATA_W_NACK_END, readBytes);
 }
 
 //---------------------------------------------------------------------------
@@ -851,7 +1535,8 @@ unsigned short DS28E18_BuildPacket_I2C_ReadDataWithNackEnd(int readBytes)
 unsigned short DS28E18_BuildPacket_SPI_WriteReadByte(const uint8_t *spiWriteData, uint8_t spiWriteDataSize, int readBytes, bool fullDuplex)
 {
     unsigned short readArrayFFhStartingAddress = 0;
-    uint8_t spi_write_read_data_byte[255];
+    // Built in place: write and read arrays together can exceed any reasonable stack buffer
+    uint8_t *spi_write_read_data_byte = sequencerPacketEnd();
     int idx = 0;
 
     //command
@@ -937,7 +1622,7 @@ unsigned short DS28E18_BuildPacket_SPI_WriteReadByte(const uint8_t *spiWriteData
         //omitted
     }
     readArrayFFhStartingAddress += localPacket.sequenceIdx;
-    appendToSequencerPacket(spi_write_read_data_byte, idx);
+    commitToSequencerPacket(idx);
     return readArrayFFhStartingAddress;
 }
 
@@ -956,7 +1641,7 @@ unsigned short DS28E18_BuildPacket_SPI_WriteReadBit(const uint8_t *spiWriteData,
 {
     uint8_t readBitsInBytes = 0;
     unsigned short readArrayFFhStartingAddress = 0;
-    uint8_t spi_write_read_data_bit[255];
+    uint8_t *spi_write_read_data_bit = sequencerPacketEnd(); // built in place
     int idx = 0;
 
     if (readBits > 0 && readBits < 9)
@@ -1066,7 +1751,7 @@ unsigned short DS28E18_BuildPacket_SPI_WriteReadBit(const uint8_t *spiWriteData,
     }
 
     readArrayFFhStartingAddress += localPacket.sequenceIdx;
-    appendToSequencerPacket(spi_write_read_data_bit,idx);
+    commitToSequencerPacket(idx);
 
     return readArrayFFhStartingAddress;
 }
@@ -1097,9 +1782,7 @@ void DS28E18_BuildPacket_SPI_SlaveSelectLow()
 /// Append a Delay command to the locally constructed command sequencer packet.
 void DS28E18_BuildPacket_Utility_Delay(DS28E18_utility_delay_T delayTimeInMsExponent)
 {
-    uint16_t delayTimeInMs = 1U << (uint16_t)delayTimeInMsExponent;
-    localPacket.totalSequencerDelayTime += delayTimeInMs;
-    uint8_t utility_delay_sequence[2] = { UTILITY_DELAY, delayTimeInMsExponent };
+    uint8_t utility_delay_sequence[2] = { UTILITY_DELAY, delayTimeInMsExponent }; // delay is accounted when appended
     APPEND_TO_PACKET(utility_delay_sequence);
 }
 
@@ -1175,3 +1858,83 @@ unsigned short DS28E18_BuildPacket_Utility_GpioControlRead()
     APPEND_TO_PACKET(utility_gpio_cntl_read);
     return readArrayFFhStartingAddress;
 }
+
+//---------------------------------------------------------------------------
+/// Read 'length' bytes from an SPI device behind the DS28E18, starting at 'address' (ignored for a FIFO).
+///
+/// The transfer is split into chunks of up to 251 - 2*(command and address bytes), each an SPI transaction
+/// in its own slot of the sequencer. Both slots are run by one Run Sequencer command, and their results
+/// read back. The sequence is written once; later passes only rewrite the address bytes, so most of the
+/// 1-Wire traffic is the data itself. (The DS28E18 does not answer 1-Wire commands while its sequencer
+/// runs, so reading one slot while the other runs is not possible.)
+/// Replaces the locally constructed sequencer packet.
+/// @return true on success; on failure 'data' may be partly filled.
+bool DS28E18_SPI_StreamRead(OneWire_handle_T device, const DS28E18_spi_stream_T *stream, uint32_t address, uint8_t *data, int length)
+{
+    int headerLength = stream->commandLength + stream->addressLength;
+    int chunkMax = STREAM_SLOT_SIZE - 5 - 2*headerLength; // SS low, C0h, lengths, header, header echo and data, SS high
+    int loaded[2] = { 0, 0 };      // data length of each slot in the loaded sequence (0: slot unused or nothing loaded)
+    unsigned short dataAddress[2]; // where each slot's data lands in sequencer memory
+    unsigned short addressOffset[2];
+    if (stream->commandLength > sizeof(stream->command) || stream->addressLength > 4) return false;
+
+    while (length > 0)
+    {
+        int chunk[2];
+        chunk[0] = (length < chunkMax) ? length : chunkMax;
+        chunk[1] = (length - chunk[0] < chunkMax) ? length - chunk[0] : chunkMax;
+
+        if (chunk[0] != loaded[0] || chunk[1] != loaded[1])
+        {
+            // (Re)build both slots; only needed for the first pass and a short final pass
+            DS28E18_BuildPacket_ClearSequencerPacket();
+            for (int slot = 0; slot < 2 && chunk[slot] > 0; slot++)
+            {
+                uint8_t header[8];
+                memcpy(header, stream->command, stream->commandLength);
+                memset(&header[stream->commandLength], 0, stream->addressLength); // address set below
+                DS28E18_BuildPacket_SPI_SlaveSelectLow();
+                addressOffset[slot] = localPacket.sequenceIdx + 3 + stream->commandLength;
+                dataAddress[slot] = DS28E18_BuildPacket_SPI_WriteReadByte(header, headerLength, chunk[slot], false);
+                DS28E18_BuildPacket_SPI_SlaveSelectHigh();
+            }
+            loaded[0] = loaded[1] = 0;
+        }
+
+        for (int slot = 0; slot < 2 && chunk[slot] > 0; slot++)
+        {
+            uint32_t chunkAddress = address + (slot ? chunk[0] : 0);
+            for (int b = 0; b < stream->addressLength; b++)
+            {
+                localPacket.sequenceData[addressOffset[slot] + b] = (uint8_t)(chunkAddress >> (8 * (stream->addressLength - 1 - b)));
+            }
+            if (loaded[0] && stream->addressLength &&
+                !DS28E18_WriteSequencer(device, addressOffset[slot], &localPacket.sequenceData[addressOffset[slot]], stream->addressLength))
+            {
+                return false;
+            }
+        }
+        if (!loaded[0])
+        {
+            if (!DS28E18_WriteSequencer(device, 0, localPacket.sequenceData, localPacket.sequenceIdx)) return false;
+            loaded[0] = chunk[0];
+            loaded[1] = chunk[1];
+        }
+
+        rememberLoadedSequence(device); // the address writes above forget it
+        if (!DS28E18_RunSequencer(device, 0, localPacket.sequenceIdx)) return false;
+
+        for (int slot = 0; slot < 2 && chunk[slot] > 0; slot++)
+        {
+            for (int done = 0; done < chunk[slot]; done += READ_SEQUENCER_MAX)
+            {
+                int n = (chunk[slot] - done < READ_SEQUENCER_MAX) ? chunk[slot] - done : READ_SEQUENCER_MAX;
+                if (!DS28E18_ReadSequencer(device, dataAddress[slot] + done, data + done, n)) return false;
+            }
+            data += chunk[slot];
+            length -= chunk[slot];
+            address += chunk[slot];
+        }
+    }
+    return true;
+}
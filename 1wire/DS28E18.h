@@ -54,11 +54,36 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "one_wire.h"
+#include "one_wire_registry.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define DS28E18_FAMILY_CODE 0x56 // first byte of DS28E18 ROM ID
+
+#ifndef DS28E18_PROBE_OVERDRIVE
+  #define DS28E18_PROBE_OVERDRIVE 1 // initialization tests each device at overdrive; 0 keeps every device at standard speed
+#endif
+#ifndef DS28E18_OVERDRIVE_PROBE_COUNT
+  #define DS28E18_OVERDRIVE_PROBE_COUNT 8 // commands which must all succeed at overdrive for a device to use it
+#endif
+#ifndef DS28E18_OVERDRIVE_FAILURES_TO_FALL_BACK
+  #define DS28E18_OVERDRIVE_FAILURES_TO_FALL_BACK 3 // consecutive overdrive failures before a device is kept at standard speed
+#endif
+#ifndef DS28E18_SCRIPT_CRC
+  #define DS28E18_SCRIPT_CRC 1 // the DS2485 checks command and response CRC16 in the script moving them; 0 checks on the host
+#endif
+#ifndef DS28E18_CRC_DIAGNOSTICS
+  #define DS28E18_CRC_DIAGNOSTICS 0 // also check the raw CRC16 bytes on the host, and report when it disagrees with the DS2485
+#endif
+#ifndef DS28E18_SEQUENCER_CACHE
+  #define DS28E18_SEQUENCER_CACHE 1 // WriteAndRun skips uploading what a device's sequencer memory already holds; 0 always uploads
+#endif
+#ifndef DS28E18_SEQUENCER_CACHE_BLOCK
+  #define DS28E18_SEQUENCER_CACHE_BLOCK 64 // bytes per hashed block (16..512, power of 2): RAM is 4*(512/block)+4 bytes per registry entry
+#endif
+
 typedef enum { // DS28E18_device_function_commands_T
     COMMAND_START = 0x66,
     WRITE_SEQUENCER = 0x11,
@@ -166,32 +191,51 @@ typedef struct { // DS28E18_sequence_T
     uint8_t sequenceData[512];
     int sequenceIdx;  // index to next available entry in sequence data == current sequence length
     unsigned int totalSequencerDelayTime; // milliseconds
+    unsigned int busClocks;     // I2C SCL or SPI SCK cycles clocked by the sequence
+    unsigned int commandCount;  // sequencer commands in the sequence
 } DS28E18_sequence_T;
 
+typedef struct { // DS28E18_run_timing_T
+    unsigned int estimated_uSec; // modeled run time of the sequence
+    int delay_msec;              // delay used before reading the Run Sequencer result
+    bool modeled;                // false if the run was not the sequence the device was loaded with, so estimated from the
+                                 // last sequence built's delays and the run length
+} DS28E18_run_timing_T;
 
-/***** Globals *****/
+/// SPI read stream through the DS28E18 (DS28E18_SPI_StreamRead).
+/// Each chunk is one SPI transaction: slave select low, command and address, data, slave select high.
+typedef struct { // DS28E18_spi_stream_T
+    uint8_t command[4];     ///< SPI command bytes sent before the address, e.g. { 0x03 } for a flash Read Data
+    uint8_t commandLength;
+    uint8_t addressLength;  ///< address bytes sent MSB first after the command, at most 4; 0 to read the same place (a FIFO) every chunk
+} DS28E18_spi_stream_T;
 
-/// DS28E18 device addressed for current operations (may be one of many on 1-Wire bus)
-extern OneWire_ROM_ID_T current_DS28E18_ROM_ID;
+#ifndef DS28E18_SEQUENCER_COMMAND_USEC
+  #define DS28E18_SEQUENCER_COMMAND_USEC 10 // DS28E18 time to fetch and decode one sequencer command
+#endif
 
 
 /***** API *****/
 
 // High Level Functions
 int DS28E18_Init(void);
+int DS28E18_InitWarm(void);
+const OneWire_ROM_table_T *DS28E18_GetDeviceTable(void);
+OneWire_handle_T DS28E18_GetDeviceHandle(int index);
 int DS28E18_SetOnewireSpeed(one_wire_speeds spd);
-extern void DS28E18_SetRomCommand(DS28E18_one_wire_rom_commands_T rom_cmd);
-extern DS28E18_one_wire_rom_commands_T DS28E18_GetRomCommand(void);
+bool DS28E18_ProbeOverdrive(OneWire_handle_T device);
+void DS28E18_OrderBySpeed(OneWire_handle_T *devices, int count);
+bool DS28E18_CalibrateTiming(OneWire_handle_T device, int trials, int maxFailures, OneWire_timing_profile_T *profile);
 
 // Device Function Commands
-bool DS28E18_WriteSequencer(unsigned short nineBitStartingAddress, const uint8_t *txData, int txDataSize);
-bool DS28E18_ReadSequencer(unsigned short nineBitStartingAddress, uint8_t *rxData,  unsigned short readLength);
-bool DS28E18_RunSequencer(unsigned short nineBitStartingAddress, unsigned short runLength);
-bool DS28E18_WriteConfiguration(DS28E18_protocol_speed_T SPD, DS28E18_ignore_nack_T INACK, DS28E18_protocol_T PROT, DS28E18_spi_mode_T SPI_MODE);
-bool DS28E18_ReadConfiguration(uint8_t *rxData);
-bool DS28E18_WriteGpioConfiguration(DS28E18_target_configuration_register_T CFG_REG_TARGET, uint8_t GPIO_HI, uint8_t GPIO_LO);
-bool DS28E18_ReadGpioConfiguration(uint8_t CFG_REG_TARGET, uint8_t *rxData);
-bool DS28E18_DeviceStatus(uint8_t *rxData);
+bool DS28E18_WriteSequencer(OneWire_handle_T device, unsigned short nineBitStartingAddress, const uint8_t *txData, int txDataSize);
+bool DS28E18_ReadSequencer(OneWire_handle_T device, unsigned short nineBitStartingAddress, uint8_t *rxData,  unsigned short readLength);
+bool DS28E18_RunSequencer(OneWire_handle_T device, unsigned short nineBitStartingAddress, unsigned short runLength);
+bool DS28E18_WriteConfiguration(OneWire_handle_T device, DS28E18_protocol_speed_T SPD, DS28E18_ignore_nack_T INACK, DS28E18_protocol_T PROT, DS28E18_spi_mode_T SPI_MODE);
+bool DS28E18_ReadConfiguration(OneWire_handle_T device, uint8_t *rxData);
+bool DS28E18_WriteGpioConfiguration(OneWire_handle_T device, DS28E18_target_configuration_register_T CFG_REG_TARGET, uint8_t GPIO_HI, uint8_t GPIO_LO);
+bool DS28E18_ReadGpioConfiguration(OneWire_handle_T device, uint8_t CFG_REG_TARGET, uint8_t *rxData);
+bool DS28E18_DeviceStatus(OneWire_handle_T device, uint8_t *rxData);
 
 // Utilities to build and use a packet of Sequencer Commands
 void DS28E18_BuildPacket_ClearSequencerPacket(void);
@@ -214,9 +258,14 @@ unsigned short DS28E18_BuildPacket_Utility_GpioBufferRead(void);
 void DS28E18_BuildPacket_Utility_GpioControlWrite(uint8_t GPIO_CRTL_HI, uint8_t GPIO_CRTL_LO);
 unsigned short DS28E18_BuildPacket_Utility_GpioControlRead(void);
 void DS28E18_BuildPacket_Append(const uint8_t* sequencerCmds, size_t length);
-bool DS28E18_BuildPacket_WriteAndRun(void);
+unsigned int DS28E18_BuildPacket_GetEstimatedRunTime_uSec(DS28E18_protocol_speed_T speed);
+const DS28E18_run_timing_T *DS28E18_GetLastRunTiming(void);
+
+// Bulk transfers
+bool DS28E18_SPI_StreamRead(OneWire_handle_T device, const DS28E18_spi_stream_T *stream, uint32_t address, uint8_t *data, int length);
+bool DS28E18_BuildPacket_WriteAndRun(OneWire_handle_T device);
 unsigned short DS28E18_GetLastSequenceLength(void); // DRN addition
-bool DS28E18_RerunLastSequence(unsigned int length); // DRN addition
+bool DS28E18_RerunLastSequence(OneWire_handle_T device, unsigned int length); // DRN addition
 
 #ifdef __cplusplus
 }
@@ -53,8 +53,22 @@
 #include <string.h>
 #include "one_wire.h"
 #include "DS2485.h"
+#include "one_wire_instrument.h"
+#include "one_wire_stats.h"
 
 /* **** Definitions **** */
+#define SEARCH_TRIPLETS_MAX_PER_SCRIPT  61 // first script also holds reset and search command; each triplet uses 2 bytes of script and response
+#define BLOCK_MAX_PER_SCRIPT (sizeof(oneWireScript) - 2) // block command and length, then data (write) or length, status and data (read)
+#define ROM_TABLE_PAGE_SIZE     32
+#define ROM_TABLE_PAGES         (PAGE_5 + 1 - ONEWIRE_ROM_TABLE_FIRST_PAGE)
+#define ROM_TABLE_HEADER_SIZE   8 // 'O','W', version, count, generation (4 bytes LSB first)
+#define ROM_TABLE_VERSION       1
+#define ROM_TABLE_IMAGE_SIZE(count_) (ROM_TABLE_HEADER_SIZE + 8*(count_) + 2) // header, ROM IDs, CRC16
+#define ROM_TABLE_PAGES_USED(count_) ((ROM_TABLE_IMAGE_SIZE(count_) + ROM_TABLE_PAGE_SIZE - 1) / ROM_TABLE_PAGE_SIZE)
+_Static_assert(ROM_TABLE_PAGES_USED(ONEWIRE_ROM_TABLE_SAVE_MAX) <= ROM_TABLE_PAGES, "ONEWIRE_ROM_TABLE_SAVE_MAX too large for DS2485 user memory");
+#define TIMING_PROFILE_VERSION  1
+#define TIMING_PROFILE_IMAGE_SIZE (3 + 2*ONEWIRE_TIMINGS + 3 + 2) // 'O','T', version, presets, RPUP/BUF, CRC16
+_Static_assert(ONEWIRE_TIMING_PROFILE_PAGE < ONEWIRE_ROM_TABLE_FIRST_PAGE, "timing profile page overlaps ROM ID table");
 
 /* **** Globals **** */
 uint8_t oneWireScript[126];
@@ -63,6 +77,20 @@ double  oneWireScript_accumulativeOneWireTime = 0;
 uint8_t oneWireScript_commandsCount = 0;
 uint8_t oneWireScriptResponse[126];
 uint8_t oneWireScriptResponse_length = 0;
+const OneWire_timing_profile_T OneWire_DefaultTimingProfile = {
+    .standard  = { PRESET_6, PRESET_6, PRESET_6, PRESET_6, PRESET_6, PRESET_6, PRESET_6, PRESET_6 },
+    .overdrive = { PRESET_6, PRESET_6, PRESET_6, PRESET_6, PRESET_6, PRESET_6, PRESET_6, PRESET_6 },
+    .vth = VTH_MEDIUM,
+    .viapo = VIAPO_LOW,
+    .rwpu = RWPU_1000,
+};
+
+/* **** Locals **** */
+static int searchTripletsPerScript = 32; // 64 ROM ID bits in 2 scripts
+static bool scriptChangesSpeed; // script holds PC_SPEED or PC_OV_SKIP, which change master speed
+// 1-Wire traffic of the script being built, added to the bus statistics once it has run
+static uint8_t scriptResets;
+static uint8_t scriptBytesWritten[2], scriptBytesRead[2]; // by one_wire_speeds
 
 /* **** Functions **** */
 int OneWire_ResetPulse()
@@ -83,6 +111,7 @@ int OneWire_ResetPulse()
     // This is the very first OneWire script run during initialization; maybe there's a 'first time' bug somewhere...
     // Subsequent attempts work fine, hence the retry loop below
     for(int i=0; i<3; i++) {
+        if (i) ONEWIRE_STATS_ADD(retries, 1);
         error = OneWire_Script_Execute();
         if(error == 0) break;
     }
@@ -95,6 +124,7 @@ int OneWire_ResetPulse()
     }
     else
     {
+        ONEWIRE_STATS_ADD(presenceFailures, 1);
         error = 1;
     }
 
@@ -127,23 +157,50 @@ int OneWire_WriteByte(unsigned char byte)
 
 int OneWire_WriteBlock(unsigned char *data, int data_length)
 {
-    int error = 0;
-    uint8_t writeBlockResponse_index;
+    return OneWire_WriteBlockGather(data, data_length, NULL, 0);
+}
 
-    OneWire_Script_Clear();
+/// Write 'first' then 'second' as one 1-Wire block, without copying them together.
+/// Each script takes as much of both as fits, so a short header and its data go in one script.
+int OneWire_WriteBlockGather(const uint8_t *first, int first_length, const uint8_t *second, int second_length)
+{
+    int error = 0;
+    uint8_t writeBlockResponse_index[2];
 
-    error = OneWire_Script_Add_OW_WRITE_BLOCK(&writeBlockResponse_index, data, data_length);
-    if(error) return error;
-    error = OneWire_Script_Execute();
-    if(error) return error;
-    uint8_t writeBlock_status = oneWireScriptResponse[writeBlockResponse_index + 1];
-    if (writeBlock_status == 0xAA)
+    // Longer blocks do not fit in one script; send them a script at a time
+    while (first_length + second_length > 0)
     {
-        error = 0;
-    }
-    else
-    {
-        error = 1;
+        int blocks = 0;
+        int space = sizeof(oneWireScript);
+        OneWire_Script_Clear();
+
+        if (first_length > 0)
+        {
+            int length = (first_length < space - 2) ? first_length : space - 2;
+            error = OneWire_Script_Add_OW_WRITE_BLOCK(&writeBlockResponse_index[blocks++], first, length);
+            if(error) return error;
+            first += length;
+            first_length -= length;
+            space -= 2 + length;
+        }
+        if (second_length > 0 && space > 2)
+        {
+            int length = (second_length < space - 2) ? second_length : space - 2;
+            error = OneWire_Script_Add_OW_WRITE_BLOCK(&writeBlockResponse_index[blocks++], second, length);
+            if(error) return error;
+            second += length;
+            second_length -= length;
+        }
+        error = OneWire_Script_Execute();
+        if(error) return error;
+        for (int b = 0; b < blocks; b++)
+        {
+            uint8_t writeBlock_status = oneWireScriptResponse[writeBlockResponse_index[b] + 1];
+            if (writeBlock_status != 0xAA)
+            {
+                return 1;
+            }
+        }
     }
 
     return error;
@@ -166,20 +223,113 @@ uint8_t OneWire_ReadByte()
 }
 
 int OneWire_ReadBlock(unsigned char *data, int data_length)
+{
+    return OneWire_ReadBlockScatter(data, data_length, NULL, 0);
+}
+
+/// Read one 1-Wire block of first_length + second_length bytes, the start into 'first' and the rest into 'second'.
+int OneWire_ReadBlockScatter(uint8_t *first, int first_length, uint8_t *second, int second_length)
+{
+    int error = 0;
+    uint8_t readBlockResponse_index;
+    int data_length = first_length + second_length;
+
+    for (int done = 0; done < data_length; done += BLOCK_MAX_PER_SCRIPT)
+    {
+        int length = (data_length - done < (int)BLOCK_MAX_PER_SCRIPT) ? data_length - done : (int)BLOCK_MAX_PER_SCRIPT;
+        OneWire_Script_Clear();
+
+        error = OneWire_Script_Add_OW_READ_BLOCK(&readBlockResponse_index, length);
+        if(error) return error;
+        error = OneWire_Script_Execute();
+        if(error) return error;
+
+        uint8_t readBlock_length = oneWireScriptResponse[readBlockResponse_index + 1];
+        const uint8_t *readBlock = &oneWireScriptResponse[readBlockResponse_index + 2];
+        if (readBlock_length > length) return 1;
+        for (int i = 0; i < readBlock_length; i++)
+        {
+            int at = done + i;
+            if (at < first_length) first[at] = readBlock[i];
+            else second[at - first_length] = readBlock[i];
+        }
+    }
+    return 0;
+}
+
+/// Write 'first' then 'second' as one block, then read the 2-byte CRC16 the device returns for it, in one script.
+/// The DS2485 computes CRC16 over the block and the CRC16 read, and verifies the residual (ONEWIRE_CRC16_RESIDUAL
+/// if the device returned the inverted CRC16 of the block), so the host only gets the verdict in *crcOK.
+/// The raw CRC16 bytes are copied to crc16 unless it is NULL (diagnostics).
+/// Returns RB_INVALID_LENGTH if the block is longer than one script holds (ONEWIRE_WRITE_CRC16_MAX).
+int OneWire_WriteBlockVerifyCrc16(const uint8_t *first, int first_length, const uint8_t *second, int second_length, bool *crcOK, uint8_t *crc16)
+{
+    int error = 0;
+    uint8_t writeBlockResponse_index[2];
+    uint8_t readBlockResponse_index;
+    uint8_t verifyResponse_index;
+    int blocks = 0;
+
+    if (first_length + second_length > ONEWIRE_WRITE_CRC16_MAX) return RB_INVALID_LENGTH;
+    OneWire_Script_Clear();
+
+    OneWire_Script_Add_CRC16_START();
+    if (first_length > 0)
+    {
+        error = OneWire_Script_Add_OW_WRITE_BLOCK(&writeBlockResponse_index[blocks++], first, first_length);
+        if(error) return error;
+    }
+    if (second_length > 0)
+    {
+        error = OneWire_Script_Add_OW_WRITE_BLOCK(&writeBlockResponse_index[blocks++], second, second_length);
+        if(error) return error;
+    }
+    error = OneWire_Script_Add_OW_READ_BLOCK(&readBlockResponse_index, 2);
+    if(error) return error;
+    OneWire_Script_Add_VERIFY_CRC16(&verifyResponse_index, ONEWIRE_CRC16_RESIDUAL);
+    error = OneWire_Script_Execute();
+    if(error) return error;
+
+    for (int b = 0; b < blocks; b++)
+    {
+        if (oneWireScriptResponse[writeBlockResponse_index[b] + 1] != 0xAA) return 1;
+    }
+    if (oneWireScriptResponse[readBlockResponse_index + 1] != 2) return 1;
+    if (crc16) memcpy(crc16, &oneWireScriptResponse[readBlockResponse_index + 2], 2);
+    *crcOK = (oneWireScriptResponse[verifyResponse_index + 1] == 0xAA);
+    return 0;
+}
+
+/// Read and discard 'skip' bytes, then read data_length bytes which end with their inverted CRC16, in one script.
+/// The DS2485 verifies the CRC16 residual of the data_length bytes, so the host only gets the verdict in *crcOK.
+/// *data points to the data_length bytes in oneWireScriptResponse, valid until the next script.
+/// Returns RB_INVALID_LENGTH if they are more than one script holds (skip + data_length > ONEWIRE_READ_CRC16_MAX).
+int OneWire_ReadBlockVerifyCrc16(int skip, int data_length, const uint8_t **data, bool *crcOK)
 {
     int error = 0;
+    uint8_t skipResponse_index;
     uint8_t readBlockResponse_index;
+    uint8_t verifyResponse_index;
 
+    if (skip < 0 || data_length < 2 || skip + data_length > ONEWIRE_READ_CRC16_MAX) return RB_INVALID_LENGTH;
     OneWire_Script_Clear();
 
+    if (skip > 0)
+    {
+        error = OneWire_Script_Add_OW_READ_BLOCK(&skipResponse_index, skip);
+        if(error) return error;
+    }
+    OneWire_Script_Add_CRC16_START();
     error = OneWire_Script_Add_OW_READ_BLOCK(&readBlockResponse_index, data_length);
     if(error) return error;
+    OneWire_Script_Add_VERIFY_CRC16(&verifyResponse_index, ONEWIRE_CRC16_RESIDUAL);
     error = OneWire_Script_Execute();
     if(error) return error;
 
-    uint8_t readBlock_length = oneWireScriptResponse[readBlockResponse_index + 1];
-    uint8_t readBlock_index = readBlockResponse_index + 2;
-    memcpy(&data[0], &oneWireScriptResponse[readBlock_index], readBlock_length);
+    if (skip > 0 && oneWireScriptResponse[skipResponse_index + 1] != skip) return 1;
+    if (oneWireScriptResponse[readBlockResponse_index + 1] != data_length) return 1;
+    *data = &oneWireScriptResponse[readBlockResponse_index + 2];
+    *crcOK = (oneWireScriptResponse[verifyResponse_index + 1] == 0xAA);
     return 0;
 }
 
@@ -190,7 +340,8 @@ int OneWire_ReadBlock(unsigned char *data, int data_length)
 /// return parameter: last_device_found - True: no more devices
 int OneWire_Search(OneWire_ROM_ID_T *romid, bool search_reset, bool *last_device_found)
 {
-    return DS2485_OneWireSearch(romid->ID, /*search command code=*/0xF0, /*reset=*/true, /*ignore=*/false, search_reset, last_device_found);
+    ONEWIRE_STATS_ADD(searches, 1);
+    return DS2485_OneWireSearch(romid->ID, /*search command code=*/ONEWIRE_SEARCH_NORMAL, /*reset=*/true, /*ignore=*/false, search_reset, last_device_found);
 }
 
 int OneWire_WriteBytePower(int send_byte)
@@ -218,6 +369,276 @@ int OneWire_WriteBytePower(int send_byte)
     return error;
 }
 
+unsigned int OneWire_CalculateCrc16Byte(uint8_t data, unsigned int crc)
+{
+  const uint8_t oddparity[] = {0, 1, 1, 0, 1, 0, 0, 1,
+                                     1, 0, 0, 1, 0, 1, 1, 0};
+
+  unsigned int data16 = (data ^ crc) & 0xff;
+  crc = (crc >> 8) & 0xff;
+
+  if (oddparity[data16 & 0xf] ^ oddparity[data16 >> 4]) {
+    crc ^= 0xc001;
+  }
+
+  data16 <<= 6;
+  crc ^= data16;
+  data16 <<= 1;
+  crc ^= data16;
+
+  return crc;
+}
+unsigned int OneWire_CalculateCrc16Block(const uint8_t *data, int dataSize, unsigned int crc)
+{
+  for (int i = 0; i < dataSize; i++)
+  {
+    crc = OneWire_CalculateCrc16Byte(data[i], crc);
+  }
+  return crc;
+}
+uint8_t OneWire_CalculateCrc8(const uint8_t *data, int dataSize)
+{
+  uint8_t crc = 0;
+  for (int i = 0; i < dataSize; i++)
+  {
+    uint8_t byte = data[i];
+    for (int bit = 0; bit < 8; bit++)
+    {
+      uint8_t mix = (crc ^ byte) & 0x01;
+      crc >>= 1;
+      if (mix) crc ^= 0x8C;
+      byte >>= 1;
+    }
+  }
+  return crc;
+}
+
+// Append 'count' OW_TRIPLET primitives for ROM ID bits starting at 'firstBit', taking direction from romID
+// where the search tree branches. Timing is fetched once by the caller rather than per primitive.
+static void scriptAddSearchTriplets(uint8_t *response_index, const uint8_t *romID, int firstBit, int count, double t_slot)
+{
+    *response_index = oneWireScriptResponse_length;
+    for (int bit = firstBit; bit < firstBit + count; bit++)
+    {
+        oneWireScript[oneWireScript_length++] = PC_OW_TRIPLET;
+        oneWireScript[oneWireScript_length++] = (romID[bit/8] >> (bit%8)) & 1;
+        oneWireScriptResponse_length += 2;
+    }
+    oneWireScript_accumulativeOneWireTime += 3 * t_slot * count; // each triplet is 2 read slots and 1 write slot
+}
+
+//--------------------------------------------------------------------------
+/// One pass of the 1-Wire search algorithm, run as host-built scripts of OW_TRIPLET primitives.
+/// romid: in: search direction for each bit (used where devices with both bit values respond);
+///        out: bits from forcedBits onward are replaced by the path actually taken.
+/// forcedBits: the first forcedBits bits of romid must be followed; if no device has the wanted
+///        value at some forced bit, the pass stops and reports it in pass->divergedBit.
+/// Return 0: no error (see pass for outcome)
+int OneWire_SearchPass(OneWire_ROM_ID_T *romid, int forcedBits, uint8_t searchCode, OneWire_search_pass_T *pass)
+{
+    int error = 0;
+    one_wire_speeds speed;
+    double t_w0l, t_rec;
+
+    pass->lastZero = 0;
+    pass->discrepancies = 0;
+    pass->divergedBit = -1;
+    pass->noDevices = false;
+
+    if ((error = OneWire_Get_OneWireMasterSpeed(&speed)) != 0) return error;
+    if ((error = OneWire_Get_tW0L(&t_w0l, speed)) != 0) return error;
+    if ((error = OneWire_Get_tREC(&t_rec, speed)) != 0) return error;
+    double t_slot = t_w0l + t_rec;
+    ONEWIRE_STATS_ADD(searches, 1);
+
+    for (int firstBit = 0; firstBit < 64; firstBit += searchTripletsPerScript)
+    {
+        uint8_t reset_index, search_index, triplet_index;
+        int triplets = (64 - firstBit < searchTripletsPerScript) ? 64 - firstBit : searchTripletsPerScript;
+        OneWire_Script_Clear();
+        if (firstBit == 0)
+        {
+            if ((error = OneWire_Script_Add_OW_RESET(&reset_index, speed, false)) != 0) return error;
+            if ((error = OneWire_Script_Add_OW_WRITE_BYTE(&search_index, searchCode)) != 0) return error;
+        }
+        scriptAddSearchTriplets(&triplet_index, romid->ID, firstBit, triplets, t_slot);
+        if ((error = OneWire_Script_Execute()) != 0) return error;
+        if (firstBit == 0 && !(oneWireScriptResponse[reset_index + 1] & (1 << 1)))
+        {
+            ONEWIRE_STATS_ADD(presenceFailures, 1);
+            pass->noDevices = true; // no presence pulse
+            return 0;
+        }
+
+        for (int i = 0; i < triplets; i++)
+        {
+            int bit = firstBit + i;
+            uint8_t result = oneWireScriptResponse[triplet_index + 2*i + 1];
+            bool idBit = result & OW_TRIPLET_ID_BIT;
+            bool cmpBit = result & OW_TRIPLET_CMP_ID_BIT;
+            bool direction = result & OW_TRIPLET_DIRECTION;
+            if (idBit && cmpBit)
+            {
+                pass->noDevices = true; // no device participating (eg none in alarm state)
+                return 0;
+            }
+            if (!idBit && !cmpBit)
+            {
+                pass->discrepancies |= (uint64_t)1 << bit;
+                if (!direction) pass->lastZero = bit+1;
+            }
+            if (bit < forcedBits)
+            {
+                if (direction != ((romid->ID[bit/8] >> (bit%8)) & 1))
+                {
+                    pass->divergedBit = bit; // no device on the forced path; remaining results follow other devices
+                    return 0;
+                }
+                continue;
+            }
+            if (direction) romid->ID[bit/8] |= (1 << (bit%8));
+            else romid->ID[bit/8] &= ~(1 << (bit%8));
+        }
+    }
+    return 0;
+}
+
+/// Number of OW_TRIPLET primitives per script in host-side searches (1..61, default 32).
+/// Fewer means less repeated after a failed script; more means fewer DS2485 commands per pass.
+void OneWire_Set_SearchTripletsPerScript(int triplets)
+{
+    if (triplets < 1) triplets = 1;
+    if (triplets > SEARCH_TRIPLETS_MAX_PER_SCRIPT) triplets = SEARCH_TRIPLETS_MAX_PER_SCRIPT;
+    searchTripletsPerScript = triplets;
+}
+
+//--------------------------------------------------------------------------
+/// Start a host-side search for devices whose ROM ID begins with the first prefixBits bits of
+/// 'prefix' (prefix NULL and prefixBits 0: all devices). State is held by the caller; see OneWire_Search_Next.
+void OneWire_Search_Start(OneWire_search_state_T *state, uint8_t searchCode, const OneWire_ROM_ID_T *prefix, int prefixBits)
+{
+    memset(state, 0, sizeof(*state));
+    if (prefix) state->romid = *prefix;
+    state->prefixBits = prefixBits;
+    state->searchCode = searchCode;
+}
+
+//--------------------------------------------------------------------------
+/// Find the next device of a search begun with OneWire_Search_Start.
+/// A pass that fails (DS2485 error, ROM ID CRC8 mismatch, or a branch seen on the previous pass
+/// that no longer responds) is repeated from the same branch up to ONEWIRE_SEARCH_RETRIES times.
+/// If still failing the error is returned with state unchanged, so calling again resumes there
+/// rather than restarting the enumeration.
+/// Return 0: device found (romid set); 1: no more devices; otherwise error
+int OneWire_Search_Next(OneWire_search_state_T *state, OneWire_ROM_ID_T *romid)
+{
+    int error = 0;
+    OneWire_search_pass_T pass;
+
+    if (state->done) return 1;
+    for (int attempt = 0; attempt <= ONEWIRE_SEARCH_RETRIES; attempt++)
+    {
+        if (attempt) state->retries++;
+
+        // Path for this pass: keep bits before lastDiscrepancy, take the 1 branch at it, 0 afterwards
+        OneWire_ROM_ID_T path = state->romid;
+        for (int bit = state->prefixBits; bit < 64; bit++)
+        {
+            if (bit+1 == state->lastDiscrepancy) path.ID[bit/8] |= (1 << (bit%8));
+            else if (bit+1 > state->lastDiscrepancy) path.ID[bit/8] &= ~(1 << (bit%8));
+        }
+        if ((error = OneWire_SearchPass(&path, state->prefixBits, state->searchCode, &pass)) != 0) continue;
+        if (pass.noDevices || pass.divergedBit >= 0)
+        {
+            if (state->devicesFound == 0)
+            {
+                state->done = true; // nothing in this subtree
+                return 1;
+            }
+            error = RB_NOT_DETECTED; // previous pass saw devices on this branch: glitch
+            continue;
+        }
+        if (OneWire_CalculateCrc8(path.ID, 7) != path.ID[7])
+        {
+            error = RB_INCORRECT_CRC;
+            continue;
+        }
+
+        state->romid = path;
+        state->devicesFound++;
+        // Branches above the subtree root belong to other subtrees
+        state->lastDiscrepancy = (pass.lastZero > state->prefixBits) ? pass.lastZero : 0;
+        if (state->lastDiscrepancy == 0) state->done = true; // this was the last device
+        *romid = path;
+        return 0;
+    }
+    return error;
+}
+
+//--------------------------------------------------------------------------
+/// Find every device whose ROM ID starts with the first prefixBits bits of 'prefix',
+/// appending them to found[*foundCount] (at most foundMax entries in total).
+/// Only that subtree of the search is traversed: one pass per device found,
+/// or one pass if there is none.
+/// Return 0: no error; RB_TABLE_FULL: found[] filled up before the subtree was done
+int OneWire_SearchSubtree(const OneWire_ROM_ID_T *prefix, int prefixBits, uint8_t searchCode,
+                          OneWire_ROM_ID_T *found, int foundMax, int *foundCount)
+{
+    int error = 0;
+    OneWire_search_state_T state;
+
+    OneWire_Search_Start(&state, searchCode, prefix, prefixBits);
+    while (*foundCount < foundMax)
+    {
+        error = OneWire_Search_Next(&state, &found[*foundCount]);
+        if (error == 1) return 0; // subtree done
+        if (error) return error;
+        (*foundCount)++;
+    }
+    return state.done ? 0 : RB_TABLE_FULL;
+}
+
+//--------------------------------------------------------------------------
+/// Find devices on the 1-Wire bus and list them in 'table' (at most ONEWIRE_ROM_TABLE_MAX).
+/// searchCode: ONEWIRE_SEARCH_NORMAL, or ONEWIRE_SEARCH_CONDITIONAL to find only devices in alarm state.
+/// familyCode: ONEWIRE_FAMILY_ANY, or family code (first byte of ROM ID) of the only devices wanted.
+/// For a family search the family code bits are forced, so only that subtree of the search is traversed
+/// and time taken is proportional to the number of matching devices rather than all devices on the bus.
+/// Return 0: no error (table->count may be 0);
+/// RB_TABLE_FULL: more devices than the table holds, which lists the first ONEWIRE_ROM_TABLE_MAX (table->truncated set)
+int OneWire_SearchTable(OneWire_ROM_table_T *table, uint8_t searchCode, int familyCode)
+{
+    int error = 0;
+    int count = 0;
+
+    table->count = 0;
+    table->truncated = false;
+    if (familyCode == ONEWIRE_FAMILY_ANY)
+    {
+        // DS2485 on-chip search handles the whole tree
+        bool last_device_found = false;
+        while (!last_device_found)
+        {
+            OneWire_ROM_ID_T romid;
+            if (table->count == ONEWIRE_ROM_TABLE_MAX)
+            {
+                table->truncated = true;
+                return RB_TABLE_FULL;
+            }
+            error = DS2485_OneWireSearch(romid.ID, searchCode, /*reset=*/true, /*ignore=*/false, table->count == 0, &last_device_found);
+            if (error == RB_NOT_DETECTED) return 0; // no (more) devices
+            if (error) return error;
+            table->romID[table->count++] = romid;
+        }
+        return 0;
+    }
+
+    OneWire_ROM_ID_T prefix = { .ID = { (uint8_t)familyCode } };
+    error = OneWire_SearchSubtree(&prefix, 8, searchCode, table->romID, ONEWIRE_ROM_TABLE_MAX, &count);
+    table->count = count;
+    table->truncated = (error == RB_TABLE_FULL);
+    return error;
+}
 
 /* **** Primitive Commands Functions **** */
 void OneWire_Script_Clear(void)
@@ -226,12 +647,47 @@ void OneWire_Script_Clear(void)
     oneWireScript_accumulativeOneWireTime = 0;
     oneWireScript_commandsCount = 0;
     oneWireScriptResponse_length = 0;
+    scriptChangesSpeed = false;
+    scriptResets = 0;
+    memset(scriptBytesWritten, 0, sizeof(scriptBytesWritten));
+    memset(scriptBytesRead, 0, sizeof(scriptBytesRead));
+}
+
+// Add the script just run to the bus statistics; its traffic only if it succeeded
+static void countScript(int error)
+{
+    OneWire_Stats_Lock();
+    OneWire_bus_stats_T *stats = &oneWireBusStats[oneWireStatsBus];
+    if (error)
+    {
+        stats->scriptErrors++;
+    }
+    else
+    {
+        stats->scripts++;
+        stats->resets += scriptResets;
+        for (int spd = STANDARD; spd <= OVERDRIVE; spd++)
+        {
+            stats->bytesWritten[spd] += scriptBytesWritten[spd];
+            stats->bytesRead[spd] += scriptBytesRead[spd];
+        }
+    }
+    OneWire_Stats_Unlock();
 }
+
 int OneWire_Script_Execute(void)
 {
     int error = 0;
 
-    if((error = DS2485_OneWireScript(oneWireScript, oneWireScript_length, oneWireScript_accumulativeOneWireTime, oneWireScript_commandsCount, oneWireScriptResponse, oneWireScriptResponse_length)) != 0)
+    ONEWIRE_INSTR_BEGIN(instrStart);
+    error = DS2485_OneWireScript(oneWireScript, oneWireScript_length, oneWireScript_accumulativeOneWireTime, oneWireScript_commandsCount, oneWireScriptResponse, oneWireScriptResponse_length);
+    if (scriptChangesSpeed)
+    {
+        DS2485_InvalidatePortConfigShadow(); // even on error, the script may have run
+    }
+    ONEWIRE_INSTR_END(ONEWIRE_INSTR_SCRIPT_EXECUTE, instrStart);
+    countScript(error);
+    if(error != 0)
     {
         return error;
     }
@@ -297,6 +753,8 @@ int OneWire_Script_Add_OW_RESET(uint8_t *response_index, one_wire_speeds spd, bo
     //Add to total 1-Wire time
     oneWireScript_accumulativeOneWireTime += ow_rst_time;
 
+    scriptResets++;
+
     return error;
 }
 
@@ -491,6 +949,8 @@ int OneWire_Script_Add_OW_WRITE_BYTE(uint8_t *response_index, uint8_t txByte)
     //Add to total 1-Wire time
     oneWireScript_accumulativeOneWireTime += byte_time;
 
+    scriptBytesWritten[master_speed]++;
+
     return error;
 }
 
@@ -557,6 +1017,8 @@ int OneWire_Script_Add_OW_READ_BYTE(uint8_t *response_index)
     //Add to total 1-Wire time
     oneWireScript_accumulativeOneWireTime += byte_time;
 
+    scriptBytesRead[master_speed]++;
+
     return error;
 }
 
@@ -618,8 +1080,8 @@ int OneWire_Script_Add_OW_TRIPLET(uint8_t *response_index, bool t_value)
     //Calculate 1-Wire time
     t_slot = t_w0l + t_rec;
 
-    //Add to total 1-Wire time
-    oneWireScript_accumulativeOneWireTime += t_slot;
+    //Add to total 1-Wire time (triplet is 2 read slots and 1 write slot)
+    oneWireScript_accumulativeOneWireTime += 3 * t_slot;
 
     return error;
 }
@@ -627,6 +1089,7 @@ int OneWire_Script_Add_OW_TRIPLET(uint8_t *response_index, bool t_value)
 int OneWire_Script_Add_OV_SKIP(uint8_t *response_index)
 {
     int error = 0;
+    scriptChangesSpeed = true;
 
     // Delay variables
     double standard_ow_rst_time;
@@ -691,6 +1154,9 @@ int OneWire_Script_Add_OV_SKIP(uint8_t *response_index)
     //Add to total 1-Wire time
     oneWireScript_accumulativeOneWireTime += standard_ow_rst_time + byte_time + overdrive_ow_rst_time + 2000;
 
+    scriptResets += 2;
+    scriptBytesWritten[STANDARD]++;
+
     return error;
 }
 
@@ -749,6 +1215,9 @@ int OneWire_Script_Add_SKIP(uint8_t *response_index)
     //Add to total 1-Wire time
     oneWireScript_accumulativeOneWireTime += ow_rst_time + byte_time;
 
+    scriptResets++;
+    scriptBytesWritten[STANDARD]++;
+
     return error;
 }
 
@@ -815,6 +1284,8 @@ int OneWire_Script_Add_OW_READ_BLOCK(uint8_t *response_index, uint8_t rxBytes)
     //Add to total 1-Wire time
     oneWireScript_accumulativeOneWireTime += byte_time * rxBytes;
 
+    scriptBytesRead[master_speed] += rxBytes;
+
     return error;
 }
 
@@ -885,6 +1356,8 @@ int OneWire_Script_Add_OW_WRITE_BLOCK(uint8_t *response_index, const uint8_t *tx
     //Add to total 1-Wire time
     oneWireScript_accumulativeOneWireTime += byte_time * txData_length;
 
+    scriptBytesWritten[master_speed] += txData_length;
+
     return error;
 }
 
@@ -943,6 +1416,7 @@ void OneWire_Script_Add_SPU_OFF(void)
 int OneWire_Script_Add_SPEED(one_wire_speeds spd, bool ignore)
 {
     int error = 0;
+    scriptChangesSpeed = true;
 
     // Delay variables
     double ow_rst_time;
@@ -1474,2196 +1948,302 @@ int OneWire_Get_Custom_RPUP_BUF(vth_values *vth, viapo_values *viapo, rwpu_value
 }
 
 
-int OneWire_Set_tRSTL_Standard_Predefined(one_wire_timing_presets trstl)
-{
-    int error = 0;
-    uint8_t reg_data[2];
+/* **** 1-Wire timings **** */
 
-    reg_data[1] = 0x00;
-    reg_data[0] = trstl;
+// one_wire.h preset define in 62.5 ns units; every preset is an exact multiple of 62.5 ns
+#define TIMING_UNITS(us) ((uint16_t)((us) * 16))
+#define TIMING_PRESETS(t, spd) { \
+    TIMING_UNITS(t##_##spd##_PRESET_0), TIMING_UNITS(t##_##spd##_PRESET_1), \
+    TIMING_UNITS(t##_##spd##_PRESET_2), TIMING_UNITS(t##_##spd##_PRESET_3), \
+    TIMING_UNITS(t##_##spd##_PRESET_4), TIMING_UNITS(t##_##spd##_PRESET_5), \
+    TIMING_UNITS(t##_##spd##_PRESET_6), TIMING_UNITS(t##_##spd##_PRESET_7), \
+    TIMING_UNITS(t##_##spd##_PRESET_8), TIMING_UNITS(t##_##spd##_PRESET_9), \
+    TIMING_UNITS(t##_##spd##_PRESET_A), TIMING_UNITS(t##_##spd##_PRESET_B), \
+    TIMING_UNITS(t##_##spd##_PRESET_C), TIMING_UNITS(t##_##spd##_PRESET_D), \
+    TIMING_UNITS(t##_##spd##_PRESET_E), TIMING_UNITS(t##_##spd##_PRESET_F) }
+#define TIMING_CUSTOM 0x8000 // register bit 15: value is custom rather than a preset
 
-    if((error = DS2485_WriteOneWirePortConfig(STANDARD_SPEED_tRSTL, reg_data)) != 0)
-    {
-        return error;
-    }
+/// Preset timings in 62.5 ns units, indexed by [one_wire_timings][one_wire_speeds][one_wire_timing_presets]
+static const uint16_t timingPresets[ONEWIRE_TIMINGS][2][16] = {
+    [ONEWIRE_tRSTL] = { TIMING_PRESETS(tRSTL, STANDARD), TIMING_PRESETS(tRSTL, OVERDRIVE) },
+    [ONEWIRE_tMSI]  = { TIMING_PRESETS(tMSI,  STANDARD), TIMING_PRESETS(tMSI,  OVERDRIVE) },
+    [ONEWIRE_tMSP]  = { TIMING_PRESETS(tMSP,  STANDARD), TIMING_PRESETS(tMSP,  OVERDRIVE) },
+    [ONEWIRE_tRSTH] = { TIMING_PRESETS(tRSTH, STANDARD), TIMING_PRESETS(tRSTH, OVERDRIVE) },
+    [ONEWIRE_tW0L]  = { TIMING_PRESETS(tW0L,  STANDARD), TIMING_PRESETS(tW0L,  OVERDRIVE) },
+    [ONEWIRE_tW1L]  = { TIMING_PRESETS(tW1L,  STANDARD), TIMING_PRESETS(tW1L,  OVERDRIVE) },
+    [ONEWIRE_tMSR]  = { TIMING_PRESETS(tMSR,  STANDARD), TIMING_PRESETS(tMSR,  OVERDRIVE) },
+    [ONEWIRE_tREC]  = { TIMING_PRESETS(tREC,  STANDARD), TIMING_PRESETS(tREC,  OVERDRIVE) },
+};
 
-    return error;
+/// Largest custom timing in 62.5 ns units (DS2485 datasheet), indexed by [one_wire_timings][one_wire_speeds]
+static const uint16_t timingCustomMax[ONEWIRE_TIMINGS][2] = {
+    [ONEWIRE_tRSTL] = { TIMING_UNITS(1020),  TIMING_UNITS(126)    },
+    [ONEWIRE_tMSI]  = { TIMING_UNITS(15.5),  TIMING_UNITS(3.875)  },
+    [ONEWIRE_tMSP]  = { TIMING_UNITS(127),   TIMING_UNITS(15.5)   },
+    [ONEWIRE_tRSTH] = { TIMING_UNITS(1020),  TIMING_UNITS(126)    },
+    [ONEWIRE_tW0L]  = { TIMING_UNITS(126),   TIMING_UNITS(31.5)   },
+    [ONEWIRE_tW1L]  = { TIMING_UNITS(31.5),  TIMING_UNITS(1.9375) },
+    [ONEWIRE_tMSR]  = { TIMING_UNITS(31.5),  TIMING_UNITS(3.875)  },
+    [ONEWIRE_tREC]  = { TIMING_UNITS(255.5), TIMING_UNITS(255.5)  },
+};
+
+// DS2485 port configuration register holding a timing
+static DS2485_configuration_register_address_T timingRegister(one_wire_timings timing, one_wire_speeds spd)
+{
+    return (DS2485_configuration_register_address_T)((spd != STANDARD ? OVERDRIVE_SPEED_tRSTL : STANDARD_SPEED_tRSTL) + timing);
 }
-int OneWire_Set_tRSTL_Overdrive_Predefined(one_wire_timing_presets trstl)
+
+// Write a timing register value, LSB first
+static int writeTimingRegister(one_wire_timings timing, one_wire_speeds spd, uint16_t value)
 {
-    int error = 0;
     uint8_t reg_data[2];
 
-    reg_data[1] = 0x00;
-    reg_data[0] = trstl;
+    reg_data[0] = (uint8_t)value;
+    reg_data[1] = (uint8_t)(value >> 8);
+    return DS2485_WriteOneWirePortConfig(timingRegister(timing, spd), reg_data);
+}
 
-    if((error = DS2485_WriteOneWirePortConfig(OVERDRIVE_SPEED_tRSTL, reg_data)) != 0)
+int OneWire_Set_Timing_Predefined(one_wire_timings timing, one_wire_speeds spd, one_wire_timing_presets preset)
+{
+    if ((unsigned)timing >= ONEWIRE_TIMINGS || (unsigned)preset > PRESET_F)
     {
-        return error;
+        return RB_INVALID_PARAMETER;
     }
+    return writeTimingRegister(timing, spd, preset);
+}
 
-    return error;
+int OneWire_Set_Timing_Custom(one_wire_timings timing, one_wire_speeds spd, double usec)
+{
+    // written so that NaN fails the check
+    if ((unsigned)timing >= ONEWIRE_TIMINGS || !(usec >= 0 && usec * 16 <= timingCustomMax[timing][spd != STANDARD]))
+    {
+        return RB_INVALID_PARAMETER;
+    }
+    return writeTimingRegister(timing, spd, (uint16_t)(usec * 16) | TIMING_CUSTOM); // us -> 62.5 ns units, truncated
 }
-int OneWire_Set_tRSTL_Standard_Custom(double trstl)
+
+int OneWire_Get_Timing(one_wire_timings timing, one_wire_speeds spd, double *usec)
 {
     int error = 0;
     uint8_t reg_data[2];
+    uint16_t units;
 
-    if (trstl > 1020)
+    if ((unsigned)timing >= ONEWIRE_TIMINGS)
     {
-        return error = RB_INVALID_PARAMETER;
+        return RB_INVALID_PARAMETER;
     }
-
-    trstl *= 1000; //us -> ns
-    trstl /= (double)62.5;
-    trstl = ((int)trstl | 0x8000);
-    reg_data[0] = (uint8_t)trstl;
-    reg_data[1] = ((int)trstl >> 8);
-
-    if((error = DS2485_WriteOneWirePortConfig(STANDARD_SPEED_tRSTL, reg_data)) != 0)
+    if((error = DS2485_ReadOneWirePortConfig(timingRegister(timing, spd), reg_data)) != 0)
     {
         return error;
     }
 
-    return error;
-}
-int OneWire_Set_tRSTL_Overdrive_Custom(double trstl)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    if (trstl > 126)
+    if (reg_data[1] & (TIMING_CUSTOM >> 8))
     {
-        return error = RB_INVALID_PARAMETER;
+        units = ((reg_data[1] & 0x7F) << 8) | reg_data[0];
     }
-
-    trstl *= 1000; //us -> ns
-    trstl /= (double)62.5;
-    trstl = ((int)trstl | 0x8000);
-    reg_data[0] = (uint8_t)trstl;
-    reg_data[1] = ((int)trstl >> 8);
-
-    if((error = DS2485_WriteOneWirePortConfig(OVERDRIVE_SPEED_tRSTL, reg_data)) != 0)
+    else
     {
-        return error;
+        // an unknown preset code reads as PRESET_6, as before
+        units = timingPresets[timing][spd != STANDARD][reg_data[0] <= PRESET_F ? reg_data[0] : PRESET_6];
     }
+    *usec = units / 16.0;
 
     return error;
 }
-int OneWire_Get_tRSTL(double *trstl, one_wire_speeds spd)
+
+int OneWire_Init(void)
 {
     int error = 0;
-    uint8_t reg_data[2];
-    unsigned short value;
-
-    if(spd != STANDARD)  //Overdrive
-    {
-        if((error = DS2485_ReadOneWirePortConfig(OVERDRIVE_SPEED_tRSTL, reg_data)) != 0)
-        {
-            return error;
-        }
-
-        if((reg_data[1] >> 7) != 0) //custom value
-        {
 
-            value = ((reg_data[1] & ~(0x80)) << 8) | reg_data[0];
-            *trstl = (double)value;
-            *trstl *= (double)62.5;
-            *trstl /= 1000;
-        }
-        else //predefined value
-        {
-            switch(reg_data[0])
-            {
-            case PRESET_0:
-                *trstl = tRSTL_OVERDRIVE_PRESET_0;
-                break;
+    //Set standard and overdrive speed 1-Wire timings, and RPUP/BUF
+    error = OneWire_Apply_TimingProfile(&OneWire_DefaultTimingProfile);
+    if(error) return error;
 
-            case PRESET_1:
-                *trstl = tRSTL_OVERDRIVE_PRESET_1;
-                break;
+    //Set 1-Wire master speed to Standard
+    error = OneWire_Set_OneWireMasterSpeed(STANDARD);
+    if(error) return error;
+    
+    // DRN: Add SPU (strong pull-up) which might be needed before trying reset pulse?
+    // DS28E18 VDD_SENS (DS28E18 power to the sensor) requires 'Strong Pull-Up' 'SPU' on 1-Wire bus.
+    // That's turned on with DS2485 1-Wire Master Configuration (Register 0) Bit 13: Strong Pullup (SPU).
+    // But, we don't need this yet to talk to the DS28E18, as the sensor is not yet powered up.
+    //    error = OneWire_Enable_SPU(true); // DS2485 must provide strong power to 1-Wire bus
+    //    if(error) return error;
 
-            case PRESET_2:
-                *trstl = tRSTL_OVERDRIVE_PRESET_2;
-                break;
+    //Perform a 1-Wire Reset - This is very first script executed on the one-wire bus during initialization.
+    error = OneWire_ResetPulse();
+    if(error) return error;
 
-            case PRESET_3:
-                *trstl = tRSTL_OVERDRIVE_PRESET_3;
-                break;
+    return error;
+}
 
-            case PRESET_4:
-                *trstl = tRSTL_OVERDRIVE_PRESET_4;
-                break;
 
-            case PRESET_5:
-                *trstl = tRSTL_OVERDRIVE_PRESET_5;
-                break;
+/// Set every 1-Wire timing and RPUP/BUF from a profile.
+/// Only registers which differ from their current value are written to the DS2485.
+int OneWire_Apply_TimingProfile(const OneWire_timing_profile_T *profile)
+{
+    int error = 0;
 
-            case PRESET_6:
-                *trstl = tRSTL_OVERDRIVE_PRESET_6;
-                break;
+    for (int t = 0; t < ONEWIRE_TIMINGS; t++)
+    {
+        if (profile->standard[t] > PRESET_F || profile->overdrive[t] > PRESET_F) return RB_INVALID_PARAMETER;
+        if ((error = OneWire_Set_Timing_Predefined((one_wire_timings)t, STANDARD, (one_wire_timing_presets)profile->standard[t])) != 0) return error;
+        if ((error = OneWire_Set_Timing_Predefined((one_wire_timings)t, OVERDRIVE, (one_wire_timing_presets)profile->overdrive[t])) != 0) return error;
+    }
+    return OneWire_Set_Custom_RPUP_BUF(profile->vth, profile->viapo, profile->rwpu);
+}
 
-            case PRESET_7:
-                *trstl = tRSTL_OVERDRIVE_PRESET_7;
-                break;
 
-            case PRESET_8:
-                *trstl = tRSTL_OVERDRIVE_PRESET_8;
-                break;
+/* **** ROM ID table in DS2485 user memory **** */
 
-            case PRESET_9:
-                *trstl = tRSTL_OVERDRIVE_PRESET_9;
-                break;
+// Decode a stored table image; return 0 if valid, 1 if absent or corrupt
+static int parseRomTable(const uint8_t *image, int imageLength, OneWire_ROM_table_T *table)
+{
+    if (image[0] != 'O' || image[1] != 'W' || image[2] != ROM_TABLE_VERSION) return 1;
+    int count = image[3];
+    if (count > ONEWIRE_ROM_TABLE_SAVE_MAX || ROM_TABLE_IMAGE_SIZE(count) > imageLength) return 1;
+    int crcIdx = ROM_TABLE_IMAGE_SIZE(count) - 2;
+    unsigned int crc = OneWire_CalculateCrc16Block(image, crcIdx, 0);
+    if (image[crcIdx] != (crc & 0xFF) || image[crcIdx+1] != (crc >> 8)) return 1;
 
-            case PRESET_A:
-                *trstl = tRSTL_OVERDRIVE_PRESET_A;
-                break;
+    table->count = count;
+    table->truncated = false;
+    table->generation = (uint32_t)image[4] | (uint32_t)image[5]<<8 | (uint32_t)image[6]<<16 | (uint32_t)image[7]<<24;
+    memcpy(table->romID, &image[ROM_TABLE_HEADER_SIZE], 8*count);
+    return 0;
+}
 
-            case PRESET_B:
-                *trstl = tRSTL_OVERDRIVE_PRESET_B;
-                break;
+int OneWire_LoadRomTable(OneWire_ROM_table_T *table)
+{
+    int error = 0;
+    uint8_t image[ROM_TABLE_PAGES * ROM_TABLE_PAGE_SIZE];
 
-            case PRESET_C:
-                *trstl = tRSTL_OVERDRIVE_PRESET_C;
-                break;
+    // Read first page to learn the table size, then only the pages it occupies
+    error = DS2485_ReadMemory(ONEWIRE_ROM_TABLE_FIRST_PAGE, &image[0]);
+    if(error) return error;
+    int pages = (image[0] == 'O' && image[1] == 'W' && image[3] <= ONEWIRE_ROM_TABLE_SAVE_MAX) ? ROM_TABLE_PAGES_USED(image[3]) : 1;
+    for (int page = 1; page < pages; page++)
+    {
+        error = DS2485_ReadMemory(ONEWIRE_ROM_TABLE_FIRST_PAGE + page, &image[page * ROM_TABLE_PAGE_SIZE]);
+        if(error) return error;
+    }
+    return parseRomTable(image, pages * ROM_TABLE_PAGE_SIZE, table);
+}
 
-            case PRESET_D:
-                *trstl = tRSTL_OVERDRIVE_PRESET_D;
-                break;
+// Mark any stored table invalid, so a warm boot does not take it as the complete device list
+static int invalidateRomTable(void)
+{
+    int error = 0;
+    uint8_t image[ROM_TABLE_PAGE_SIZE];
 
-            case PRESET_E:
-                *trstl = tRSTL_OVERDRIVE_PRESET_E;
-                break;
+    error = DS2485_ReadMemory(ONEWIRE_ROM_TABLE_FIRST_PAGE, image);
+    if(error) return error;
+    if (image[0] != 'O') return 0;
+    image[0] = 0xFF;
+    return DS2485_WriteMemory(ONEWIRE_ROM_TABLE_FIRST_PAGE, image);
+}
 
-            case PRESET_F:
-                *trstl = tRSTL_OVERDRIVE_PRESET_F;
-                break;
+int OneWire_SaveRomTable(OneWire_ROM_table_T *table)
+{
+    int error = 0;
+    uint8_t stored[ROM_TABLE_PAGES * ROM_TABLE_PAGE_SIZE];
+    uint8_t image[ROM_TABLE_PAGES * ROM_TABLE_PAGE_SIZE];
+    OneWire_ROM_table_T storedTable;
 
-            default:
-                *trstl = tRSTL_OVERDRIVE_PRESET_6;
-                break;
-            }
-        }
-    }
-    else //Standard
-    {
-        if((error = DS2485_ReadOneWirePortConfig(STANDARD_SPEED_tRSTL, reg_data)) != 0)
-        {
-            return error;
-        }
-
-        if((reg_data[1] >> 7) != 0) //Custom Value
-        {
-            value = ((reg_data[1] & ~(0x80)) << 8) | reg_data[0];
-            *trstl = (double)value;
-            *trstl *= (double)62.5;
-            *trstl /= 1000;
-        }
-        else //Predefined value
-        {
-            switch(reg_data[0])
-            {
-            case PRESET_0:
-                *trstl = tRSTL_STANDARD_PRESET_0;
-                break;
-
-            case PRESET_1:
-                *trstl = tRSTL_STANDARD_PRESET_1;
-                break;
-
-            case PRESET_2:
-                *trstl = tRSTL_STANDARD_PRESET_2;
-                break;
-
-            case PRESET_3:
-                *trstl = tRSTL_STANDARD_PRESET_3;
-                break;
-
-            case PRESET_4:
-                *trstl = tRSTL_STANDARD_PRESET_4;
-                break;
-
-            case PRESET_5:
-                *trstl = tRSTL_STANDARD_PRESET_5;
-                break;
-
-            case PRESET_6:
-                *trstl = tRSTL_STANDARD_PRESET_6;
-                break;
-
-            case PRESET_7:
-                *trstl = tRSTL_STANDARD_PRESET_7;
-                break;
-
-            case PRESET_8:
-                *trstl = tRSTL_STANDARD_PRESET_8;
-                break;
-
-            case PRESET_9:
-                *trstl = tRSTL_STANDARD_PRESET_9;
-                break;
-
-            case PRESET_A:
-                *trstl = tRSTL_STANDARD_PRESET_A;
-                break;
-
-            case PRESET_B:
-                *trstl = tRSTL_STANDARD_PRESET_B;
-                break;
-
-            case PRESET_C:
-                *trstl = tRSTL_STANDARD_PRESET_C;
-                break;
-
-            case PRESET_D:
-                *trstl = tRSTL_STANDARD_PRESET_D;
-                break;
-
-            case PRESET_E:
-                *trstl = tRSTL_STANDARD_PRESET_E;
-                break;
-
-            case PRESET_F:
-                *trstl = tRSTL_STANDARD_PRESET_F;
-                break;
-
-            default:
-                *trstl = tRSTL_STANDARD_PRESET_6;
-                break;
-            }
-        }
-    }
-
-    return error;
-}
-int OneWire_Set_tRSTH_Standard_Predefined(one_wire_timing_presets trsth)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    reg_data[1] = 0x00;
-    reg_data[0] = trsth;
-
-    if((error = DS2485_WriteOneWirePortConfig(STANDARD_SPEED_tRSTH, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Set_tRSTH_Overdrive_Predefined(one_wire_timing_presets trsth)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    reg_data[1] = 0x00;
-    reg_data[0] = trsth;
-
-    if((error = DS2485_WriteOneWirePortConfig(OVERDRIVE_SPEED_tRSTH, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Set_tRSTH_Standard_Custom(double trsth)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    if (trsth > 1020)
-    {
-        return error = RB_INVALID_PARAMETER;
-    }
-
-    trsth *= 1000; //us -> ns
-    trsth /= (double)62.5;
-    trsth = ((int)trsth | 0x8000);
-    reg_data[0] = (uint8_t)trsth;
-    reg_data[1] = ((int)trsth >> 8);
-
-    if((error = DS2485_WriteOneWirePortConfig(STANDARD_SPEED_tRSTH, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Set_tRSTH_Overdrive_Custom(double trsth)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    if (trsth > 126)
-    {
-        return error = RB_INVALID_PARAMETER;
-    }
-
-    trsth *= 1000; //us -> ns
-    trsth /= (double)62.5;
-    trsth = ((int)trsth | 0x8000);
-    reg_data[0] = (uint8_t)trsth;
-    reg_data[1] = ((int)trsth >> 8);
-
-    if((error = DS2485_WriteOneWirePortConfig(OVERDRIVE_SPEED_tRSTH, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Get_tRSTH(double *trsth, one_wire_speeds spd)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-    unsigned short value;
-
-    if(spd != STANDARD)  //Overdrive
-    {
-        if((error = DS2485_ReadOneWirePortConfig(OVERDRIVE_SPEED_tRSTH, reg_data)) != 0)
-        {
-            return error;
-        }
-
-        if((reg_data[1] >> 7) != 0) //custom value
-        {
-
-            value = ((reg_data[1] & ~(0x80)) << 8) | reg_data[0];
-            *trsth = (double)value;
-            *trsth *= (double)62.5;
-            *trsth /= 1000;
-        }
-        else //predefined value
-        {
-            switch(reg_data[0])
-            {
-            case PRESET_0:
-                *trsth = tRSTH_OVERDRIVE_PRESET_0;
-                break;
-
-            case PRESET_1:
-                *trsth = tRSTH_OVERDRIVE_PRESET_1;
-                break;
-
-            case PRESET_2:
-                *trsth = tRSTH_OVERDRIVE_PRESET_2;
-                break;
-
-            case PRESET_3:
-                *trsth = tRSTH_OVERDRIVE_PRESET_3;
-                break;
-
-            case PRESET_4:
-                *trsth = tRSTH_OVERDRIVE_PRESET_4;
-                break;
-
-            case PRESET_5:
-                *trsth = tRSTH_OVERDRIVE_PRESET_5;
-                break;
-
-            case PRESET_6:
-                *trsth = tRSTH_OVERDRIVE_PRESET_6;
-                break;
-
-            case PRESET_7:
-                *trsth = tRSTH_OVERDRIVE_PRESET_7;
-                break;
-
-            case PRESET_8:
-                *trsth = tRSTH_OVERDRIVE_PRESET_8;
-                break;
-
-            case PRESET_9:
-                *trsth = tRSTH_OVERDRIVE_PRESET_9;
-                break;
-
-            case PRESET_A:
-                *trsth = tRSTH_OVERDRIVE_PRESET_A;
-                break;
-
-            case PRESET_B:
-                *trsth = tRSTH_OVERDRIVE_PRESET_B;
-                break;
-
-            case PRESET_C:
-                *trsth = tRSTH_OVERDRIVE_PRESET_C;
-                break;
-
-            case PRESET_D:
-                *trsth = tRSTH_OVERDRIVE_PRESET_D;
-                break;
-
-            case PRESET_E:
-                *trsth = tRSTH_OVERDRIVE_PRESET_E;
-                break;
-
-            case PRESET_F:
-                *trsth = tRSTH_OVERDRIVE_PRESET_F;
-                break;
-
-            default:
-                *trsth = tRSTH_OVERDRIVE_PRESET_6;
-                break;
-            }
-        }
-    }
-    else //Standard
-    {
-        if((error = DS2485_ReadOneWirePortConfig(STANDARD_SPEED_tRSTH, reg_data)) != 0)
-        {
-            return error;
-        }
-
-        if((reg_data[1] >> 7) != 0) //Custom Value
-        {
-            value = ((reg_data[1] & ~(0x80)) << 8) | reg_data[0];
-            *trsth = (double)value;
-            *trsth *= (double)62.5;
-            *trsth /= 1000;
-        }
-        else //Predefined value
-        {
-            switch(reg_data[0])
-            {
-            case PRESET_0:
-                *trsth = tRSTH_STANDARD_PRESET_0;
-                break;
-
-            case PRESET_1:
-                *trsth = tRSTH_STANDARD_PRESET_1;
-                break;
-
-            case PRESET_2:
-                *trsth = tRSTH_STANDARD_PRESET_2;
-                break;
-
-            case PRESET_3:
-                *trsth = tRSTH_STANDARD_PRESET_3;
-                break;
-
-            case PRESET_4:
-                *trsth = tRSTH_STANDARD_PRESET_4;
-                break;
-
-            case PRESET_5:
-                *trsth = tRSTH_STANDARD_PRESET_5;
-                break;
-
-            case PRESET_6:
-                *trsth = tRSTH_STANDARD_PRESET_6;
-                break;
-
-            case PRESET_7:
-                *trsth = tRSTH_STANDARD_PRESET_7;
-                break;
-
-            case PRESET_8:
-                *trsth = tRSTH_STANDARD_PRESET_8;
-                break;
-
-            case PRESET_9:
-                *trsth = tRSTH_STANDARD_PRESET_9;
-                break;
-
-            case PRESET_A:
-                *trsth = tRSTH_STANDARD_PRESET_A;
-                break;
-
-            case PRESET_B:
-                *trsth = tRSTH_STANDARD_PRESET_B;
-                break;
-
-            case PRESET_C:
-                *trsth = tRSTH_STANDARD_PRESET_C;
-                break;
-
-            case PRESET_D:
-                *trsth = tRSTH_STANDARD_PRESET_D;
-                break;
-
-            case PRESET_E:
-                *trsth = tRSTH_STANDARD_PRESET_E;
-                break;
-
-            case PRESET_F:
-                *trsth = tRSTH_STANDARD_PRESET_F;
-                break;
-
-            default:
-                *trsth = tRSTH_STANDARD_PRESET_6;
-                break;
-            }
-        }
-    }
-
-    return error;
-}
-int OneWire_Set_tW0L_Standard_Predefined(one_wire_timing_presets tw0l)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    reg_data[1] = 0x00;
-    reg_data[0] = tw0l;
-
-    if((error = DS2485_WriteOneWirePortConfig(STANDARD_SPEED_tW0L, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Set_tW0L_Overdrive_Predefined(one_wire_timing_presets tw0l)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    reg_data[1] = 0x00;
-    reg_data[0] = tw0l;
-
-    if((error = DS2485_WriteOneWirePortConfig(OVERDRIVE_SPEED_tW0L, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Set_tW0L_Standard_Custom(double tw0l)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    if (tw0l > 126)
-    {
-        return error = RB_INVALID_PARAMETER;
-    }
-
-    tw0l *= 1000; //us -> ns
-    tw0l /= (double)62.5;
-    tw0l = ((int)tw0l | 0x8000);
-    reg_data[0] = (uint8_t)tw0l;
-    reg_data[1] = ((int)tw0l >> 8);
-
-    if((error = DS2485_WriteOneWirePortConfig(STANDARD_SPEED_tW0L, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Set_tW0L_Overdrive_Custom(double tw0l)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    if (tw0l > (double)31.5)
-    {
-        return error = RB_INVALID_PARAMETER;
-    }
-
-    tw0l *= 1000; //us -> ns
-    tw0l /= (double)62.5;
-    tw0l = ((int)tw0l | 0x8000);
-    reg_data[0] = (uint8_t)tw0l;
-    reg_data[1] = ((int)tw0l >> 8);
-
-    if((error = DS2485_WriteOneWirePortConfig(OVERDRIVE_SPEED_tW0L, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Get_tW0L(double *tw0l, one_wire_speeds spd)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-    unsigned short value;
-
-    if(spd != STANDARD)  //Overdrive
-    {
-        if((error = DS2485_ReadOneWirePortConfig(OVERDRIVE_SPEED_tW0L, reg_data)) != 0)
-        {
-            return error;
-        }
-
-        if((reg_data[1] >> 7) != 0) //custom value
-        {
-
-            value = ((reg_data[1] & ~(0x80)) << 8) | reg_data[0];
-            *tw0l = (double)value;
-            *tw0l *= (double)62.5;
-            *tw0l /= 1000;
-        }
-        else //predefined value
-        {
-            switch(reg_data[0])
-            {
-            case PRESET_0:
-                *tw0l = tW0L_OVERDRIVE_PRESET_0;
-                break;
-
-            case PRESET_1:
-                *tw0l = tW0L_OVERDRIVE_PRESET_1;
-                break;
-
-            case PRESET_2:
-                *tw0l = tW0L_OVERDRIVE_PRESET_2;
-                break;
-
-            case PRESET_3:
-                *tw0l = tW0L_OVERDRIVE_PRESET_3;
-                break;
-
-            case PRESET_4:
-                *tw0l = tW0L_OVERDRIVE_PRESET_4;
-                break;
-
-            case PRESET_5:
-                *tw0l = tW0L_OVERDRIVE_PRESET_5;
-                break;
-
-            case PRESET_6:
-                *tw0l = tW0L_OVERDRIVE_PRESET_6;
-                break;
-
-            case PRESET_7:
-                *tw0l = tW0L_OVERDRIVE_PRESET_7;
-                break;
-
-            case PRESET_8:
-                *tw0l = tW0L_OVERDRIVE_PRESET_8;
-                break;
-
-            case PRESET_9:
-                *tw0l = tW0L_OVERDRIVE_PRESET_9;
-                break;
-
-            case PRESET_A:
-                *tw0l = tW0L_OVERDRIVE_PRESET_A;
-                break;
-
-            case PRESET_B:
-                *tw0l = tW0L_OVERDRIVE_PRESET_B;
-                break;
-
-            case PRESET_C:
-                *tw0l = tW0L_OVERDRIVE_PRESET_C;
-                break;
-
-            case PRESET_D:
-                *tw0l = tW0L_OVERDRIVE_PRESET_D;
-                break;
-
-            case PRESET_E:
-                *tw0l = tW0L_OVERDRIVE_PRESET_E;
-                break;
-
-            case PRESET_F:
-                *tw0l = tW0L_OVERDRIVE_PRESET_F;
-                break;
-
-            default:
-                *tw0l = tW0L_OVERDRIVE_PRESET_6;
-                break;
-            }
-        }
-    }
-    else //Standard
-    {
-        if((error = DS2485_ReadOneWirePortConfig(STANDARD_SPEED_tW0L, reg_data)) != 0)
-        {
-            return error;
-        }
-
-        if((reg_data[1] >> 7) != 0) //Custom Value
-        {
-            value = ((reg_data[1] & ~(0x80)) << 8) | reg_data[0];
-            *tw0l = (double)value;
-            *tw0l *= (double)62.5;
-            *tw0l /= 1000;
-        }
-        else //Predefined value
-        {
-            switch(reg_data[0])
-            {
-            case PRESET_0:
-                *tw0l = tW0L_STANDARD_PRESET_0;
-                break;
-
-            case PRESET_1:
-                *tw0l = tW0L_STANDARD_PRESET_1;
-                break;
-
-            case PRESET_2:
-                *tw0l = tW0L_STANDARD_PRESET_2;
-                break;
-
-            case PRESET_3:
-                *tw0l = tW0L_STANDARD_PRESET_3;
-                break;
-
-            case PRESET_4:
-                *tw0l = tW0L_STANDARD_PRESET_4;
-                break;
-
-            case PRESET_5:
-                *tw0l = tW0L_STANDARD_PRESET_5;
-                break;
-
-            case PRESET_6:
-                *tw0l = tW0L_STANDARD_PRESET_6;
-                break;
-
-            case PRESET_7:
-                *tw0l = tW0L_STANDARD_PRESET_7;
-                break;
-
-            case PRESET_8:
-                *tw0l = tW0L_STANDARD_PRESET_8;
-                break;
-
-            case PRESET_9:
-                *tw0l = tW0L_STANDARD_PRESET_9;
-                break;
-
-            case PRESET_A:
-                *tw0l = tW0L_STANDARD_PRESET_A;
-                break;
-
-            case PRESET_B:
-                *tw0l = tW0L_STANDARD_PRESET_B;
-                break;
-
-            case PRESET_C:
-                *tw0l = tW0L_STANDARD_PRESET_C;
-                break;
-
-            case PRESET_D:
-                *tw0l = tW0L_STANDARD_PRESET_D;
-                break;
-
-            case PRESET_E:
-                *tw0l = tW0L_STANDARD_PRESET_E;
-                break;
-
-            case PRESET_F:
-                *tw0l = tW0L_STANDARD_PRESET_F;
-                break;
-
-            default:
-                *tw0l = tW0L_STANDARD_PRESET_6;
-                break;
-            }
-        }
-    }
-
-    return error;
-}
-int OneWire_Set_tREC_Standard_Predefined(one_wire_timing_presets trec)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    reg_data[1] = 0x00;
-    reg_data[0] = trec;
-
-    if((error = DS2485_WriteOneWirePortConfig(STANDARD_SPEED_tREC, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Set_tREC_Overdrive_Predefined(one_wire_timing_presets trec)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    reg_data[1] = 0x00;
-    reg_data[0] = trec;
-
-    if((error = DS2485_WriteOneWirePortConfig(OVERDRIVE_SPEED_tREC, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Set_tREC_Standard_Custom(double trec)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    if (trec > (double)255.5)
-    {
-        return error = RB_INVALID_PARAMETER;
-    }
-
-    trec *= 1000; //us -> ns
-    trec /= (double)62.5;
-    trec = ((int)trec | 0x8000);
-    reg_data[0] = (uint8_t)trec;
-    reg_data[1] = ((int)trec >> 8);
-
-    if((error = DS2485_WriteOneWirePortConfig(STANDARD_SPEED_tREC, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Set_tREC_Overdrive_Custom(double trec)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    if (trec > (double)255.5)
-    {
-        return error = RB_INVALID_PARAMETER;
-    }
-
-    trec *= 1000; //us -> ns
-    trec /= (double)62.5;
-    trec = ((int)trec | 0x8000);
-    reg_data[0] = (uint8_t)trec;
-    reg_data[1] = ((int)trec >> 8);
-
-    if((error = DS2485_WriteOneWirePortConfig(OVERDRIVE_SPEED_tREC, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Get_tREC(double *trec, one_wire_speeds spd)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-    unsigned short value;
-
-    if(spd != STANDARD)  //Overdrive
-    {
-        if((error = DS2485_ReadOneWirePortConfig(OVERDRIVE_SPEED_tREC, reg_data)) != 0)
-        {
-            return error;
-        }
-
-        if((reg_data[1] >> 7) != 0) //custom value
-        {
-
-            value = ((reg_data[1] & ~(0x80)) << 8) | reg_data[0];
-            *trec = (double)value;
-            *trec *= (double)62.5;
-            *trec /= 1000;
-        }
-        else //predefined value
-        {
-            switch(reg_data[0])
-            {
-            case PRESET_0:
-                *trec = tREC_OVERDRIVE_PRESET_0;
-                break;
-
-            case PRESET_1:
-                *trec = tREC_OVERDRIVE_PRESET_1;
-                break;
-
-            case PRESET_2:
-                *trec = tREC_OVERDRIVE_PRESET_2;
-                break;
-
-            case PRESET_3:
-                *trec = tREC_OVERDRIVE_PRESET_3;
-                break;
-
-            case PRESET_4:
-                *trec = tREC_OVERDRIVE_PRESET_4;
-                break;
-
-            case PRESET_5:
-                *trec = tREC_OVERDRIVE_PRESET_5;
-                break;
-
-            case PRESET_6:
-                *trec = tREC_OVERDRIVE_PRESET_6;
-                break;
-
-            case PRESET_7:
-                *trec = tREC_OVERDRIVE_PRESET_7;
-                break;
-
-            case PRESET_8:
-                *trec = tREC_OVERDRIVE_PRESET_8;
-                break;
-
-            case PRESET_9:
-                *trec = tREC_OVERDRIVE_PRESET_9;
-                break;
-
-            case PRESET_A:
-                *trec = tREC_OVERDRIVE_PRESET_A;
-                break;
-
-            case PRESET_B:
-                *trec = tREC_OVERDRIVE_PRESET_B;
-                break;
-
-            case PRESET_C:
-                *trec = tREC_OVERDRIVE_PRESET_C;
-                break;
-
-            case PRESET_D:
-                *trec = tREC_OVERDRIVE_PRESET_D;
-                break;
-
-            case PRESET_E:
-                *trec = tREC_OVERDRIVE_PRESET_E;
-                break;
-
-            case PRESET_F:
-                *trec = tREC_OVERDRIVE_PRESET_F;
-                break;
-
-            default:
-                *trec = tREC_OVERDRIVE_PRESET_6;
-                break;
-            }
-        }
-    }
-    else //Standard
-    {
-        if((error = DS2485_ReadOneWirePortConfig(STANDARD_SPEED_tREC, reg_data)) != 0)
-        {
-            return error;
-        }
-
-        if((reg_data[1] >> 7) != 0) //Custom Value
-        {
-            value = ((reg_data[1] & ~(0x80)) << 8) | reg_data[0];
-            *trec = (double)value;
-            *trec *= (double)62.5;
-            *trec /= 1000;
-        }
-        else //Predefined value
-        {
-            switch(reg_data[0])
-            {
-            case PRESET_0:
-                *trec = tREC_STANDARD_PRESET_0;
-                break;
-
-            case PRESET_1:
-                *trec = tREC_STANDARD_PRESET_1;
-                break;
-
-            case PRESET_2:
-                *trec = tREC_STANDARD_PRESET_2;
-                break;
-
-            case PRESET_3:
-                *trec = tREC_STANDARD_PRESET_3;
-                break;
-
-            case PRESET_4:
-                *trec = tREC_STANDARD_PRESET_4;
-                break;
-
-            case PRESET_5:
-                *trec = tREC_STANDARD_PRESET_5;
-                break;
-
-            case PRESET_6:
-                *trec = tREC_STANDARD_PRESET_6;
-                break;
-
-            case PRESET_7:
-                *trec = tREC_STANDARD_PRESET_7;
-                break;
-
-            case PRESET_8:
-                *trec = tREC_STANDARD_PRESET_8;
-                break;
-
-            case PRESET_9:
-                *trec = tREC_STANDARD_PRESET_9;
-                break;
-
-            case PRESET_A:
-                *trec = tREC_STANDARD_PRESET_A;
-                break;
-
-            case PRESET_B:
-                *trec = tREC_STANDARD_PRESET_B;
-                break;
-
-            case PRESET_C:
-                *trec = tREC_STANDARD_PRESET_C;
-                break;
-
-            case PRESET_D:
-                *trec = tREC_STANDARD_PRESET_D;
-                break;
-
-            case PRESET_E:
-                *trec = tREC_STANDARD_PRESET_E;
-                break;
-
-            case PRESET_F:
-                *trec = tREC_STANDARD_PRESET_F;
-                break;
-
-            default:
-                *trec = tREC_STANDARD_PRESET_6;
-                break;
-            }
-        }
-    }
-
-    return error;
-}
-
-int OneWire_Set_tMSI_Standard_Predefined(one_wire_timing_presets tmsi)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    reg_data[1] = 0x00;
-    reg_data[0] = tmsi;
-
-    if((error = DS2485_WriteOneWirePortConfig(STANDARD_SPEED_tMSI, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Set_tMSI_Overdrive_Predefined(one_wire_timing_presets tmsi)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    reg_data[1] = 0x00;
-    reg_data[0] = tmsi;
-
-    if((error = DS2485_WriteOneWirePortConfig(OVERDRIVE_SPEED_tMSI, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Set_tMSI_Standard_Custom(double tmsi)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    if (tmsi > (double)255.5)
-    {
-        return error = RB_INVALID_PARAMETER;
-    }
-
-    tmsi *= 1000; //us -> ns
-    tmsi /= (double)62.5;
-    tmsi = ((int)tmsi | 0x8000);
-    reg_data[0] = (uint8_t)tmsi;
-    reg_data[1] = ((int)tmsi >> 8);
-
-    if((error = DS2485_WriteOneWirePortConfig(STANDARD_SPEED_tMSI, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Set_tMSI_Overdrive_Custom(double tmsi)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    if (tmsi > (double)255.5)
-    {
-        return error = RB_INVALID_PARAMETER;
-    }
-
-    tmsi *= 1000; //us -> ns
-    tmsi /= (double)62.5;
-    tmsi = ((int)tmsi | 0x8000);
-    reg_data[0] = (uint8_t)tmsi;
-    reg_data[1] = ((int)tmsi >> 8);
-
-    if((error = DS2485_WriteOneWirePortConfig(OVERDRIVE_SPEED_tMSI, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Get_tMSI(double *tmsi, one_wire_speeds spd)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-    unsigned short value;
-
-    if(spd != STANDARD)  //Overdrive
-    {
-        if((error = DS2485_ReadOneWirePortConfig(OVERDRIVE_SPEED_tMSI, reg_data)) != 0)
-        {
-            return error;
-        }
-
-        if((reg_data[1] >> 7) != 0) //custom value
-        {
-
-            value = ((reg_data[1] & ~(0x80)) << 8) | reg_data[0];
-            *tmsi = (double)value;
-            *tmsi *= (double)62.5;
-            *tmsi /= 1000;
-        }
-        else //predefined value
-        {
-            switch(reg_data[0])
-            {
-            case PRESET_0:
-                *tmsi = tMSI_OVERDRIVE_PRESET_0;
-                break;
-
-            case PRESET_1:
-                *tmsi = tMSI_OVERDRIVE_PRESET_1;
-                break;
-
-            case PRESET_2:
-                *tmsi = tMSI_OVERDRIVE_PRESET_2;
-                break;
-
-            case PRESET_3:
-                *tmsi = tMSI_OVERDRIVE_PRESET_3;
-                break;
-
-            case PRESET_4:
-                *tmsi = tMSI_OVERDRIVE_PRESET_4;
-                break;
-
-            case PRESET_5:
-                *tmsi = tMSI_OVERDRIVE_PRESET_5;
-                break;
-
-            case PRESET_6:
-                *tmsi = tMSI_OVERDRIVE_PRESET_6;
-                break;
-
-            case PRESET_7:
-                *tmsi = tMSI_OVERDRIVE_PRESET_7;
-                break;
-
-            case PRESET_8:
-                *tmsi = tMSI_OVERDRIVE_PRESET_8;
-                break;
-
-            case PRESET_9:
-                *tmsi = tMSI_OVERDRIVE_PRESET_9;
-                break;
-
-            case PRESET_A:
-                *tmsi = tMSI_OVERDRIVE_PRESET_A;
-                break;
-
-            case PRESET_B:
-                *tmsi = tMSI_OVERDRIVE_PRESET_B;
-                break;
-
-            case PRESET_C:
-                *tmsi = tMSI_OVERDRIVE_PRESET_C;
-                break;
-
-            case PRESET_D:
-                *tmsi = tMSI_OVERDRIVE_PRESET_D;
-                break;
-
-            case PRESET_E:
-                *tmsi = tMSI_OVERDRIVE_PRESET_E;
-                break;
-
-            case PRESET_F:
-                *tmsi = tMSI_OVERDRIVE_PRESET_F;
-                break;
-
-            default:
-                *tmsi = tMSI_OVERDRIVE_PRESET_6;
-                break;
-            }
-        }
-    }
-    else //Standard
-    {
-        if((error = DS2485_ReadOneWirePortConfig(STANDARD_SPEED_tMSI, reg_data)) != 0)
-        {
-            return error;
-        }
-
-        if((reg_data[1] >> 7) != 0) //Custom Value
-        {
-            value = ((reg_data[1] & ~(0x80)) << 8) | reg_data[0];
-            *tmsi = (double)value;
-            *tmsi *= (double)62.5;
-            *tmsi /= 1000;
-        }
-        else //Predefined value
-        {
-            switch(reg_data[0])
-            {
-            case PRESET_0:
-                *tmsi = tMSI_STANDARD_PRESET_0;
-                break;
-
-            case PRESET_1:
-                *tmsi = tMSI_STANDARD_PRESET_1;
-                break;
-
-            case PRESET_2:
-                *tmsi = tMSI_STANDARD_PRESET_2;
-                break;
-
-            case PRESET_3:
-                *tmsi = tMSI_STANDARD_PRESET_3;
-                break;
-
-            case PRESET_4:
-                *tmsi = tMSI_STANDARD_PRESET_4;
-                break;
-
-            case PRESET_5:
-                *tmsi = tMSI_STANDARD_PRESET_5;
-                break;
-
-            case PRESET_6:
-                *tmsi = tMSI_STANDARD_PRESET_6;
-                break;
-
-            case PRESET_7:
-                *tmsi = tMSI_STANDARD_PRESET_7;
-                break;
-
-            case PRESET_8:
-                *tmsi = tMSI_STANDARD_PRESET_8;
-                break;
-
-            case PRESET_9:
-                *tmsi = tMSI_STANDARD_PRESET_9;
-                break;
-
-            case PRESET_A:
-                *tmsi = tMSI_STANDARD_PRESET_A;
-                break;
-
-            case PRESET_B:
-                *tmsi = tMSI_STANDARD_PRESET_B;
-                break;
-
-            case PRESET_C:
-                *tmsi = tMSI_STANDARD_PRESET_C;
-                break;
-
-            case PRESET_D:
-                *tmsi = tMSI_STANDARD_PRESET_D;
-                break;
-
-            case PRESET_E:
-                *tmsi = tMSI_STANDARD_PRESET_E;
-                break;
-
-            case PRESET_F:
-                *tmsi = tMSI_STANDARD_PRESET_F;
-                break;
-
-            default:
-                *tmsi = tMSI_STANDARD_PRESET_6;
-                break;
-            }
-        }
-    }
-
-    return error;
-}
-
-int OneWire_Set_tMSP_Standard_Predefined(one_wire_timing_presets tmsp)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    reg_data[1] = 0x00;
-    reg_data[0] = tmsp;
-
-    if((error = DS2485_WriteOneWirePortConfig(STANDARD_SPEED_tMSP, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Set_tMSP_Overdrive_Predefined(one_wire_timing_presets tmsp)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    reg_data[1] = 0x00;
-    reg_data[0] = tmsp;
-
-    if((error = DS2485_WriteOneWirePortConfig(OVERDRIVE_SPEED_tMSP, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Set_tMSP_Standard_Custom(double tmsp)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    if (tmsp > (double)255.5)
-    {
-        return error = RB_INVALID_PARAMETER;
-    }
-
-    tmsp *= 1000; //us -> ns
-    tmsp /= (double)62.5;
-    tmsp = ((int)tmsp | 0x8000);
-    reg_data[0] = (uint8_t)tmsp;
-    reg_data[1] = ((int)tmsp >> 8);
-
-    if((error = DS2485_WriteOneWirePortConfig(STANDARD_SPEED_tMSP, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Set_tMSP_Overdrive_Custom(double tmsp)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    if (tmsp > (double)255.5)
-    {
-        return error = RB_INVALID_PARAMETER;
-    }
-
-    tmsp *= 1000; //us -> ns
-    tmsp /= (double)62.5;
-    tmsp = ((int)tmsp | 0x8000);
-    reg_data[0] = (uint8_t)tmsp;
-    reg_data[1] = ((int)tmsp >> 8);
-
-    if((error = DS2485_WriteOneWirePortConfig(OVERDRIVE_SPEED_tMSP, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Get_tMSP(double *tmsp, one_wire_speeds spd)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-    unsigned short value;
-
-    if(spd != STANDARD)  //Overdrive
-    {
-        if((error = DS2485_ReadOneWirePortConfig(OVERDRIVE_SPEED_tMSP, reg_data)) != 0)
-        {
-            return error;
-        }
-
-        if((reg_data[1] >> 7) != 0) //custom value
-        {
-
-            value = ((reg_data[1] & ~(0x80)) << 8) | reg_data[0];
-            *tmsp = (double)value;
-            *tmsp *= (double)62.5;
-            *tmsp /= 1000;
-        }
-        else //predefined value
-        {
-            switch(reg_data[0])
-            {
-            case PRESET_0:
-                *tmsp = tMSP_OVERDRIVE_PRESET_0;
-                break;
-
-            case PRESET_1:
-                *tmsp = tMSP_OVERDRIVE_PRESET_1;
-                break;
-
-            case PRESET_2:
-                *tmsp = tMSP_OVERDRIVE_PRESET_2;
-                break;
-
-            case PRESET_3:
-                *tmsp = tMSP_OVERDRIVE_PRESET_3;
-                break;
-
-            case PRESET_4:
-                *tmsp = tMSP_OVERDRIVE_PRESET_4;
-                break;
-
-            case PRESET_5:
-                *tmsp = tMSP_OVERDRIVE_PRESET_5;
-                break;
-
-            case PRESET_6:
-                *tmsp = tMSP_OVERDRIVE_PRESET_6;
-                break;
-
-            case PRESET_7:
-                *tmsp = tMSP_OVERDRIVE_PRESET_7;
-                break;
-
-            case PRESET_8:
-                *tmsp = tMSP_OVERDRIVE_PRESET_8;
-                break;
-
-            case PRESET_9:
-                *tmsp = tMSP_OVERDRIVE_PRESET_9;
-                break;
-
-            case PRESET_A:
-                *tmsp = tMSP_OVERDRIVE_PRESET_A;
-                break;
-
-            case PRESET_B:
-                *tmsp = tMSP_OVERDRIVE_PRESET_B;
-                break;
-
-            case PRESET_C:
-                *tmsp = tMSP_OVERDRIVE_PRESET_C;
-                break;
-
-            case PRESET_D:
-                *tmsp = tMSP_OVERDRIVE_PRESET_D;
-                break;
-
-            case PRESET_E:
-                *tmsp = tMSP_OVERDRIVE_PRESET_E;
-                break;
-
-            case PRESET_F:
-                *tmsp = tMSP_OVERDRIVE_PRESET_F;
-                break;
-
-            default:
-                *tmsp = tMSP_OVERDRIVE_PRESET_6;
-                break;
-            }
-        }
-    }
-    else //Standard
-    {
-        if((error = DS2485_ReadOneWirePortConfig(STANDARD_SPEED_tMSP, reg_data)) != 0)
-        {
-            return error;
-        }
-
-        if((reg_data[1] >> 7) != 0) //Custom Value
-        {
-            value = ((reg_data[1] & ~(0x80)) << 8) | reg_data[0];
-            *tmsp = (double)value;
-            *tmsp *= (double)62.5;
-            *tmsp /= 1000;
-        }
-        else //Predefined value
-        {
-            switch(reg_data[0])
-            {
-            case PRESET_0:
-                *tmsp = tMSP_STANDARD_PRESET_0;
-                break;
-
-            case PRESET_1:
-                *tmsp = tMSP_STANDARD_PRESET_1;
-                break;
-
-            case PRESET_2:
-                *tmsp = tMSP_STANDARD_PRESET_2;
-                break;
-
-            case PRESET_3:
-                *tmsp = tMSP_STANDARD_PRESET_3;
-                break;
-
-            case PRESET_4:
-                *tmsp = tMSP_STANDARD_PRESET_4;
-                break;
-
-            case PRESET_5:
-                *tmsp = tMSP_STANDARD_PRESET_5;
-                break;
-
-            case PRESET_6:
-                *tmsp = tMSP_STANDARD_PRESET_6;
-                break;
-
-            case PRESET_7:
-                *tmsp = tMSP_STANDARD_PRESET_7;
-                break;
-
-            case PRESET_8:
-                *tmsp = tMSP_STANDARD_PRESET_8;
-                break;
-
-            case PRESET_9:
-                *tmsp = tMSP_STANDARD_PRESET_9;
-                break;
-
-            case PRESET_A:
-                *tmsp = tMSP_STANDARD_PRESET_A;
-                break;
-
-            case PRESET_B:
-                *tmsp = tMSP_STANDARD_PRESET_B;
-                break;
-
-            case PRESET_C:
-                *tmsp = tMSP_STANDARD_PRESET_C;
-                break;
-
-            case PRESET_D:
-                *tmsp = tMSP_STANDARD_PRESET_D;
-                break;
-
-            case PRESET_E:
-                *tmsp = tMSP_STANDARD_PRESET_E;
-                break;
-
-            case PRESET_F:
-                *tmsp = tMSP_STANDARD_PRESET_F;
-                break;
-
-            default:
-                *tmsp = tMSP_STANDARD_PRESET_6;
-                break;
-            }
-        }
-    }
-
-    return error;
-}
-
-int OneWire_Set_tW1L_Standard_Predefined(one_wire_timing_presets tw1l)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    reg_data[1] = 0x00;
-    reg_data[0] = tw1l;
-
-    if((error = DS2485_WriteOneWirePortConfig(STANDARD_SPEED_tW1L, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Set_tW1L_Overdrive_Predefined(one_wire_timing_presets tw1l)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    reg_data[1] = 0x00;
-    reg_data[0] = tw1l;
-
-    if((error = DS2485_WriteOneWirePortConfig(OVERDRIVE_SPEED_tW1L, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Set_tW1L_Standard_Custom(double tw1l)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    if (tw1l > (double)255.5)
-    {
-        return error = RB_INVALID_PARAMETER;
-    }
-
-    tw1l *= 1000; //us -> ns
-    tw1l /= (double)62.5;
-    tw1l = ((int)tw1l | 0x8000);
-    reg_data[0] = (uint8_t)tw1l;
-    reg_data[1] = ((int)tw1l >> 8);
-
-    if((error = DS2485_WriteOneWirePortConfig(STANDARD_SPEED_tW1L, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Set_tW1L_Overdrive_Custom(double tw1l)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    if (tw1l > (double)255.5)
-    {
-        return error = RB_INVALID_PARAMETER;
-    }
-
-    tw1l *= 1000; //us -> ns
-    tw1l /= (double)62.5;
-    tw1l = ((int)tw1l | 0x8000);
-    reg_data[0] = (uint8_t)tw1l;
-    reg_data[1] = ((int)tw1l >> 8);
-
-    if((error = DS2485_WriteOneWirePortConfig(OVERDRIVE_SPEED_tW1L, reg_data)) != 0)
+    if (table->count > ONEWIRE_ROM_TABLE_SAVE_MAX || table->truncated)
     {
-        return error;
+        // DS2485 user memory cannot hold the list: leave none rather than part of it
+        error = invalidateRomTable();
+        return error ? error : RB_TABLE_FULL;
     }
-
-    return error;
-}
-int OneWire_Get_tW1L(double *tw1l, one_wire_speeds spd)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-    unsigned short value;
-
-    if(spd != STANDARD)  //Overdrive
+    int pages = ROM_TABLE_PAGES_USED(table->count);
+    for (int page = 0; page < pages; page++)
     {
-        if((error = DS2485_ReadOneWirePortConfig(OVERDRIVE_SPEED_tW1L, reg_data)) != 0)
-        {
-            return error;
-        }
-
-        if((reg_data[1] >> 7) != 0) //custom value
-        {
-
-            value = ((reg_data[1] & ~(0x80)) << 8) | reg_data[0];
-            *tw1l = (double)value;
-            *tw1l *= (double)62.5;
-            *tw1l /= 1000;
-        }
-        else //predefined value
-        {
-            switch(reg_data[0])
-            {
-            case PRESET_0:
-                *tw1l = tW1L_OVERDRIVE_PRESET_0;
-                break;
-
-            case PRESET_1:
-                *tw1l = tW1L_OVERDRIVE_PRESET_1;
-                break;
-
-            case PRESET_2:
-                *tw1l = tW1L_OVERDRIVE_PRESET_2;
-                break;
-
-            case PRESET_3:
-                *tw1l = tW1L_OVERDRIVE_PRESET_3;
-                break;
-
-            case PRESET_4:
-                *tw1l = tW1L_OVERDRIVE_PRESET_4;
-                break;
-
-            case PRESET_5:
-                *tw1l = tW1L_OVERDRIVE_PRESET_5;
-                break;
-
-            case PRESET_6:
-                *tw1l = tW1L_OVERDRIVE_PRESET_6;
-                break;
-
-            case PRESET_7:
-                *tw1l = tW1L_OVERDRIVE_PRESET_7;
-                break;
-
-            case PRESET_8:
-                *tw1l = tW1L_OVERDRIVE_PRESET_8;
-                break;
-
-            case PRESET_9:
-                *tw1l = tW1L_OVERDRIVE_PRESET_9;
-                break;
-
-            case PRESET_A:
-                *tw1l = tW1L_OVERDRIVE_PRESET_A;
-                break;
-
-            case PRESET_B:
-                *tw1l = tW1L_OVERDRIVE_PRESET_B;
-                break;
-
-            case PRESET_C:
-                *tw1l = tW1L_OVERDRIVE_PRESET_C;
-                break;
-
-            case PRESET_D:
-                *tw1l = tW1L_OVERDRIVE_PRESET_D;
-                break;
-
-            case PRESET_E:
-                *tw1l = tW1L_OVERDRIVE_PRESET_E;
-                break;
-
-            case PRESET_F:
-                *tw1l = tW1L_OVERDRIVE_PRESET_F;
-                break;
-
-            default:
-                *tw1l = tW1L_OVERDRIVE_PRESET_6;
-                break;
-            }
-        }
+        error = DS2485_ReadMemory(ONEWIRE_ROM_TABLE_FIRST_PAGE + page, &stored[page * ROM_TABLE_PAGE_SIZE]);
+        if(error) return error;
     }
-    else //Standard
+    // Unchanged device list: nothing to write (DS2485 memory writes are slow and wear the EEPROM)
+    bool storedValid = (parseRomTable(stored, pages * ROM_TABLE_PAGE_SIZE, &storedTable) == 0);
+    if (storedValid && storedTable.count == table->count &&
+        memcmp(storedTable.romID, table->romID, 8*table->count) == 0)
     {
-        if((error = DS2485_ReadOneWirePortConfig(STANDARD_SPEED_tW1L, reg_data)) != 0)
-        {
-            return error;
-        }
-
-        if((reg_data[1] >> 7) != 0) //Custom Value
-        {
-            value = ((reg_data[1] & ~(0x80)) << 8) | reg_data[0];
-            *tw1l = (double)value;
-            *tw1l *= (double)62.5;
-            *tw1l /= 1000;
-        }
-        else //Predefined value
-        {
-            switch(reg_data[0])
-            {
-            case PRESET_0:
-                *tw1l = tW1L_STANDARD_PRESET_0;
-                break;
-
-            case PRESET_1:
-                *tw1l = tW1L_STANDARD_PRESET_1;
-                break;
-
-            case PRESET_2:
-                *tw1l = tW1L_STANDARD_PRESET_2;
-                break;
-
-            case PRESET_3:
-                *tw1l = tW1L_STANDARD_PRESET_3;
-                break;
-
-            case PRESET_4:
-                *tw1l = tW1L_STANDARD_PRESET_4;
-                break;
-
-            case PRESET_5:
-                *tw1l = tW1L_STANDARD_PRESET_5;
-                break;
-
-            case PRESET_6:
-                *tw1l = tW1L_STANDARD_PRESET_6;
-                break;
-
-            case PRESET_7:
-                *tw1l = tW1L_STANDARD_PRESET_7;
-                break;
-
-            case PRESET_8:
-                *tw1l = tW1L_STANDARD_PRESET_8;
-                break;
-
-            case PRESET_9:
-                *tw1l = tW1L_STANDARD_PRESET_9;
-                break;
-
-            case PRESET_A:
-                *tw1l = tW1L_STANDARD_PRESET_A;
-                break;
-
-            case PRESET_B:
-                *tw1l = tW1L_STANDARD_PRESET_B;
-                break;
-
-            case PRESET_C:
-                *tw1l = tW1L_STANDARD_PRESET_C;
-                break;
-
-            case PRESET_D:
-                *tw1l = tW1L_STANDARD_PRESET_D;
-                break;
-
-            case PRESET_E:
-                *tw1l = tW1L_STANDARD_PRESET_E;
-                break;
-
-            case PRESET_F:
-                *tw1l = tW1L_STANDARD_PRESET_F;
-                break;
-
-            default:
-                *tw1l = tW1L_STANDARD_PRESET_6;
-                break;
-            }
-        }
+        table->generation = storedTable.generation;
+        return 0;
     }
+    table->generation = (storedValid ? storedTable.generation : table->generation) + 1;
 
-    return error;
-}
-
-int OneWire_Set_tMSR_Standard_Predefined(one_wire_timing_presets tmsr)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    reg_data[1] = 0x00;
-    reg_data[0] = tmsr;
+    // Build the new image; unused bytes in the last page keep their stored value to avoid needless writes
+    memcpy(image, stored, sizeof(image));
+    image[0] = 'O';
+    image[1] = 'W';
+    image[2] = ROM_TABLE_VERSION;
+    image[3] = table->count;
+    image[4] = table->generation & 0xFF;
+    image[5] = (table->generation >> 8) & 0xFF;
+    image[6] = (table->generation >> 16) & 0xFF;
+    image[7] = (table->generation >> 24) & 0xFF;
+    memcpy(&image[ROM_TABLE_HEADER_SIZE], table->romID, 8*table->count);
+    int crcIdx = ROM_TABLE_IMAGE_SIZE(table->count) - 2;
+    unsigned int crc = OneWire_CalculateCrc16Block(image, crcIdx, 0);
+    image[crcIdx] = crc & 0xFF;
+    image[crcIdx+1] = crc >> 8;
 
-    if((error = DS2485_WriteOneWirePortConfig(STANDARD_SPEED_tMSR, reg_data)) != 0)
+    for (int page = 0; page < pages; page++)
     {
-        return error;
+        if (memcmp(&image[page * ROM_TABLE_PAGE_SIZE], &stored[page * ROM_TABLE_PAGE_SIZE], ROM_TABLE_PAGE_SIZE) == 0) continue;
+        error = DS2485_WriteMemory(ONEWIRE_ROM_TABLE_FIRST_PAGE + page, &image[page * ROM_TABLE_PAGE_SIZE]);
+        if(error) return error;
     }
-
     return error;
 }
-int OneWire_Set_tMSR_Overdrive_Predefined(one_wire_timing_presets tmsr)
-{
-    int error = 0;
-    uint8_t reg_data[2];
 
-    reg_data[1] = 0x00;
-    reg_data[0] = tmsr;
 
-    if((error = DS2485_WriteOneWirePortConfig(OVERDRIVE_SPEED_tMSR, reg_data)) != 0)
-    {
-        return error;
-    }
+/* **** Timing profile in DS2485 user memory **** */
 
-    return error;
-}
-int OneWire_Set_tMSR_Standard_Custom(double tmsr)
+static void encodeTimingProfile(const OneWire_timing_profile_T *profile, uint8_t *image)
 {
-    int error = 0;
-    uint8_t reg_data[2];
-
-    if (tmsr > (double)255.5)
-    {
-        return error = RB_INVALID_PARAMETER;
-    }
-
-    tmsr *= 1000; //us -> ns
-    tmsr /= (double)62.5;
-    tmsr = ((int)tmsr | 0x8000);
-    reg_data[0] = (uint8_t)tmsr;
-    reg_data[1] = ((int)tmsr >> 8);
-
-    if((error = DS2485_WriteOneWirePortConfig(STANDARD_SPEED_tMSR, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
+    image[0] = 'O';
+    image[1] = 'T';
+    image[2] = TIMING_PROFILE_VERSION;
+    memcpy(&image[3], profile->standard, ONEWIRE_TIMINGS);
+    memcpy(&image[3 + ONEWIRE_TIMINGS], profile->overdrive, ONEWIRE_TIMINGS);
+    image[3 + 2*ONEWIRE_TIMINGS] = profile->vth;
+    image[4 + 2*ONEWIRE_TIMINGS] = profile->viapo;
+    image[5 + 2*ONEWIRE_TIMINGS] = profile->rwpu;
+    unsigned int crc = OneWire_CalculateCrc16Block(image, TIMING_PROFILE_IMAGE_SIZE - 2, 0);
+    image[TIMING_PROFILE_IMAGE_SIZE - 2] = crc & 0xFF;
+    image[TIMING_PROFILE_IMAGE_SIZE - 1] = crc >> 8;
 }
-int OneWire_Set_tMSR_Overdrive_Custom(double tmsr)
-{
-    int error = 0;
-    uint8_t reg_data[2];
-
-    if (tmsr > (double)255.5)
-    {
-        return error = RB_INVALID_PARAMETER;
-    }
 
-    tmsr *= 1000; //us -> ns
-    tmsr /= (double)62.5;
-    tmsr = ((int)tmsr | 0x8000);
-    reg_data[0] = (uint8_t)tmsr;
-    reg_data[1] = ((int)tmsr >> 8);
-
-    if((error = DS2485_WriteOneWirePortConfig(OVERDRIVE_SPEED_tMSR, reg_data)) != 0)
-    {
-        return error;
-    }
-
-    return error;
-}
-int OneWire_Get_tMSR(double *tmsr, one_wire_speeds spd)
+int OneWire_LoadTimingProfile(OneWire_timing_profile_T *profile)
 {
     int error = 0;
-    uint8_t reg_data[2];
-    unsigned short value;
+    uint8_t image[ROM_TABLE_PAGE_SIZE];
 
-    if(spd != STANDARD)  //Overdrive
-    {
-        if((error = DS2485_ReadOneWirePortConfig(OVERDRIVE_SPEED_tMSR, reg_data)) != 0)
-        {
-            return error;
-        }
-
-        if((reg_data[1] >> 7) != 0) //custom value
-        {
-
-            value = ((reg_data[1] & ~(0x80)) << 8) | reg_data[0];
-            *tmsr = (double)value;
-            *tmsr *= (double)62.5;
-            *tmsr /= 1000;
-        }
-        else //predefined value
-        {
-            switch(reg_data[0])
-            {
-            case PRESET_0:
-                *tmsr = tMSR_OVERDRIVE_PRESET_0;
-                break;
-
-            case PRESET_1:
-                *tmsr = tMSR_OVERDRIVE_PRESET_1;
-                break;
-
-            case PRESET_2:
-                *tmsr = tMSR_OVERDRIVE_PRESET_2;
-                break;
-
-            case PRESET_3:
-                *tmsr = tMSR_OVERDRIVE_PRESET_3;
-                break;
-
-            case PRESET_4:
-                *tmsr = tMSR_OVERDRIVE_PRESET_4;
-                break;
-
-            case PRESET_5:
-                *tmsr = tMSR_OVERDRIVE_PRESET_5;
-                break;
-
-            case PRESET_6:
-                *tmsr = tMSR_OVERDRIVE_PRESET_6;
-                break;
-
-            case PRESET_7:
-                *tmsr = tMSR_OVERDRIVE_PRESET_7;
-                break;
-
-            case PRESET_8:
-                *tmsr = tMSR_OVERDRIVE_PRESET_8;
-                break;
-
-            case PRESET_9:
-                *tmsr = tMSR_OVERDRIVE_PRESET_9;
-                break;
-
-            case PRESET_A:
-                *tmsr = tMSR_OVERDRIVE_PRESET_A;
-                break;
-
-            case PRESET_B:
-                *tmsr = tMSR_OVERDRIVE_PRESET_B;
-                break;
-
-            case PRESET_C:
-                *tmsr = tMSR_OVERDRIVE_PRESET_C;
-                break;
-
-            case PRESET_D:
-                *tmsr = tMSR_OVERDRIVE_PRESET_D;
-                break;
-
-            case PRESET_E:
-                *tmsr = tMSR_OVERDRIVE_PRESET_E;
-                break;
-
-            case PRESET_F:
-                *tmsr = tMSR_OVERDRIVE_PRESET_F;
-                break;
-
-            default:
-                *tmsr = tMSR_OVERDRIVE_PRESET_6;
-                break;
-            }
-        }
-    }
-    else //Standard
-    {
-        if((error = DS2485_ReadOneWirePortConfig(STANDARD_SPEED_tMSR, reg_data)) != 0)
-        {
-            return error;
-        }
-
-        if((reg_data[1] >> 7) != 0) //Custom Value
-        {
-            value = ((reg_data[1] & ~(0x80)) << 8) | reg_data[0];
-            *tmsr = (double)value;
-            *tmsr *= (double)62.5;
-            *tmsr /= 1000;
-        }
-        else //Predefined value
-        {
-            switch(reg_data[0])
-            {
-            case PRESET_0:
-                *tmsr = tMSR_STANDARD_PRESET_0;
-                break;
-
-            case PRESET_1:
-                *tmsr = tMSR_STANDARD_PRESET_1;
-                break;
-
-            case PRESET_2:
-                *tmsr = tMSR_STANDARD_PRESET_2;
-                break;
-
-            case PRESET_3:
-                *tmsr = tMSR_STANDARD_PRESET_3;
-                break;
-
-            case PRESET_4:
-                *tmsr = tMSR_STANDARD_PRESET_4;
-                break;
-
-            case PRESET_5:
-                *tmsr = tMSR_STANDARD_PRESET_5;
-                break;
-
-            case PRESET_6:
-                *tmsr = tMSR_STANDARD_PRESET_6;
-                break;
-
-            case PRESET_7:
-                *tmsr = tMSR_STANDARD_PRESET_7;
-                break;
-
-            case PRESET_8:
-                *tmsr = tMSR_STANDARD_PRESET_8;
-                break;
-
-            case PRESET_9:
-                *tmsr = tMSR_STANDARD_PRESET_9;
-                break;
-
-            case PRESET_A:
-                *tmsr = tMSR_STANDARD_PRESET_A;
-                break;
-
-            case PRESET_B:
-                *tmsr = tMSR_STANDARD_PRESET_B;
-                break;
-
-            case PRESET_C:
-                *tmsr = tMSR_STANDARD_PRESET_C;
-                break;
-
-            case PRESET_D:
-                *tmsr = tMSR_STANDARD_PRESET_D;
-                break;
-
-            case PRESET_E:
-                *tmsr = tMSR_STANDARD_PRESET_E;
-                break;
-
-            case PRESET_F:
-                *tmsr = tMSR_STANDARD_PRESET_F;
-                break;
-
-            default:
-                *tmsr = tMSR_STANDARD_PRESET_6;
-                break;
-            }
-        }
-    }
-
-    return error;
+    error = DS2485_ReadMemory(ONEWIRE_TIMING_PROFILE_PAGE, image);
+    if(error) return error;
+    if (image[0] != 'O' || image[1] != 'T' || image[2] != TIMING_PROFILE_VERSION) return 1;
+    unsigned int crc = OneWire_CalculateCrc16Block(image, TIMING_PROFILE_IMAGE_SIZE - 2, 0);
+    if (image[TIMING_PROFILE_IMAGE_SIZE - 2] != (crc & 0xFF) || image[TIMING_PROFILE_IMAGE_SIZE - 1] != (crc >> 8)) return 1;
+
+    memcpy(profile->standard, &image[3], ONEWIRE_TIMINGS);
+    memcpy(profile->overdrive, &image[3 + ONEWIRE_TIMINGS], ONEWIRE_TIMINGS);
+    profile->vth = image[3 + 2*ONEWIRE_TIMINGS];
+    profile->viapo = image[4 + 2*ONEWIRE_TIMINGS];
+    profile->rwpu = image[5 + 2*ONEWIRE_TIMINGS];
+    return 0;
 }
 
-int OneWire_Init(void)
+int OneWire_SaveTimingProfile(const OneWire_timing_profile_T *profile)
 {
     int error = 0;
+    uint8_t stored[ROM_TABLE_PAGE_SIZE];
+    uint8_t image[ROM_TABLE_PAGE_SIZE];
 
-    //Set standard speed 1-Wire timings
-    if ((error = OneWire_Set_tRSTL_Standard_Predefined(PRESET_6)) != 0)
-    {
-        return error;
-    }
-    if ((error = OneWire_Set_tMSI_Standard_Predefined(PRESET_6)) != 0)
-    {
-        return error;
-    }
-    if ((error = OneWire_Set_tMSP_Standard_Predefined(PRESET_6)) != 0)
-    {
-        return error;
-    }
-    if ((error = OneWire_Set_tRSTH_Standard_Predefined(PRESET_6)) != 0)
-    {
-        return error;
-    }
-    if ((error = OneWire_Set_tW0L_Standard_Predefined(PRESET_6)) != 0)
-    {
-        return error;
-    }
-    if ((error = OneWire_Set_tW1L_Standard_Predefined(PRESET_6)) != 0)
-    {
-        return error;
-    }
-    if ((error = OneWire_Set_tMSR_Standard_Predefined(PRESET_6)) != 0)
-    {
-        return error;
-    }
-    if ((error = OneWire_Set_tREC_Standard_Predefined(PRESET_6)) != 0)
-    {
-        return error;
-    }
-    //Set overdrive speed 1-Wire timings
-    if ((error = OneWire_Set_tRSTL_Overdrive_Predefined(PRESET_6)) != 0)
-    {
-        return error;
-    }
-    if ((error = OneWire_Set_tMSI_Overdrive_Predefined(PRESET_6)) != 0)
-    {
-        return error;
-    }
-    if ((error = OneWire_Set_tMSP_Overdrive_Predefined(PRESET_6)) != 0)
-    {
-        return error;
-    }
-    if ((error = OneWire_Set_tRSTH_Overdrive_Predefined(PRESET_6)) != 0)
-    {
-        return error;
-    }
-    if ((error = OneWire_Set_tW0L_Overdrive_Predefined(PRESET_6)) != 0)
-    {
-        return error;
-    }
-    if ((error = OneWire_Set_tW1L_Overdrive_Predefined(PRESET_6)) != 0)
-    {
-        return error;
-    }
-    if ((error = OneWire_Set_tMSR_Overdrive_Predefined(PRESET_6)) != 0)
-    {
-        return error;
-    }
-    if ((error = OneWire_Set_tREC_Overdrive_Predefined(PRESET_6)) != 0)
-    {
-        return error;
-    }
-
-    //Set 1-Wire master speed to Standard
-    error = OneWire_Set_OneWireMasterSpeed(STANDARD);
-    if(error) return error;
-
-    //Set RPUP/BUF
-    error = OneWire_Set_Custom_RPUP_BUF(VTH_MEDIUM, VIAPO_LOW, RWPU_1000);
-    if(error) return error;
-    
-    // DRN: Add SPU (strong pull-up) which might be needed before trying reset pulse?
-    // DS28E18 VDD_SENS (DS28E18 power to the sensor) requires 'Strong Pull-Up' 'SPU' on 1-Wire bus.
-    // That's turned on with DS2485 1-Wire Master Configuration (Register 0) Bit 13: Strong Pullup (SPU).
-    // But, we don't need this yet to talk to the DS28E18, as the sensor is not yet powered up.
-    //    error = OneWire_Enable_SPU(true); // DS2485 must provide strong power to 1-Wire bus
-    //    if(error) return error;
-
-    //Perform a 1-Wire Reset - This is very first script executed on the one-wire bus during initialization.
-    error = OneWire_ResetPulse();
+    error = DS2485_ReadMemory(ONEWIRE_TIMING_PROFILE_PAGE, stored);
     if(error) return error;
-
-    return error;
+    memcpy(image, stored, sizeof(image)); // rest of the page keeps its stored value
+    encodeTimingProfile(profile, image);
+    if (memcmp(image, stored, sizeof(image)) == 0) return 0;
+    return DS2485_WriteMemory(ONEWIRE_TIMING_PROFILE_PAGE, image);
 }
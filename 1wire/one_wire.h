@@ -79,6 +79,21 @@
 #define PC_VERIFY_GPIO                  0x14
 #define PC_CONFIG_RPUP_BUF              0x15
 
+/* CRC16 checked by the DS2485 within a script (OneWire_WriteBlockVerifyCrc16, OneWire_ReadBlockVerifyCrc16) */
+#define ONEWIRE_CRC16_RESIDUAL          0xB001 // CRC16 of data followed by its inverted CRC16 (LSB first)
+#define ONEWIRE_WRITE_CRC16_MAX         116 // bytes written; the script also holds CRC16 start, block commands, CRC16 read and verify
+#define ONEWIRE_READ_CRC16_MAX          120 // bytes skipped plus bytes read; the response also holds block headers and verify result
+
+/* OW_TRIPLET primitive result byte */
+#define OW_TRIPLET_ID_BIT               0x01 // first bit read (logical AND of ROM ID bit of all participating devices)
+#define OW_TRIPLET_CMP_ID_BIT           0x02 // second bit read (AND of complemented ROM ID bits)
+#define OW_TRIPLET_DIRECTION            0x04 // bit written, ie search direction taken
+
+/* 1-Wire search ROM command codes */
+#define ONEWIRE_SEARCH_NORMAL           0xF0 // all devices
+#define ONEWIRE_SEARCH_CONDITIONAL      0xEC // only devices in alarm (conditional search) state
+#define ONEWIRE_FAMILY_ANY              (-1) // OneWire_SearchTable: no family code filter
+
 /* 1-Wire Preset Timings [us] */
 //tRSTL - Standard Speed
 #define tRSTL_STANDARD_PRESET_0         440
@@ -418,6 +433,28 @@ typedef enum {
     RWPU_333,
 } rwpu_values;
 
+/* 1-Wire timings, in DS2485 port configuration register order */
+typedef enum {
+    ONEWIRE_tRSTL,
+    ONEWIRE_tMSI,
+    ONEWIRE_tMSP,
+    ONEWIRE_tRSTH,
+    ONEWIRE_tW0L,
+    ONEWIRE_tW1L,
+    ONEWIRE_tMSR,
+    ONEWIRE_tREC,
+    ONEWIRE_TIMINGS, // count
+} one_wire_timings;
+
+/* 1-Wire timing profile: every timing preset and the RPUP/BUF setting (OneWire_Apply_TimingProfile) */
+typedef struct {
+    uint8_t standard[ONEWIRE_TIMINGS];  // one_wire_timing_presets, indexed by one_wire_timings
+    uint8_t overdrive[ONEWIRE_TIMINGS];
+    uint8_t vth;                        // vth_values
+    uint8_t viapo;                      // viapo_values
+    uint8_t rwpu;                       // rwpu_values
+} OneWire_timing_profile_T;
+
 /* GPIO Settings */
 typedef enum {
     CONDUCTING = 0xAA,
@@ -433,6 +470,31 @@ typedef enum {
 } gpio_verify_level_detection;
 
 
+/* Outcome of one search pass (OneWire_SearchPass) */
+typedef struct {
+    int lastZero;           // last bit number (1..64) where devices with both values responded and 0 was taken; 0 if none
+    uint64_t discrepancies; // bit n set: devices with both values of ROM ID bit n responded
+    int divergedBit;        // first forced bit no device matched, or -1
+    bool noDevices;         // no presence pulse, or no device took part in the search
+} OneWire_search_pass_T;
+
+
+/* Host-side search in progress (OneWire_Search_Start, OneWire_Search_Next) */
+typedef struct {
+    OneWire_ROM_ID_T romid; // path of the last device found (first prefixBits bits are fixed)
+    int prefixBits;
+    int lastDiscrepancy;    // bit number (1..64) where the next pass takes the 1 branch; 0 before first pass
+    uint8_t searchCode;
+    bool done;
+    int devicesFound;
+    int retries;            // passes repeated because of errors or glitches
+} OneWire_search_state_T;
+
+#ifndef ONEWIRE_SEARCH_RETRIES
+  #define ONEWIRE_SEARCH_RETRIES 3 // repeats of a failing search pass before OneWire_Search_Next gives up
+#endif
+
+
 /* **** Globals **** */
 
 extern uint8_t oneWireScript[126];
@@ -441,15 +503,30 @@ extern double oneWireScript_accumulativeOneWireTime;
 extern uint8_t oneWireScript_commandsCount;
 extern uint8_t oneWireScriptResponse[126];
 extern uint8_t oneWireScriptResponse_length;
+extern const OneWire_timing_profile_T OneWire_DefaultTimingProfile; // conservative settings used by OneWire_Init
 
 /***** Low Level Functions *****/
 int OneWire_ResetPulse(void);
 int OneWire_WriteByte(uint8_t byte);
 int OneWire_WriteBlock(uint8_t *data, int data_length);
+int OneWire_WriteBlockGather(const uint8_t *first, int first_length, const uint8_t *second, int second_length);
 uint8_t OneWire_ReadByte(void);
 int OneWire_ReadBlock(uint8_t *data, int data_length);
+int OneWire_ReadBlockScatter(uint8_t *first, int first_length, uint8_t *second, int second_length);
+int OneWire_WriteBlockVerifyCrc16(const uint8_t *first, int first_length, const uint8_t *second, int second_length, bool *crcOK, uint8_t *crc16);
+int OneWire_ReadBlockVerifyCrc16(int skip, int data_length, const uint8_t **data, bool *crcOK);
 int OneWire_Search(OneWire_ROM_ID_T *romid, bool search_reset, bool *last_device_found);
+int OneWire_SearchTable(OneWire_ROM_table_T *table, uint8_t searchCode, int familyCode);
+int OneWire_SearchSubtree(const OneWire_ROM_ID_T *prefix, int prefixBits, uint8_t searchCode,
+                          OneWire_ROM_ID_T *found, int foundMax, int *foundCount);
+int OneWire_SearchPass(OneWire_ROM_ID_T *romid, int forcedBits, uint8_t searchCode, OneWire_search_pass_T *pass);
+void OneWire_Search_Start(OneWire_search_state_T *state, uint8_t searchCode, const OneWire_ROM_ID_T *prefix, int prefixBits);
+int OneWire_Search_Next(OneWire_search_state_T *state, OneWire_ROM_ID_T *romid);
+void OneWire_Set_SearchTripletsPerScript(int triplets);
 int OneWire_WriteBytePower(int send_byte);
+unsigned int OneWire_CalculateCrc16Byte(uint8_t data, unsigned int crc);
+unsigned int OneWire_CalculateCrc16Block(const uint8_t *data, int dataSize, unsigned int crc);
+uint8_t OneWire_CalculateCrc8(const uint8_t *data, int dataSize);
 
 /***** High Level Functions *****/
 int OneWire_Enable_APU(bool apu);
@@ -462,61 +539,66 @@ int OneWire_Get_OneWireMasterSpeed(one_wire_speeds *spd);
 int OneWire_Set_Custom_RPUP_BUF(vth_values vth, viapo_values viapo, rwpu_values rwpu);
 int OneWire_Get_Custom_RPUP_BUF(vth_values *vth, viapo_values *viapo, rwpu_values *rwpu); //overwrites vth, viapo, and rwpu with value read from DS2485
 
-//tRSTL
-int OneWire_Set_tRSTL_Standard_Predefined(one_wire_timing_presets trstl);
-int OneWire_Set_tRSTL_Overdrive_Predefined(one_wire_timing_presets trstl);
-int OneWire_Set_tRSTL_Standard_Custom(double trstl); // Max = 1020 us
-int OneWire_Set_tRSTL_Overdrive_Custom(double trstl); // Max = 126 us
-int OneWire_Get_tRSTL(double *trstl, one_wire_speeds spd); //overwrites trstl in us
+//1-Wire timings: one table-driven codec, presets per one_wire.h tXXX_<speed>_PRESET_<n>, custom values in 62.5 ns steps
+int OneWire_Set_Timing_Predefined(one_wire_timings timing, one_wire_speeds spd, one_wire_timing_presets preset);
+int OneWire_Set_Timing_Custom(one_wire_timings timing, one_wire_speeds spd, double usec); // RB_INVALID_PARAMETER above the datasheet maximum
+int OneWire_Get_Timing(one_wire_timings timing, one_wire_speeds spd, double *usec); //overwrites usec in us
 
-//tRSTH
-int OneWire_Set_tRSTH_Standard_Predefined(one_wire_timing_presets trsth);
-int OneWire_Set_tRSTH_Overdrive_Predefined(one_wire_timing_presets trsth);
-int OneWire_Set_tRSTH_Standard_Custom(double trsth); // Max = 1020 us
-int OneWire_Set_tRSTH_Overdrive_Custom(double trsth); // Max = 126 us
-int OneWire_Get_tRSTH(double *trsth, one_wire_speeds spd); //overwrites trsth in us
+//tRSTL
+static inline int OneWire_Set_tRSTL_Standard_Predefined(one_wire_timing_presets trstl) { return OneWire_Set_Timing_Predefined(ONEWIRE_tRSTL, STANDARD, trstl); }
+static inline int OneWire_Set_tRSTL_Overdrive_Predefined(one_wire_timing_presets trstl) { return OneWire_Set_Timing_Predefined(ONEWIRE_tRSTL, OVERDRIVE, trstl); }
+static inline int OneWire_Set_tRSTL_Standard_Custom(double trstl) { return OneWire_Set_Timing_Custom(ONEWIRE_tRSTL, STANDARD, trstl); } // Max = 1020 us
+static inline int OneWire_Set_tRSTL_Overdrive_Custom(double trstl) { return OneWire_Set_Timing_Custom(ONEWIRE_tRSTL, OVERDRIVE, trstl); } // Max = 126 us
+static inline int OneWire_Get_tRSTL(double *trstl, one_wire_speeds spd) { return OneWire_Get_Timing(ONEWIRE_tRSTL, spd, trstl); } //overwrites trstl in us
 
 //tRSTH
-int OneWire_Set_tW0L_Standard_Predefined(one_wire_timing_presets tw0l);
-int OneWire_Set_tW0L_Overdrive_Predefined(one_wire_timing_presets tw0l);
-int OneWire_Set_tW0L_Standard_Custom(double tw0l); // Max = 126 us
-int OneWire_Set_tW0L_Overdrive_Custom(double tw0l); // Max = 31.5 us
-int OneWire_Get_tW0L(double *tw0l, one_wire_speeds spd); //overwrites tw0l in us
+static inline int OneWire_Set_tRSTH_Standard_Predefined(one_wire_timing_presets trsth) { return OneWire_Set_Timing_Predefined(ONEWIRE_tRSTH, STANDARD, trsth); }
+static inline int OneWire_Set_tRSTH_Overdrive_Predefined(one_wire_timing_presets trsth) { return OneWire_Set_Timing_Predefined(ONEWIRE_tRSTH, OVERDRIVE, trsth); }
+static inline int OneWire_Set_tRSTH_Standard_Custom(double trsth) { return OneWire_Set_Timing_Custom(ONEWIRE_tRSTH, STANDARD, trsth); } // Max = 1020 us
+static inline int OneWire_Set_tRSTH_Overdrive_Custom(double trsth) { return OneWire_Set_Timing_Custom(ONEWIRE_tRSTH, OVERDRIVE, trsth); } // Max = 126 us
+static inline int OneWire_Get_tRSTH(double *trsth, one_wire_speeds spd) { return OneWire_Get_Timing(ONEWIRE_tRSTH, spd, trsth); } //overwrites trsth in us
+
+//tW0L
+static inline int OneWire_Set_tW0L_Standard_Predefined(one_wire_timing_presets tw0l) { return OneWire_Set_Timing_Predefined(ONEWIRE_tW0L, STANDARD, tw0l); }
+static inline int OneWire_Set_tW0L_Overdrive_Predefined(one_wire_timing_presets tw0l) { return OneWire_Set_Timing_Predefined(ONEWIRE_tW0L, OVERDRIVE, tw0l); }
+static inline int OneWire_Set_tW0L_Standard_Custom(double tw0l) { return OneWire_Set_Timing_Custom(ONEWIRE_tW0L, STANDARD, tw0l); } // Max = 126 us
+static inline int OneWire_Set_tW0L_Overdrive_Custom(double tw0l) { return OneWire_Set_Timing_Custom(ONEWIRE_tW0L, OVERDRIVE, tw0l); } // Max = 31.5 us
+static inline int OneWire_Get_tW0L(double *tw0l, one_wire_speeds spd) { return OneWire_Get_Timing(ONEWIRE_tW0L, spd, tw0l); } //overwrites tw0l in us
 
 //tREC
-int OneWire_Set_tREC_Standard_Predefined(one_wire_timing_presets trec);
-int OneWire_Set_tREC_Overdrive_Predefined(one_wire_timing_presets trec);
-int OneWire_Set_tREC_Standard_Custom(double trec); // Max = 255.5 us
-int OneWire_Set_tREC_Overdrive_Custom(double trec); // Max = 255.5 us
-int OneWire_Get_tREC(double *trec, one_wire_speeds spd); //overwrites trec in us
+static inline int OneWire_Set_tREC_Standard_Predefined(one_wire_timing_presets trec) { return OneWire_Set_Timing_Predefined(ONEWIRE_tREC, STANDARD, trec); }
+static inline int OneWire_Set_tREC_Overdrive_Predefined(one_wire_timing_presets trec) { return OneWire_Set_Timing_Predefined(ONEWIRE_tREC, OVERDRIVE, trec); }
+static inline int OneWire_Set_tREC_Standard_Custom(double trec) { return OneWire_Set_Timing_Custom(ONEWIRE_tREC, STANDARD, trec); } // Max = 255.5 us
+static inline int OneWire_Set_tREC_Overdrive_Custom(double trec) { return OneWire_Set_Timing_Custom(ONEWIRE_tREC, OVERDRIVE, trec); } // Max = 255.5 us
+static inline int OneWire_Get_tREC(double *trec, one_wire_speeds spd) { return OneWire_Get_Timing(ONEWIRE_tREC, spd, trec); } //overwrites trec in us
 
 //tMSI
-int OneWire_Set_tMSI_Standard_Predefined(one_wire_timing_presets tmsi);
-int OneWire_Set_tMSI_Overdrive_Predefined(one_wire_timing_presets tmsi);
-int OneWire_Set_tMSI_Standard_Custom(double tmsi); // Max = 15.5 us
-int OneWire_Set_tMSI_Overdrive_Custom(double tmsi); // Max = 3.875 us
-int OneWire_Get_tMSI(double *tmsi, one_wire_speeds spd); //overwrites tmsi in us
+static inline int OneWire_Set_tMSI_Standard_Predefined(one_wire_timing_presets tmsi) { return OneWire_Set_Timing_Predefined(ONEWIRE_tMSI, STANDARD, tmsi); }
+static inline int OneWire_Set_tMSI_Overdrive_Predefined(one_wire_timing_presets tmsi) { return OneWire_Set_Timing_Predefined(ONEWIRE_tMSI, OVERDRIVE, tmsi); }
+static inline int OneWire_Set_tMSI_Standard_Custom(double tmsi) { return OneWire_Set_Timing_Custom(ONEWIRE_tMSI, STANDARD, tmsi); } // Max = 15.5 us
+static inline int OneWire_Set_tMSI_Overdrive_Custom(double tmsi) { return OneWire_Set_Timing_Custom(ONEWIRE_tMSI, OVERDRIVE, tmsi); } // Max = 3.875 us
+static inline int OneWire_Get_tMSI(double *tmsi, one_wire_speeds spd) { return OneWire_Get_Timing(ONEWIRE_tMSI, spd, tmsi); } //overwrites tmsi in us
 
 //tMSP
-int OneWire_Set_tMSP_Standard_Predefined(one_wire_timing_presets tmsp);
-int OneWire_Set_tMSP_Overdrive_Predefined(one_wire_timing_presets tmsp);
-int OneWire_Set_tMSP_Standard_Custom(double tmsp); // Max = 127 us
-int OneWire_Set_tMSP_Overdrive_Custom(double tmsp); // Max = 15.5 us
-int OneWire_Get_tMSP(double *tmsp, one_wire_speeds spd); //overwrites tmsp in us
+static inline int OneWire_Set_tMSP_Standard_Predefined(one_wire_timing_presets tmsp) { return OneWire_Set_Timing_Predefined(ONEWIRE_tMSP, STANDARD, tmsp); }
+static inline int OneWire_Set_tMSP_Overdrive_Predefined(one_wire_timing_presets tmsp) { return OneWire_Set_Timing_Predefined(ONEWIRE_tMSP, OVERDRIVE, tmsp); }
+static inline int OneWire_Set_tMSP_Standard_Custom(double tmsp) { return OneWire_Set_Timing_Custom(ONEWIRE_tMSP, STANDARD, tmsp); } // Max = 127 us
+static inline int OneWire_Set_tMSP_Overdrive_Custom(double tmsp) { return OneWire_Set_Timing_Custom(ONEWIRE_tMSP, OVERDRIVE, tmsp); } // Max = 15.5 us
+static inline int OneWire_Get_tMSP(double *tmsp, one_wire_speeds spd) { return OneWire_Get_Timing(ONEWIRE_tMSP, spd, tmsp); } //overwrites tmsp in us
 
 //tW1L
-int OneWire_Set_tW1L_Standard_Predefined(one_wire_timing_presets tw1l);
-int OneWire_Set_tW1L_Overdrive_Predefined(one_wire_timing_presets tw1l);
-int OneWire_Set_tW1L_Standard_Custom(double tw1l); // Max = 31.5 us
-int OneWire_Set_tW1L_Overdrive_Custom(double tw1l); // Max = 1.9375 us
-int OneWire_Get_tW1L(double *tw1l, one_wire_speeds spd); //overwrites tw1l in us
+static inline int OneWire_Set_tW1L_Standard_Predefined(one_wire_timing_presets tw1l) { return OneWire_Set_Timing_Predefined(ONEWIRE_tW1L, STANDARD, tw1l); }
+static inline int OneWire_Set_tW1L_Overdrive_Predefined(one_wire_timing_presets tw1l) { return OneWire_Set_Timing_Predefined(ONEWIRE_tW1L, OVERDRIVE, tw1l); }
+static inline int OneWire_Set_tW1L_Standard_Custom(double tw1l) { return OneWire_Set_Timing_Custom(ONEWIRE_tW1L, STANDARD, tw1l); } // Max = 31.5 us
+static inline int OneWire_Set_tW1L_Overdrive_Custom(double tw1l) { return OneWire_Set_Timing_Custom(ONEWIRE_tW1L, OVERDRIVE, tw1l); } // Max = 1.9375 us
+static inline int OneWire_Get_tW1L(double *tw1l, one_wire_speeds spd) { return OneWire_Get_Timing(ONEWIRE_tW1L, spd, tw1l); } //overwrites tw1l in us
 
 //tMSR
-int OneWire_Set_tMSR_Standard_Predefined(one_wire_timing_presets tmsr);
-int OneWire_Set_tMSR_Overdrive_Predefined(one_wire_timing_presets tmsr);
-int OneWire_Set_tMSR_Standard_Custom(double tmsr); // Max = 31.5 us
-int OneWire_Set_tMSR_Overdrive_Custom(double tmsr); // Max = 3.875 us
-int OneWire_Get_tMSR(double *tmsr, one_wire_speeds spd); //overwrites tmsr in us
+static inline int OneWire_Set_tMSR_Standard_Predefined(one_wire_timing_presets tmsr) { return OneWire_Set_Timing_Predefined(ONEWIRE_tMSR, STANDARD, tmsr); }
+static inline int OneWire_Set_tMSR_Overdrive_Predefined(one_wire_timing_presets tmsr) { return OneWire_Set_Timing_Predefined(ONEWIRE_tMSR, OVERDRIVE, tmsr); }
+static inline int OneWire_Set_tMSR_Standard_Custom(double tmsr) { return OneWire_Set_Timing_Custom(ONEWIRE_tMSR, STANDARD, tmsr); } // Max = 31.5 us
+static inline int OneWire_Set_tMSR_Overdrive_Custom(double tmsr) { return OneWire_Set_Timing_Custom(ONEWIRE_tMSR, OVERDRIVE, tmsr); } // Max = 3.875 us
+static inline int OneWire_Get_tMSR(double *tmsr, one_wire_speeds spd) { return OneWire_Get_Timing(ONEWIRE_tMSR, spd, tmsr); } //overwrites tmsr in us
 
 /* Primitive Script Commands */
 extern void OneWire_Script_Clear(void);
@@ -545,6 +627,27 @@ extern void OneWire_Script_Add_VERIFY_GPIO(uint8_t *response_index, gpio_verify_
 extern void OneWire_Script_Add_CONFIG_RPUP_BUF(unsigned short hex_value);
 
 int OneWire_Init(void);
+int OneWire_Apply_TimingProfile(const OneWire_timing_profile_T *profile);
+
+/***** ROM ID table persisted in DS2485 user memory *****/
+// Table occupies ONEWIRE_ROM_TABLE_FIRST_PAGE through (at most) PAGE_5; pages below are left for the application.
+#ifndef ONEWIRE_ROM_TABLE_FIRST_PAGE
+  #define ONEWIRE_ROM_TABLE_FIRST_PAGE 1
+#endif
+// Devices a saved table holds: 32-byte pages up to PAGE_5, less 10 bytes of header and CRC16 (18 from PAGE_1),
+// and no more than a table holds
+#define ONEWIRE_ROM_TABLE_MEMORY_MAX (((6 - ONEWIRE_ROM_TABLE_FIRST_PAGE) * 32 - 10) / 8)
+#define ONEWIRE_ROM_TABLE_SAVE_MAX (ONEWIRE_ROM_TABLE_MEMORY_MAX < ONEWIRE_ROM_TABLE_MAX ? ONEWIRE_ROM_TABLE_MEMORY_MAX : ONEWIRE_ROM_TABLE_MAX)
+int OneWire_SaveRomTable(OneWire_ROM_table_T *table); // writes only pages that changed; updates table->generation; RB_TABLE_FULL if too long or truncated
+int OneWire_LoadRomTable(OneWire_ROM_table_T *table); // returns 1 if no valid table is stored
+
+/***** Timing profile persisted in DS2485 user memory *****/
+// Each DS2485 stores the profile calibrated for its own bus (see DS28E18_CalibrateTiming).
+#ifndef ONEWIRE_TIMING_PROFILE_PAGE
+  #define ONEWIRE_TIMING_PROFILE_PAGE 0 // PAGE_0
+#endif
+int OneWire_SaveTimingProfile(const OneWire_timing_profile_T *profile); // writes only if changed
+int OneWire_LoadTimingProfile(OneWire_timing_profile_T *profile); // returns 1 if no valid profile is stored
 
 
 #ifdef __cplusplus
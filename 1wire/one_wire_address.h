@@ -13,12 +13,25 @@
 #endif
 
 #include <stdint.h>
+#include <stdbool.h>
 
 /// OneWire_ROM_ID_T type stores a 1-Wire address
 typedef struct {
 	uint8_t ID[8];
 } OneWire_ROM_ID_T;
 
+#ifndef ONEWIRE_ROM_TABLE_MAX
+  #define ONEWIRE_ROM_TABLE_MAX 32 // devices a table holds; at most ONEWIRE_ROM_TABLE_SAVE_MAX of them can be saved (one_wire.h)
+#endif
+
+/// OneWire_ROM_table_T lists the devices found on a 1-Wire bus
+typedef struct {
+	uint32_t generation; ///< incremented each time a changed table is saved
+	uint8_t count;       ///< number of valid entries in romID
+	bool truncated;      ///< more devices responded than romID holds (the search returned RB_TABLE_FULL)
+	OneWire_ROM_ID_T romID[ONEWIRE_ROM_TABLE_MAX];
+} OneWire_ROM_table_T;
+
 
 #ifdef __cplusplus
 }
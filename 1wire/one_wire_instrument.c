@@ -0,0 +1,98 @@
+/**
+ * @file one_wire_instrument.c
+ * @brief Latency histograms for the 1-Wire stack, see one_wire_instrument.h.
+ */
+
+#if !defined(ONEWIRE_INSTR_CYCLES) && !defined(__ARM_ARCH)
+  #define _POSIX_C_SOURCE 200809L
+  #include <time.h>
+#endif
+#include <stdint.h>
+#include <string.h>
+#include "one_wire_instrument.h"
+
+/* **** Globals **** */
+OneWire_instr_histogram_T oneWireInstrHistograms[ONEWIRE_INSTR_OPS];
+
+/* **** Locals **** */
+static uint32_t cyclesPerUsec = 1;
+
+static const char *const opNames[ONEWIRE_INSTR_OPS] = {
+    [ONEWIRE_INSTR_ENS210_INIT]           = "ENS210 Init",
+    [ONEWIRE_INSTR_ENS210_MEASURE]        = "ENS210 Measure",
+    [ONEWIRE_INSTR_DS28E18_COMMAND]       = "DS28E18 command",
+    [ONEWIRE_INSTR_DS28E18_RUN_SEQUENCER] = "DS28E18 Run Sequencer",
+    [ONEWIRE_INSTR_SCRIPT_EXECUTE]        = "1-Wire script",
+    [ONEWIRE_INSTR_DS2485_COMMAND]        = "DS2485 command",
+    [ONEWIRE_INSTR_DS2485_POLL]           = "DS2485 poll",
+    [ONEWIRE_INSTR_I2C_WRITE]             = "I2C write",
+    [ONEWIRE_INSTR_I2C_READ]              = "I2C read",
+};
+
+#if !defined(ONEWIRE_INSTR_CYCLES) && !defined(__ARM_ARCH)
+uint32_t OneWire_Instr_Cycles(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec);
+}
+#endif
+
+void OneWire_Instr_Init(uint32_t cycles_per_uSec)
+{
+#if !defined(ONEWIRE_INSTR_CYCLES) && defined(__ARM_ARCH)
+    *(volatile uint32_t *)0xE000EDFCUL |= 1U << 24; // CoreDebug DEMCR.TRCENA: enable DWT
+    *(volatile uint32_t *)0xE0001000UL |= 1U;       // DWT_CTRL.CYCCNTENA
+#endif
+    cyclesPerUsec = cycles_per_uSec ? cycles_per_uSec : 1;
+    OneWire_Instr_Reset();
+}
+
+void OneWire_Instr_Reset(void)
+{
+    memset(oneWireInstrHistograms, 0, sizeof(oneWireInstrHistograms));
+}
+
+const char *OneWire_Instr_Name(OneWire_instr_op_T op)
+{
+    return (op < ONEWIRE_INSTR_OPS) ? opNames[op] : "?";
+}
+
+// Largest value counted in a bucket
+static uint32_t bucketLimit(unsigned int bucket)
+{
+    if (bucket < (1U << ONEWIRE_INSTR_SUB_BITS)) return bucket;
+    unsigned int shift = (bucket >> (ONEWIRE_INSTR_SUB_BITS - 1)) - 1;
+    uint32_t mantissa = bucket - (shift << (ONEWIRE_INSTR_SUB_BITS - 1));
+    return (mantissa << shift) + ((1U << shift) - 1);
+}
+
+// Value below which 'percent' of the events fall, in cycles
+static uint32_t percentile(const OneWire_instr_histogram_T *h, unsigned int percent)
+{
+    uint64_t rank = ((uint64_t)h->count * percent + 99) / 100; // events at or below the percentile
+    uint64_t seen = 0;
+    for (unsigned int b = 0; b < ONEWIRE_INSTR_BUCKETS; b++)
+    {
+        seen += h->buckets[b];
+        if (seen >= rank && seen > 0)
+        {
+            uint32_t limit = bucketLimit(b);
+            return (limit > h->max) ? h->max : limit;
+        }
+    }
+    return h->max;
+}
+
+void OneWire_Instr_GetStats(OneWire_instr_op_T op, OneWire_instr_stats_T *stats)
+{
+    const OneWire_instr_histogram_T *h = &oneWireInstrHistograms[op];
+    memset(stats, 0, sizeof(*stats));
+    stats->count = h->count;
+    if (h->count == 0) return;
+    stats->min_uSec  = (double)h->min / cyclesPerUsec;
+    stats->max_uSec  = (double)h->max / cyclesPerUsec;
+    stats->mean_uSec = (double)h->sum / h->count / cyclesPerUsec;
+    stats->p50_uSec  = (double)percentile(h, 50) / cyclesPerUsec;
+    stats->p99_uSec  = (double)percentile(h, 99) / cyclesPerUsec;
+}
@@ -0,0 +1,122 @@
+/**
+ * @file one_wire_instrument.h
+ * @brief Optional latency instrumentation of each layer of the 1-Wire stack.
+ *
+ * Built with ONEWIRE_INSTRUMENT defined, each layer boundary (ENS210_T, DS28E18 commands,
+ * OneWire_Script_Execute, DS2485 port calls, and the NXP port's DMA transfers) times itself
+ * with a cycle counter and adds the duration to a per-operation histogram. Otherwise the
+ * hooks compile to nothing.
+ *
+ * Histograms are log-linear: 2^(ONEWIRE_INSTR_SUB_BITS-1) buckets per power of two, so a
+ * percentile is within about 1/2^(ONEWIRE_INSTR_SUB_BITS-1) of the true value. Recording
+ * an event is a count-leading-zeros, two compares and three increments. Only one context
+ * records each operation (the DMA operations from the interrupt, the others from the task),
+ * so no locking is needed; reading the statistics while events are recorded may see a
+ * partly updated histogram.
+ *
+ * Timestamps: the DWT cycle counter on Cortex-M (enabled by OneWire_Instr_Init), CLOCK_MONOTONIC
+ * nanoseconds elsewhere; or define ONEWIRE_INSTR_CYCLES() to supply another source.
+ */
+
+#ifndef ONE_WIRE_INSTRUMENT_H_INCLUDED
+#define ONE_WIRE_INSTRUMENT_H_INCLUDED
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+typedef enum {
+    ONEWIRE_INSTR_ENS210_INIT,
+    ONEWIRE_INSTR_ENS210_MEASURE,
+    ONEWIRE_INSTR_DS28E18_COMMAND,       ///< DS28E18 command other than Run Sequencer, including any retry
+    ONEWIRE_INSTR_DS28E18_RUN_SEQUENCER, ///< includes the strong pull-up delay while the sequence runs
+    ONEWIRE_INSTR_SCRIPT_EXECUTE,        ///< OneWire_Script_Execute
+    ONEWIRE_INSTR_DS2485_COMMAND,        ///< DS2485_ExecuteCommand: I2C write, execution delay, I2C read
+    ONEWIRE_INSTR_DS2485_POLL,           ///< DS2485_ReadResponse
+    ONEWIRE_INSTR_I2C_WRITE,             ///< DMA transfer, start to completion callback
+    ONEWIRE_INSTR_I2C_READ,
+    ONEWIRE_INSTR_OPS
+} OneWire_instr_op_T;
+
+#ifndef ONEWIRE_INSTR_SUB_BITS
+  #define ONEWIRE_INSTR_SUB_BITS 3
+#endif
+#define ONEWIRE_INSTR_BUCKETS ((32 - ONEWIRE_INSTR_SUB_BITS) * (1 << (ONEWIRE_INSTR_SUB_BITS - 1)) + (1 << ONEWIRE_INSTR_SUB_BITS))
+
+/// Histogram of one operation, in cycles
+typedef struct {
+    uint32_t count;
+    uint32_t min, max;
+    uint64_t sum;
+    uint32_t buckets[ONEWIRE_INSTR_BUCKETS];
+} OneWire_instr_histogram_T;
+
+/// Summary of one operation (OneWire_Instr_GetStats)
+typedef struct {
+    uint32_t count;
+    double min_uSec, max_uSec, mean_uSec;
+    double p50_uSec, p99_uSec; ///< upper bound of the histogram bucket holding the percentile
+} OneWire_instr_stats_T;
+
+extern OneWire_instr_histogram_T oneWireInstrHistograms[ONEWIRE_INSTR_OPS];
+
+/// Start the timestamp source; cyclesPerUsec converts cycles for OneWire_Instr_GetStats
+/// (e.g. SystemCoreClock/1000000 on Cortex-M, 1000 with the default host source).
+void OneWire_Instr_Init(uint32_t cyclesPerUsec);
+void OneWire_Instr_Reset(void);
+void OneWire_Instr_GetStats(OneWire_instr_op_T op, OneWire_instr_stats_T *stats);
+const char *OneWire_Instr_Name(OneWire_instr_op_T op);
+
+#if defined(ONEWIRE_INSTR_CYCLES)
+  static inline uint32_t OneWire_Instr_Cycles(void) { return ONEWIRE_INSTR_CYCLES(); }
+#elif defined(__ARM_ARCH)
+  static inline uint32_t OneWire_Instr_Cycles(void) { return *(volatile uint32_t *)0xE0001004UL; } // DWT_CYCCNT
+#else
+  uint32_t OneWire_Instr_Cycles(void);
+#endif
+
+static inline unsigned int OneWire_Instr_Bucket(uint32_t cycles)
+{
+    if (cycles < (1U << ONEWIRE_INSTR_SUB_BITS)) return cycles;
+    unsigned int shift = (31 - __builtin_clz(cycles)) - (ONEWIRE_INSTR_SUB_BITS - 1);
+    return (shift << (ONEWIRE_INSTR_SUB_BITS - 1)) + (cycles >> shift);
+}
+
+static inline void OneWire_Instr_Record(OneWire_instr_op_T op, uint32_t cycles)
+{
+    OneWire_instr_histogram_T *h = &oneWireInstrHistograms[op];
+    if (h->count == 0 || cycles < h->min) h->min = cycles;
+    if (cycles > h->max) h->max = cycles;
+    h->count++;
+    h->sum += cycles;
+    h->buckets[OneWire_Instr_Bucket(cycles)]++;
+}
+
+#ifdef ONEWIRE_INSTRUMENT
+  #define ONEWIRE_INSTR_BEGIN(start_)    uint32_t start_ = OneWire_Instr_Cycles()
+  #define ONEWIRE_INSTR_END(op_, start_) OneWire_Instr_Record((op_), OneWire_Instr_Cycles() - (start_))
+#else
+  #define ONEWIRE_INSTR_BEGIN(start_)
+  #define ONEWIRE_INSTR_END(op_, start_) ((void)0)
+#endif
+
+
+#ifdef __cplusplus
+}
+
+/// Times the enclosing scope (for functions with several returns)
+struct OneWire_InstrScope {
+    OneWire_instr_op_T op;
+    uint32_t start;
+    explicit OneWire_InstrScope(OneWire_instr_op_T op_) : op(op_), start(OneWire_Instr_Cycles()) {}
+    ~OneWire_InstrScope() { OneWire_Instr_Record(op, OneWire_Instr_Cycles() - start); }
+};
+#ifdef ONEWIRE_INSTRUMENT
+  #define ONEWIRE_INSTR_SCOPE(op_) OneWire_InstrScope instrScope_(op_)
+#else
+  #define ONEWIRE_INSTR_SCOPE(op_)
+#endif
+#endif
+#endif /* ONE_WIRE_INSTRUMENT_H_INCLUDED */
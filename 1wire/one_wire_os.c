@@ -0,0 +1,165 @@
+/**
+ * @file one_wire_os.c
+ * @brief Operating system services for platforms without FreeRTOS, and the target microsecond clock; see one_wire_os.h.
+ */
+
+#if defined(__linux__)
+  #define _GNU_SOURCE // recursive mutex initializer
+  #include <time.h>
+  #include <errno.h>
+#endif
+#include <stddef.h>
+#include <stdint.h>
+#include "one_wire_os.h"
+
+#if defined(ONEWIRE_OS_HOST)
+
+/* **** Locals **** */
+static pthread_mutex_t criticalMutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP; // critical sections may nest
+static bool simulatedClock;
+static uint64_t simulated_uSec;
+
+uint64_t OneWire_OS_Now_uSec(void)
+{
+    if (simulatedClock) return simulated_uSec;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000U + (uint64_t)ts.tv_nsec / 1000U;
+}
+
+void OneWire_OS_Delay_uSec(uint32_t uSec)
+{
+    if (simulatedClock)
+    {
+        simulated_uSec += uSec;
+        return;
+    }
+    struct timespec ts = { .tv_sec = uSec / 1000000U, .tv_nsec = (long)(uSec % 1000000U) * 1000 };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+    {
+    }
+}
+
+void OneWire_OS_UseSimulatedClock(bool simulated)
+{
+    simulatedClock = simulated;
+    simulated_uSec = 0;
+}
+
+uint32_t OneWire_OS_NowMsec(void)
+{
+    return (uint32_t)(OneWire_OS_Now_uSec() / 1000U);
+}
+
+void OneWire_OS_DelayMsec(uint32_t msec)
+{
+    OneWire_OS_Delay_uSec(msec * 1000U);
+}
+
+void OneWire_OS_EnterCritical(void)
+{
+    pthread_mutex_lock(&criticalMutex);
+}
+
+void OneWire_OS_ExitCritical(void)
+{
+    pthread_mutex_unlock(&criticalMutex);
+}
+
+#elif defined(ONEWIRE_OS_MAXIM)
+
+#include "mxc_device.h"
+#include "mxc_delay.h"
+#include "tmr.h"
+
+/* **** Locals **** */
+static uint32_t savedPrimask;
+static int criticalNesting;
+static bool msecTimerStarted;
+static uint32_t msecTicksPerSecond;
+static uint32_t msecLastCount;  // timer count when last read
+static uint32_t msecWraps;      // times the 32-bit count has wrapped since started
+
+// mxc_delay takes SysTick, so the millisecond clock is a free-running timer, started on first use
+uint32_t OneWire_OS_NowMsec(void)
+{
+    OneWire_OS_EnterCritical();
+    if (!msecTimerStarted)
+    {
+        const sys_cfg_tmr_t sys_tmr_cfg = NULL;
+        const tmr_cfg_t cfg = { .mode = TMR_MODE_CONTINUOUS, .cmp_cnt = 0xFFFFFFFFUL, .pol = TMR_POL_LOW };
+        TMR_Init(ONEWIRE_OS_MAXIM_TMR, ONEWIRE_OS_MAXIM_TMR_PRESCALE, &sys_tmr_cfg);
+        TMR_Config(ONEWIRE_OS_MAXIM_TMR, &cfg);
+        TMR_GetTicks(ONEWIRE_OS_MAXIM_TMR, 1, TMR_UNIT_SEC, &msecTicksPerSecond);
+        if (msecTicksPerSecond == 0) msecTicksPerSecond = 1;
+        TMR_Enable(ONEWIRE_OS_MAXIM_TMR);
+        msecTimerStarted = true;
+    }
+    uint32_t count = TMR_GetCount(ONEWIRE_OS_MAXIM_TMR);
+    if (count < msecLastCount) msecWraps++;
+    msecLastCount = count;
+    uint64_t ticks = ((uint64_t)msecWraps << 32) | count;
+    OneWire_OS_ExitCritical();
+    return (uint32_t)(ticks * 1000U / msecTicksPerSecond);
+}
+
+void OneWire_OS_DelayMsec(uint32_t msec)
+{
+    mxc_delay(MXC_DELAY_MSEC(msec));
+}
+
+void OneWire_OS_EnterCritical(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (criticalNesting++ == 0) savedPrimask = primask;
+}
+
+void OneWire_OS_ExitCritical(void)
+{
+    if (--criticalNesting == 0) __set_PRIMASK(savedPrimask);
+}
+
+#endif
+
+#if !defined(ONEWIRE_OS_HOST) && !defined(ONEWIRE_OS_NOW_USEC)
+
+// DWT cycle counter (Cortex-M3 and later), started on first use
+#define DEMCR       (*(volatile uint32_t *)0xE000EDFCUL)
+#define DWT_CTRL    (*(volatile uint32_t *)0xE0001000UL)
+#define DWT_CYCCNT  (*(volatile uint32_t *)0xE0001004UL)
+
+extern uint32_t SystemCoreClock; // CMSIS system_<device>.c
+
+/* **** Locals **** */
+static uint32_t countedCycles; // cycle count up to which nowUsec has been advanced
+static uint32_t nowUsec;
+
+uint32_t OneWire_OS_NowUsec(void)
+{
+    ONEWIRE_OS_ENTER_CRITICAL();
+    if (!(DWT_CTRL & 1U))
+    {
+        DEMCR |= 1U << 24; // TRCENA: enable DWT
+        DWT_CTRL |= 1U;    // CYCCNTENA
+        countedCycles = DWT_CYCCNT;
+    }
+    uint32_t cyclesPerUsec = SystemCoreClock / 1000000U;
+    if (cyclesPerUsec == 0) cyclesPerUsec = 1;
+    uint32_t elapsed = (DWT_CYCCNT - countedCycles) / cyclesPerUsec;
+    countedCycles += elapsed * cyclesPerUsec; // the part of a microsecond left over counts next time
+    nowUsec += elapsed;
+    uint32_t now = nowUsec;
+    ONEWIRE_OS_EXIT_CRITICAL();
+    return now;
+}
+
+void OneWire_OS_DelayUsec(uint32_t usec)
+{
+    uint32_t start = OneWire_OS_NowUsec();
+    while (OneWire_OS_NowUsec() - start < usec)
+    {
+    }
+}
+
+#endif
@@ -0,0 +1,125 @@
+/**
+ * @file one_wire_os.h
+ * @brief Operating system services used by the 1-Wire stack and the ENS210 driver.
+ *
+ * The stack needs a millisecond clock, a task delay, a microsecond clock and spin delay (to time
+ * and poll DS2485 commands), short critical sections, and (ENS210_T) a mutex. They are provided here for:
+ * - FreeRTOS (default on targets)
+ * - Maxim bare-metal, with USE_MAXIM_DEFINITIONS: a timer counts milliseconds, delays spin, interrupts masked
+ * - hosts (Linux), with ONEWIRE_OS_HOST (default on Linux): POSIX clock and pthreads
+ *
+ * Define ONEWIRE_OS_FREERTOS, ONEWIRE_OS_MAXIM or ONEWIRE_OS_HOST to choose explicitly.
+ * The DS2485 ports are platform code and use their platform's services directly.
+ *
+ * The microsecond clock is the DWT cycle counter at SystemCoreClock on Cortex-M targets; define
+ * ONEWIRE_OS_NOW_USEC() and ONEWIRE_OS_DELAY_USEC() to use a hardware timer instead.
+ *
+ * On a host the clock can be simulated (OneWire_OS_UseSimulatedClock): delays then advance
+ * the clock instead of sleeping, so the simulator port runs long workloads in CPU time.
+ */
+
+#ifndef ONE_WIRE_OS_H_INCLUDED
+#define ONE_WIRE_OS_H_INCLUDED
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if !defined(ONEWIRE_OS_FREERTOS) && !defined(ONEWIRE_OS_MAXIM) && !defined(ONEWIRE_OS_HOST)
+  #if defined(USE_MAXIM_DEFINITIONS)
+    #define ONEWIRE_OS_MAXIM
+  #elif defined(__linux__)
+    #define ONEWIRE_OS_HOST
+  #else
+    #define ONEWIRE_OS_FREERTOS
+  #endif
+#endif
+
+#if defined(ONEWIRE_OS_FREERTOS)
+  #include "FreeRTOS.h"
+  #include "task.h"
+  #include "semphr.h"
+#elif defined(ONEWIRE_OS_HOST)
+  #include <pthread.h>
+#endif
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#if defined(ONEWIRE_OS_FREERTOS)
+
+  #define ONEWIRE_OS_NOW_MSEC()           ((uint32_t)(xTaskGetTickCount() * portTICK_PERIOD_MS))
+  #define ONEWIRE_OS_DELAY_MSEC(msec_)    vTaskDelay(pdMS_TO_TICKS(msec_))
+  #define ONEWIRE_OS_ENTER_CRITICAL()     taskENTER_CRITICAL()
+  #define ONEWIRE_OS_EXIT_CRITICAL()      taskEXIT_CRITICAL()
+
+  typedef struct {
+      StaticSemaphore_t buffer;
+      SemaphoreHandle_t handle;
+  } OneWire_OS_mutex_T;
+  static inline void OneWire_OS_MutexInit(OneWire_OS_mutex_T *m)   { m->handle = xSemaphoreCreateMutexStatic(&m->buffer); }
+  static inline void OneWire_OS_MutexLock(OneWire_OS_mutex_T *m)   { xSemaphoreTake(m->handle, portMAX_DELAY); }
+  static inline void OneWire_OS_MutexUnlock(OneWire_OS_mutex_T *m) { xSemaphoreGive(m->handle); }
+
+#else // implemented in one_wire_os.c
+
+  uint32_t OneWire_OS_NowMsec(void);
+  void OneWire_OS_DelayMsec(uint32_t msec);
+  void OneWire_OS_EnterCritical(void);
+  void OneWire_OS_ExitCritical(void);
+  #define ONEWIRE_OS_NOW_MSEC()           OneWire_OS_NowMsec()
+  #define ONEWIRE_OS_DELAY_MSEC(msec_)    OneWire_OS_DelayMsec(msec_)
+  #define ONEWIRE_OS_ENTER_CRITICAL()     OneWire_OS_EnterCritical()
+  #define ONEWIRE_OS_EXIT_CRITICAL()      OneWire_OS_ExitCritical()
+
+  #if defined(ONEWIRE_OS_MAXIM)
+    #ifndef ONEWIRE_OS_MAXIM_TMR
+      #define ONEWIRE_OS_MAXIM_TMR           MXC_TMR1      // timer OneWire_OS_NowMsec runs free, reserved for it
+    #endif
+    #ifndef ONEWIRE_OS_MAXIM_TMR_PRESCALE
+      #define ONEWIRE_OS_MAXIM_TMR_PRESCALE  TMR_PRES_4096 // at a 48 MHz peripheral clock the count wraps after 4 days; read it more often
+    #endif
+  #endif
+
+  #if defined(ONEWIRE_OS_HOST)
+    typedef struct {
+        pthread_mutex_t mutex;
+    } OneWire_OS_mutex_T;
+    static inline void OneWire_OS_MutexInit(OneWire_OS_mutex_T *m)   { pthread_mutex_init(&m->mutex, NULL); }
+    static inline void OneWire_OS_MutexLock(OneWire_OS_mutex_T *m)   { pthread_mutex_lock(&m->mutex); }
+    static inline void OneWire_OS_MutexUnlock(OneWire_OS_mutex_T *m) { pthread_mutex_unlock(&m->mutex); }
+
+    /// Microsecond clock, real (CLOCK_MONOTONIC) or simulated
+    uint64_t OneWire_OS_Now_uSec(void);
+    /// Sleep, or with the simulated clock advance it
+    void OneWire_OS_Delay_uSec(uint32_t uSec);
+    /// Switch to a simulated clock (starting at 0) or back to the real one
+    void OneWire_OS_UseSimulatedClock(bool simulated);
+  #else // no RTOS: one thread of execution, nothing to exclude
+    typedef struct {
+        uint8_t unused;
+    } OneWire_OS_mutex_T;
+    static inline void OneWire_OS_MutexInit(OneWire_OS_mutex_T *m)   { (void)m; }
+    static inline void OneWire_OS_MutexLock(OneWire_OS_mutex_T *m)   { (void)m; }
+    static inline void OneWire_OS_MutexUnlock(OneWire_OS_mutex_T *m) { (void)m; }
+  #endif
+
+#endif
+
+#if defined(ONEWIRE_OS_HOST)
+  #define ONEWIRE_OS_NOW_USEC()           ((uint32_t)OneWire_OS_Now_uSec())
+  #define ONEWIRE_OS_DELAY_USEC(usec_)    OneWire_OS_Delay_uSec(usec_)
+#elif !defined(ONEWIRE_OS_NOW_USEC)
+  /// Microseconds, wrapping at 2^32, for timing short intervals. Call at least once per 2^32
+  /// CPU cycles (several seconds) for it to run on continuously.
+  uint32_t OneWire_OS_NowUsec(void);
+  /// Spin for usec: for waits shorter than a system tick
+  void OneWire_OS_DelayUsec(uint32_t usec);
+  #define ONEWIRE_OS_NOW_USEC()           OneWire_OS_NowUsec()
+  #define ONEWIRE_OS_DELAY_USEC(usec_)    OneWire_OS_DelayUsec(usec_)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* ONE_WIRE_OS_H_INCLUDED */
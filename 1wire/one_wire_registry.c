@@ -0,0 +1,103 @@
+/**
+ * @file one_wire_registry.c
+ * @brief 1-Wire device registry, see one_wire_registry.h.
+ *
+ * ROM ID to handle lookup is an open-addressed hash table with linear probing,
+ * twice the size of the registry so probe sequences stay short.
+ * Removal uses backward-shift deletion, so there are no tombstones to degrade lookups.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "one_wire_registry.h"
+
+#define HASH_SIZE (2*ONEWIRE_REGISTRY_MAX)
+#define HASH_MASK (HASH_SIZE - 1)
+_Static_assert((ONEWIRE_REGISTRY_MAX & (ONEWIRE_REGISTRY_MAX - 1)) == 0, "ONEWIRE_REGISTRY_MAX must be a power of 2");
+
+/* **** Globals **** */
+OneWire_device_T oneWireRegistry[ONEWIRE_REGISTRY_MAX];
+
+/* **** Locals **** */
+static OneWire_handle_T hashIndex[HASH_SIZE]; // handle, or ONEWIRE_HANDLE_INVALID for an empty slot
+static OneWire_handle_T freeList[ONEWIRE_REGISTRY_MAX]; // stack of unused handles
+static int freeCount;
+static bool initialized;
+
+static void initialize(void)
+{
+    for (int i = 0; i < HASH_SIZE; i++) hashIndex[i] = ONEWIRE_HANDLE_INVALID;
+    // Push in reverse so handles are handed out from 0 upward
+    for (int i = 0; i < ONEWIRE_REGISTRY_MAX; i++) freeList[i] = ONEWIRE_REGISTRY_MAX - 1 - i;
+    freeCount = ONEWIRE_REGISTRY_MAX;
+    initialized = true;
+}
+
+static unsigned int hashRomID(const OneWire_ROM_ID_T *romID)
+{
+    uint64_t key = 0;
+    for (int i = 0; i < 8; i++) key |= (uint64_t)romID->ID[i] << (8*i);
+    return (unsigned int)((key * 0x9E3779B97F4A7C15ULL) >> 40) & HASH_MASK; // Fibonacci hashing
+}
+
+// Hash slot holding romID, or the empty slot where it would go
+static unsigned int findSlot(const OneWire_ROM_ID_T *romID)
+{
+    unsigned int slot = hashRomID(romID);
+    while (hashIndex[slot] != ONEWIRE_HANDLE_INVALID &&
+           memcmp(oneWireRegistry[hashIndex[slot]].romID.ID, romID->ID, sizeof(romID->ID)) != 0)
+    {
+        slot = (slot + 1) & HASH_MASK;
+    }
+    return slot;
+}
+
+OneWire_handle_T OneWire_Registry_Add(uint8_t bus, const OneWire_ROM_ID_T *romID)
+{
+    if (!initialized) initialize();
+    unsigned int slot = findSlot(romID);
+    if (hashIndex[slot] != ONEWIRE_HANDLE_INVALID) return hashIndex[slot]; // already registered
+    if (freeCount == 0) return ONEWIRE_HANDLE_INVALID;
+
+    OneWire_handle_T handle = freeList[--freeCount];
+    OneWire_device_T *device = &oneWireRegistry[handle];
+    memset(device, 0, sizeof(*device));
+    device->romID = *romID;
+    device->bus = bus;
+    device->family = romID->ID[0];
+    device->speedCapability = ONEWIRE_SPEED_UNTESTED;
+    device->inUse = true;
+    hashIndex[slot] = handle;
+    return handle;
+}
+
+OneWire_handle_T OneWire_Registry_Find(const OneWire_ROM_ID_T *romID)
+{
+    if (!initialized) return ONEWIRE_HANDLE_INVALID;
+    return hashIndex[findSlot(romID)];
+}
+
+void OneWire_Registry_Remove(OneWire_handle_T handle)
+{
+    OneWire_device_T *device = OneWire_Registry_Get(handle);
+    if (!device) return;
+
+    // Backward-shift deletion: move later entries of the probe sequence into the hole
+    // unless that would put them before their home slot
+    unsigned int hole = findSlot(&device->romID);
+    unsigned int next = (hole + 1) & HASH_MASK;
+    while (hashIndex[next] != ONEWIRE_HANDLE_INVALID)
+    {
+        unsigned int home = hashRomID(&oneWireRegistry[hashIndex[next]].romID);
+        if (((next - home) & HASH_MASK) >= ((next - hole) & HASH_MASK))
+        {
+            hashIndex[hole] = hashIndex[next];
+            hole = next;
+        }
+        next = (next + 1) & HASH_MASK;
+    }
+    hashIndex[hole] = ONEWIRE_HANDLE_INVALID;
+
+    device->inUse = false;
+    freeList[freeCount++] = handle;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file one_wire_registry.h
+ * @brief Registry of 1-Wire devices, addressed by compact integer handles.
+ *
+ * Each registered device gets a small handle which indexes its entry directly;
+ * looking up the handle for a ROM ID uses a hash index, so neither direction
+ * scans the device list. Drivers take handles rather than ROM IDs.
+ */
+
+#ifndef ONE_WIRE_REGISTRY_H_INCLUDED
+#define ONE_WIRE_REGISTRY_H_INCLUDED
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "one_wire_address.h"
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#ifndef ONEWIRE_REGISTRY_MAX
+  #define ONEWIRE_REGISTRY_MAX 128 // devices, all buses; must be a power of 2
+#endif
+
+/// OneWire_handle_T identifies a registered device
+typedef int16_t OneWire_handle_T;
+#define ONEWIRE_HANDLE_INVALID      ((OneWire_handle_T)-1)
+#define ONEWIRE_HANDLE_ALL_DEVICES  ((OneWire_handle_T)-2) // address every device on the bus (Skip ROM)
+
+typedef enum {
+    ONEWIRE_SPEED_UNTESTED = 0,
+    ONEWIRE_SPEED_STANDARD_ONLY,
+    ONEWIRE_SPEED_OVERDRIVE_OK,
+} OneWire_speed_capability_T;
+
+/// Registry entry for one device
+typedef struct {
+    OneWire_ROM_ID_T romID;
+    uint8_t bus;             ///< DS2485 (1-Wire master) the device is attached to
+    uint8_t family;          ///< romID.ID[0]
+    uint8_t speedCapability; ///< OneWire_speed_capability_T
+    uint8_t overdriveFailures; ///< consecutive failed overdrive transactions (maintained by the driver)
+    bool inUse;
+    uint32_t lastSeenMS;     ///< time of last successful transaction (maintained by the driver)
+    void *driverState;       ///< owned by the driver or application using the device
+} OneWire_device_T;
+
+/***** Globals *****/
+
+extern OneWire_device_T oneWireRegistry[ONEWIRE_REGISTRY_MAX]; // use OneWire_Registry_Get()
+
+
+/***** API *****/
+
+/// Register a device, or return its existing handle. Returns ONEWIRE_HANDLE_INVALID if the registry is full.
+OneWire_handle_T OneWire_Registry_Add(uint8_t bus, const OneWire_ROM_ID_T *romID);
+/// Handle for a ROM ID, or ONEWIRE_HANDLE_INVALID if not registered.
+OneWire_handle_T OneWire_Registry_Find(const OneWire_ROM_ID_T *romID);
+/// Forget a device; its handle may be reused by a later Add.
+void OneWire_Registry_Remove(OneWire_handle_T handle);
+/// Entry for a handle, or NULL if the handle is not in use.
+static inline OneWire_device_T *OneWire_Registry_Get(OneWire_handle_T handle)
+{
+    if (handle < 0 || handle >= ONEWIRE_REGISTRY_MAX || !oneWireRegistry[handle].inUse) return 0;
+    return &oneWireRegistry[handle];
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* ONE_WIRE_REGISTRY_H_INCLUDED */
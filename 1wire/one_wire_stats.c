@@ -0,0 +1,62 @@
+/**
+ * @file one_wire_stats.c
+ * @brief Per-bus health and throughput counters, see one_wire_stats.h.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "one_wire_stats.h"
+#include "one_wire_os.h"
+
+#if defined(ONEWIRE_STATS_ENTER_CRITICAL) // application-supplied, with ONEWIRE_STATS_EXIT_CRITICAL()
+  #define ENTER_CRITICAL() ONEWIRE_STATS_ENTER_CRITICAL()
+  #define EXIT_CRITICAL()  ONEWIRE_STATS_EXIT_CRITICAL()
+#else
+  #define ENTER_CRITICAL() ONEWIRE_OS_ENTER_CRITICAL()
+  #define EXIT_CRITICAL()  ONEWIRE_OS_EXIT_CRITICAL()
+#endif
+
+/* **** Globals **** */
+OneWire_bus_stats_T oneWireBusStats[ONEWIRE_STATS_MAX_BUSES];
+uint8_t oneWireStatsBus;
+
+/* **** Locals **** */
+static uint32_t intervalStart_msec[ONEWIRE_STATS_MAX_BUSES];
+
+void OneWire_Stats_Lock(void)
+{
+    ENTER_CRITICAL();
+}
+
+void OneWire_Stats_Unlock(void)
+{
+    EXIT_CRITICAL();
+}
+
+int OneWire_Stats_SelectBus(int bus)
+{
+    if (bus < 0 || bus >= ONEWIRE_STATS_MAX_BUSES) return 1;
+    OneWire_Stats_Lock();
+    oneWireStatsBus = (uint8_t)bus;
+    OneWire_Stats_Unlock();
+    return 0;
+}
+
+void OneWire_Stats_Snapshot(int bus, OneWire_bus_stats_T *stats, bool reset)
+{
+    if (bus < 0 || bus >= ONEWIRE_STATS_MAX_BUSES)
+    {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    uint32_t now = ONEWIRE_OS_NOW_MSEC();
+    OneWire_Stats_Lock();
+    *stats = oneWireBusStats[bus];
+    stats->interval_msec = now - intervalStart_msec[bus];
+    if (reset)
+    {
+        memset(&oneWireBusStats[bus], 0, sizeof(oneWireBusStats[bus]));
+        intervalStart_msec[bus] = now;
+    }
+    OneWire_Stats_Unlock();
+}
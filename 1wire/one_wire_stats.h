@@ -0,0 +1,72 @@
+/**
+ * @file one_wire_stats.h
+ * @brief Per-bus health and throughput counters for the 1-Wire stack.
+ *
+ * one_wire.c, DS2485.c and DS28E18.c count traffic and errors into the statistics block
+ * of the current bus. The library drives one DS2485 at a time; an application with several
+ * buses calls OneWire_Stats_SelectBus() whenever it switches the port to another DS2485
+ * (e.g. with DS2485_Linux_SelectBus).
+ *
+ * Bytes and resets are counted per script when the script has run successfully. Busy time is
+ * the analytic 1-Wire time of each DS2485 1-Wire command (the estimate DS2485.c waits for),
+ * plus the strong pull-up time while a DS28E18 runs a command, so busy_uSec / (1000 * interval_msec)
+ * is the bus utilization.
+ *
+ * Each update and OneWire_Stats_Snapshot() run in a short critical section, so a snapshot taken
+ * by another task (optionally resetting the counters) never sees or loses part of an update.
+ */
+
+#ifndef ONE_WIRE_STATS_H_INCLUDED
+#define ONE_WIRE_STATS_H_INCLUDED
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#ifndef ONEWIRE_STATS_MAX_BUSES
+  #define ONEWIRE_STATS_MAX_BUSES 1
+#endif
+
+/// Counters of one bus since it was last reset. Byte counts are indexed by one_wire_speeds.
+typedef struct {
+    uint32_t resets;            ///< 1-Wire resets, including those of Skip and Overdrive Skip ROM
+    uint32_t presenceFailures;  ///< resets without a presence pulse
+    uint32_t bytesWritten[2];   ///< [STANDARD], [OVERDRIVE]
+    uint32_t bytesRead[2];
+    uint32_t scripts;           ///< 1-Wire scripts run successfully
+    uint32_t scriptErrors;      ///< scripts the DS2485 failed or did not answer
+    uint32_t searches;          ///< search passes
+    uint32_t retries;           ///< repeated reset scripts, DS28E18 commands repeated at standard speed
+    uint32_t crcFailures;       ///< DS28E18 command or response with an invalid CRC16
+    uint32_t sequencerNacks;    ///< DS28E18 sequences ended by an I2C NACK
+    uint32_t lastNackOffset;    ///< sequencer address of the most recent NACK
+    uint32_t porEvents;         ///< DS28E18 power-on resets (sequencer memory lost)
+    uint32_t sequencerBytesSkipped;   ///< DS28E18 sequencer bytes not uploaded as the device already held them
+    uint32_t sequencerUploadsSkipped; ///< DS28E18_BuildPacket_WriteAndRun uploads skipped entirely
+    uint64_t busy_uSec;         ///< 1-Wire busy time
+    uint32_t interval_msec;     ///< wall time since the counters were reset (set by OneWire_Stats_Snapshot)
+} OneWire_bus_stats_T;
+
+/// Count further activity on 'bus' (0..ONEWIRE_STATS_MAX_BUSES-1). Returns 0, or 1 if out of range.
+int OneWire_Stats_SelectBus(int bus);
+/// Copy the counters of 'bus', and with 'reset' zero them and start a new interval, in one step.
+void OneWire_Stats_Snapshot(int bus, OneWire_bus_stats_T *stats, bool reset);
+
+/***** Used by the 1-Wire stack *****/
+
+extern OneWire_bus_stats_T oneWireBusStats[ONEWIRE_STATS_MAX_BUSES];
+extern uint8_t oneWireStatsBus;
+void OneWire_Stats_Lock(void);
+void OneWire_Stats_Unlock(void);
+
+#define ONEWIRE_STATS_ADD(field_, n_) \
+    do { OneWire_Stats_Lock(); oneWireBusStats[oneWireStatsBus].field_ += (n_); OneWire_Stats_Unlock(); } while (0)
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* ONE_WIRE_STATS_H_INCLUDED */
@@ -0,0 +1,203 @@
+/**
+ * @file one_wire_watch.c
+ * @brief Incremental 1-Wire hot-plug detection, see one_wire_watch.h.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "one_wire.h"
+#include "DS2485.h" // RB_ result codes
+#include "one_wire_watch.h"
+
+#define MAX_BRANCHES 16 // unexplained branches searched per poll; more are picked up by the next poll
+
+typedef struct {
+    OneWire_ROM_ID_T prefix;
+    int bits;
+} branch_T;
+
+typedef enum {
+    SEEN_NOT,       // not verified this poll
+    SEEN_PRESENT,   // its search pass completed
+    SEEN_ABSENT,    // its search pass diverged, or another pass found its branch empty
+} seen_T;
+
+/* **** Locals **** */
+static OneWire_ROM_ID_T knownDevices[ONEWIRE_WATCH_MAX];
+static uint8_t knownMisses[ONEWIRE_WATCH_MAX];
+static uint8_t verified[ONEWIRE_WATCH_MAX]; // seen_T, this poll
+static int knownCount;
+static int nextVerify;              // known device whose turn to be verified is next
+static OneWire_ROM_ID_T rootPrefix; // family code, if watching one family
+static int rootBits;                // 8 if watching one family, else 0
+static OneWire_watch_callback_T eventCallback;
+static branch_T branches[MAX_BRANCHES];
+static int branchCount;
+static OneWire_ROM_ID_T foundDevices[ONEWIRE_WATCH_MAX];
+
+static bool prefixMatches(const OneWire_ROM_ID_T *a, const OneWire_ROM_ID_T *b, int bits)
+{
+    for (int bit = 0; bit < bits; bit++)
+    {
+        if (((a->ID[bit/8] ^ b->ID[bit/8]) >> (bit%8)) & 1) return false;
+    }
+    return true;
+}
+
+static int findKnown(const OneWire_ROM_ID_T *romid)
+{
+    for (int i = 0; i < knownCount; i++)
+    {
+        if (memcmp(knownDevices[i].ID, romid->ID, sizeof(romid->ID)) == 0) return i;
+    }
+    return -1;
+}
+
+// Is any known device (present or not) in the subtree below this prefix?
+static bool knownInSubtree(const OneWire_ROM_ID_T *prefix, int bits)
+{
+    for (int i = 0; i < knownCount; i++)
+    {
+        if (prefixMatches(&knownDevices[i], prefix, bits)) return true;
+    }
+    return false;
+}
+
+// Every known device in the subtree below this prefix is missing
+static void markAbsent(const OneWire_ROM_ID_T *prefix, int bits)
+{
+    for (int i = 0; i < knownCount; i++)
+    {
+        if (verified[i] == SEEN_NOT && prefixMatches(&knownDevices[i], prefix, bits)) verified[i] = SEEN_ABSENT;
+    }
+}
+
+static void addBranch(const OneWire_ROM_ID_T *prefix, int bits)
+{
+    for (int i = 0; i < branchCount; i++)
+    {
+        if (branches[i].bits == bits && prefixMatches(&branches[i].prefix, prefix, bits)) return; // already queued
+    }
+    if (branchCount < MAX_BRANCHES)
+    {
+        branches[branchCount].prefix = *prefix;
+        branches[branchCount].bits = bits;
+        branchCount++;
+    }
+}
+
+void OneWire_Watch_Start(const OneWire_ROM_ID_T *known, int count, int familyCode, OneWire_watch_callback_T callback)
+{
+    knownCount = (count < ONEWIRE_WATCH_MAX) ? count : ONEWIRE_WATCH_MAX;
+    memcpy(knownDevices, known, knownCount * sizeof(knownDevices[0]));
+    memset(knownMisses, 0, sizeof(knownMisses));
+    nextVerify = 0;
+    memset(&rootPrefix, 0, sizeof(rootPrefix));
+    rootBits = 0;
+    if (familyCode != ONEWIRE_FAMILY_ANY)
+    {
+        rootPrefix.ID[0] = (uint8_t)familyCode;
+        rootBits = 8;
+    }
+    eventCallback = callback;
+}
+
+// Search along one known device's ROM ID. The pass verifies it; at each bit of the path it also shows
+// whether any device lies on the other side: if none, known devices there are gone, and if some but
+// no known device is there, the branch is queued to be searched.
+static int verifyKnown(int d)
+{
+    int error = 0;
+    OneWire_search_pass_T pass;
+    OneWire_ROM_ID_T romid = knownDevices[d];
+
+    if ((error = OneWire_SearchPass(&romid, 64, ONEWIRE_SEARCH_NORMAL, &pass)) != 0) return error;
+    verified[d] = (!pass.noDevices && pass.divergedBit < 0) ? SEEN_PRESENT : SEEN_ABSENT;
+    if (pass.noDevices) return 0;
+
+    int lastBit = (pass.divergedBit >= 0) ? pass.divergedBit : 63;
+    for (int bit = rootBits; bit <= lastBit; bit++)
+    {
+        OneWire_ROM_ID_T branch = knownDevices[d];
+        branch.ID[bit/8] ^= (1 << (bit%8));
+        // At divergedBit only the other side responded; elsewhere a discrepancy means both did
+        bool otherSideResponded = (bit == pass.divergedBit) || ((pass.discrepancies >> bit) & 1);
+        if (!otherSideResponded) markAbsent(&branch, bit+1);
+        else if (!knownInSubtree(&branch, bit+1)) addBranch(&branch, bit+1);
+    }
+    if (pass.divergedBit >= 0) markAbsent(&knownDevices[d], pass.divergedBit+1); // nothing on this side
+    return 0;
+}
+
+int OneWire_Watch_Poll(void)
+{
+    int error = 0;
+    int passes = 0;
+    int passesMax = (ONEWIRE_WATCH_PASSES_PER_POLL > 0) ? ONEWIRE_WATCH_PASSES_PER_POLL : ONEWIRE_WATCH_MAX;
+
+    branchCount = 0;
+    memset(verified, SEEN_NOT, sizeof(verified));
+    if (knownCount == 0)
+    {
+        addBranch(&rootPrefix, rootBits); // nothing known yet: search everything being watched
+    }
+
+    // Devices that missed last time first, then the rest in turn
+    for (int d = 0; d < knownCount && passes < passesMax; d++)
+    {
+        if (knownMisses[d] == 0 || verified[d] != SEEN_NOT) continue;
+        if ((error = verifyKnown(d)) != 0) return error;
+        passes++;
+    }
+    for (int n = 0; n < knownCount && passes < passesMax; n++)
+    {
+        int d = (nextVerify + n) % knownCount;
+        if (verified[d] != SEEN_NOT) continue;
+        if ((error = verifyKnown(d)) != 0) return error;
+        passes++;
+        nextVerify = d + 1;
+    }
+
+    // Report and forget devices that have failed verification repeatedly
+    int kept = 0;
+    for (int d = 0; d < knownCount; d++)
+    {
+        if (verified[d] == SEEN_PRESENT) knownMisses[d] = 0;
+        else if (verified[d] == SEEN_ABSENT) knownMisses[d]++;
+        if (knownMisses[d] >= ONEWIRE_WATCH_MISSES_TO_REMOVE)
+        {
+            if (eventCallback) eventCallback(ONEWIRE_WATCH_REMOVED, &knownDevices[d]);
+            if (d < nextVerify) nextVerify--;
+            continue;
+        }
+        knownDevices[kept] = knownDevices[d];
+        knownMisses[kept] = knownMisses[d];
+        kept++;
+    }
+    knownCount = kept;
+    if (nextVerify >= knownCount) nextVerify = 0;
+
+    // Search only the unexplained branches
+    for (int b = 0; b < branchCount; b++)
+    {
+        int foundCount = 0;
+        error = OneWire_SearchSubtree(&branches[b].prefix, branches[b].bits, ONEWIRE_SEARCH_NORMAL,
+                                      foundDevices, ONEWIRE_WATCH_MAX, &foundCount);
+        if (error && error != RB_TABLE_FULL) return error; // a full list is taken as is; the rest are found by later polls
+        for (int i = 0; i < foundCount && knownCount < ONEWIRE_WATCH_MAX; i++)
+        {
+            if (findKnown(&foundDevices[i]) >= 0) continue;
+            knownDevices[knownCount] = foundDevices[i];
+            knownMisses[knownCount] = 0;
+            knownCount++;
+            if (eventCallback) eventCallback(ONEWIRE_WATCH_ADDED, &foundDevices[i]);
+        }
+    }
+    return 0;
+}
+
+int OneWire_Watch_GetDevices(const OneWire_ROM_ID_T **devices)
+{
+    *devices = knownDevices;
+    return knownCount;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file one_wire_watch.h
+ * @brief Detect devices added to or removed from a 1-Wire bus without re-enumerating it.
+ *
+ * Each OneWire_Watch_Poll() verifies up to ONEWIRE_WATCH_PASSES_PER_POLL known devices,
+ * in turn, with a search pass forced along the ROM ID. The same pass shows where other
+ * devices branch off that path: a branch containing no known device must hold a new
+ * device, and only that subtree is searched; a branch where nothing answered means
+ * the known devices there are gone. A poll therefore costs a few passes however many
+ * devices are on the bus, where a full search costs one per device. Every device is
+ * verified at least once per ceil(devices / ONEWIRE_WATCH_PASSES_PER_POLL) polls, and
+ * one that missed is verified again first.
+ * (A Match ROM gets no answer from the selected device, so it cannot confirm presence.)
+ * Known devices are never re-enumerated or re-initialized.
+ *
+ * The watch does no locking and has no task of its own: call OneWire_Watch_Poll()
+ * periodically from the task that owns the 1-Wire bus, with the bus at the speed of
+ * every device (after DS28E18 transactions, DS28E18_SetOnewireSpeed(STANDARD)).
+ */
+
+#ifndef ONE_WIRE_WATCH_H_INCLUDED
+#define ONE_WIRE_WATCH_H_INCLUDED
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "one_wire_address.h"
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#ifndef ONEWIRE_WATCH_MAX
+  #define ONEWIRE_WATCH_MAX 64 // maximum number of devices watched
+#endif
+#ifndef ONEWIRE_WATCH_PASSES_PER_POLL
+  #define ONEWIRE_WATCH_PASSES_PER_POLL 4 // known devices verified by a search pass each poll; 0: all of them
+#endif
+#ifndef ONEWIRE_WATCH_MISSES_TO_REMOVE
+  #define ONEWIRE_WATCH_MISSES_TO_REMOVE 2 // consecutive failed verifications before a device is reported removed
+#endif
+
+typedef enum {
+    ONEWIRE_WATCH_ADDED,
+    ONEWIRE_WATCH_REMOVED,
+} OneWire_watch_event_T;
+
+typedef void (*OneWire_watch_callback_T)(OneWire_watch_event_T event, const OneWire_ROM_ID_T *romid);
+
+/// Start watching with 'known' devices already present (no events are sent for these).
+/// familyCode: ONEWIRE_FAMILY_ANY, or only watch devices of this family.
+void OneWire_Watch_Start(const OneWire_ROM_ID_T *known, int count, int familyCode, OneWire_watch_callback_T callback);
+/// Verify known devices and look for new ones, calling the callback for each change.
+/// Returns 0, or the DS2485 error which stopped the poll (changes found so far have been reported).
+int OneWire_Watch_Poll(void);
+/// Current device list; returns number of devices.
+int OneWire_Watch_GetDevices(const OneWire_ROM_ID_T **devices);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* ONE_WIRE_WATCH_H_INCLUDED */
@@ -48,15 +48,13 @@
 #include <assert.h>
 #include <stdio.h> // Diagnostic printf
 
-// FreeRTOS APIs for QwikTest() only
-#include "FreeRTOS.h"
-#include "task.h"
-
 #include "ENS210.hpp" // public interface for this class
 
 // Maxim 1-Wire
 #include "1wire/one_wire.h"
 #include "1wire/DS28E18.h"
+#include "1wire/one_wire_instrument.h"
+#include "1wire/one_wire_os.h" // result timestamps, MeasureCached(), and QwikTest()
 
 
 // ==========  Internal ENS210 definitions (not part of public interface)  ==========
@@ -84,6 +82,10 @@ static const uint8_t ENS210_setActive[] =
 	{ ENS210_I2C_SlaveAddressShifted, ENS210_REG_SYS_CTRL, 0x00};// Disable low-power (device stays active): SYS_CTRL = x00
 static const uint8_t ENS210_setContinuousAndStart[] =
 	{ ENS210_I2C_SlaveAddressShifted, ENS210_REG_SENS_RUN, 0x03, 0x03};// SENS_RUN=3 SENS_START=3 enables and starts both temperature and humidity
+static const uint8_t ENS210_setLowPower[] =
+	{ ENS210_I2C_SlaveAddressShifted, ENS210_REG_SYS_CTRL, 0x01};// Enable low-power (device goes to standby between single-shot conversions): SYS_CTRL = x01
+static const uint8_t ENS210_startSingleShot[] =
+	{ ENS210_I2C_SlaveAddressShifted, ENS210_REG_SENS_RUN, 0x00, 0x03};// SENS_RUN=0 SENS_START=3 starts one single-shot conversion of both temperature and humidity
 
 // dataStream first byte is starting register, followed by register value(s)
 void ENS210_T::writeRegisters(const uint8_t *dataStream, int len) {
@@ -109,27 +111,49 @@ int ENS210_T::readRegisters(uint8_t firstRegister, int len) {
 	//printf("result at index %d\n", resultIdx);
 	return resultIdx;
 }
+// DS28E18 delay argument is a power-of-two exponent; append one delay per set bit of 'ms' so the total is exactly 'ms'.
+void ENS210_T::appendDelayMS(int ms) {
+	for(int exponent=DELAY_32768msec; exponent>=DELAY_1msec; exponent--) {
+		if(ms & (1<<exponent)) DS28E18_BuildPacket_Utility_Delay((DS28E18_utility_delay_T)exponent);
+	}
+}
+
+
+bool ENS210_T::busInitOK = false;
+
+// Bring up the 1-Wire bus and find its DS28E18s, once for all probes; retried by the next Init if it fails
+bool ENS210_T::initBus() {
+	if(busInitOK) return true;
+	// Initialize Maxim 1-Wire library (beneath the hood, initializes I2C to DS2485 and DS2485)
+	int OneWireInitError = OneWire_Init();
+	assert(OneWireInitError==0);
+	if(OneWireInitError) return false;
 
+    // DS28E18 VDD_SENS (DS28E18 power to the sensor) requires 'Strong Pull-Up' 'SPU' on 1-Wire bus.
+    // That's turned on with DS2485 1-Wire Master Configuration (Register 0) Bit 13: Strong Pullup (SPU).
+	int SPUerror = OneWire_Enable_SPU(true); // DS2485 must provide strong power to 1-Wire bus
+	assert(SPUerror==0);
+	if(SPUerror) return false;
+
+	int ds28e18Count = DS28E18_InitWarm();
+	assert(ds28e18Count > 0);
+	if(ds28e18Count <= 0) return false;
+	busInitOK = true;
+	return true;
+}
 
 bool ENS210_T::Init() {
+	ONEWIRE_INSTR_SCOPE(ONEWIRE_INSTR_ENS210_INIT);
 	initOK = false;
 	do {
-		// Initialize Maxim 1-Wire library (beneath the hood, initializes I2C to DS2485 and DS2485)
-		int OneWireInitError = OneWire_Init();
-		assert(OneWireInitError==0);
-		if(OneWireInitError) break;
-
-        // DS28E18 VDD_SENS (DS28E18 power to the sensor) requires 'Strong Pull-Up' 'SPU' on 1-Wire bus.
-        // That's turned on with DS2485 1-Wire Master Configuration (Register 0) Bit 13: Strong Pullup (SPU).
-		int SPUerror = OneWire_Enable_SPU(true); // DS2485 must provide strong power to 1-Wire bus
-		assert(SPUerror==0);
-		if(SPUerror) break;
-
-        // ToDo ENS210: Assumes there's only one DS28E18 on 1-Wire bus (controlling ENS210); could search in Init()...
-		bool ds28e18_init_OK = DS28E18_Init(); // global current_DS28E18_ROM_ID is set to last 1-Wire device found
-		assert (ds28e18_init_OK);
-		if(!ds28e18_init_OK) break;
-		OneWireAddress = current_DS28E18_ROM_ID;
+		if(!initBus()) break;
+
+        // Several DS28E18 may share the 1-Wire bus; ds28e18Index selects the one controlling this ENS210.
+        // From here on only that DS28E18 is addressed.
+		int deviceCount = DS28E18_GetDeviceTable()->count;
+		if(ds28e18Index >= deviceCount) break;
+		deviceHandle = DS28E18_GetDeviceHandle(ds28e18Index < 0 ? deviceCount - 1 : ds28e18Index); // by default the last DS28E18 found
+		OneWire_Registry_Get(deviceHandle)->driverState = this;
 
 		// For temperature probe, use DS28E18Q+T internal I2C pull-up resistors,
 		// which must be enabled **BEFORE** powering up sensor with hard-VDD-pullup
@@ -143,7 +167,7 @@ bool ENS210_T::Init() {
 		// For stronger 1.2k pull-up on all IO, PS=0, PW=F; GPIO_CTRL_HI=xF0
 		// No pull-down slew, outputs high or release line depending on pull-up selected: GPIO_CTRL_LO=0x0F
 		// Stronger pull-ups seem to be required (sometimes got 0 values during reads with weak pull-ups)
-		bool configured_GPIO_OK = DS28E18_WriteGpioConfiguration(CONTROL, 0xF0, 0x0F);
+		bool configured_GPIO_OK = DS28E18_WriteGpioConfiguration(deviceHandle, CONTROL, 0xF0, 0x0F);
 		assert(configured_GPIO_OK);
 		if(!configured_GPIO_OK) break;
 
@@ -153,7 +177,7 @@ bool ENS210_T::Init() {
 		// 7-bit slave address. ENS210 does not use clock stretching.
 		// None of the other optional I²C features (10-bit slave address, General Call, Software reset, or Device ID)
 		// are supported, nor are the master features (Synchronization, Arbitration, START byte).
-        bool configured_I2C_OK = DS28E18_WriteConfiguration(KHZ_400, DONT_IGNORE, I2C, /* SPI mode ignored for I2C: */MODE_0);
+        bool configured_I2C_OK = DS28E18_WriteConfiguration(deviceHandle, KHZ_400, DONT_IGNORE, I2C, /* SPI mode ignored for I2C: */MODE_0);
         assert(configured_I2C_OK);
         if(!configured_I2C_OK) break;
 
@@ -162,7 +186,7 @@ bool ENS210_T::Init() {
 		DS28E18_BuildPacket_Utility_SensVddOn();
 		DS28E18_BuildPacket_Utility_Delay(DELAY_256msec); // give sensor time to power up 64->256
 		// Write the packet into DS28E18 sequencer memory, run it, and wait long enough for it to complete
-		bool writeAndRun_PowerUp_OK = DS28E18_BuildPacket_WriteAndRun();
+		bool writeAndRun_PowerUp_OK = DS28E18_BuildPacket_WriteAndRun(deviceHandle);
 		assert(writeAndRun_PowerUp_OK);
 		if(!writeAndRun_PowerUp_OK) break;
 
@@ -179,15 +203,19 @@ bool ENS210_T::Init() {
 		uint8_t SYS_STAT_idx = readRegisters(ENS210_REG_SYS_STAT, 1); // read 1 byte
 		uint8_t PART_ID_idx = readRegisters(ENS210_REG_PART_ID, 2+2+8); // read 2 bytes PART_ID, 2 bytes DIE_REV, and 8 bytes UID
 		// Write the packet into DS28E18 sequencer memory, run it, and wait long enough for it to complete
-		bool writeAndRun_StatusAndPartID_OK = DS28E18_BuildPacket_WriteAndRun();
+		bool writeAndRun_StatusAndPartID_OK = DS28E18_BuildPacket_WriteAndRun(deviceHandle);
 		assert(writeAndRun_StatusAndPartID_OK);
 		if(!writeAndRun_StatusAndPartID_OK) break;
 
-		// read DS28E18 sequencer memory back to host to extract SYS_STAT and PART_ID-DIE_ID-UID values read from sensor
-		uint8_t sequencer_memory[DS28E18_BuildPacket_GetSequencerPacketSize()] = {0};
-        bool initSequencerReadOK = DS28E18_ReadSequencer(0x00, sequencer_memory, sizeof(sequencer_memory));
+		// read back to host only the part of DS28E18 sequencer memory holding SYS_STAT and PART_ID-DIE_ID-UID values read from sensor
+		uint8_t readback[32];
+		int readbackLength = PART_ID_idx + 2+2+8 - SYS_STAT_idx;
+		assert(readbackLength <= (int)sizeof(readback));
+		if(readbackLength > (int)sizeof(readback)) break;
+        bool initSequencerReadOK = DS28E18_ReadSequencer(deviceHandle, SYS_STAT_idx, readback, readbackLength);
         assert(initSequencerReadOK);
         if(!initSequencerReadOK) break;
+		const uint8_t *sequencer_memory = readback - SYS_STAT_idx; // index by sequencer address, as the packet was built
 		SYS_STAT = sequencer_memory[SYS_STAT_idx];
 		PART_ID = sequencer_memory[PART_ID_idx+1]<<8 | sequencer_memory[PART_ID_idx]; // looking for 0x0210 - OK
 		printf("ENS210::Init read SYS_STAT=x%02X, PARTID=x%04X\n", SYS_STAT, PART_ID);
@@ -206,16 +234,24 @@ bool ENS210_T::Init() {
 				(uint64_t)sequencer_memory[UID_idx+2]<<16 |
 				(uint64_t)sequencer_memory[UID_idx+1]<< 8 |
 				(uint64_t)sequencer_memory[UID_idx+0]<< 0 ;
-		printf("ENS210::Init read dieRevision=x%02X, uniqueDeviceID=x%016llX\n", dieRevision, uniqueDeviceID);
+		printf("ENS210::Init read dieRevision=x%02X, uniqueDeviceID=x%016llX\n", dieRevision, (unsigned long long)uniqueDeviceID);
 
-		// Set continuous mode and start for both temperature and humidity sensor
 		DS28E18_BuildPacket_ClearSequencerPacket();
-		writeRegisters(ENS210_setContinuousAndStart, sizeof(ENS210_setContinuousAndStart)); // run ENS210 sensors continuously
-		// Immediately after starting continuous, wait max conversion time for both temp and humidity = 238ms
-		DS28E18_BuildPacket_Utility_Delay(DELAY_256msec);
+		if(mode == Mode_Continuous) {
+			// Set continuous mode and start for both temperature and humidity sensor
+			writeRegisters(ENS210_setContinuousAndStart, sizeof(ENS210_setContinuousAndStart)); // run ENS210 sensors continuously
+			// Immediately after starting continuous, wait max conversion time for both temp and humidity = 238ms
+			DS28E18_BuildPacket_Utility_Delay(DELAY_256msec);
+		} else {
+			// Single-shot: let the ENS210 drop to standby between conversions started by Measure()
+			writeRegisters(ENS210_setLowPower, sizeof(ENS210_setLowPower));
+			// Optionally remove sensor power entirely; Measure() powers up, converts, reads, and powers down again
+			if(sensVddOffBetweenSamples) DS28E18_BuildPacket_Utility_SensVddOff();
+		}
 		// Write the packet into DS28E18 sequencer memory, run it, and wait long enough for it to complete
-		bool started_OK = DS28E18_BuildPacket_WriteAndRun();
+		bool started_OK = DS28E18_BuildPacket_WriteAndRun(deviceHandle);
 		if(!started_OK) break;
+		measureSequenceLoaded = false; // sequencer memory now holds the start-up sequence
 
 		initOK = true;
 	} while(0);
@@ -224,50 +260,55 @@ bool ENS210_T::Init() {
 }
 
 ENS210_Result_T ENS210_T::Measure() {
+	ONEWIRE_INSTR_SCOPE(ONEWIRE_INSTR_ENS210_MEASURE);
 	ENS210_Result_T result;
 
 	do {
 		if(! initOK) Init();
 		if(! initOK) break; // arrrggg...
 
-		// Address this ENS210's DS28E18 controller on the 1-wire bus.
-		current_DS28E18_ROM_ID = OneWireAddress;
-
 		// Set up and run DS28E18 sequencer (inside temperature probe) to read ENS210 temperature and humidity
 		bool readTemperatureAndHumidty_OK;
-		// saved information about loaded sequence...
-		static bool DS28E18_SequenceLoaded = false;
-        static uint8_t T_VAL_idx; // index to beginning of temperature value in (send and receive) sequence
-		static unsigned short TH_readSequenceLength;
-		if(!DS28E18_SequenceLoaded)		{
-			// This sequence takes ~215mSec (including read-back below)
-		// Read temperature and humidity: 6 bytes (T_VAL and H_VAL) starting at T_VAL register
-		DS28E18_BuildPacket_ClearSequencerPacket();
+		if(!measureSequenceLoaded)		{
+			// Continuous: this sequence takes ~215mSec (including read-back below)
+			DS28E18_BuildPacket_ClearSequencerPacket();
+			if(mode == Mode_SingleShot) {
+				// Start, wait, and read all in one sequencer run (no host round-trip while converting)
+				if(sensVddOffBetweenSamples) {
+					DS28E18_BuildPacket_Utility_SensVddOn();
+					appendDelayMS(4*ENS210_Boot_Time_MS); // ENS210 boots into single-shot low-power defaults
+				}
+				writeRegisters(ENS210_startSingleShot, sizeof(ENS210_startSingleShot));
+				appendDelayMS(ENS210_THConv_Single_MS);
+			}
+			// Read temperature and humidity: 6 bytes (T_VAL and H_VAL) starting at T_VAL register
 			T_VAL_idx = readRegisters(ENS210_REG_T_VAL, 6);
-			TH_readSequenceLength = DS28E18_GetLastSequenceLength();
-		// Write the packet into DS28E18 sequencer memory, run it, and wait long enough for it to complete
-			readTemperatureAndHumidty_OK = DS28E18_BuildPacket_WriteAndRun();
-			DS28E18_SequenceLoaded = true;
+			if(sensVddOffBetweenSamples) DS28E18_BuildPacket_Utility_SensVddOff();
+			measureSequenceLength = DS28E18_GetLastSequenceLength();
+			// Write the packet into DS28E18 sequencer memory, run it, and wait long enough for it to complete
+			readTemperatureAndHumidty_OK = DS28E18_BuildPacket_WriteAndRun(deviceHandle);
+			measureSequenceLoaded = readTemperatureAndHumidty_OK;
 		} else {
-			// This sequence takes ~140mSec (including read-back below); saves 75mSec by not reloading DS28E18 sequencer
-			readTemperatureAndHumidty_OK = DS28E18_RerunLastSequence(TH_readSequenceLength);
+			// Continuous: this sequence takes ~140mSec (including read-back below); saves 75mSec by not reloading DS28E18 sequencer
+			readTemperatureAndHumidty_OK = DS28E18_RerunLastSequence(deviceHandle, measureSequenceLength);
 		}
 		assert(readTemperatureAndHumidty_OK);
         if(!readTemperatureAndHumidty_OK) {
+            measureSequenceLoaded = false; // sequencer memory may have been lost (DS28E18 POR); reload next time
             result.status = ENS210_Result_T::Status_I2C_error;
             return result;
         }
 
-		// Read DS28E18 sequencer memory back to host to obtain values read from sensor
-		uint8_t readback2[DS28E18_BuildPacket_GetSequencerPacketSize()] = {0};
-        bool sequencerReadOK = DS28E18_ReadSequencer(0x00, readback2, sizeof(readback2));
+		// Read back to host the 6 bytes of DS28E18 sequencer memory holding the values read from sensor
+		uint8_t readback2[6];
+        bool sequencerReadOK = DS28E18_ReadSequencer(deviceHandle, T_VAL_idx, readback2, sizeof(readback2));
         if(!sequencerReadOK) {
             result.status = ENS210_Result_T::Status_I2C_error; // could be local I2C to DS2485 (don't know about remote I2C)
             return result;
         };
 
 		//printf("ENS210 T_VAL, H_VAL with checksums: x%02X%02X%02X, %02X%02X%02X\n",
-		//		readback2[T_VAL_idx],readback2[T_VAL_idx+1],readback2[T_VAL_idx+2],readback2[T_VAL_idx+3],readback2[T_VAL_idx+4],readback2[T_VAL_idx+5]);
+		//		readback2[0],readback2[1],readback2[2],readback2[3],readback2[4],readback2[5]);
 		// Lambda function extracts raw returned value and verifies checksum
 		auto GetVal = [this](uint8_t *p, uint32_t &val, bool &OK, bool &validCRC) {
 			// Note low-order value is first byte, then high-order, then CRC and "OK" bit
@@ -281,11 +322,11 @@ ENS210_Result_T ENS210_T::Measure() {
 		uint32_t T_val;
 		bool T_OK;
 		bool T_validCRC;
-		GetVal(&readback2[T_VAL_idx], T_val, T_OK, T_validCRC);
+		GetVal(&readback2[0], T_val, T_OK, T_validCRC);
 		uint32_t H_val;
 		bool H_OK;
 		bool H_validCRC;
-		GetVal(&readback2[T_VAL_idx+3], H_val, H_OK, H_validCRC);
+		GetVal(&readback2[3], H_val, H_OK, H_validCRC);
 		// Verify checksums OK
 		if(!T_validCRC || !H_validCRC) {
 			result.status = ENS210_Result_T::Status_CRC_error;
@@ -300,28 +341,97 @@ ENS210_Result_T ENS210_T::Measure() {
 		result.rawTemperature = T_val  - soldercorrection;
 		result.rawHumidity    = H_val;
 		result.status = ENS210_Result_T::Status_OK;
+		result.timestampMS = ONEWIRE_OS_NOW_MSEC();
 
 	} while(0);
 
 	return result;
 }
 
+ENS210_Result_T ENS210_T::MeasureCached(unsigned long maxAgeMS) {
+	// Age computed with unsigned subtraction, so tick counter wrap is harmless
+	auto fresh = [maxAgeMS](const ENS210_Result_T &r) {
+		return r.status == ENS210_Result_T::Status_OK &&
+			(uint32_t)(ONEWIRE_OS_NOW_MSEC() - r.timestampMS) <= maxAgeMS;
+	};
+	// Fast path: no need to wait on the mutex to return a fresh result.
+	// Counters are updated in critical sections, as fast-path callers do not hold cacheMutex.
+	ONEWIRE_OS_ENTER_CRITICAL();
+	ENS210_Result_T cached = lastValidResult;
+	bool hit = fresh(cached);
+	if(hit) cacheHits++;
+	ONEWIRE_OS_EXIT_CRITICAL();
+	if(hit) return cached;
+	// Stale: only one caller measures; others block here and then find the new result fresh
+	OneWire_OS_MutexLock(&cacheMutex);
+	ENS210_Result_T result;
+	if(fresh(lastValidResult)) { // lastValidResult is only written while holding cacheMutex
+		result = lastValidResult;
+		ONEWIRE_OS_ENTER_CRITICAL();
+		cacheHits++;
+		cacheCoalesced++;
+		ONEWIRE_OS_EXIT_CRITICAL();
+	} else {
+		result = Measure();
+		ONEWIRE_OS_ENTER_CRITICAL();
+		cacheMisses++;
+		if(result.status == ENS210_Result_T::Status_OK) lastValidResult = result;
+		ONEWIRE_OS_EXIT_CRITICAL();
+	}
+	OneWire_OS_MutexUnlock(&cacheMutex);
+	return result;
+}
+
 unsigned long ENS210_T::QwikTest() {
     // perform a timed measurement
-    unsigned long startTimeMS = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    unsigned long startTimeMS = ONEWIRE_OS_NOW_MSEC();
 	ENS210_Result_T r = Measure(); // does Init() if not yet completed
-    unsigned long elapsedMS = (xTaskGetTickCount() * portTICK_PERIOD_MS) - startTimeMS;
+    unsigned long elapsedMS = ONEWIRE_OS_NOW_MSEC() - startTimeMS;
 	// report results
 	static bool initSummaryPrinted;
 	if(!initSummaryPrinted && initOK) {
 		printf("ENS210::Init read SYS_STAT=x%02X, PARTID=x%04X\n", SYS_STAT, PART_ID);
-		printf("ENS210::Init read dieRevision=x%02X, uniqueDeviceID=x%016llX\n", dieRevision, uniqueDeviceID);
+		printf("ENS210::Init read dieRevision=x%02X, uniqueDeviceID=x%016llX\n", dieRevision, (unsigned long long)uniqueDeviceID);
 		initSummaryPrinted = true;
 	}
 		r.DiagPrintf();
     return elapsedMS;
 }
 
+int ENS210_T::Benchmark(int samples) {
+    if(samples <= 0) return 0;
+    int okCount = 0;
+    unsigned long maxMS = 0;
+    unsigned long long runUS = 0; // modeled sequencer run time, which the sensor is awake (or powered) for
+    unsigned long spuMS = 0;      // strong pull-up held while the DS28E18 runs its sequence
+    unsigned long startTimeMS = ONEWIRE_OS_NOW_MSEC();
+    for(int i=0; i<samples; i++) {
+        unsigned long sampleStartMS = ONEWIRE_OS_NOW_MSEC();
+        ENS210_Result_T r = Measure(); // does Init() if not yet completed
+        unsigned long sampleMS = ONEWIRE_OS_NOW_MSEC() - sampleStartMS;
+        if(sampleMS > maxMS) maxMS = sampleMS;
+        if(r.status == ENS210_Result_T::Status_OK) okCount++;
+        runUS += DS28E18_GetLastRunTiming()->estimated_uSec;
+        spuMS += DS28E18_GetLastRunTiming()->delay_msec;
+    }
+    unsigned long elapsedMS = ONEWIRE_OS_NOW_MSEC() - startTimeMS;
+    unsigned long meanMS = elapsedMS / samples;
+    // Continuous: the sensor is powered and converting for the whole interval. Single-shot: it is awake for the
+    // measurement sequence (with SENS_VDD off, powered from SENS_VDD on to off, including its boot delay),
+    // as modeled by the DS28E18 layer, and in standby (or unpowered) otherwise.
+    unsigned long activeMS = (mode == Mode_Continuous) ? meanMS : (unsigned long)((runUS / samples + 999) / 1000);
+    if(activeMS > meanMS) activeMS = meanMS;
+    printf("ENS210::Benchmark %s%s: %d samples (%d OK) in %lu ms\n",
+            mode == Mode_Continuous ? "continuous" : "single-shot",
+            sensVddOffBetweenSamples ? " with SENS_VDD off" : "", samples, okCount, elapsedMS);
+    printf("ENS210::Benchmark latency mean=%lu ms max=%lu ms, throughput=%lu samples/min, sensor active %lu%% of sample period (%s between samples)\n",
+            meanMS, maxMS, meanMS ? 60000UL/meanMS : 0, meanMS ? (100*activeMS)/meanMS : 0,
+            mode == Mode_Continuous ? "converting" : sensVddOffBetweenSamples ? "unpowered" : "standby");
+    printf("ENS210::Benchmark strong pull-up %lu ms per sample (%lu%% of sample period)\n",
+            spuMS / samples, meanMS ? (100*(spuMS / samples))/meanMS : 0);
+    return okCount;
+}
+
 // Compute the CRC-7 of 'val' (should only have 17 bits)
 // https://en.wikipedia.org/wiki/Cyclic_redundancy_check#Computation
 //               7654 3210
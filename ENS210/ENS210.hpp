@@ -12,32 +12,68 @@
 #include <stdint.h>
 
 #include "ENS210_Result.hpp"
-#include "1wire/one_wire_address.h"
+#include "1wire/one_wire_os.h" // MeasureCached serialization
+#include "1wire/one_wire_registry.h"
 
 class ENS210_T {
+public:
+    /// How the ENS210 is operated between Measure() calls
+    enum Mode_T : uint8_t {
+        Mode_Continuous = 0, ///< Sensor converts continuously; Measure() only reads the latest values.
+        Mode_SingleShot = 1, ///< Sensor sleeps; each Measure() starts one conversion, waits, and reads in a single DS28E18 sequencer run.
+    };
+private:
     bool initOK = false;
+    Mode_T mode;
+    bool sensVddOffBetweenSamples; // single-shot only: DS28E18 SENS_VDD (and hence ENS210) powered only during each measurement
     uint8_t soldercorrection = 0; // Correction due to soldering (in 1/64K); subtracted from rawTemperature by measure function.
-    uint32_t crc7( uint32_t val ); // calculate ENS210 checksum for a raw temperature or humidity value
     // *** Following members are specific to the DS28E18 controlling this ENS210 on a 1-Wire bus ***
-    OneWire_ROM_ID_T OneWireAddress; ///< Address of the DS28E18 controlling this ENS210 on the 1-Wire bus.
+    OneWire_handle_T deviceHandle = ONEWIRE_HANDLE_INVALID; ///< DS28E18 controlling this ENS210 on the 1-Wire bus.
+    int ds28e18Index; ///< position of that DS28E18 in DS28E18_GetDeviceTable(), or -1 for the last found
+    // The 1-Wire bus and its DS28E18s are initialized once for every ENS210_T on the bus: initializing them
+    // again (Skip ROM GPIO configuration) would undo what earlier probes' Init set up on their own DS28E18.
+    static bool busInitOK;
+    static bool initBus();
     // Append a write to the command sequence under construction
     // dataStream first byte is starting register, followed by register value(s)
     void writeRegisters(const uint8_t *dataStream, int len);
     // Append a read to the command sequence under construction
     // Return value is the index of the result in the readback command sequence
     int readRegisters(uint8_t firstRegister, int len);
+    // Append DS28E18 delay commands totaling 'ms' milliseconds
+    static void appendDelayMS(int ms);
+    // Information about the measurement sequence currently loaded in the DS28E18 sequencer
+    bool measureSequenceLoaded = false;
+    uint8_t T_VAL_idx = 0; // index to beginning of temperature value in (send and receive) sequence
+    unsigned short measureSequenceLength = 0;
+    // MeasureCached state: last valid result, and mutex so concurrent callers share one bus transaction
+    ENS210_Result_T lastValidResult;
+    OneWire_OS_mutex_T cacheMutex;
 public:
+    static uint32_t crc7( uint32_t val ); // calculate ENS210 checksum for a raw temperature or humidity value (valid bit and 16 data bits)
     uint16_t PART_ID; // looking for 0x0210
     bool PART_ID_Valid() const { return PART_ID == 0x0210; };
     uint8_t SYS_STAT; // must be 1 in active state
     bool SYS_STAT_Valid() const { return SYS_STAT == 1; };
     uint16_t dieRevision = 0;
     uint64_t uniqueDeviceID = 0;
-    ENS210_T() : OneWireAddress() {}; // ctor does NOT do device initialization; permits static allocation...
+    // ctor does NOT do device initialization; permits static allocation...
+    ENS210_T(Mode_T mode_ = Mode_Continuous, bool sensVddOffBetweenSamples_ = false, int ds28e18Index_ = -1) :
+        mode(mode_), sensVddOffBetweenSamples(sensVddOffBetweenSamples_ && mode_==Mode_SingleShot), ds28e18Index(ds28e18Index_) {
+        OneWire_OS_MutexInit(&cacheMutex);
+    };
     bool Init();
     bool InitOK() const { return initOK; };
+    Mode_T Mode() const { return mode; };
     unsigned long QwikTest(); // returns elapsed mSec
+    int Benchmark(int samples); // time 'samples' back-to-back Measure() calls and report throughput, latency, and power duty; returns how many were OK
     ENS210_Result_T Measure();
+    /// Return the last valid result if no older than maxAgeMS, otherwise Measure().
+    /// Callers arriving while a measurement is in progress wait for and share its result.
+    ENS210_Result_T MeasureCached(unsigned long maxAgeMS);
+    unsigned long cacheHits = 0;      ///< MeasureCached calls answered without a new measurement (includes coalesced)
+    unsigned long cacheCoalesced = 0; ///< subset of cacheHits that waited for another caller's measurement
+    unsigned long cacheMisses = 0;    ///< MeasureCached calls that ran a measurement
 };
 
 #endif /* ENS210_HPP_INCLUDED */
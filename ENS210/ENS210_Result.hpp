@@ -29,7 +29,8 @@ struct ENS210_Result_T {
 	// Note: raw values have been stripped of checksum; just the interesting 16-bit data here.
 	uint16_t rawTemperature; ///< temperature in 1/64 Kelvin, corrected for solder offset
 	uint16_t rawHumidity; ///< relative humidity in 1/512%RH (ie a value of 51200 means 100% relative humidity)
-	ENS210_Result_T() : status(Status_NA), rawTemperature(0), rawHumidity(0) {};
+	uint32_t timestampMS; ///< RTOS time (ms) at which this measurement was read from the sensor
+	ENS210_Result_T() : status(Status_NA), rawTemperature(0), rawHumidity(0), timestampMS(0) {};
 	float TempKelvin() const;       // Convert to Kelvin
 	int   TempKelvinx10() const { return (10*((unsigned int)rawTemperature))/64; };
 	float TempCelsius() const;      // Convert to Celsius
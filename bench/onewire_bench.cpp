@@ -0,0 +1,437 @@
+/**
+ * @file onewire_bench.cpp
+ * @brief Host benchmark of the 1-Wire stack and ENS210 driver against the simulated DS2485 (DS2485_port_sim.c).
+ *
+ * Usage: onewire_bench [probes [rounds]]
+ *
+ * Workloads: init (OneWire_Init), enumerate (DS28E18_Init: search and initialize each DS28E18),
+ * measure (ENS210_T::Init per probe, then 'rounds' Measure() of every probe),
+ * learned delays ('rounds' more with DS2485_SetDelayLearning, then 'rounds' using what was learned,
+ * reporting per command class the fit, early reads, and time waited against the analytic estimates),
+ * ENS210 benchmark (ENS210_T::Benchmark of the first probe: 'rounds' samples continuous, single-shot,
+ * and single-shot with SENS_VDD off, reporting latency and the sensor's modeled active and strong pull-up time),
+ * SPI stream ('rounds' DS28E18_SPI_StreamRead of 4 KB from the simulated SPI flash behind the first DS28E18,
+ * checked against its content, at each SPI clock rate),
+ * sequencer uploads ('rounds' DS28E18_BuildPacket_WriteAndRun of a 240-byte sequence changed in every block,
+ * unchanged, and changed in its last block, reporting the upload time the sequencer cache saves),
+ * and watch ('rounds' family searches against 'rounds' OneWire_Watch_Poll() of the same bus,
+ * then polls until an unplugged probe is reported removed and, plugged back in, added),
+ * search (on fresh buses of 1, 10 and 100 devices, the host search engine's OW_TRIPLET scripts
+ * against the DS2485 1-Wire Search command), and on a fresh bus of 50 devices 'rounds' full searches
+ * against 'rounds' times the watch polls that verify every device once.
+ * For each, reports the CPU time spent in the stack, the simulated time (what the workload
+ * would take on the bus, including every delay the stack waits), the 1-Wire signalling time,
+ * the busy time counted by one_wire_stats, and with ONEWIRE_INSTRUMENT the CPU time per layer.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+#include "1wire/DS2485.h"
+#include "1wire/DS28E18.h"
+#include "1wire/one_wire.h"
+#include "1wire/one_wire_instrument.h"
+#include "1wire/one_wire_os.h"
+#include "1wire/one_wire_stats.h"
+#include "1wire/one_wire_watch.h"
+#include "ENS210/ENS210.hpp"
+
+static uint64_t cpu_uSec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000U + (uint64_t)ts.tv_nsec / 1000U;
+}
+
+static int watchAdded, watchRemoved;
+
+static void watchEvent(OneWire_watch_event_T event, const OneWire_ROM_ID_T *romid)
+{
+    (void)romid;
+    if (event == ONEWIRE_WATCH_ADDED) watchAdded++;
+    else watchRemoved++;
+}
+
+// Poll until the watch reports a change; returns the number of polls, or -1 if none within 'limit'
+static int pollsUntilChange(int limit)
+{
+    int before = watchAdded + watchRemoved;
+    for (int poll = 1; poll <= limit; poll++)
+    {
+        if (OneWire_Watch_Poll() == 0 && watchAdded + watchRemoved != before) return poll;
+    }
+    return -1;
+}
+
+// Build a 240-byte sequence of ENS210 register reads (four 64-byte cache blocks). 'shifted' puts one more
+// command in front, moving every block; 'lastRegister' is read by the last read, in the last block.
+static void buildRegisterReads(bool shifted, uint8_t lastRegister)
+{
+    DS28E18_BuildPacket_ClearSequencerPacket();
+    if (shifted) DS28E18_BuildPacket_Utility_SensVddOn(); // already on
+    for (int i = 0; i < 12; i++)
+    {
+        const uint8_t selectRegister[] = { 0x43 << 1, (i == 11) ? lastRegister : (uint8_t)0x00 };
+        const uint8_t readAddress[] = { (0x43 << 1) | 1 };
+        DS28E18_BuildPacket_I2C_Start();
+        DS28E18_BuildPacket_I2C_WriteData(selectRegister, sizeof(selectRegister));
+        DS28E18_BuildPacket_I2C_Start();
+        DS28E18_BuildPacket_I2C_WriteData(readAddress, sizeof(readAddress));
+        DS28E18_BuildPacket_I2C_ReadDataWithNackEnd(8);
+        DS28E18_BuildPacket_I2C_Stop();
+    }
+}
+
+static const char *const commandClassNames[DS2485_CLASS_COUNT] = {
+    "memory", "config", "script", "block", "search", "full sequence",
+};
+
+// Delay statistics of each command class used since 'before'
+static void reportDelayStats(const DS2485_delay_stats_T before[DS2485_CLASS_COUNT])
+{
+    for (int c = 0; c < DS2485_CLASS_COUNT; c++)
+    {
+        DS2485_delay_stats_T s;
+        DS2485_GetDelayStats((DS2485_command_class_T)c, &s);
+        uint32_t commands = s.commands - before[c].commands;
+        if (commands == 0) continue;
+        printf("  %-13s %6lu commands, fit %.3f x estimate %+.0f us + %.0f us margin, %lu early reads,\n"
+               "                waited %9.3f ms where the estimates total %9.3f ms\n",
+            commandClassNames[c], (unsigned long)commands, s.slope, s.offset_uSec, s.margin_uSec,
+            (unsigned long)(s.earlyReads - before[c].earlyReads),
+            (s.waited_uSec - before[c].waited_uSec) / 1000.0, (s.estimated_uSec - before[c].estimated_uSec) / 1000.0);
+    }
+}
+
+/// Measures one workload from construction to report()
+class Workload {
+    const char *name;
+    uint64_t cpuStart, simStart, busStart;
+public:
+    explicit Workload(const char *name_) : name(name_) {
+        OneWire_bus_stats_T discard;
+        OneWire_Stats_Snapshot(0, &discard, true);
+        OneWire_Instr_Reset();
+        cpuStart = cpu_uSec();
+        simStart = OneWire_OS_Now_uSec();
+        busStart = DS2485_Sim_BusTime_uSec();
+    }
+    void report(int operations, const char *operation) {
+        uint64_t cpu = cpu_uSec() - cpuStart;
+        uint64_t sim = OneWire_OS_Now_uSec() - simStart;
+        uint64_t bus = DS2485_Sim_BusTime_uSec() - busStart;
+        OneWire_bus_stats_T stats;
+        OneWire_Stats_Snapshot(0, &stats, false);
+        printf("\n%s: %d %s\n", name, operations, operation);
+        printf("  CPU          %10.3f ms  (%.1f us per %s)\n", cpu / 1000.0, operations ? (double)cpu / operations : 0.0, operation);
+        printf("  simulated    %10.3f ms  (%.1f us per %s)\n", sim / 1000.0, operations ? (double)sim / operations : 0.0, operation);
+        printf("  1-Wire bus   %10.3f ms  (%.0f%% of simulated)\n", bus / 1000.0, sim ? 100.0 * bus / sim : 0.0);
+        printf("  stats busy   %10.3f ms  resets %lu, scripts %lu (%lu failed), retries %lu, CRC failures %lu\n",
+            stats.busy_uSec / 1000.0, (unsigned long)stats.resets, (unsigned long)stats.scripts,
+            (unsigned long)stats.scriptErrors, (unsigned long)stats.retries, (unsigned long)stats.crcFailures);
+        printf("  sequencer    %10lu bytes not uploaded, %lu uploads skipped\n",
+            (unsigned long)stats.sequencerBytesSkipped, (unsigned long)stats.sequencerUploadsSkipped);
+#ifdef ONEWIRE_INSTRUMENT
+        for (int op = 0; op < ONEWIRE_INSTR_OPS; op++)
+        {
+            OneWire_instr_stats_T s;
+            OneWire_Instr_GetStats((OneWire_instr_op_T)op, &s);
+            if (s.count == 0) continue;
+            printf("  %-24s %7lu x  mean %8.2f us  p99 %8.2f us  total %9.3f ms\n", OneWire_Instr_Name((OneWire_instr_op_T)op),
+                (unsigned long)s.count, s.mean_uSec, s.p99_uSec, s.count * s.mean_uSec / 1000.0);
+        }
+#endif
+    }
+};
+
+int main(int argc, char **argv)
+{
+    int probes = (argc > 1) ? atoi(argv[1]) : 4;
+    int rounds = (argc > 2) ? atoi(argv[2]) : 100;
+    if (probes < 1 || probes > DS2485_SIM_MAX_PROBES || rounds < 1)
+    {
+        fprintf(stderr, "usage: %s [probes (1..%d) [rounds]]\n", argv[0], DS2485_SIM_MAX_PROBES);
+        return 2;
+    }
+
+    OneWire_OS_UseSimulatedClock(true);
+    OneWire_Instr_Init(1000); // host timestamps are nanoseconds
+    DS2485_sim_config_T config = { probes, 21.0, 45.0 };
+    DS2485_Sim_Start(&config);
+    printf("1-Wire stack benchmark: %d simulated DS28E18 + ENS210 probes, %d rounds\n", probes, rounds);
+
+    {
+        Workload w("init");
+        int error = OneWire_Init();
+        w.report(1, "init");
+        if (error)
+        {
+            fprintf(stderr, "OneWire_Init failed: %d\n", error);
+            return 1;
+        }
+    }
+    {
+        Workload w("enumerate");
+        DS28E18_Init();
+        int found = DS28E18_GetDeviceTable()->count;
+        w.report(found, "device");
+        if (found != probes)
+        {
+            fprintf(stderr, "DS28E18_Init found %d of %d devices\n", found, probes);
+            return 1;
+        }
+    }
+
+    std::vector<ENS210_T> sensors;
+    sensors.reserve(probes); // not moved once constructed (each holds a mutex)
+    for (int i = 0; i < probes; i++)
+    {
+        sensors.emplace_back(ENS210_T::Mode_Continuous, false, i);
+    }
+    {
+        Workload w("ENS210 init");
+        for (ENS210_T &s : sensors)
+        {
+            if (!s.Init())
+            {
+                fprintf(stderr, "ENS210_T::Init failed\n");
+                return 1;
+            }
+        }
+        w.report(probes, "probe");
+    }
+    int failures = 0;      // measurements
+    int checkFailures = 0; // other workloads
+    {
+        Workload w("measure");
+        for (int r = 0; r < rounds; r++)
+        {
+            for (ENS210_T &s : sensors)
+            {
+                if (s.Measure().status != ENS210_Result_T::Status_OK) failures++;
+            }
+        }
+        w.report(rounds * probes, "measurement");
+    }
+    DS2485_delay_stats_T delayStats[DS2485_CLASS_COUNT];
+    {
+        DS2485_ResetDelayLearning();
+        DS2485_SetDelayLearning(true);
+        for (int c = 0; c < DS2485_CLASS_COUNT; c++) DS2485_GetDelayStats((DS2485_command_class_T)c, &delayStats[c]);
+        Workload w("measure, learning delays");
+        for (int r = 0; r < rounds; r++)
+        {
+            for (ENS210_T &s : sensors)
+            {
+                if (s.Measure().status != ENS210_Result_T::Status_OK) failures++;
+            }
+        }
+        w.report(rounds * probes, "measurement");
+        reportDelayStats(delayStats);
+        DS2485_SetDelayLearning(false);
+    }
+    {
+        for (int c = 0; c < DS2485_CLASS_COUNT; c++) DS2485_GetDelayStats((DS2485_command_class_T)c, &delayStats[c]);
+        Workload w("measure, learned delays");
+        for (int r = 0; r < rounds; r++)
+        {
+            for (ENS210_T &s : sensors)
+            {
+                if (s.Measure().status != ENS210_Result_T::Status_OK) failures++;
+            }
+        }
+        w.report(rounds * probes, "measurement");
+        reportDelayStats(delayStats);
+    }
+    {
+        Workload w("ENS210 benchmark, continuous");
+        if (sensors[0].Benchmark(rounds) != rounds) checkFailures++;
+        w.report(rounds, "sample");
+    }
+    for (int sensVddOff = 0; sensVddOff < 2; sensVddOff++)
+    {
+        // Another ENS210_T on the first probe's DS28E18: its Init loads the single-shot sequences
+        ENS210_T single(ENS210_T::Mode_SingleShot, sensVddOff != 0, 0);
+        Workload w(sensVddOff ? "ENS210 benchmark, single-shot with SENS_VDD off" : "ENS210 benchmark, single-shot");
+        if (!single.Init() || single.Benchmark(rounds) != rounds) checkFailures++;
+        w.report(rounds, "sample");
+    }
+    if (!sensors[0].Init()) checkFailures++; // back to continuous, with SENS_VDD on for the workloads below
+
+    {
+        static const DS28E18_protocol_speed_T speeds[] = { KHZ_100, KHZ_400, KHZ_1000, KHZ_2300 };
+        static const char *const speedNames[] = { "SPI stream, 100 kHz", "SPI stream, 400 kHz", "SPI stream, 1 MHz", "SPI stream, 2.3 MHz" };
+        const DS28E18_spi_stream_T flashRead = { { 0x03 }, 1, 3 }; // Read Data, 24-bit address
+        const int streamBytes = 4096;
+        std::vector<uint8_t> buffer(streamBytes);
+        OneWire_handle_T flash = DS28E18_GetDeviceHandle(0);
+        int flashProbe = DS28E18_GetDeviceTable()->romID[0].ID[1] - 1; // the simulator numbers probes in ROM ID byte 1
+        for (int s = 0; s < 4; s++)
+        {
+            if (!DS28E18_WriteConfiguration(flash, speeds[s], DONT_IGNORE, SPI, MODE_0)) checkFailures++;
+            Workload w(speedNames[s]);
+            uint64_t simStart = OneWire_OS_Now_uSec();
+            for (int r = 0; r < rounds; r++)
+            {
+                uint32_t address = (uint32_t)r * streamBytes;
+                if (!DS28E18_SPI_StreamRead(flash, &flashRead, address, buffer.data(), streamBytes))
+                {
+                    checkFailures++;
+                    continue;
+                }
+                for (int i = 0; i < streamBytes; i++)
+                {
+                    if (buffer[i] != DS2485_Sim_SpiFlashByte(flashProbe, address + i))
+                    {
+                        checkFailures++;
+                        break;
+                    }
+                }
+            }
+            uint64_t sim = OneWire_OS_Now_uSec() - simStart;
+            w.report(rounds * streamBytes / 1024, "KB");
+            printf("  throughput   %10.1f KB/s\n", sim ? rounds * streamBytes / 1024.0 / (sim / 1e6) : 0.0);
+        }
+        // Back to the ENS210's I2C; its sequences were overwritten, so WriteAndRun uploads them again
+        if (!DS28E18_WriteConfiguration(flash, KHZ_400, DONT_IGNORE, I2C, MODE_0)) checkFailures++;
+    }
+    {
+        OneWire_handle_T device = DS28E18_GetDeviceHandle(0);
+        static const char *const names[] = {
+            "sequencer uploads, every block changed", "sequencer uploads, unchanged", "sequencer uploads, last block changed"
+        };
+        double perRun[3];
+        for (int variant = 0; variant < 3; variant++)
+        {
+            Workload w(names[variant]);
+            uint64_t simStart = OneWire_OS_Now_uSec();
+            for (int r = 0; r < rounds; r++)
+            {
+                bool odd = (r & 1) != 0;
+                buildRegisterReads(variant == 0 && odd, (variant == 2 && odd) ? 0x10 : 0x00);
+                if (!DS28E18_BuildPacket_WriteAndRun(device)) checkFailures++;
+            }
+            perRun[variant] = (double)(OneWire_OS_Now_uSec() - simStart) / rounds;
+            w.report(rounds, "run");
+            if (variant > 0)
+            {
+                printf("  saved        %10.1f us per run (%.0f%%) against every block changed\n",
+                    perRun[0] - perRun[variant], 100.0 * (perRun[0] - perRun[variant]) / perRun[0]);
+            }
+        }
+    }
+
+    DS28E18_SetOnewireSpeed(STANDARD); // the last probe measured is still at overdrive; searches are at standard speed
+    {
+        Workload w("full search");
+        OneWire_ROM_table_T table;
+        for (int r = 0; r < rounds; r++)
+        {
+            if (OneWire_SearchTable(&table, ONEWIRE_SEARCH_NORMAL, DS28E18_FAMILY_CODE) != 0 || table.count != probes) checkFailures++;
+        }
+        w.report(rounds, "search");
+    }
+    {
+        const OneWire_ROM_table_T *known = DS28E18_GetDeviceTable();
+        OneWire_Watch_Start(known->romID, known->count, DS28E18_FAMILY_CODE, watchEvent);
+        Workload w("watch");
+        for (int r = 0; r < rounds; r++)
+        {
+            if (OneWire_Watch_Poll() != 0) checkFailures++;
+        }
+        w.report(rounds, "poll");
+        if (watchAdded + watchRemoved) checkFailures++; // nothing changed
+    }
+    {
+        Workload w("watch unplug and replug");
+        DS2485_Sim_ConnectProbe(probes - 1, false);
+        int removedAfter = pollsUntilChange(2 * probes + ONEWIRE_WATCH_MISSES_TO_REMOVE);
+        DS2485_Sim_ConnectProbe(probes - 1, true);
+        int addedAfter = pollsUntilChange(2 * probes + ONEWIRE_WATCH_MISSES_TO_REMOVE);
+        w.report(2, "change");
+        printf("  removal reported after %d polls, addition after %d\n", removedAfter, addedAfter);
+        if (watchRemoved != 1 || watchAdded != 1) checkFailures++;
+    }
+
+    static const int searchBusSizes[] = { 1, 10, 100 };
+    for (int devices : searchBusSizes)
+    {
+        DS2485_sim_config_T bus = { devices, 21.0, 45.0 };
+        DS2485_Sim_Start(&bus);
+        OneWire_Init();
+        DS28E18_WriteGpioConfiguration(ONEWIRE_HANDLE_ALL_DEVICES, CONTROL, 0xA5, 0x0F); // load the unique ROM IDs
+        char name[48];
+        OneWire_ROM_ID_T romid;
+        {
+            snprintf(name, sizeof(name), "host search, %d devices", devices);
+            Workload w(name);
+            OneWire_search_state_T state;
+            int found = 0;
+            OneWire_Search_Start(&state, ONEWIRE_SEARCH_NORMAL, NULL, 0);
+            while (OneWire_Search_Next(&state, &romid) == 0) found++;
+            w.report(found, "device");
+            if (found != devices) checkFailures++;
+        }
+        {
+            snprintf(name, sizeof(name), "DS2485 search, %d devices", devices);
+            Workload w(name);
+            bool last = false;
+            int found = 0;
+            while (!last && DS2485_OneWireSearch(romid.ID, ONEWIRE_SEARCH_NORMAL, true, false, found == 0, &last) == 0) found++;
+            w.report(found, "device");
+            if (found != devices) checkFailures++;
+        }
+    }
+
+    {
+        const int devices = 50;
+        DS2485_sim_config_T bus = { devices, 21.0, 45.0 };
+        DS2485_Sim_Start(&bus);
+        OneWire_Init();
+        DS28E18_WriteGpioConfiguration(ONEWIRE_HANDLE_ALL_DEVICES, CONTROL, 0xA5, 0x0F); // load the unique ROM IDs
+        std::vector<OneWire_ROM_ID_T> found(devices); // more than a OneWire_ROM_table_T holds
+        double perSearch, perCycle;
+        {
+            Workload w("full search, 50 devices");
+            uint64_t simStart = OneWire_OS_Now_uSec();
+            for (int r = 0; r < rounds; r++)
+            {
+                OneWire_search_state_T state;
+                OneWire_ROM_ID_T romid;
+                int count = 0;
+                OneWire_Search_Start(&state, ONEWIRE_SEARCH_NORMAL, NULL, 0);
+                while (OneWire_Search_Next(&state, &romid) == 0)
+                {
+                    if (count < devices) found[count] = romid;
+                    count++;
+                }
+                if (count != devices) checkFailures++;
+            }
+            perSearch = (double)(OneWire_OS_Now_uSec() - simStart) / rounds;
+            w.report(rounds, "search");
+        }
+        {
+            const int pollsPerCycle = ONEWIRE_WATCH_PASSES_PER_POLL ? (devices + ONEWIRE_WATCH_PASSES_PER_POLL - 1) / ONEWIRE_WATCH_PASSES_PER_POLL : 1;
+            int changesBefore = watchAdded + watchRemoved;
+            OneWire_Watch_Start(found.data(), devices, DS28E18_FAMILY_CODE, watchEvent);
+            Workload w("watch, 50 devices");
+            uint64_t simStart = OneWire_OS_Now_uSec();
+            for (int r = 0; r < rounds * pollsPerCycle; r++)
+            {
+                if (OneWire_Watch_Poll() != 0) checkFailures++;
+            }
+            perCycle = (double)(OneWire_OS_Now_uSec() - simStart) / rounds;
+            w.report(rounds * pollsPerCycle, "poll");
+            printf("  every device verified in %d polls: %.1f us, against %.1f us per full search (%.0f%%)\n",
+                pollsPerCycle, perCycle, perSearch, perSearch ? 100.0 * perCycle / perSearch : 0.0);
+            if (watchAdded + watchRemoved != changesBefore) checkFailures++; // nothing changed
+        }
+    }
+
+    printf("\n%d workload checks failed\n", checkFailures);
+    printf("%d of %d measurements failed\n", failures, 3 * rounds * probes);
+    return (failures || checkFailures) ? 1 : 0;
+}
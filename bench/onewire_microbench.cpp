@@ -0,0 +1,306 @@
+/**
+ * @file onewire_microbench.cpp
+ * @brief Micro-benchmarks of the 1-Wire stack's hot primitives, with JSON output for comparing builds.
+ *
+ * Usage: onewire_microbench [min_msec_per_case]
+ *
+ * Covers CRC16 and the ENS210 CRC-7, each OneWire_Script_Add_* builder, the OneWire_Get_tXXX
+ * timing decoders, DS28E18 sequencer packet building (up to a 255-byte SPI write), a full 512-byte
+ * Write Sequencer, ENS210_Result_T conversions, ENS210_T::Init(), and a complete ENS210_T::Measure()
+ * (whose stack depth is the worst case of a task using the stack).
+ * The transport is the simulated DS2485 (DS2485_port_sim.c) with a simulated clock, so port
+ * configuration reads cost only the stack's own work and nothing waits.
+ *
+ * For each case the JSON output gives the time per operation, heap allocations per operation
+ * (malloc and operator new, counted with glibc), and the stack depth of one operation
+ * (measured on a painted stack, less the depth of an empty operation).
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <new>
+#include <ucontext.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "1wire/DS2485.h"
+#include "1wire/DS28E18.h"
+#include "1wire/one_wire.h"
+#include "1wire/one_wire_os.h"
+#include "ENS210/ENS210.hpp"
+#include "ENS210/ENS210_Result.hpp"
+
+/* **** Allocation counting **** */
+static bool countAllocations;
+static uint64_t allocations;
+
+#ifdef __GLIBC__
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t size);
+void __libc_free(void *p);
+void *malloc(size_t size)            { if (countAllocations) allocations++; return __libc_malloc(size); }
+void *calloc(size_t n, size_t size)  { if (countAllocations) allocations++; return __libc_calloc(n, size); }
+void *realloc(void *p, size_t size)  { if (countAllocations) allocations++; return __libc_realloc(p, size); }
+void free(void *p)                   { __libc_free(p); }
+}
+#endif
+void *operator new(size_t size)
+{
+    void *p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+/* **** Stack depth **** */
+static const size_t STACK_SIZE = 64 * 1024;
+static const uint8_t STACK_PAINT = 0xA5;
+static uint8_t probeStack[STACK_SIZE];
+static ucontext_t mainContext, probeContext;
+static void (*probeOperation)(void);
+
+static void runProbeOperation(void)
+{
+    probeOperation();
+}
+
+/// Bytes of stack used by one call of 'operation', including the context trampoline
+static size_t stackDepth(void (*operation)(void))
+{
+    memset(probeStack, STACK_PAINT, sizeof(probeStack));
+    probeOperation = operation;
+    getcontext(&probeContext);
+    probeContext.uc_stack.ss_sp = probeStack;
+    probeContext.uc_stack.ss_size = sizeof(probeStack);
+    probeContext.uc_link = &mainContext;
+    makecontext(&probeContext, runProbeOperation, 0);
+    swapcontext(&mainContext, &probeContext);
+    size_t untouched = 0;
+    while (untouched < sizeof(probeStack) && probeStack[untouched] == STACK_PAINT) untouched++; // stack grows down
+    return sizeof(probeStack) - untouched;
+}
+
+/* **** Cases **** */
+static volatile uint32_t sink;
+static volatile double sinkDouble;
+static uint8_t data64[64];
+static uint8_t data512[512];
+static uint8_t responseIndex;
+static const ENS210_Result_T ens210Result = [] {
+    ENS210_Result_T r;
+    r.status = ENS210_Result_T::Status_OK;
+    r.rawTemperature = (uint16_t)((21.5 + 273.15) * 64);
+    r.rawHumidity = (uint16_t)(45.0 * 512);
+    return r;
+}();
+
+static void empty(void) {}
+static void crc16Block8(void)   { sink = OneWire_CalculateCrc16Block(data64, 8, 0); }
+static void crc16Block64(void)  { sink = OneWire_CalculateCrc16Block(data64, 64, 0); }
+static void crc8Rom(void)       { sink = OneWire_CalculateCrc8(data64, 7); }
+static void ens210Crc7(void)    { sink = ENS210_T::crc7((1UL << 16) | sink); }
+
+static void scriptClear(void)   { OneWire_Script_Clear(); }
+static void addOwReset(void)    { OneWire_Script_Clear(); OneWire_Script_Add_OW_RESET(&responseIndex, STANDARD, false); }
+static void addWriteBit(void)   { OneWire_Script_Clear(); OneWire_Script_Add_OW_WRITE_BIT(&responseIndex, true); }
+static void addReadBit(void)    { OneWire_Script_Clear(); OneWire_Script_Add_OW_READ_BIT(&responseIndex); }
+static void addWriteByte(void)  { OneWire_Script_Clear(); OneWire_Script_Add_OW_WRITE_BYTE(&responseIndex, 0x66); }
+static void addReadByte(void)   { OneWire_Script_Clear(); OneWire_Script_Add_OW_READ_BYTE(&responseIndex); }
+static void addTriplet(void)    { OneWire_Script_Clear(); OneWire_Script_Add_OW_TRIPLET(&responseIndex, true); }
+static void addOvSkip(void)     { OneWire_Script_Clear(); OneWire_Script_Add_OV_SKIP(&responseIndex); }
+static void addSkip(void)       { OneWire_Script_Clear(); OneWire_Script_Add_SKIP(&responseIndex); }
+static void addReadBlock(void)  { OneWire_Script_Clear(); OneWire_Script_Add_OW_READ_BLOCK(&responseIndex, 32); }
+static void addWriteBlock(void) { OneWire_Script_Clear(); OneWire_Script_Add_OW_WRITE_BLOCK(&responseIndex, data64, 32); }
+static void addDelay(void)      { OneWire_Script_Clear(); OneWire_Script_Add_DELAY(1); }
+static void addPrimeSpu(void)   { OneWire_Script_Clear(); OneWire_Script_Add_PRIME_SPU(); }
+static void addSpuOff(void)     { OneWire_Script_Clear(); OneWire_Script_Add_SPU_OFF(); }
+static void addSpeed(void)      { OneWire_Script_Clear(); OneWire_Script_Add_SPEED(STANDARD, false); }
+static void addVerifyToggle(void) { OneWire_Script_Clear(); OneWire_Script_Add_VERIFY_TOGGLE(&responseIndex); }
+static void addVerifyByte(void) { OneWire_Script_Clear(); OneWire_Script_Add_VERIFY_BYTE(&responseIndex, 0xAA); }
+static void addCrc16Start(void) { OneWire_Script_Clear(); OneWire_Script_Add_CRC16_START(); }
+static void addVerifyCrc16(void) { OneWire_Script_Clear(); OneWire_Script_Add_VERIFY_CRC16(&responseIndex, 0xB001); }
+static void addSetGpio(void)    { OneWire_Script_Clear(); OneWire_Script_Add_SET_GPIO(&responseIndex, CONDUCTING); }
+static void addReadGpio(void)   { OneWire_Script_Clear(); OneWire_Script_Add_READ_GPIO(&responseIndex); }
+static void addVerifyGpio(void) { OneWire_Script_Clear(); OneWire_Script_Add_VERIFY_GPIO(&responseIndex, HIGH); }
+static void addConfigRpup(void) { OneWire_Script_Clear(); OneWire_Script_Add_CONFIG_RPUP_BUF(0x0000); }
+
+#define GET_TIMING(name_, speed_) \
+    static void get_##name_##_##speed_(void) { double t; OneWire_Get_##name_(&t, speed_); sinkDouble = t; }
+GET_TIMING(tRSTL, STANDARD) GET_TIMING(tRSTL, OVERDRIVE)
+GET_TIMING(tRSTH, STANDARD) GET_TIMING(tRSTH, OVERDRIVE)
+GET_TIMING(tW0L, STANDARD)  GET_TIMING(tW0L, OVERDRIVE)
+GET_TIMING(tREC, STANDARD)  GET_TIMING(tREC, OVERDRIVE)
+GET_TIMING(tMSI, STANDARD)  GET_TIMING(tMSI, OVERDRIVE)
+GET_TIMING(tMSP, STANDARD)  GET_TIMING(tMSP, OVERDRIVE)
+GET_TIMING(tW1L, STANDARD)  GET_TIMING(tW1L, OVERDRIVE)
+GET_TIMING(tMSR, STANDARD)  GET_TIMING(tMSR, OVERDRIVE)
+
+static void packetI2cWrite(void)   { DS28E18_BuildPacket_ClearSequencerPacket(); DS28E18_BuildPacket_I2C_WriteData(data64, 8); }
+static void packetI2cRead(void)    { DS28E18_BuildPacket_ClearSequencerPacket(); sink = DS28E18_BuildPacket_I2C_ReadData(8); }
+static void packetI2cReadNack(void) { DS28E18_BuildPacket_ClearSequencerPacket(); sink = DS28E18_BuildPacket_I2C_ReadDataWithNackEnd(8); }
+static void packetSpiByte(void)    { DS28E18_BuildPacket_ClearSequencerPacket(); sink = DS28E18_BuildPacket_SPI_WriteReadByte(data64, 4, 8, false); }
+static void packetSpiBit(void)     { DS28E18_BuildPacket_ClearSequencerPacket(); sink = DS28E18_BuildPacket_SPI_WriteReadBit(data64, 2, 12, 12); }
+static void packetSpiByte255(void) { DS28E18_BuildPacket_ClearSequencerPacket(); sink = DS28E18_BuildPacket_SPI_WriteReadByte(data512, 255, 8, true); }
+static void packetEns210Read(void) // as ENS210_T builds a temperature and humidity read
+{
+    static const uint8_t address[] = { 0x43 << 1, 0x30 };
+    static const uint8_t readAddress[] = { (0x43 << 1) | 1 };
+    DS28E18_BuildPacket_ClearSequencerPacket();
+    DS28E18_BuildPacket_I2C_Start();
+    DS28E18_BuildPacket_I2C_WriteData(address, sizeof(address));
+    DS28E18_BuildPacket_I2C_Start();
+    DS28E18_BuildPacket_I2C_WriteData(readAddress, sizeof(readAddress));
+    sink = DS28E18_BuildPacket_I2C_ReadDataWithNackEnd(6);
+    DS28E18_BuildPacket_I2C_Stop();
+}
+
+static void resultKelvin(void)      { sinkDouble = ens210Result.TempKelvin(); }
+static void resultCelsius(void)     { sinkDouble = ens210Result.TempCelsius(); }
+static void resultCelsiusX10(void)  { sink = ens210Result.TempCelsiusX10(); }
+static void resultFahrenheit(void)  { sinkDouble = ens210Result.TempFahrenheit(); }
+static void resultHumidity(void)    { sinkDouble = ens210Result.HumidityPercent(); }
+static void resultHumidityX10(void) { sink = ens210Result.HumidityPercentX10(); }
+static void resultAbsHumidity(void) { sinkDouble = ens210Result.AbsoluteHumidityPercent(); }
+
+static void writeSequencer512(void) { sink = DS28E18_WriteSequencer(DS28E18_GetDeviceHandle(0), 0, data512, 512); } // two commands
+
+static ENS210_T ens210;
+static void ens210Init(void)        { sink = ens210.Init(); } // loads and reads back sequences: the deepest path
+static void ens210Measure(void)     { sink = ens210.Measure().status; } // whole stack, down to the simulated DS2485
+
+struct Case {
+    const char *name;
+    void (*operation)(void);
+};
+
+#define CASE(name_, fn_) { name_, fn_ }
+static const Case cases[] = {
+    CASE("crc16_block_8", crc16Block8),
+    CASE("crc16_block_64", crc16Block64),
+    CASE("crc8_rom_id", crc8Rom),
+    CASE("ens210_crc7", ens210Crc7),
+    CASE("script_clear", scriptClear),
+    CASE("script_add_ow_reset", addOwReset),
+    CASE("script_add_ow_write_bit", addWriteBit),
+    CASE("script_add_ow_read_bit", addReadBit),
+    CASE("script_add_ow_write_byte", addWriteByte),
+    CASE("script_add_ow_read_byte", addReadByte),
+    CASE("script_add_ow_triplet", addTriplet),
+    CASE("script_add_ov_skip", addOvSkip),
+    CASE("script_add_skip", addSkip),
+    CASE("script_add_ow_read_block_32", addReadBlock),
+    CASE("script_add_ow_write_block_32", addWriteBlock),
+    CASE("script_add_delay", addDelay),
+    CASE("script_add_prime_spu", addPrimeSpu),
+    CASE("script_add_spu_off", addSpuOff),
+    CASE("script_add_speed", addSpeed),
+    CASE("script_add_verify_toggle", addVerifyToggle),
+    CASE("script_add_verify_byte", addVerifyByte),
+    CASE("script_add_crc16_start", addCrc16Start),
+    CASE("script_add_verify_crc16", addVerifyCrc16),
+    CASE("script_add_set_gpio", addSetGpio),
+    CASE("script_add_read_gpio", addReadGpio),
+    CASE("script_add_verify_gpio", addVerifyGpio),
+    CASE("script_add_config_rpup_buf", addConfigRpup),
+    CASE("get_tRSTL_standard", get_tRSTL_STANDARD), CASE("get_tRSTL_overdrive", get_tRSTL_OVERDRIVE),
+    CASE("get_tRSTH_standard", get_tRSTH_STANDARD), CASE("get_tRSTH_overdrive", get_tRSTH_OVERDRIVE),
+    CASE("get_tW0L_standard", get_tW0L_STANDARD),   CASE("get_tW0L_overdrive", get_tW0L_OVERDRIVE),
+    CASE("get_tREC_standard", get_tREC_STANDARD),   CASE("get_tREC_overdrive", get_tREC_OVERDRIVE),
+    CASE("get_tMSI_standard", get_tMSI_STANDARD),   CASE("get_tMSI_overdrive", get_tMSI_OVERDRIVE),
+    CASE("get_tMSP_standard", get_tMSP_STANDARD),   CASE("get_tMSP_overdrive", get_tMSP_OVERDRIVE),
+    CASE("get_tW1L_standard", get_tW1L_STANDARD),   CASE("get_tW1L_overdrive", get_tW1L_OVERDRIVE),
+    CASE("get_tMSR_standard", get_tMSR_STANDARD),   CASE("get_tMSR_overdrive", get_tMSR_OVERDRIVE),
+    CASE("ds28e18_packet_i2c_write_8", packetI2cWrite),
+    CASE("ds28e18_packet_i2c_read_8", packetI2cRead),
+    CASE("ds28e18_packet_i2c_read_nack_end_8", packetI2cReadNack),
+    CASE("ds28e18_packet_spi_write_read_byte", packetSpiByte),
+    CASE("ds28e18_packet_spi_write_read_bit", packetSpiBit),
+    CASE("ds28e18_packet_spi_write_read_byte_255", packetSpiByte255),
+    CASE("ds28e18_packet_ens210_read", packetEns210Read),
+    CASE("ens210_result_kelvin", resultKelvin),
+    CASE("ens210_result_celsius", resultCelsius),
+    CASE("ens210_result_celsius_x10", resultCelsiusX10),
+    CASE("ens210_result_fahrenheit", resultFahrenheit),
+    CASE("ens210_result_humidity", resultHumidity),
+    CASE("ens210_result_humidity_x10", resultHumidityX10),
+    CASE("ens210_result_absolute_humidity", resultAbsHumidity),
+    CASE("ds28e18_write_sequencer_512", writeSequencer512), // before ens210_init, which reloads the ENS210's sequences
+    CASE("ens210_init", ens210Init),
+    CASE("ens210_measure", ens210Measure),
+};
+
+static uint64_t now_nsec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+    int minMsec = (argc > 1) ? atoi(argv[1]) : 20;
+    if (minMsec < 1)
+    {
+        fprintf(stderr, "usage: %s [min_msec_per_case]\n", argv[0]);
+        return 2;
+    }
+    for (size_t i = 0; i < sizeof(data64); i++) data64[i] = (uint8_t)(i * 37 + 11);
+    for (size_t i = 0; i < sizeof(data512); i++) data512[i] = (uint8_t)(i * 13 + 5);
+
+    OneWire_OS_UseSimulatedClock(true);
+    DS2485_sim_config_T config = { 1, 21.0, 45.0 };
+    DS2485_Sim_Start(&config);
+    int error = OneWire_Init();
+    if (error)
+    {
+        fprintf(stderr, "OneWire_Init failed: %d\n", error);
+        return 1;
+    }
+    // ENS210_T::Init reports what it found on stdout; keep stdout for the JSON only
+    fflush(stdout);
+    FILE *json = fdopen(dup(STDOUT_FILENO), "w");
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+    close(devNull);
+    if (!json || !ens210.Init())
+    {
+        fprintf(stderr, "ENS210_T::Init failed\n");
+        return 1;
+    }
+
+    size_t baseDepth = stackDepth(empty);
+    fprintf(json, "{\n  \"benchmark\": \"onewire_microbench\",\n  \"min_msec_per_case\": %d,\n  \"results\": [\n", minMsec);
+    const size_t count = sizeof(cases) / sizeof(cases[0]);
+    for (size_t c = 0; c < count; c++)
+    {
+        const Case &k = cases[c];
+        k.operation(); // warm up
+
+        countAllocations = true;
+        allocations = 0;
+        uint64_t iterations = 0;
+        uint64_t batch = 16;
+        uint64_t start = now_nsec(), elapsed;
+        do {
+            for (uint64_t i = 0; i < batch; i++) k.operation();
+            iterations += batch;
+            if (batch < (1U << 20)) batch *= 2;
+            elapsed = now_nsec() - start;
+        } while (elapsed < (uint64_t)minMsec * 1000000U);
+        countAllocations = false;
+
+        size_t depth = stackDepth(k.operation);
+        fprintf(json, "    {\"name\": \"%s\", \"ns_per_op\": %.2f, \"iterations\": %llu, \"allocations_per_op\": %.3f, \"stack_bytes\": %zu}%s\n",
+            k.name, (double)elapsed / iterations, (unsigned long long)iterations, (double)allocations / iterations,
+            depth > baseDepth ? depth - baseDepth : 0, (c + 1 < count) ? "," : "");
+    }
+    fprintf(json, "  ]\n}\n");
+    fclose(json);
+    return 0;
+}
@@ -0,0 +1,162 @@
+/**
+ * @file test_DS2485_port_linux.c
+ * @brief Tests of the Linux i2c-dev port (DS2485_port_linux.c) against a fake i2c-dev file descriptor.
+ *
+ * Linked with -Wl,--wrap=open,--wrap=close,--wrap=ioctl: the port's system calls land in the
+ * __wrap_ functions below, which record each I2C message and answer as a DS2485 would.
+ * Run by ctest (test_DS2485_port_linux), exits non-zero on a failure.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "DS2485.h"
+
+static int failures;
+
+#define CHECK(condition_) \
+    do { if (!(condition_)) { failures++; printf("  FAILED %s:%d: %s\n", __FILE__, __LINE__, #condition_); } } while (0)
+
+/* **** Fake i2c-dev **** */
+#define FAKE_FD_BASE 100
+
+static int opens, closes;
+static char openedDevice[4][32];
+static bool closed[4];
+static int writeErrno, readErrno;   // errno for the next write or read, 0 to succeed
+static uint8_t lastWrite[16];
+static int lastWriteLength;
+static uint16_t lastAddress;
+static int lastFd;
+static uint8_t reply[16] = { 0x01, 0xAA }; // length, result
+
+int __wrap_open(const char *path, int flags, ...)
+{
+    (void)flags;
+    if (opens >= 4) return -1;
+    snprintf(openedDevice[opens], sizeof(openedDevice[0]), "%s", path);
+    return FAKE_FD_BASE + opens++;
+}
+
+int __wrap_close(int fd)
+{
+    int i = fd - FAKE_FD_BASE;
+    if (i < 0 || i >= opens || closed[i]) return -1;
+    closed[i] = true;
+    closes++;
+    return 0;
+}
+
+int __wrap_ioctl(int fd, unsigned long request, ...)
+{
+    va_list args;
+    va_start(args, request);
+    struct i2c_rdwr_ioctl_data *rdwr = va_arg(args, struct i2c_rdwr_ioctl_data *);
+    va_end(args);
+    if (request != I2C_RDWR || rdwr->nmsgs != 1) return -1;
+    struct i2c_msg *msg = &rdwr->msgs[0];
+    lastFd = fd;
+    lastAddress = msg->addr;
+    int *error = (msg->flags & I2C_M_RD) ? &readErrno : &writeErrno;
+    if (*error)
+    {
+        errno = *error;
+        *error = 0;
+        return -1;
+    }
+    if (msg->flags & I2C_M_RD)
+    {
+        memcpy(msg->buf, reply, (msg->len < sizeof(reply)) ? msg->len : sizeof(reply));
+    }
+    else
+    {
+        lastWriteLength = (msg->len < sizeof(lastWrite)) ? msg->len : (int)sizeof(lastWrite);
+        memcpy(lastWrite, msg->buf, lastWriteLength);
+    }
+    return 1; // messages transferred
+}
+
+/* **** Tests **** */
+static const uint8_t packet[] = { 0x75, 0x01, 0x00 }; // Read One Wire Port Config, register 0
+
+static void testBuses(void)
+{
+    CHECK(DS2485_Linux_AddBus("/dev/i2c-3", 0x40) == 0);
+    CHECK(DS2485_Linux_AddBus("/dev/i2c-3", 0x41) == 1); // same adapter: shares its fd
+    CHECK(DS2485_Linux_AddBus("/dev/i2c-5", 0x40) == 2);
+    CHECK(opens == 2);
+    CHECK(strcmp(openedDevice[0], "/dev/i2c-3") == 0 && strcmp(openedDevice[1], "/dev/i2c-5") == 0);
+    CHECK(DS2485_Linux_SelectBus(3) == RB_INVALID_PARAMETER);
+
+    uint8_t response[2];
+    CHECK(DS2485_Linux_SelectBus(1) == 0);
+    CHECK(DS2485_ExecuteCommand(packet, sizeof(packet), 0, response, sizeof(response)) == 0);
+    CHECK(lastFd == FAKE_FD_BASE && lastAddress == 0x41);
+    CHECK(lastWriteLength == (int)sizeof(packet) && memcmp(lastWrite, packet, sizeof(packet)) == 0);
+    CHECK(response[0] == 0x01 && response[1] == 0xAA);
+
+    CHECK(DS2485_Linux_SelectBus(2) == 0);
+    CHECK(DS2485_ExecuteCommand(packet, sizeof(packet), 0, response, sizeof(response)) == 0);
+    CHECK(lastFd == FAKE_FD_BASE + 1 && lastAddress == 0x40);
+}
+
+static void testErrors(void)
+{
+    uint8_t response[2];
+    DS2485_port_stats_T stats;
+    DS2485_ResetPortStats();
+    CHECK(DS2485_Linux_SelectBus(0) == 0);
+
+    readErrno = ENXIO; // address NAK'd: still executing
+    CHECK(DS2485_ExecuteCommand(packet, sizeof(packet), 0, response, sizeof(response)) == RB_NOT_READY);
+    readErrno = EREMOTEIO;
+    CHECK(DS2485_ExecuteCommand(packet, sizeof(packet), 0, response, sizeof(response)) == RB_NOT_READY);
+    readErrno = EREMOTEIO;
+    CHECK(DS2485_ReadResponse(0, response, sizeof(response)) == RB_NOT_READY);
+    CHECK(DS2485_ReadResponse(0, response, sizeof(response)) == 0);
+    DS2485_GetPortStats(&stats);
+    CHECK(stats.busErrors == 0 && stats.failures == 0);
+
+    writeErrno = ENXIO; // write NAK'd: the command was not accepted
+    CHECK(DS2485_ExecuteCommand(packet, sizeof(packet), 0, response, sizeof(response)) == RB_COMMS_FAIL);
+    readErrno = EIO;    // anything else is a bus error
+    CHECK(DS2485_ExecuteCommand(packet, sizeof(packet), 0, response, sizeof(response)) == RB_COMMS_FAIL);
+    DS2485_GetPortStats(&stats);
+    CHECK(stats.commands == 4 && stats.busErrors == 1 && stats.failures == 2);
+}
+
+static void testClose(void)
+{
+    DS2485_Linux_CloseAll();
+    CHECK(closes == 2); // each adapter once, though two buses share the first
+    CHECK(closed[0] && closed[1]);
+    CHECK(DS2485_Linux_SelectBus(0) == RB_INVALID_PARAMETER);
+}
+
+int main(void)
+{
+    static const struct {
+        const char *name;
+        void (*run)(void);
+    } tests[] = {
+        { "buses", testBuses },
+        { "errors", testErrors },
+        { "close", testClose },
+    };
+    for (size_t t = 0; t < sizeof(tests) / sizeof(tests[0]); t++)
+    {
+        int before = failures;
+        tests[t].run();
+        printf("%-16s %s\n", tests[t].name, (failures == before) ? "ok" : "FAILED");
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * @file test_DS2485_trace.cpp
+ * @brief Record and replay (DS2485_trace.h): ENS210 measurements recorded against the simulator, then replayed.
+ *
+ * Built twice: test_DS2485_trace_record (simulator port, DS2485_TRACE) runs ENS210 Init and several
+ * Measures and saves the log and their results to the file named on the command line;
+ * test_DS2485_trace_replay (replay port) runs the same calls against that log at timeScale 0 and
+ * checks every result matches, with no mismatched call and the whole log used.
+ * Run by ctest in that order; exits non-zero on a failure.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include "1wire/DS2485.h"
+#include "1wire/DS2485_trace.h"
+#include "1wire/one_wire_os.h"
+#include "ENS210/ENS210.hpp"
+
+#define PROBES  2
+#define ROUNDS  4
+
+static int failures;
+
+#define CHECK(condition_) \
+    do { if (!(condition_)) { failures++; printf("  FAILED %s:%d: %s\n", __FILE__, __LINE__, #condition_); } } while (0)
+
+typedef struct {
+    int32_t status, tempX10, humidityX10;
+} measurement_T;
+
+// The calls recorded and replayed: bring up the bus and each probe, then measure each probe ROUNDS times
+static std::vector<measurement_T> run()
+{
+    std::vector<measurement_T> results;
+    std::vector<ENS210_T> sensors;
+    sensors.reserve(PROBES); // not moved once constructed (each holds a mutex)
+    for (int i = 0; i < PROBES; i++) sensors.emplace_back(ENS210_T::Mode_Continuous, false, i);
+    for (ENS210_T &s : sensors) CHECK(s.Init());
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        for (ENS210_T &s : sensors)
+        {
+            ENS210_Result_T r = s.Measure();
+            results.push_back({ (int32_t)r.status, (int32_t)r.TempCelsiusX10(), (int32_t)r.HumidityPercentX10() });
+        }
+    }
+    return results;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        printf("usage: %s trace-file\n", argv[0]);
+        return 2;
+    }
+    OneWire_OS_UseSimulatedClock(true); // the stack's own delays do not sleep either
+#ifdef DS2485_TRACE
+    // Record: log, then the results as recorded
+    static uint8_t log[1 << 20];
+    DS2485_sim_config_T config = { PROBES, 21.0, 45.0 };
+    DS2485_Sim_Start(&config);
+    DS2485_Trace_StartRecording(log, sizeof(log));
+    std::vector<measurement_T> results = run();
+    bool complete;
+    uint32_t length = (uint32_t)DS2485_Trace_StopRecording(&complete);
+    CHECK(complete);
+    for (const measurement_T &m : results) CHECK(m.status == ENS210_Result_T::Status_OK);
+    FILE *f = fopen(argv[1], "wb");
+    CHECK(f != NULL);
+    if (!f) return 1;
+    uint32_t count = (uint32_t)results.size();
+    CHECK(fwrite(&length, sizeof(length), 1, f) == 1 && fwrite(log, 1, length, f) == length);
+    CHECK(fwrite(&count, sizeof(count), 1, f) == 1 && fwrite(results.data(), sizeof(measurement_T), count, f) == count);
+    fclose(f);
+    printf("recorded %u bytes, %u measurements\n", (unsigned)length, (unsigned)count);
+#else
+    // Replay: the same calls answered from the log must give the same results
+    FILE *f = fopen(argv[1], "rb");
+    CHECK(f != NULL);
+    if (!f) return 1;
+    uint32_t length = 0, count = 0;
+    CHECK(fread(&length, sizeof(length), 1, f) == 1);
+    std::vector<uint8_t> log(length);
+    CHECK(fread(log.data(), 1, length, f) == length);
+    CHECK(fread(&count, sizeof(count), 1, f) == 1);
+    std::vector<measurement_T> recorded(count);
+    CHECK(fread(recorded.data(), sizeof(measurement_T), count, f) == count);
+    fclose(f);
+
+    CHECK(DS2485_Replay_Start(log.data(), log.size(), 0.0) == 0);
+    std::vector<measurement_T> results = run();
+    CHECK(results.size() == recorded.size());
+    for (size_t i = 0; i < results.size() && i < recorded.size(); i++)
+    {
+        CHECK(results[i].status == recorded[i].status);
+        CHECK(results[i].tempX10 == recorded[i].tempX10);
+        CHECK(results[i].humidityX10 == recorded[i].humidityX10);
+    }
+    DS2485_replay_status_T status;
+    DS2485_Replay_GetStatus(&status);
+    CHECK(status.mismatches == 0);
+    CHECK(status.ended);
+    printf("replayed %u records, %u mismatches\n", (unsigned)status.records, (unsigned)status.mismatches);
+#endif
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,240 @@
+/**
+ * @file test_onewire_sim.cpp
+ * @brief Tests of the 1-Wire stack and ENS210 driver against the simulated DS2485 (DS2485_port_sim.c).
+ *
+ * Each test starts a fresh simulated bus; run by ctest (test_onewire_sim), exits non-zero on a failure.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "1wire/DS2485.h"
+#include "1wire/DS28E18.h"
+#include "1wire/one_wire.h"
+#include "1wire/one_wire_os.h"
+#include "1wire/one_wire_stats.h"
+#include "1wire/one_wire_watch.h"
+#include "ENS210/ENS210.hpp"
+
+static int failures;
+
+#define CHECK(condition_) \
+    do { if (!(condition_)) { failures++; printf("  FAILED %s:%d: %s\n", __FILE__, __LINE__, #condition_); } } while (0)
+
+// Fresh simulated bus of 'probes' DS28E18 + ENS210, with the DS2485 initialized
+static void startBus(int probes)
+{
+    OneWire_OS_UseSimulatedClock(true);
+    DS2485_sim_config_T config = { probes, 21.0, 45.0 };
+    DS2485_Sim_Start(&config);
+    CHECK(OneWire_Init() == 0);
+}
+
+static void testEnumerate()
+{
+    startBus(3);
+    CHECK(DS28E18_Init() == 3);
+    CHECK(DS28E18_GetDeviceTable()->count == 3);
+    CHECK(!DS28E18_GetDeviceTable()->truncated);
+
+    DS28E18_SetOnewireSpeed(STANDARD); // searches are at standard speed
+    OneWire_ROM_table_T table;
+    CHECK(OneWire_SearchTable(&table, ONEWIRE_SEARCH_NORMAL, DS28E18_FAMILY_CODE) == 0);
+    CHECK(table.count == 3);
+}
+
+static void testMeasure()
+{
+    startBus(3);
+    std::vector<ENS210_T> sensors;
+    sensors.reserve(3); // not moved once constructed (each holds a mutex)
+    for (int i = 0; i < 3; i++) sensors.emplace_back(ENS210_T::Mode_Continuous, false, i);
+    for (ENS210_T &s : sensors) CHECK(s.Init());
+
+    // Each probe's Init addresses only its own DS28E18: the first probe keeps its 1.2k pull-ups
+    uint8_t gpio[4] = { 0 };
+    CHECK(DS28E18_ReadGpioConfiguration(DS28E18_GetDeviceHandle(0), CONTROL, gpio));
+    CHECK(gpio[0] == 0xF0 && gpio[1] == 0x0F);
+
+    for (int round = 0; round < 3; round++)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            ENS210_Result_T r = sensors[i].Measure();
+            int probe = DS28E18_GetDeviceTable()->romID[i].ID[1] - 1;
+            int expected = 210 + 5 * probe; // the simulator sets each probe 0.5 C warmer than the one before
+            CHECK(r.status == ENS210_Result_T::Status_OK);
+            CHECK(r.TempCelsiusX10() >= expected - 2 && r.TempCelsiusX10() <= expected + 2);
+            CHECK(r.HumidityPercentX10() >= 445 && r.HumidityPercentX10() <= 455);
+            // The rerun waits as modeled for the sequence loaded in that device, whatever was built since
+            CHECK(DS28E18_GetLastRunTiming()->modeled);
+        }
+    }
+
+    ENS210_T single(ENS210_T::Mode_SingleShot, false, 1);
+    CHECK(single.Init());
+    CHECK(single.Measure().status == ENS210_Result_T::Status_OK);
+    CHECK(single.Measure().status == ENS210_Result_T::Status_OK);
+}
+
+// A failed read-back leaves the loaded sequence in place: the next rerun still waits its modeled time
+static void testFailedReadback()
+{
+    startBus(2);
+    CHECK(DS28E18_Init() == 2); // ENS210_T brings up the bus only once
+    ENS210_T single(ENS210_T::Mode_SingleShot, false, 0);
+    CHECK(single.Init());
+    CHECK(single.Measure().status == ENS210_Result_T::Status_OK);
+    CHECK(single.Measure().status == ENS210_Result_T::Status_OK);
+
+    int probe = DS28E18_GetDeviceTable()->romID[0].ID[1] - 1;
+    DS2485_Sim_CorruptResponses(probe, READ_SEQUENCER, 2); // at overdrive, and the retry at standard speed
+    CHECK(single.Measure().status == ENS210_Result_T::Status_I2C_error);
+    CHECK(single.Measure().status == ENS210_Result_T::Status_OK);
+    CHECK(DS28E18_GetLastRunTiming()->modeled);
+    CHECK(DS28E18_GetLastRunTiming()->estimated_uSec >= 130000); // the single-shot conversion time
+}
+
+// A port sleeping longer than asked must not widen the learned delay margins: the first read was answered
+static void testOversleep()
+{
+    startBus(1);
+    CHECK(DS28E18_Init() == 1);
+    OneWire_handle_T device = DS28E18_GetDeviceHandle(0);
+    uint8_t gpio[4];
+    DS2485_ResetDelayLearning();
+    DS2485_SetDelayLearning(true);
+    for (int i = 0; i < 2 * DS2485_LEARN_MIN_SAMPLES; i++) CHECK(DS28E18_ReadGpioConfiguration(device, CONTROL, gpio));
+    DS2485_SetDelayLearning(false);
+
+    DS2485_delay_stats_T before[DS2485_CLASS_COUNT], after;
+    for (int c = 0; c < DS2485_CLASS_COUNT; c++) DS2485_GetDelayStats((DS2485_command_class_T)c, &before[c]);
+    CHECK(before[DS2485_CLASS_SCRIPT].samples >= DS2485_LEARN_MIN_SAMPLES);
+    DS2485_Sim_SetOversleep(3 * DS2485_POLL_USEC);
+    for (int i = 0; i < 100; i++) CHECK(DS28E18_ReadGpioConfiguration(device, CONTROL, gpio));
+    DS2485_Sim_SetOversleep(0);
+    for (int c = 0; c < DS2485_CLASS_COUNT; c++)
+    {
+        DS2485_GetDelayStats((DS2485_command_class_T)c, &after);
+        CHECK(after.earlyReads == before[c].earlyReads);
+        CHECK(after.margin_uSec == before[c].margin_uSec);
+    }
+    DS2485_ResetDelayLearning();
+}
+
+static void testSequencerCache()
+{
+    startBus(1);
+    CHECK(DS28E18_Init() == 1);
+    OneWire_handle_T device = DS28E18_GetDeviceHandle(0);
+    OneWire_bus_stats_T stats;
+    OneWire_Stats_Snapshot(0, &stats, true);
+    for (int i = 0; i < 2; i++)
+    {
+        DS28E18_BuildPacket_ClearSequencerPacket();
+        DS28E18_BuildPacket_Utility_GpioControlWrite(0xF0, 0x0F);
+        DS28E18_BuildPacket_Utility_Delay(DELAY_1msec);
+        CHECK(DS28E18_BuildPacket_WriteAndRun(device));
+    }
+    OneWire_Stats_Snapshot(0, &stats, false);
+    CHECK(stats.sequencerUploadsSkipped == 1);
+
+    // A block equal to the one uploaded before is not what the device holds if a run read into it since:
+    // first an ENS210 read fills the second block, then that block's 0xFFs are SPI flash address bytes
+    static const uint8_t readRegisters[] = {
+        UTILITY_SENS_VDD_ON, I2C_START, I2C_WRITE_DATA, 2, 0x86, 0x00, I2C_START, I2C_WRITE_DATA, 1, 0x87,
+        I2C_READ_DATA_W_NACK_END, 116 // read slots up to address 127
+    };
+    DS28E18_BuildPacket_ClearSequencerPacket();
+    DS28E18_BuildPacket_Append(readRegisters, sizeof(readRegisters));
+    std::vector<uint8_t> slots(116, 0xFF);
+    DS28E18_BuildPacket_Append(slots.data(), slots.size());
+    CHECK(DS28E18_BuildPacket_WriteAndRun(device));
+
+    DS28E18_BuildPacket_ClearSequencerPacket();
+    for (int i = 0; i < 59; i++) DS28E18_BuildPacket_SPI_SlaveSelectHigh();
+    DS28E18_BuildPacket_SPI_SlaveSelectLow();
+    uint8_t readFlash[65];
+    memset(readFlash, 0xFF, sizeof(readFlash));
+    readFlash[0] = 0x03; // Read Data at address 0xFFFFFF, from the second block
+    unsigned short readIdx = DS28E18_BuildPacket_SPI_WriteReadByte(readFlash, sizeof(readFlash), 16, true);
+    DS28E18_BuildPacket_SPI_SlaveSelectHigh();
+    CHECK(DS28E18_BuildPacket_WriteAndRun(device));
+    uint8_t data[16];
+    CHECK(DS28E18_ReadSequencer(device, readIdx, data, sizeof(data)));
+    for (int k = 4; k < 16; k++) CHECK(data[k] == DS2485_Sim_SpiFlashByte(0, 0xFFFFFF + k - 4));
+}
+
+static void testSpiStream()
+{
+    startBus(2);
+    CHECK(DS28E18_Init() == 2);
+    OneWire_handle_T device = DS28E18_GetDeviceHandle(1);
+    int probe = DS28E18_GetDeviceTable()->romID[1].ID[1] - 1; // the simulator numbers probes in ROM ID byte 1
+    CHECK(DS28E18_WriteConfiguration(device, KHZ_2300, DONT_IGNORE, SPI, MODE_0));
+
+    const DS28E18_spi_stream_T flashRead = { { 0x03 }, 1, 3 }; // Read Data, 24-bit address
+    static uint8_t data[1000]; // several chunks and a short last one
+    CHECK(DS28E18_SPI_StreamRead(device, &flashRead, 0x1234, data, sizeof(data)));
+    int wrong = 0;
+    for (int i = 0; i < (int)sizeof(data); i++)
+    {
+        if (data[i] != DS2485_Sim_SpiFlashByte(probe, 0x1234 + i)) wrong++;
+    }
+    CHECK(wrong == 0);
+}
+
+static int watchAdded, watchRemoved;
+
+static void watchEvent(OneWire_watch_event_T event, const OneWire_ROM_ID_T *romid)
+{
+    (void)romid;
+    if (event == ONEWIRE_WATCH_ADDED) watchAdded++;
+    else watchRemoved++;
+}
+
+static void testWatch()
+{
+    startBus(4);
+    CHECK(DS28E18_Init() == 4);
+    DS28E18_SetOnewireSpeed(STANDARD);
+    const OneWire_ROM_table_T *known = DS28E18_GetDeviceTable();
+    watchAdded = watchRemoved = 0;
+    OneWire_Watch_Start(known->romID, known->count, DS28E18_FAMILY_CODE, watchEvent);
+    for (int poll = 0; poll < 4; poll++) CHECK(OneWire_Watch_Poll() == 0);
+    CHECK(watchAdded == 0 && watchRemoved == 0);
+
+    DS2485_Sim_ConnectProbe(2, false);
+    for (int poll = 0; poll < 8 && watchRemoved == 0; poll++) OneWire_Watch_Poll();
+    CHECK(watchRemoved == 1);
+    DS2485_Sim_ConnectProbe(2, true);
+    for (int poll = 0; poll < 8 && watchAdded == 0; poll++) OneWire_Watch_Poll();
+    CHECK(watchAdded == 1);
+    const OneWire_ROM_ID_T *devices;
+    CHECK(OneWire_Watch_GetDevices(&devices) == 4);
+}
+
+int main()
+{
+    static const struct {
+        const char *name;
+        void (*run)();
+    } tests[] = {
+        { "enumerate", testEnumerate },
+        { "measure", testMeasure },
+        { "failed read-back", testFailedReadback },
+        { "oversleep", testOversleep },
+        { "sequencer cache", testSequencerCache },
+        { "SPI stream", testSpiStream },
+        { "watch", testWatch },
+    };
+    for (const auto &t : tests)
+    {
+        int before = failures;
+        t.run();
+        printf("%-16s %s\n", t.name, (failures == before) ? "ok" : "FAILED");
+    }
+    return failures ? 1 : 0;
+}